@@ -0,0 +1,38 @@
+#include "adv_monitor.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::vector<MonitorPattern> buildMonitorPatterns(const SchemaIndex* schema)
+{
+    std::vector<MonitorPattern> patterns;
+    patterns.push_back(MonitorPattern{0, AD_SERVICE_DATA_16,
+                                      {static_cast<uint8_t>(BTHOME_UUID16 & 0xFF), static_cast<uint8_t>(BTHOME_UUID16 >> 8)}});
+    if (!schema) return patterns;
+
+    for (const auto& dev : schema->devices) {
+        // The name fills the whole structure: type byte + name <= 31
+        if (dev.name.empty() || dev.name.size() > AD_MAX_PAYLOAD - 2) continue;
+        MonitorPattern p{0, AD_COMPLETE_NAME, std::vector<uint8_t>(dev.name.begin(), dev.name.end())};
+        if (std::find(patterns.begin(), patterns.end(), p) == patterns.end()) patterns.push_back(std::move(p));
+    }
+    return patterns;
+}
+
+bool matchesAny(const std::vector<MonitorPattern>& patterns, const uint8_t* adv, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t fieldLen = adv[pos];
+        if (fieldLen == 0 || pos + 1 + fieldLen > len) break;
+        uint8_t type = adv[pos + 1];
+        const uint8_t* data = adv + pos + 2;
+        size_t dataLen = fieldLen - 1u;
+        for (const auto& p : patterns) {
+            if (p.adType != type || p.start + p.content.size() > dataLen) continue;
+            if (std::memcmp(data + p.start, p.content.data(), p.content.size()) == 0) return true;
+        }
+        pos += 1u + fieldLen;
+    }
+    return false;
+}
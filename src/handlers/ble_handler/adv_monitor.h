@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "device_schema.h"
+
+// Passive scanning through BlueZ advertisement monitors
+// (org.bluez.AdvertisementMonitor1, type "or_patterns"). The handler
+// registers a monitor whose patterns match the advertisements it cares
+// about. bluetoothd filters on the controller when it supports that (MSFT
+// extension) or in the daemon otherwise. Only matching devices create
+// objects and signals; with active discovery every phone and tag nearby
+// does.
+//
+// A pattern matches an advertisement if one AD structure of its type
+// carries its bytes at its start position. Patterns are ORed. Addresses
+// cannot be matched (they are not in the AD data), so the patterns are:
+//
+//   - BTHome service data (AD 0x16, UUID 0xFCD2), for sensors that
+//     broadcast their readings
+//   - the complete local name (AD 0x09) of every device in
+//     devices_config.json
+//
+// DeviceFound/DeviceLost for devices outside the registry are counted as
+// foreign and otherwise ignored.
+
+constexpr uint8_t AD_COMPLETE_NAME = 0x09;
+constexpr uint8_t AD_SERVICE_DATA_16 = 0x16;
+constexpr uint16_t BTHOME_UUID16 = 0xFCD2;
+constexpr size_t AD_MAX_PAYLOAD = 31;   // legacy advertising data
+
+struct MonitorPattern {
+    uint8_t start = 0;
+    uint8_t adType = 0;
+    std::vector<uint8_t> content;   // 1..31 bytes
+
+    bool operator==(const MonitorPattern& other) const {
+        return start == other.start && adType == other.adType && content == other.content;
+    }
+};
+
+// RSSI filter of the monitor. A device is found once it is above high for
+// highTimeoutS and lost once it is below low for lowTimeoutS. Sampling
+// period is in 100 ms units. 0 forwards every advertisement, which BTHome
+// readings need.
+struct MonitorRssi {
+    int16_t low = -95;
+    int16_t high = -85;
+    uint16_t lowTimeoutS = 30;
+    uint16_t highTimeoutS = 2;
+    uint16_t samplingPeriod = 0;
+};
+
+// Patterns for the configured devices, without duplicates
+std::vector<MonitorPattern> buildMonitorPatterns(const SchemaIndex* schema);
+
+// The match bluetoothd performs, over raw advertising data (length, type,
+// data structures); for estimating what a pattern set lets through
+bool matchesAny(const std::vector<MonitorPattern>& patterns, const uint8_t* adv, size_t len);
+
+class AdvMonitorStats {
+public:
+    void found(bool registered) { (registered ? foundCount : foreignCount).fetch_add(1, std::memory_order_relaxed); }
+    void lost() { lostCount.fetch_add(1, std::memory_order_relaxed); }
+    void activated() { activeCount.fetch_add(1, std::memory_order_relaxed); }
+    void released() { releaseCount.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t devicesFound() const { return foundCount.load(std::memory_order_relaxed); }
+    uint64_t foreign() const { return foreignCount.load(std::memory_order_relaxed); }
+    uint64_t devicesLost() const { return lostCount.load(std::memory_order_relaxed); }
+    uint64_t activations() const { return activeCount.load(std::memory_order_relaxed); }
+    uint64_t releases() const { return releaseCount.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> foundCount{0};
+    std::atomic<uint64_t> foreignCount{0};
+    std::atomic<uint64_t> lostCount{0};
+    std::atomic<uint64_t> activeCount{0};
+    std::atomic<uint64_t> releaseCount{0};
+};
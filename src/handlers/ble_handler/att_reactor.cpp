@@ -0,0 +1,274 @@
+#include "att_reactor.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Largest ATT value (512) plus headroom; one seqpacket read is one value
+constexpr size_t READ_BUFFER_BYTES = 1024;
+
+uint64_t eventData(uint32_t slot, uint32_t generation)
+{
+    return (static_cast<uint64_t>(generation) << 32) | slot;
+}
+
+} // namespace
+
+AttReactor::~AttReactor()
+{
+    stop();
+}
+
+bool AttReactor::start(NotifyHandler onNotify, ClosedHandler onClosed)
+{
+    if (thread.joinable()) return true;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = UINT64_MAX;
+    if (epollFd < 0 || wakeFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) != 0) {
+        std::cerr << "[ATT] epoll unavailable: " << std::strerror(errno) << std::endl;
+        if (epollFd >= 0) close(epollFd);
+        if (wakeFd >= 0) close(wakeFd);
+        epollFd = wakeFd = -1;
+        return false;
+    }
+
+    notifyHandler = std::move(onNotify);
+    closedHandler = std::move(onClosed);
+    readBuffer.resize(READ_BUFFER_BYTES);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        slots.assign(MAX_CHANNELS, Channel{});
+        freeSlots.clear();
+        for (uint32_t i = MAX_CHANNELS; i-- > 0;) freeSlots.push_back(i);
+        slotByKey.reserve(MAX_CHANNELS);
+    }
+    stopRequested = false;
+    thread = std::thread([this]() { loop(); });
+    return true;
+}
+
+void AttReactor::stop()
+{
+    if (!thread.joinable()) return;
+    stopRequested = true;
+    uint64_t one = 1;
+    (void)!::write(wakeFd, &one, sizeof(one));
+    thread.join();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (uint32_t i = 0; i < slots.size(); ++i)
+        if (slots[i].fd >= 0) closeSlot(i);
+    close(epollFd);
+    close(wakeFd);
+    epollFd = wakeFd = -1;
+}
+
+bool AttReactor::addNotify(MacAddr mac, const Uuid128& uuid, int fd, uint16_t mtu)
+{
+    return add(ChannelKey{mac, uuid, false}, fd, mtu);
+}
+
+bool AttReactor::addWrite(MacAddr mac, const Uuid128& uuid, int fd, uint16_t mtu)
+{
+    return add(ChannelKey{mac, uuid, true}, fd, mtu);
+}
+
+bool AttReactor::add(const ChannelKey& key, int fd, uint16_t mtu)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (epollFd < 0 || stopRequested || freeSlots.empty() || slotByKey.contains(key)) {
+        close(fd);
+        return false;
+    }
+
+    // BlueZ hands out blocking sockets; the reactor drains until EAGAIN
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        close(fd);
+        return false;
+    }
+
+    uint32_t slot = freeSlots.back();
+    Channel& c = slots[slot];
+    ++c.generation;
+
+    // Write sockets are only watched for hangup, which epoll always reports
+    epoll_event ev{};
+    ev.events = key.write ? 0u : static_cast<uint32_t>(EPOLLIN);
+    ev.data.u64 = eventData(slot, c.generation);
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        std::cerr << "[ATT] epoll_ctl failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    freeSlots.pop_back();
+    c.fd = fd;
+    c.key = key;
+    c.mtu = mtu;
+    c.lastValue.clear();
+    slotByKey.emplace(key, slot);
+    return true;
+}
+
+void AttReactor::closeSlot(uint32_t slot)
+{
+    Channel& c = slots[slot];
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    c.fd = -1;
+    ++c.generation;
+    slotByKey.erase(c.key);
+    freeSlots.push_back(slot);
+}
+
+AttReactor::WriteResult AttReactor::write(MacAddr mac, const Uuid128& uuid, const uint8_t* data, size_t len)
+{
+    ChannelKey key{mac, uuid, true};
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        const uint32_t* slot = slotByKey.find(key);
+        if (!slot) return WriteResult::NoChannel;
+        Channel& c = slots[*slot];
+        if (len + ATT_WRITE_HEADER > c.mtu) return WriteResult::TooLong;
+
+        // Under the lock so the fd cannot be closed and reused mid-send
+        ssize_t sent;
+        do {
+            sent = send(c.fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+
+        if (sent == static_cast<ssize_t>(len)) {
+            writeCount.fetch_add(1, std::memory_order_relaxed);
+            bytesOutCount.fetch_add(len, std::memory_order_relaxed);
+            return WriteResult::Ok;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            busyCount.fetch_add(1, std::memory_order_relaxed);
+            return WriteResult::Busy;
+        }
+        closeSlot(*slot);
+        closedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (closedHandler) closedHandler(mac, uuid, true);
+    return WriteResult::Closed;
+}
+
+bool AttReactor::hasNotify(MacAddr mac, const Uuid128& uuid) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return slotByKey.contains(ChannelKey{mac, uuid, false});
+}
+
+bool AttReactor::hasWrite(MacAddr mac, const Uuid128& uuid) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return slotByKey.contains(ChannelKey{mac, uuid, true});
+}
+
+size_t AttReactor::maxWritePayload(MacAddr mac, const Uuid128& uuid) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    const uint32_t* slot = slotByKey.find(ChannelKey{mac, uuid, true});
+    if (!slot || slots[*slot].mtu <= ATT_WRITE_HEADER) return 0;
+    return slots[*slot].mtu - ATT_WRITE_HEADER;
+}
+
+size_t AttReactor::queuedBytes(MacAddr mac, const Uuid128& uuid) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    const uint32_t* slot = slotByKey.find(ChannelKey{mac, uuid, true});
+    int queued = 0;
+    if (!slot || ioctl(slots[*slot].fd, SIOCOUTQ, &queued) != 0 || queued < 0) return 0;
+    return static_cast<size_t>(queued);
+}
+
+void AttReactor::closeDevice(MacAddr mac)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for (uint32_t i = 0; i < slots.size(); ++i)
+        if (slots[i].fd >= 0 && slots[i].key.mac == mac) closeSlot(i);
+}
+
+size_t AttReactor::channels() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return slotByKey.size();
+}
+
+bool AttReactor::drain(uint32_t slot, uint32_t generation, Clock::time_point woke, ChannelKey& closed)
+{
+    for (int i = 0; i < READ_BURST; ++i) {
+        ChannelKey key;
+        ssize_t n;
+        bool changed;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            Channel& c = slots[slot];
+            if (c.fd < 0 || c.generation != generation) return true;   // closed meanwhile
+            key = c.key;
+
+            if (key.write) n = 0;   // hangup on a write socket
+            else do {
+                n = read(c.fd, readBuffer.data(), readBuffer.size());
+            } while (n < 0 && errno == EINTR);
+
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (n <= 0) {
+                closed = key;
+                closeSlot(slot);
+                closedCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            size_t len = static_cast<size_t>(n);
+            changed = c.lastValue.size() != len || std::memcmp(c.lastValue.data(), readBuffer.data(), len) != 0;
+            if (changed) c.lastValue.assign(readBuffer.begin(), readBuffer.begin() + n);
+        }
+
+        notifyCount.fetch_add(1, std::memory_order_relaxed);
+        bytesInCount.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+        if (notifyHandler) notifyHandler(key.mac, key.uuid, readBuffer.data(), static_cast<size_t>(n), changed, woke);
+        dispatch.record(Clock::now() - woke);
+    }
+    return true;
+}
+
+void AttReactor::loop()
+{
+    epoll_event events[MAX_EVENTS];
+
+    while (!stopRequested) {
+        int n = epoll_wait(epollFd, events, static_cast<int>(MAX_EVENTS), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[ATT] epoll_wait failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        auto woke = Clock::now();
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 == UINT64_MAX) return;   // stop()
+            uint32_t slot = static_cast<uint32_t>(events[i].data.u64);
+            uint32_t generation = static_cast<uint32_t>(events[i].data.u64 >> 32);
+
+            ChannelKey closed;
+            if (!drain(slot, generation, woke, closed) && closedHandler)
+                closedHandler(closed.mac, closed.uuid, closed.write);
+        }
+    }
+}
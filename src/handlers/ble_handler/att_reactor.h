@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+#include "latency_histogram.h"
+
+// Raw ATT data path over the sockets BlueZ hands out for AcquireNotify and
+// AcquireWrite. Each socket carries one ATT value per packet, so a
+// notification or a write without response no longer goes through a D-Bus
+// message and bluetoothd marshalling.
+//
+// All notify sockets are multiplexed on one epoll thread that reads into a
+// single reusable buffer and hands the bytes to the notify handler; each
+// channel keeps its last value so the handler is told whether it changed.
+// Writes are sent by the caller's thread, non-blocking. When BlueZ closes
+// a socket (link down, characteristic gone) the channel is dropped and the
+// closed handler runs; callers fall back to ReadValue/WriteValue until a
+// new channel is acquired.
+
+class AttReactor {
+public:
+    static constexpr size_t MAX_CHANNELS = 512;
+    static constexpr size_t MAX_EVENTS = 64;
+    // Packets read from one socket per wakeup before the others get a turn
+    static constexpr int READ_BURST = 32;
+    // ATT header (opcode + handle) BlueZ adds to a write without response
+    static constexpr uint16_t ATT_WRITE_HEADER = 3;
+
+    using Clock = std::chrono::steady_clock;
+    // Runs on the reactor thread; data is only valid during the call
+    using NotifyHandler = std::function<void(MacAddr mac, const Uuid128& uuid, const uint8_t* data, size_t len,
+                                             bool changed, Clock::time_point received)>;
+    using ClosedHandler = std::function<void(MacAddr mac, const Uuid128& uuid, bool write)>;
+
+    enum class WriteResult { Ok, NoChannel, TooLong, Busy, Closed };
+
+    AttReactor() = default;
+    ~AttReactor();
+
+    AttReactor(const AttReactor&) = delete;
+    AttReactor& operator=(const AttReactor&) = delete;
+
+    bool start(NotifyHandler onNotify, ClosedHandler onClosed);
+    // Closes every channel without calling the closed handler
+    void stop();
+
+    // Take ownership of fd (closed on failure). False if stopped, full or
+    // a channel of that kind is already open for the characteristic.
+    bool addNotify(MacAddr mac, const Uuid128& uuid, int fd, uint16_t mtu);
+    bool addWrite(MacAddr mac, const Uuid128& uuid, int fd, uint16_t mtu);
+
+    // One write without response; Busy when the socket buffer is full
+    WriteResult write(MacAddr mac, const Uuid128& uuid, const uint8_t* data, size_t len);
+
+    bool hasNotify(MacAddr mac, const Uuid128& uuid) const;
+    bool hasWrite(MacAddr mac, const Uuid128& uuid) const;
+    // Largest value write() accepts, 0 without a write channel
+    size_t maxWritePayload(MacAddr mac, const Uuid128& uuid) const;
+    // Bytes written but not yet taken by bluetoothd, 0 without a channel.
+    // Once 0, a WriteValue on D-Bus cannot overtake earlier socket writes.
+    size_t queuedBytes(MacAddr mac, const Uuid128& uuid) const;
+
+    // Link went down; BlueZ closes the sockets anyway, this just does it now
+    void closeDevice(MacAddr mac);
+
+    size_t channels() const;
+    uint64_t notifications() const { return notifyCount.load(std::memory_order_relaxed); }
+    uint64_t bytesIn() const { return bytesInCount.load(std::memory_order_relaxed); }
+    uint64_t writes() const { return writeCount.load(std::memory_order_relaxed); }
+    uint64_t bytesOut() const { return bytesOutCount.load(std::memory_order_relaxed); }
+    uint64_t writesBusy() const { return busyCount.load(std::memory_order_relaxed); }
+    uint64_t closedByPeer() const { return closedCount.load(std::memory_order_relaxed); }
+    // Socket readable until the notify handler returned
+    LatencyHistogram& dispatchLatency() { return dispatch; }
+
+private:
+    struct ChannelKey {
+        MacAddr mac = 0;
+        Uuid128 uuid;
+        bool write = false;
+        bool operator==(const ChannelKey& other) const {
+            return mac == other.mac && uuid == other.uuid && write == other.write;
+        }
+    };
+    struct ChannelKeyHash {
+        size_t operator()(const ChannelKey& key) const noexcept {
+            return FlatHash<uint64_t>{}(key.mac ^ (key.uuid.hi * 31) ^ key.uuid.lo ^ (key.write ? 1ULL << 63 : 0));
+        }
+    };
+    struct Channel {
+        int fd = -1;
+        ChannelKey key;
+        uint16_t mtu = 0;
+        uint32_t generation = 0;        // bumped on reuse, guards stale epoll events
+        std::vector<uint8_t> lastValue; // notify only, capacity reused
+    };
+
+    bool add(const ChannelKey& key, int fd, uint16_t mtu);
+    // Call with mtx held
+    void closeSlot(uint32_t slot);
+    void loop();
+    // Drains one readable socket; returns false once the peer closed it
+    bool drain(uint32_t slot, uint32_t generation, Clock::time_point woke, ChannelKey& closed);
+
+    mutable std::mutex mtx;
+    std::vector<Channel> slots;
+    std::vector<uint32_t> freeSlots;
+    FlatMap<ChannelKey, uint32_t, ChannelKeyHash> slotByKey;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> stopRequested{false};
+    std::thread thread;
+    NotifyHandler notifyHandler;
+    ClosedHandler closedHandler;
+    std::vector<uint8_t> readBuffer;    // reactor thread only
+
+    std::atomic<uint64_t> notifyCount{0};
+    std::atomic<uint64_t> bytesInCount{0};
+    std::atomic<uint64_t> writeCount{0};
+    std::atomic<uint64_t> bytesOutCount{0};
+    std::atomic<uint64_t> busyCount{0};
+    std::atomic<uint64_t> closedCount{0};
+    LatencyHistogram dispatch;
+};
@@ -0,0 +1,184 @@
+// Discovery cycling vs an AdvertisementMonitor1 with the handler's
+// patterns, in a crowded room: foreign advertisers (phones, tags, TVs)
+// plus the registered devices and BTHome sensors.
+//
+//   discovery  bluetoothd forwards every advertisement as a signal (RSSI
+//              and ManufacturerData change on almost every packet)
+//   monitor    only advertisements that match a pattern (matchesAny, the
+//              same OR rule bluetoothd applies) reach the handler
+//
+// The advertisement stream is generated for a simulated time span. Each
+// signal that reaches the handler costs what the loop thread and the
+// signal worker do with it: decode the property dict (a string map
+// standing in for the sdbus Variant map), queue it, then look the device
+// up in the registry. That part runs for real and is timed. Registered
+// devices whose name is only in the scan response are not seen by a
+// passive scan; the handler keeps discovery on until they have shown up.
+//
+//   ./adv_monitor_bench [foreign advertisers] [seconds] [registered devices]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../adv_monitor.h"
+#include "../event_queue.h"
+#include "../flat_map.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Advertiser {
+    MacAddr mac = 0;
+    int intervalMs = 100;
+    std::vector<uint8_t> adv;   // raw AD structures
+    bool registered = false;
+};
+
+struct Event {
+    MacAddr mac = 0;
+    std::map<std::string, std::vector<uint8_t>> props;
+};
+
+void addField(std::vector<uint8_t>& adv, uint8_t type, const std::vector<uint8_t>& data)
+{
+    adv.push_back(static_cast<uint8_t>(data.size() + 1));
+    adv.push_back(type);
+    adv.insert(adv.end(), data.begin(), data.end());
+}
+
+std::vector<uint8_t> bytes(const std::string& s) { return std::vector<uint8_t>(s.begin(), s.end()); }
+
+std::vector<Advertiser> makeRoom(int foreign, int registered, SchemaIndex& schema, std::mt19937& rng)
+{
+    std::vector<Advertiser> room;
+    std::uniform_int_distribution<int> interval(100, 1000);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (int i = 0; i < foreign; ++i) {
+        Advertiser a;
+        a.mac = 0xA00000000000ULL + static_cast<MacAddr>(i);
+        a.intervalMs = interval(rng);
+        addField(a.adv, 0x01, {0x06});
+        std::vector<uint8_t> mfg{0x4C, 0x00};   // iBeacon-ish manufacturer data
+        for (int k = 0; k < 20; ++k) mfg.push_back(static_cast<uint8_t>(byte(rng)));
+        addField(a.adv, 0xFF, mfg);
+        if (i % 3 == 0) addField(a.adv, AD_COMPLETE_NAME, bytes("Phone " + std::to_string(i)));
+        if (i % 7 == 0) addField(a.adv, AD_SERVICE_DATA_16, {0x9F, 0xFE, 0x00});   // other service data
+        room.push_back(std::move(a));
+    }
+    for (int i = 0; i < registered; ++i) {
+        DeviceSchema dev;
+        dev.name = "hub_sensor_" + std::to_string(i);
+        Advertiser a;
+        a.mac = 0xC00000000000ULL + static_cast<MacAddr>(i);
+        dev.macAddr = a.mac;
+        a.intervalMs = 1000;
+        a.registered = true;
+        addField(a.adv, 0x01, {0x06});
+        if (i % 4 == 3) {
+            // BTHome: readings in service data, no name in the advertisement
+            addField(a.adv, AD_SERVICE_DATA_16, {0xD2, 0xFC, 0x40, 0x02, 0xC4, 0x09});
+            a.intervalMs = 2000;
+        } else if (i % 4 != 2) {
+            addField(a.adv, AD_COMPLETE_NAME, bytes(dev.name));
+        }   // i % 4 == 2: name only in the scan response
+        schema.devices.push_back(std::move(dev));
+        room.push_back(std::move(a));
+    }
+    return room;
+}
+
+struct Result {
+    uint64_t advertisements = 0;
+    uint64_t signals = 0;
+    uint64_t registeredSignals = 0;
+    int registeredSeen = 0;
+    double handlerMs = 0;
+    double matchUs = 0;     // pattern matching per advertisement, bluetoothd side
+};
+
+Result run(const std::vector<Advertiser>& room, const std::vector<MonitorPattern>* patterns, int seconds)
+{
+    FlatMap<MacAddr, uint32_t> registry;
+    for (const auto& a : room)
+        if (a.registered) registry.emplace(a.mac, 0u);
+    FlatMap<MacAddr, bool> seen;
+    EventQueue<Event> queue(8192);
+
+    // Which advertisements get through
+    Result r;
+    std::vector<const Advertiser*> forwarded;
+    for (const auto& a : room) {
+        uint64_t count = static_cast<uint64_t>(seconds) * 1000 / a.intervalMs;
+        r.advertisements += count;
+        if (patterns && !matchesAny(*patterns, a.adv.data(), a.adv.size())) continue;
+        for (uint64_t k = 0; k < count; ++k) forwarded.push_back(&a);
+    }
+    if (patterns) {
+        constexpr int ROUNDS = 1000;
+        size_t hits = 0;
+        auto matchStart = Clock::now();
+        for (int k = 0; k < ROUNDS; ++k)
+            for (const auto& a : room) hits += matchesAny(*patterns, a.adv.data(), a.adv.size());
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - matchStart).count();
+        r.matchUs = hits ? us / ROUNDS / room.size() : 0;
+    }
+
+    // What the handler pays for them
+    auto start = Clock::now();
+    Event ev;
+    for (const Advertiser* a : forwarded) {
+        Event in;
+        in.mac = a->mac;
+        in.props["RSSI"] = {0xC4};
+        in.props["ManufacturerData"] = a->adv;
+        if (!queue.tryPush(std::move(in))) continue;
+        while (queue.tryPop(ev)) {
+            ++r.signals;
+            if (!registry.find(ev.mac)) continue;
+            ++r.registeredSignals;
+            seen.emplace(ev.mac, true);
+        }
+    }
+    r.handlerMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    for (const auto& a : room)
+        if (a.registered && seen.find(a.mac)) ++r.registeredSeen;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int foreign = argc > 1 ? std::atoi(argv[1]) : 200;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 600;
+    int registered = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    std::mt19937 rng(42);
+    SchemaIndex schema;
+    std::vector<Advertiser> room = makeRoom(foreign, registered, schema, rng);
+    std::vector<MonitorPattern> patterns = buildMonitorPatterns(&schema);
+    std::printf("%d foreign advertisers, %d registered devices, %d s simulated, %zu patterns\n", foreign, registered,
+                seconds, patterns.size());
+
+    Result discovery = run(room, nullptr, seconds);
+    Result monitor = run(room, &patterns, seconds);
+    for (const auto& [name, r] : {std::pair{"discovery", discovery}, std::pair{"monitor", monitor}}) {
+        std::printf("%-9s %9.1f signals/s  %6.1f%% from registered  handler %8.1f us cpu/s  %2d/%d registered seen",
+                    name, static_cast<double>(r.signals) / seconds,
+                    r.signals ? 100.0 * r.registeredSignals / r.signals : 0.0, r.handlerMs * 1000 / seconds,
+                    r.registeredSeen, registered);
+        if (r.matchUs > 0) std::printf("  match %.2f us/adv", r.matchUs);
+        std::printf("\n");
+    }
+    std::printf("signals x%.1f fewer, handler cpu x%.1f lower\n",
+                static_cast<double>(discovery.signals) / std::max<uint64_t>(monitor.signals, 1),
+                discovery.handlerMs / std::max(monitor.handlerMs, 1e-3));
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Bulk write throughput on a modelled BLE link, simulated time. The link
+// has a connection event every interval ms carrying up to perEvent
+// packets, and the controller buffers up to buffer packets. A write
+// without response waits only for buffer room. An acknowledged write
+// waits for the buffer to drain, goes out in the next event and gets its
+// response one event later, plus a D-Bus round trip.
+//
+// The transfer plan comes from BulkTransfer. Window 0 is one acknowledged
+// write per chunk, which is how write_characteristic sends today.
+//
+//   ./bulk_transfer_bench [bytes] [interval ms] [packets per event]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../bulk_transfer.h"
+
+namespace {
+
+struct LinkModel {
+    double intervalMs = 30;
+    int perEvent = 6;
+    int buffer = 8;
+    double dbusMs = 1.0;       // bluetoothd round trip of a WriteValue
+    double socketMs = 0.02;    // one send() on the write socket
+};
+
+struct Run {
+    double ms = 0;
+    uint64_t checkpoints = 0;
+    bool complete = false;
+};
+
+Run simulate(size_t total, size_t chunk, size_t window, const LinkModel& m)
+{
+    BulkTransfer transfer(total, 0, chunk, window);
+    double t = 0;
+    int queued = 0;                    // packets in the controller buffer
+    double nextEvent = m.intervalMs;
+    auto advance = [&](double until) {
+        while (nextEvent <= until) {
+            queued = std::max(0, queued - m.perEvent);
+            nextEvent += m.intervalMs;
+        }
+    };
+
+    BulkTransfer::Chunk c;
+    while (transfer.next(c)) {
+        if (!c.acknowledged) {
+            while (queued >= m.buffer) advance(t = nextEvent);   // Busy: back off
+            ++queued;
+            advance(t += m.socketMs);
+        } else {
+            while (queued > 0) advance(t = nextEvent);           // drain first
+            advance(t = nextEvent + m.intervalMs + m.dbusMs);    // request, then response
+        }
+        transfer.sent(c);
+    }
+    return Run{t, transfer.checkpoints(), transfer.done() && transfer.acked() == total};
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t bytes = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 64 * 1024;
+    LinkModel link;
+    if (argc > 2) link.intervalMs = std::atof(argv[2]);
+    if (argc > 3) link.perEvent = std::atoi(argv[3]);
+    std::printf("%zu bytes, %.1f ms interval, %d packets per event, %d buffered\n", bytes, link.intervalMs,
+                link.perEvent, link.buffer);
+
+    for (size_t chunk : {size_t(20), size_t(244)}) {
+        std::printf("chunk %zu B (ATT MTU %zu)\n", chunk, chunk + 3);
+        double baseline = 0;
+        for (size_t window : {size_t(0), size_t(4), size_t(16), size_t(64)}) {
+            Run run = simulate(bytes, chunk, window, link);
+            double rate = bytes / (run.ms / 1000);
+            if (window == 0) baseline = rate;
+            std::printf("  window %-3zu %9.0f ms  %8.0f B/s  x%5.1f  %6llu checkpoints%s\n", window, run.ms, rate,
+                        rate / baseline, static_cast<unsigned long long>(run.checkpoints),
+                        run.complete ? "" : "  INCOMPLETE");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+// Blocking vs coroutine device workflows: every workflow is connect, five
+// reads and a disconnect, each a D-Bus call whose reply a fake bus thread
+// delivers after a fixed latency (plus a connect confirmation that arrives
+// later, like the PropertiesChanged signal).
+//
+//   blocking   a pool of threads, each runs one workflow at a time and
+//              waits on every reply (the AsyncReply / runSync path)
+//   coroutine  all workflows spawned on a CoroExecutor; a workflow waiting
+//              on a reply or on the connect signal holds no thread
+//
+// Reports wall time, threads used and how many workflows were in flight.
+//
+//   ./coro_bench [workflows] [call latency ms] [blocking threads]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "../coro_executor.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int READS = 5;
+constexpr int CONNECT_SIGNAL_MS = 20;   // connect confirmation after the reply
+
+// Stands in for bluetoothd and the sdbus loop thread: runs each reply
+// callback once its latency has passed
+class FakeBus {
+public:
+    FakeBus() : thread([this] { loop(); }) {}
+    ~FakeBus() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    void call(int latencyMs, std::function<void()> reply) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            pending.push(Pending{Clock::now() + std::chrono::milliseconds(latencyMs), seq++, std::move(reply)});
+        }
+        cv.notify_all();
+        calls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> calls{0};
+
+private:
+    struct Pending {
+        Clock::time_point due;
+        uint64_t seq;
+        std::function<void()> reply;
+        bool operator>(const Pending& other) const { return due != other.due ? due > other.due : seq > other.seq; }
+    };
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!stopping) {
+            if (pending.empty()) {
+                cv.wait(lock);
+                continue;
+            }
+            if (pending.top().due > Clock::now()) {
+                cv.wait_until(lock, pending.top().due);
+                continue;
+            }
+            auto reply = std::move(const_cast<Pending&>(pending.top()).reply);
+            pending.pop();
+            lock.unlock();
+            reply();
+            lock.lock();
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+    uint64_t seq = 0;
+    bool stopping = false;
+    std::thread thread;
+};
+
+// Per-device state the connect confirmation flips, like BLEDevice
+struct Device {
+    uint64_t mac = 0;
+    std::atomic<bool> connected{false};
+};
+
+std::atomic<uint64_t> readsDone{0};
+std::atomic<int> inFlight{0};
+std::atomic<int> peakInFlight{0};
+
+void enter()
+{
+    int now = inFlight.fetch_add(1) + 1;
+    int peak = peakInFlight.load();
+    while (now > peak && !peakInFlight.compare_exchange_weak(peak, now)) {}
+}
+
+// --- blocking ---------------------------------------------------------
+
+void blockingCall(FakeBus& bus, int latencyMs)
+{
+    std::promise<void> reply;
+    auto done = reply.get_future();
+    bus.call(latencyMs, [&reply] { reply.set_value(); });
+    done.wait();
+}
+
+void blockingWorkflow(FakeBus& bus, Device& dev, int latencyMs)
+{
+    enter();
+    // Connect, then poll for the Connected property like the old connectDevice
+    blockingCall(bus, latencyMs);
+    bus.call(CONNECT_SIGNAL_MS, [&dev] { dev.connected = true; });
+    while (!dev.connected) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (int i = 0; i < READS; ++i) {
+        blockingCall(bus, latencyMs);
+        readsDone.fetch_add(1, std::memory_order_relaxed);
+    }
+    blockingCall(bus, latencyMs);
+    dev.connected = false;
+    inFlight.fetch_sub(1);
+}
+
+void runBlocking(FakeBus& bus, std::vector<Device>& devices, int latencyMs, int threads)
+{
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&] {
+            for (size_t i; (i = next.fetch_add(1)) < devices.size();) blockingWorkflow(bus, devices[i], latencyMs);
+        });
+    }
+    for (auto& t : pool) t.join();
+}
+
+// --- coroutine --------------------------------------------------------
+
+// Minimal AwaitableReply: resumes the awaiting coroutine on the executor
+struct BusCall {
+    FakeBus& bus;
+    CoroExecutor& executor;
+    int latencyMs;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        CoroExecutor* ex = &executor;
+        bus.call(latencyMs, [ex, h] { ex->post(h); });
+    }
+    void await_resume() const noexcept {}
+};
+
+Task<bool> connectAsync(FakeBus& bus, CoroExecutor& executor, Device& dev, int latencyMs)
+{
+    co_await BusCall{bus, executor, latencyMs};
+    bus.call(CONNECT_SIGNAL_MS, [&dev, &executor] {
+        dev.connected = true;
+        executor.wake(dev.mac);
+    });
+    co_return co_await executor.waitFor(dev.mac, [&dev] { return dev.connected.load(); }, 10000);
+}
+
+Task<void> coroWorkflow(FakeBus& bus, CoroExecutor& executor, Device& dev, int latencyMs, std::atomic<size_t>& left)
+{
+    enter();
+    if (co_await connectAsync(bus, executor, dev, latencyMs)) {
+        for (int i = 0; i < READS; ++i) {
+            co_await BusCall{bus, executor, latencyMs};
+            readsDone.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    co_await BusCall{bus, executor, latencyMs};
+    dev.connected = false;
+    inFlight.fetch_sub(1);
+    left.fetch_sub(1);
+}
+
+void runCoroutine(FakeBus& bus, CoroExecutor& executor, std::vector<Device>& devices, int latencyMs)
+{
+    std::atomic<size_t> left{devices.size()};
+    for (auto& dev : devices) executor.spawn(coroWorkflow(bus, executor, dev, latencyMs, left));
+    while (left) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+void report(const char* name, Clock::duration wall, int threads, uint64_t calls)
+{
+    double seconds = std::chrono::duration<double>(wall).count();
+    std::printf("%-9s %7.2f s  %3d threads  peak %5d workflows in flight  %6.0f calls/s  %llu reads\n", name,
+                seconds, threads, peakInFlight.load(), calls / seconds,
+                static_cast<unsigned long long>(readsDone.load()));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int workflows = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int latencyMs = argc > 2 ? std::atoi(argv[2]) : 50;
+    int threads = argc > 3 ? std::atoi(argv[3]) : 16;
+    std::printf("%d workflows (connect, %d reads, disconnect), %d ms per call\n", workflows, READS, latencyMs);
+
+    for (int mode = 0; mode < 2; ++mode) {
+        std::vector<Device> devices(static_cast<size_t>(workflows));
+        for (size_t i = 0; i < devices.size(); ++i) devices[i].mac = 0x001122000000ULL + i;
+        readsDone = 0;
+        peakInFlight = 0;
+
+        CoroExecutor executor;   // outlives the bus, whose thread posts to it
+        FakeBus bus;
+        auto start = Clock::now();
+        if (mode == 0) {
+            runBlocking(bus, devices, latencyMs, threads);
+            report("blocking", Clock::now() - start, threads, bus.calls);
+        } else {
+            executor.start(2);
+            runCoroutine(bus, executor, devices, latencyMs);
+            report("coroutine", Clock::now() - start, static_cast<int>(executor.threads()), bus.calls);
+            std::printf("          executor: %llu spawned, %llu resumes, %llu timed out\n",
+                        static_cast<unsigned long long>(executor.spawned()),
+                        static_cast<unsigned long long>(executor.resumes()),
+                        static_cast<unsigned long long>(executor.timedOut()));
+        }
+    }
+    return 0;
+}
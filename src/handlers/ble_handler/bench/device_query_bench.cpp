@@ -0,0 +1,180 @@
+// query_devices against the old print dump, on a registry of simulated
+// devices (mutex per device, like BLEDevice).
+//
+//   print   registry lock held while every field is read through its own
+//           locking getter and written out (to a string here, not stdout)
+//   query   registry lock held only to copy the device pointers; one lock
+//           per device to copy it, then filter, project and serialize the
+//           immutable snapshot with no lock held
+//
+// Reports how long the registry lock is held (what add_device, the
+// signal worker and every command wait for), the cost of building a
+// snapshot, and of a dashboard paging through the fleet with a filter
+// and a small projection, from a fresh and from a cached snapshot.
+//
+//   ./device_query_bench [devices] [page size]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../device_query.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+struct SimDevice {
+    MacAddr mac = 0;
+    std::string name;
+    std::string path;
+    bool discovered = true;
+    bool connected = false;
+    bool paired = false;
+    bool trusted = true;
+    int16_t rssi = -70;
+    int64_t lastSeenMs = 0;
+    std::vector<Uuid128> uuids;
+    std::mutex mtx;
+
+    template <typename T>
+    T get(const T& field) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return field;
+    }
+};
+
+double msSince(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+    size_t pageSize = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 200;
+    std::printf("%d devices, pages of %zu\n", count, pageSize);
+
+    std::mt19937 rng(3);
+    std::bernoulli_distribution coin(0.3);
+    std::vector<std::shared_ptr<SimDevice>> registry;
+    std::mutex registryMutex;
+    for (int i = 0; i < count; ++i) {
+        auto d = std::make_shared<SimDevice>();
+        d->mac = 0xA4C138000000ULL + static_cast<MacAddr>(rng() & 0xFFFFFF);
+        d->name = (i % 4 ? "ATC_" : "LYWSD_") + std::to_string(i);
+        d->path = "/org/bluez/hci0/dev_" + macToString(d->mac);
+        d->connected = coin(rng);
+        d->paired = coin(rng);
+        for (uint64_t c = 0; c < 6; ++c)   // 00001800..00001805-0000-1000-8000-00805f9b34fb
+            d->uuids.push_back(Uuid128{0x0000180000001000ULL + (c << 32), 0x800000805F9B34FBULL});
+        registry.push_back(std::move(d));
+    }
+
+    // print: everything under the registry lock
+    auto t0 = std::chrono::steady_clock::now();
+    size_t printed;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::ostringstream out;
+        for (const auto& d : registry) {
+            out << "device: " << macToString(d->get(d->mac)) << "\npath: " << d->get(d->path)
+                << "\ndiscovered: " << d->get(d->discovered) << "\nconnected: " << d->get(d->connected)
+                << "\ntrusted: " << d->get(d->trusted) << "\npaired: " << d->get(d->paired) << "\n";
+            for (const auto& uuid : d->get(d->uuids)) out << "characteristic: " << uuidToString(uuid) << "\n";
+        }
+        printed = out.str().size();
+    }
+    double printMs = msSince(t0);
+
+    // query: pointer copy under the registry lock, then one lock per device
+    t0 = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<SimDevice>> current;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        current = registry;
+    }
+    double lockMs = msSince(t0);
+    DeviceQuerySnapshot snapshot;
+    snapshot.records.reserve(current.size());
+    for (const auto& d : current) {
+        DeviceRecord r;
+        {
+            std::lock_guard<std::mutex> lock(d->mtx);
+            r.mac = d->mac;
+            r.name = d->name;
+            r.path = d->path;
+            r.discovered = d->discovered;
+            r.connected = d->connected;
+            r.paired = d->paired;
+            r.trusted = d->trusted;
+            r.rssi = d->rssi;
+            r.lastSeenMs = d->lastSeenMs;
+            r.uuids = d->uuids;
+        }
+        std::sort(r.uuids.begin(), r.uuids.end());
+        snapshot.records.push_back(std::move(r));
+    }
+    std::sort(snapshot.records.begin(), snapshot.records.end(),
+              [](const DeviceRecord& a, const DeviceRecord& b) { return a.mac < b.mac; });
+    double buildMs = msSince(t0);
+
+    auto pageThrough = [&](const json& request, size_t& pages, size_t& devices, size_t& bytes) {
+        json cmd = request;
+        pages = devices = bytes = 0;
+        for (;;) {
+            DeviceQuery q;
+            std::string error;
+            if (!DeviceQuery::parse(cmd, q, error)) {
+                std::printf("bad query: %s\n", error.c_str());
+                return;
+            }
+            json resp;
+            runDeviceQuery(snapshot, q, resp);
+            ++pages;
+            devices += resp["devices"].size();
+            bytes += resp.dump().size();
+            if (!resp.contains("next_cursor")) return;
+            cmd["cursor"] = resp["next_cursor"];
+        }
+    };
+
+    size_t pages, devices, bytes;
+    t0 = std::chrono::steady_clock::now();
+    pageThrough({{"limit", pageSize}}, pages, devices, bytes);
+    double allMs = msSince(t0);
+    std::printf("print    registry lock held %7.2f ms (%zu kB of text)\n", printMs, printed / 1000);
+    std::printf("query    registry lock held %7.3f ms; snapshot built in %.2f ms\n", lockMs, buildMs);
+    std::printf("  all devices, default fields: %zu pages, %zu devices, %zu kB JSON in %.2f ms\n", pages, devices,
+                bytes / 1000, allMs);
+
+    json filtered = {{"filter", {{"connected", true}, {"name_prefix", "ATC_"},
+                                 {"has_uuid", "00001805-0000-1000-8000-00805f9b34fb"}}},
+                     {"fields", {"name", "rssi"}}, {"limit", pageSize}};
+    t0 = std::chrono::steady_clock::now();
+    pageThrough(filtered, pages, devices, bytes);
+    double filteredMs = msSince(t0);
+    std::printf("  connected ATC_ with a UUID, name+rssi: %zu pages, %zu devices, %zu kB JSON in %.2f ms\n", pages,
+                devices, bytes / 1000, filteredMs);
+
+    t0 = std::chrono::steady_clock::now();
+    constexpr int POLLS = 100;
+    for (int i = 0; i < POLLS; ++i) {
+        DeviceQuery q;
+        std::string error;
+        DeviceQuery::parse(filtered, q, error);
+        json resp;
+        runDeviceQuery(snapshot, q, resp);
+    }
+    std::printf("  dashboard poll (first page, cached snapshot): %.3f ms\n", msSince(t0) / POLLS);
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Device events on one hub topic against retained per-device state and
+// delta events with topic aliases, on a simulated hour of traffic.
+// Devices send BTHome broadcasts (the reading changes every few
+// broadcasts), link quality reports and now and then a connection change.
+//
+//   legacy  every event carries the device's full fields on
+//           home-automation/hub; a subscriber interested in one device
+//           receives and parses all of them
+//   state   home-automation/ble/<mac>/event with the changed fields only,
+//           home-automation/ble/<mac>/state retained, event topics aliased
+//
+// Reports bytes on the wire (fixed header, topic, properties, payload),
+// messages, json::parse time for a hub and for a one-device subscriber,
+// and what a hub needs at cold start to know every device.
+//
+//   ./device_state_bench [devices] [alias maximum]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../device_state.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr int64_t RUN_MS = 60 * 60 * 1000;
+constexpr int64_t BROADCAST_MS = 10000;
+constexpr int64_t LINK_MS = 30000;
+const std::string HUB_TOPIC = "home-automation/hub";
+const std::string DEVICE_PREFIX = "home-automation/ble/";
+
+struct Wire {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t oneDeviceMessages = 0;
+    uint64_t oneDeviceBytes = 0;
+    std::vector<std::string> hubPayloads;   // parsed afterwards
+    std::vector<std::string> onePayloads;
+};
+
+// PUBLISH size: fixed header (2) + topic length (2) + topic + packet id for
+// QoS 1 (2) + v5 properties (1 + 3 with an alias) + payload
+size_t publishBytes(size_t topicLen, size_t payloadLen, int qos, bool v5, bool alias)
+{
+    return 2 + 2 + topicLen + (qos ? 2 : 0) + (v5 ? 1 + (alias ? 3 : 0) : 0) + payloadLen;
+}
+
+void record(Wire& w, size_t bytes, const std::string& payload, bool oneDevice)
+{
+    ++w.messages;
+    w.bytes += bytes;
+    w.hubPayloads.push_back(payload);
+    if (oneDevice) {
+        ++w.oneDeviceMessages;
+        w.oneDeviceBytes += bytes;
+        w.onePayloads.push_back(payload);
+    }
+}
+
+double parseUs(const std::vector<std::string>& payloads)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    size_t keys = 0;
+    for (const auto& p : payloads) keys += json::parse(p).size();
+    auto us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    return keys ? us : 0;
+}
+
+std::string macOf(int d)
+{
+    char buf[18];
+    std::snprintf(buf, sizeof buf, "A4:C1:38:%02X:%02X:%02X", (d >> 16) & 0xFF, (d >> 8) & 0xFF, d & 0xFF);
+    return buf;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int devices = argc > 1 ? std::atoi(argv[1]) : 100;
+    int aliasMax = argc > 2 ? std::atoi(argv[2]) : 65535;
+    std::printf("%d devices, 1 h, broadcast every %lld s, link report every %lld s, %d topic aliases\n", devices,
+                static_cast<long long>(BROADCAST_MS / 1000), static_cast<long long>(LINK_MS / 1000), aliasMax);
+
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> jitter(0, 999), temp(0, 3), rssi(-3, 3);
+    std::bernoulli_distribution connChange(0.002);
+
+    struct Dev {
+        std::string mac;
+        int reading = 2150;
+        int rssi = -70;
+        bool connected = false;
+    };
+    std::vector<Dev> fleet(static_cast<size_t>(devices));
+    for (int d = 0; d < devices; ++d) fleet[d].mac = macOf(d + 1);
+
+    Wire legacy, perDevice;
+    std::vector<std::string> retained(static_cast<size_t>(devices));   // what the broker keeps
+    DeviceStateTable table;
+    TopicAliases aliases;
+    aliases.reset(static_cast<uint16_t>(aliasMax));
+
+    auto legacyEvent = [&](const Dev& dev, const std::string& type, int64_t ts, const json& extra) {
+        json j = {{"origin", "ble_handler"}, {"type", type}, {"device_mac", dev.mac}, {"name", "ATC_" + dev.mac.substr(9)},
+                  {"discovered", true}, {"connected", dev.connected}, {"paired", false}, {"trusted", true},
+                  {"rssi", dev.rssi}, {"ts", ts}};
+        j.update(extra);
+        std::string payload = j.dump();
+        record(legacy, publishBytes(HUB_TOPIC.size(), payload.size(), 0, false, false), payload, &dev == &fleet[0]);
+    };
+    auto devicePublish = [&](const std::string& topic, const std::string& payload, int qos, bool oneDevice) {
+        // like mqtt_publish_device_topic: aliases for QoS 0 only
+        bool sendTopic = true;
+        uint16_t alias = qos == 0 ? aliases.resolve(topic, sendTopic) : 0;
+        record(perDevice, publishBytes(sendTopic ? topic.size() : 0, payload.size(), qos, true, alias != 0), payload,
+               oneDevice);
+    };
+    auto deviceEvent = [&](const Dev& dev, const std::string& type, int64_t ts, const json& fields) {
+        MacAddr mac = static_cast<MacAddr>(&dev - fleet.data() + 1);
+        json state, delta;
+        if (!table.merge(mac, fields, state, delta)) return;
+        std::string base = DEVICE_PREFIX + dev.mac;
+        state["device_mac"] = dev.mac;
+        state["updated"] = ts;
+        json event = {{"origin", "ble_handler"}, {"type", type}, {"device_mac", dev.mac}, {"ts", ts}};
+        event.update(delta);
+        bool one = &dev == &fleet[0];
+        retained[mac - 1] = state.dump();
+        // The subscriber of one device takes its events; the state topic
+        // is read once at start (cold start below)
+        devicePublish(base + "/state", retained[mac - 1], 1, false);
+        devicePublish(base + "/event", event.dump(), 0, one);
+    };
+
+    // Startup: every device announced once
+    for (auto& dev : fleet) {
+        legacyEvent(dev, "device_added", 0, json::object());
+        deviceEvent(dev, "device_added", 0,
+                    {{"name", "ATC_" + dev.mac.substr(9)}, {"discovered", true}, {"connected", false},
+                     {"paired", false}, {"trusted", true}});
+    }
+
+    std::vector<int64_t> phase(static_cast<size_t>(devices));
+    for (auto& p : phase) p = jitter(rng) * 10;
+    for (int64_t t = 1000; t < RUN_MS; t += 1000) {
+        for (int d = 0; d < devices; ++d) {
+            Dev& dev = fleet[d];
+            if ((t + phase[d]) % BROADCAST_MS < 1000) {
+                if (temp(rng) == 0) dev.reading += rssi(rng);   // changes every few broadcasts
+                char hex[32];
+                std::snprintf(hex, sizeof hex, "40000102%04x", dev.reading & 0xFFFF);
+                legacyEvent(dev, "device_broadcast", t, {{"service_data", {{"uuid", "0000fcd2"}, {"data", hex}}}});
+                deviceEvent(dev, "device_broadcast", t, {{"service_data", {{"0000fcd2", hex}}}});
+            }
+            if ((t + phase[d]) % LINK_MS < 1000) {
+                dev.rssi += rssi(rng);
+                json link = {{"present", true}, {"rssi", dev.rssi}, {"rssi_spread", 3}, {"adv_interval_ms", 1000}};
+                legacyEvent(dev, "link_quality", t, link);
+                deviceEvent(dev, "link_quality", t, {{"link", link}});
+            }
+            if (connChange(rng)) {
+                dev.connected = !dev.connected;
+                legacyEvent(dev, "device_update", t, json::object());
+                deviceEvent(dev, "device_update", t, {{"connected", dev.connected}});
+            }
+        }
+    }
+
+    auto report = [](const char* name, Wire& w) {
+        std::printf("%-7s %8llu msgs %9.1f kB | hub parse %7.1f ms | one-device subscriber %6llu msgs %7.1f kB, "
+                    "parse %6.2f ms\n",
+                    name, static_cast<unsigned long long>(w.messages), w.bytes / 1000.0, parseUs(w.hubPayloads) / 1000,
+                    static_cast<unsigned long long>(w.oneDeviceMessages), w.oneDeviceBytes / 1000.0,
+                    parseUs(w.onePayloads) / 1000);
+    };
+    report("legacy", legacy);
+    report("state", perDevice);
+    std::printf("state: %llu changes, %llu updates suppressed as unchanged; %zu aliases bound, %llu aliased, "
+                "%.1f kB of topic saved\n",
+                static_cast<unsigned long long>(table.changes()), static_cast<unsigned long long>(table.unchanged()),
+                aliases.bound(), static_cast<unsigned long long>(aliases.aliased()), aliases.bytesSaved() / 1000.0);
+
+    // Cold start: the retained state of every device, one subscribe
+    uint64_t coldBytes = 0;
+    for (int d = 0; d < devices; ++d)
+        coldBytes += publishBytes(DEVICE_PREFIX.size() + 17 + 6, retained[d].size(), 1, true, false);
+    std::printf("cold start: legacy has no retained state, the hub waits up to %lld s for a link report of "
+                "every device; state: 1 subscribe, %d retained messages, %.1f kB, parse %.2f ms\n",
+                static_cast<long long>(LINK_MS / 1000), devices, coldBytes / 1000.0, parseUs(retained) / 1000);
+    return 0;
+}
@@ -0,0 +1,180 @@
+// A UI slider against one characteristic, on simulated time in 1 ms steps.
+// The slider sends a write every [gap] ms for a second ("Blind time"
+// dragged from 0 to 49). Meanwhile a dashboard of 8 clients reads the
+// same value every 250 ms. A write with response takes [write ms] of
+// airtime and a read half of that, one op at a time.
+//
+//   direct     every command is its own radio op, in arrival order
+//   coalesced  OpCoalescer: pending writes collapse to the newest value,
+//              identical pending reads share one ReadValue
+//
+// Reports radio ops, when the device holds the final value (after the
+// last slider message), the longest a caller waited for its result, and
+// checks that every caller got exactly one.
+//
+//   ./op_coalescer_bench [gap ms] [write ms]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+#include "../op_coalescer.h"
+
+namespace {
+
+constexpr int64_t SLIDER_MS = 1000;
+constexpr int64_t READ_EVERY_MS = 250;
+constexpr int READERS = 8;
+constexpr MacAddr MAC = 0xA4C138000001ULL;
+const Uuid128 UUID{0x0000ff0100001000ULL, 0x800000805F9B34FBULL};
+
+struct Command {
+    int id = 0;
+    bool write = false;
+    int value = 0;
+    int64_t arrivedMs = 0;
+};
+
+struct Result {
+    uint64_t ops = 0;
+    int64_t finalAtMs = -1;      // device holds the last slider value
+    int64_t worstWaitMs = 0;
+    std::vector<int> answered;   // per command id
+};
+
+std::vector<Command> workload(int64_t gapMs)
+{
+    std::vector<Command> cmds;
+    int id = 0, value = 0;
+    for (int64_t t = 0; t <= SLIDER_MS + READ_EVERY_MS; ++t) {
+        if (t < SLIDER_MS && t % gapMs == 0) cmds.push_back(Command{id++, true, value++, t});
+        if (t % READ_EVERY_MS == 0)
+            for (int r = 0; r < READERS; ++r) cmds.push_back(Command{id++, false, 0, t});
+    }
+    return cmds;
+}
+
+Result runDirect(const std::vector<Command>& cmds, int64_t writeMs, int lastValue)
+{
+    Result res;
+    res.answered.assign(cmds.size(), 0);
+    int64_t radioFree = 0;
+    for (const auto& c : cmds) {
+        int64_t start = std::max(radioFree, c.arrivedMs);
+        radioFree = start + (c.write ? writeMs : writeMs / 2);
+        ++res.ops;
+        ++res.answered[c.id];
+        res.worstWaitMs = std::max(res.worstWaitMs, radioFree - c.arrivedMs);
+        if (c.write && c.value == lastValue) res.finalAtMs = radioFree;
+    }
+    return res;
+}
+
+Result runCoalesced(const std::vector<Command>& cmds, int64_t writeMs, int lastValue)
+{
+    Result res;
+    res.answered.assign(cmds.size(), 0);
+    OpCoalescer<Command> ops;
+    std::deque<OpCoalescer<Command>::Batch> steps;   // what the runner does next
+    bool runner = false;
+    int64_t busyUntil = 0;
+    OpCoalescer<Command>::Batch current;
+    bool inFlight = false;
+    bool currentIsWrite = false;
+    size_t next = 0;
+
+    auto finish = [&](int64_t now) {
+        if (currentIsWrite) {
+            std::vector<Command> callers = current.superseded;
+            callers.push_back(current.writer);
+            for (const auto& c : callers) {
+                ++res.answered[c.id];
+                res.worstWaitMs = std::max(res.worstWaitMs, now - c.arrivedMs);
+            }
+            if (current.value.size() == 1 && current.value[0] == lastValue) res.finalAtMs = now;
+        } else {
+            for (const auto& c : current.readers) {
+                ++res.answered[c.id];
+                res.worstWaitMs = std::max(res.worstWaitMs, now - c.arrivedMs);
+            }
+        }
+        inFlight = false;
+    };
+    auto startNext = [&](int64_t now) {
+        if (steps.empty()) {
+            OpCoalescer<Command>::Batch b;
+            if (!ops.next(MAC, UUID, b)) {
+                runner = false;
+                return;
+            }
+            // split like characteristic_runner: the write, then the reads
+            if (b.hasWrite) {
+                OpCoalescer<Command>::Batch w = b;
+                w.readers.clear();
+                steps.push_back(std::move(w));
+            }
+            if (!b.readers.empty()) {
+                OpCoalescer<Command>::Batch r;
+                r.readers = std::move(b.readers);
+                steps.push_back(std::move(r));
+            }
+        }
+        current = std::move(steps.front());
+        steps.pop_front();
+        currentIsWrite = current.hasWrite;
+        busyUntil = now + (currentIsWrite ? writeMs : writeMs / 2);
+        inFlight = true;
+        ++res.ops;
+    };
+
+    for (int64_t now = 0; next < cmds.size() || runner; ++now) {
+        if (inFlight && now >= busyUntil) finish(now);
+        for (; next < cmds.size() && cmds[next].arrivedMs == now; ++next) {
+            const Command& c = cmds[next];
+            bool start = c.write ? ops.submitWrite(MAC, UUID, c, {static_cast<uint8_t>(c.value)}, true)
+                                 : ops.submitRead(MAC, UUID, c);
+            if (start) runner = true;
+        }
+        if (runner && !inFlight) startNext(now);
+    }
+    std::printf("  coalescer: %llu writes (%llu collapsed), %llu reads (%llu merged), %llu batches\n",
+                static_cast<unsigned long long>(ops.writes()), static_cast<unsigned long long>(ops.writesCollapsed()),
+                static_cast<unsigned long long>(ops.reads()), static_cast<unsigned long long>(ops.readsMerged()),
+                static_cast<unsigned long long>(ops.batches()));
+    return res;
+}
+
+void report(const char* name, const Result& r, size_t commands, int64_t lastWriteMs)
+{
+    size_t once = 0;
+    for (int n : r.answered) once += n == 1;
+    std::printf("%-10s %4llu radio ops, final value on the device %5lld ms after the last slider message, "
+                "worst wait %5lld ms, %zu/%zu callers answered once\n",
+                name, static_cast<unsigned long long>(r.ops), static_cast<long long>(r.finalAtMs - lastWriteMs),
+                static_cast<long long>(r.worstWaitMs), once, commands);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int64_t gapMs = argc > 1 ? std::atoll(argv[1]) : 20;
+    int64_t writeMs = argc > 2 ? std::atoll(argv[2]) : 60;
+    auto cmds = workload(gapMs);
+    int lastValue = 0;
+    int64_t lastWriteMs = 0;
+    for (const auto& c : cmds)
+        if (c.write) lastValue = c.value, lastWriteMs = c.arrivedMs;
+    std::printf("slider write every %lld ms for %lld ms, %d readers every %lld ms, write %lld ms, read %lld ms; "
+                "%zu commands\n",
+                static_cast<long long>(gapMs), static_cast<long long>(SLIDER_MS), READERS,
+                static_cast<long long>(READ_EVERY_MS), static_cast<long long>(writeMs),
+                static_cast<long long>(writeMs / 2), cmds.size());
+
+    report("direct", runDirect(cmds, writeMs, lastValue), cmds.size(), lastWriteMs);
+    Result coalesced = runCoalesced(cmds, writeMs, lastValue);
+    report("coalesced", coalesced, cmds.size(), lastWriteMs);
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Radio op scheduling benchmark: three workers serve a synthetic background
+// load (polls and reconnects holding the radio for 100-800 ms) while an
+// interactive write (30 ms) arrives every 200 ms. Reports write latency
+// from submit to completion, first with every op in one FIFO class, then
+// with priority classes.
+//
+//   ./op_queue_bench [seconds]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../op_queue.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::vector<double> writeMs;
+    uint64_t background = 0;
+    uint64_t rejected = 0;
+};
+
+Result run(bool priorities, int seconds)
+{
+    OpQueue queue;
+    queue.start(3);
+    Result result;
+    std::mutex mtx;
+    std::atomic<uint64_t> backgroundDone{0};
+    std::atomic<bool> stop{false};
+
+    // Background producer: keeps its queue topped up like a reconnect storm
+    std::thread producer([&] {
+        std::mt19937 rng(1);
+        while (!stop) {
+            RadioOp op;
+            op.command = "poll";
+            op.priority = priorities ? OpPriority::Background : OpPriority::Normal;
+            int holdMs = 100 + static_cast<int>(rng() % 700);
+            op.run = [holdMs, &backgroundDone] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(holdMs));
+                ++backgroundDone;
+            };
+            if (!queue.submit(std::move(op))) ++result.rejected;
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        }
+    });
+
+    auto end = Clock::now() + std::chrono::seconds(seconds);
+    while (Clock::now() < end) {
+        RadioOp op;
+        op.command = "write";
+        op.priority = priorities ? OpPriority::Interactive : OpPriority::Normal;
+        auto submitted = Clock::now();
+        op.run = [submitted, &mtx, &result] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            std::lock_guard<std::mutex> lock(mtx);
+            result.writeMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - submitted).count());
+        };
+        queue.submit(std::move(op));
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    stop = true;
+    producer.join();
+    queue.stop();
+    result.background = backgroundDone;
+    return result;
+}
+
+void report(const char* name, Result& r)
+{
+    std::sort(r.writeMs.begin(), r.writeMs.end());
+    auto pct = [&](double p) { return r.writeMs.empty() ? 0.0 : r.writeMs[static_cast<size_t>(p * (r.writeMs.size() - 1))]; };
+    std::printf("%-10s writes=%zu p50=%.0f ms p99=%.0f ms max=%.0f ms | background done=%llu rejected=%llu\n",
+                name, r.writeMs.size(), pct(0.5), pct(0.99), pct(1.0),
+                static_cast<unsigned long long>(r.background), static_cast<unsigned long long>(r.rejected));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int seconds = argc > 1 ? std::atoi(argv[1]) : 20;
+    Result fifo = run(false, seconds);
+    report("fifo", fifo);
+    Result prio = run(true, seconds);
+    report("priority", prio);
+    return 0;
+}
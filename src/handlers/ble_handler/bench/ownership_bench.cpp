@@ -0,0 +1,164 @@
+// Device ownership between ble_handler instances, on simulated time.
+// Instances sit in different rooms of a 40 m x 10 m house, devices are
+// spread over it. RSSI follows log-distance path loss with Gaussian
+// fading per reading, smoothed like LinkQualityTable. Every gossip round
+// each instance evaluates, then publishes; peers see it one round later
+// (like MQTT). Devices stay disconnected, so only RSSI decides.
+//
+// Halfway through, a quarter of the devices are carried to the other end
+// of the house, and later one instance goes down.
+//
+// Reports devices held by exactly one instance, double claims, handoffs
+// per device-hour (flapping) and how long the moved devices took to end
+// up with the instance nearest to them.
+//
+//   ./ownership_bench [instances] [devices] [fading dB]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../device_ownership.h"
+
+namespace {
+
+constexpr int64_t GOSSIP_MS = 2000;
+constexpr int64_t RUN_MS = 20 * 60 * 1000;
+constexpr int64_t MOVE_MS = RUN_MS / 2;
+constexpr int64_t CRASH_MS = RUN_MS * 3 / 4;
+
+struct Point {
+    double x = 0;
+    double y = 0;
+};
+
+double rssiAt(Point a, Point b)
+{
+    double d = std::max(1.0, std::hypot(a.x - b.x, a.y - b.y));
+    return -45 - 10 * 3.0 * std::log10(d);   // indoor path loss exponent 3
+}
+
+struct Instance {
+    std::string id;
+    Point at;
+    std::unique_ptr<DeviceOwnership> table;
+    std::vector<float> smoothed;     // per device
+    bool up = true;
+    // what the peers see next round
+    std::vector<OwnershipBid> bids;
+    std::vector<MacAddr> owned;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int instances = argc > 1 ? std::atoi(argv[1]) : 3;
+    int devices = argc > 2 ? std::atoi(argv[2]) : 60;
+    double fading = argc > 3 ? std::atof(argv[3]) : 4.0;
+    std::printf("%d instances, %d devices, %.1f dB fading, gossip every %lld ms\n", instances, devices, fading,
+                static_cast<long long>(GOSSIP_MS));
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> ux(0, 40), uy(0, 10);
+    std::normal_distribution<double> fade(0, fading);
+
+    int64_t now = 0;
+    std::vector<Instance> fleet(static_cast<size_t>(instances));
+    for (int i = 0; i < instances; ++i) {
+        fleet[i].id = "host" + std::to_string(i);
+        fleet[i].at = Point{40.0 * (i + 0.5) / instances, 5};
+        fleet[i].table = std::make_unique<DeviceOwnership>(fleet[i].id, now);
+        fleet[i].smoothed.assign(static_cast<size_t>(devices), -200.0f);
+    }
+    std::vector<Point> where(static_cast<size_t>(devices));
+    for (auto& p : where) p = Point{ux(rng), uy(rng)};
+
+    auto nearest = [&](int d) {
+        int best = -1;
+        double bestRssi = -1e9;
+        for (int i = 0; i < instances; ++i) {
+            if (!fleet[i].up) continue;
+            double r = rssiAt(fleet[i].at, where[d]);
+            if (r > bestRssi) bestRssi = r, best = i;
+        }
+        return best;
+    };
+
+    uint64_t handoffs = 0, doubleClaims = 0, unowned = 0, samples = 0, settledMoves = 0;
+    int64_t settleSum = 0;
+    int moved = devices / 4;
+    std::vector<int64_t> settledAt(static_cast<size_t>(moved), -1);
+
+    for (; now < RUN_MS; now += GOSSIP_MS) {
+        if (now == MOVE_MS)
+            for (int d = 0; d < moved; ++d) where[d].x = 40 - where[d].x;
+        if (now == CRASH_MS) {
+            fleet[0].up = false;
+            for (auto& peer : fleet) peer.table->peerGone(fleet[0].id);   // last will
+        }
+
+        // Everyone hears this round's advertisements and decides
+        for (auto& inst : fleet) {
+            if (!inst.up) continue;
+            std::vector<OwnershipBid> local;
+            for (int d = 0; d < devices; ++d) {
+                double r = rssiAt(inst.at, where[d]) + fade(rng);
+                if (r < -100) continue;   // out of range
+                float& s = inst.smoothed[d];
+                s = s < -150 ? static_cast<float>(r) : s + 0.2f * (static_cast<float>(r) - s);
+                local.push_back(OwnershipBid{static_cast<MacAddr>(d + 1), static_cast<int16_t>(std::lround(s)), false});
+            }
+            std::vector<DeviceOwnership::Decision> changes;
+            inst.table->evaluate(local, now, changes);
+            for (const auto& c : changes)
+                if (c.change == DeviceOwnership::Change::Acquired && now > DeviceOwnership::SETTLE_MS + GOSSIP_MS)
+                    ++handoffs;
+            inst.bids = std::move(local);
+            inst.owned = inst.table->ownedDevices();
+        }
+        // Gossip, seen on the next round
+        for (auto& from : fleet) {
+            if (!from.up) continue;
+            for (auto& to : fleet)
+                if (&to != &from && to.up) to.table->peerUpdate(from.id, from.bids, from.owned, now);
+        }
+
+        // Who holds what
+        for (int d = 0; d < devices; ++d) {
+            int holders = 0, holder = -1;
+            for (int i = 0; i < instances; ++i)
+                if (fleet[i].up && fleet[i].table->owns(static_cast<MacAddr>(d + 1))) ++holders, holder = i;
+            ++samples;
+            if (holders == 0) ++unowned;
+            if (holders > 1) ++doubleClaims;
+            if (d < moved && now >= MOVE_MS && now < CRASH_MS && settledAt[d] < 0 && holder == nearest(d)) {
+                settledAt[d] = now;
+                settleSum += now - MOVE_MS;
+                ++settledMoves;
+            }
+        }
+    }
+
+    double deviceHours = devices * (RUN_MS / 3600000.0);
+    std::printf("held by one instance %6.2f%%, unowned %5.2f%%, double claims %5.3f%%\n",
+                100.0 * (samples - unowned - doubleClaims) / samples, 100.0 * unowned / samples,
+                100.0 * doubleClaims / samples);
+    std::printf("handoffs %llu (%.2f per device-hour, includes %d moved devices and the crash)\n",
+                static_cast<unsigned long long>(handoffs), handoffs / deviceHours, moved);
+    std::printf("moved devices with the nearest instance: %llu/%d, mean %.1f s after the move\n",
+                static_cast<unsigned long long>(settledMoves), moved,
+                settledMoves ? settleSum / 1000.0 / settledMoves : 0.0);
+    for (const auto& inst : fleet)
+        std::printf("  %s %s holds %zu, %llu acquired, %llu released, %llu conflicts\n", inst.id.c_str(),
+                    inst.up ? "up  " : "down", inst.up ? inst.table->ownedCount() : size_t(0),
+                    static_cast<unsigned long long>(inst.table->acquired()),
+                    static_cast<unsigned long long>(inst.table->released()),
+                    static_cast<unsigned long long>(inst.table->conflicts()));
+    return 0;
+}
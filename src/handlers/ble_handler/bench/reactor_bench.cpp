@@ -0,0 +1,246 @@
+// Threaded vs reactor benchmark: the same idle-ish hub workload driven by
+// the worker threads of the default mode and by one EventReactor.
+//
+// A feeder thread stands in for bluetoothd: every 10 ms it writes a burst
+// of advertisement events to a socket (the D-Bus connection). There are
+// also P polled characteristics, each due every interval ms.
+//
+//   threaded  a loop thread reads the socket and hands events to a signal
+//             worker through EventQueue; a poll thread sleeps until the
+//             next due read (at most 1 s); a reconnect thread and the
+//             signal worker wake once a second when idle
+//   reactor   one loop watches the socket and owns the poll timers
+//
+// Reports process CPU and voluntary context switches (wakeups) per second,
+// with the feeder thread's own share subtracted.
+//
+//   ./reactor_bench [events/s] [poll targets] [poll interval ms] [seconds]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../event_queue.h"
+#include "../event_reactor.h"
+
+namespace {
+
+constexpr int BURST_MS = 10;
+
+struct Event {
+    uint32_t device = 0;
+    int8_t rssi = 0;
+};
+
+std::atomic<uint64_t> applied{0};
+std::atomic<uint64_t> polled{0};
+uint64_t sink = 0;
+
+void apply(const Event& ev)
+{
+    sink += ev.device * 31 + static_cast<uint8_t>(ev.rssi);
+    applied.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pollRead(size_t target)
+{
+    sink += target;
+    polled.fetch_add(1, std::memory_order_relaxed);
+}
+
+struct ThreadUsage {
+    int64_t cpuUs = 0;
+    uint64_t switches = 0;
+
+    static ThreadUsage sample() {
+        ThreadUsage u;
+        rusage ru{};
+        if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+            u.cpuUs = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+            u.switches = static_cast<uint64_t>(ru.ru_nvcsw);
+        }
+        return u;
+    }
+};
+
+// Writes eventsPerSec in bursts until stopped; returns its own usage
+ThreadUsage feed(int fd, int eventsPerSec, std::atomic<bool>& stop)
+{
+    ThreadUsage start = ThreadUsage::sample();
+    int perBurst = std::max(1, eventsPerSec * BURST_MS / 1000);
+    std::vector<Event> burst(static_cast<size_t>(perBurst));
+    auto next = std::chrono::steady_clock::now();
+    uint32_t serial = 0;
+    while (!stop) {
+        for (auto& ev : burst) {
+            ev.device = serial++ % 200;
+            ev.rssi = static_cast<int8_t>(-40 - serial % 50);
+        }
+        (void)!write(fd, burst.data(), burst.size() * sizeof(Event));
+        next += std::chrono::milliseconds(BURST_MS);
+        std::this_thread::sleep_until(next);
+    }
+    ThreadUsage end = ThreadUsage::sample();
+    return ThreadUsage{end.cpuUs - start.cpuUs, end.switches - start.switches};
+}
+
+size_t readEvents(int fd, std::vector<Event>& buf)
+{
+    ssize_t n = read(fd, buf.data(), buf.size() * sizeof(Event));
+    return n > 0 ? static_cast<size_t>(n) / sizeof(Event) : 0;
+}
+
+void runThreaded(int busFd, int targets, int intervalMs, std::atomic<bool>& stop)
+{
+    EventQueue<Event> queue(8192);
+
+    std::thread loop([&] {
+        std::vector<Event> buf(1024);
+        epoll_event ev{};
+        int ep = epoll_create1(0);
+        ev.events = EPOLLIN;
+        epoll_ctl(ep, EPOLL_CTL_ADD, busFd, &ev);
+        while (!stop) {
+            if (epoll_wait(ep, &ev, 1, 100) <= 0) continue;
+            size_t n = readEvents(busFd, buf);
+            for (size_t i = 0; i < n; ++i) queue.tryPush(Event(buf[i]));
+        }
+        close(ep);
+    });
+
+    std::thread signal([&] {
+        while (!stop) {
+            Event ev;
+            size_t count = 0;
+            while (queue.tryPop(ev)) {
+                apply(ev);
+                ++count;
+            }
+            if (count == 0) queue.wait(1000);
+        }
+    });
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread poll([&] {
+        std::vector<int64_t> due(static_cast<size_t>(targets));
+        for (size_t i = 0; i < due.size(); ++i) due[i] = EventReactor::nowMs() + intervalMs * static_cast<int64_t>(i) / targets;
+        while (!stop) {
+            int64_t now = EventReactor::nowMs();
+            int64_t next = INT64_MAX;
+            for (size_t i = 0; i < due.size(); ++i) {
+                if (due[i] <= now) {
+                    pollRead(i);
+                    due[i] = now + intervalMs;
+                }
+                next = std::min(next, due[i]);
+            }
+            int64_t wait = std::clamp<int64_t>(next - now, 1, 1000);
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait_for(lock, std::chrono::milliseconds(wait), [&] { return stop.load(); });
+        }
+    });
+
+    std::thread reconnect([&] {
+        while (!stop) {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait_for(lock, std::chrono::milliseconds(1000), [&] { return stop.load(); });
+        }
+    });
+
+    while (!stop) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    cv.notify_all();
+    queue.wake();
+    loop.join();
+    signal.join();
+    poll.join();
+    reconnect.join();
+}
+
+void runReactor(int busFd, int targets, int intervalMs, std::atomic<bool>& stop, EventReactor& reactor)
+{
+    std::vector<Event> buf(1024);
+    reactor.watch(busFd, EPOLLIN, [&](uint32_t) {
+        size_t n = readEvents(busFd, buf);
+        for (size_t i = 0; i < n; ++i) apply(buf[i]);
+    });
+    for (int i = 0; i < targets; ++i) {
+        reactor.after(intervalMs * static_cast<int64_t>(i) / targets, [&reactor, i, intervalMs]() {
+            pollRead(static_cast<size_t>(i));
+            reactor.every(intervalMs, [i]() { pollRead(static_cast<size_t>(i)); });
+        });
+    }
+    std::thread stopper([&] {
+        while (!stop) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        reactor.stop();
+    });
+    reactor.run();
+    stopper.join();
+}
+
+void report(const char* name, const ProcessUsage& a, const ProcessUsage& b, const ThreadUsage& feeder,
+            uint64_t events, uint64_t reads)
+{
+    double seconds = (b.wallUs - a.wallUs) / 1e6;
+    double cpu = (b.cpuUs - a.cpuUs - feeder.cpuUs) / seconds / 1e4;
+    double switches = (b.voluntarySwitches - a.voluntarySwitches - feeder.switches) / seconds;
+    std::printf("%-9s cpu %5.2f%%  wakeups %7.0f/s  applied %llu events, %llu reads\n", name, cpu, switches,
+                static_cast<unsigned long long>(events), static_cast<unsigned long long>(reads));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int eventsPerSec = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int targets = argc > 2 ? std::atoi(argv[2]) : 20;
+    int intervalMs = argc > 3 ? std::atoi(argv[3]) : 5000;
+    int seconds = argc > 4 ? std::atoi(argv[4]) : 10;
+    std::printf("%d events/s in %d ms bursts, %d poll targets every %d ms, %d s per mode\n", eventsPerSec, BURST_MS,
+                targets, intervalMs, seconds);
+
+    for (int mode = 0; mode < 2; ++mode) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) return 1;
+        applied = 0;
+        polled = 0;
+        std::atomic<bool> stop{false};
+        ThreadUsage feederUsage;
+
+        EventReactor reactor;
+        if (mode == 1 && !reactor.open()) return 1;
+
+        ProcessUsage start = ProcessUsage::sample();
+        std::thread feeder([&] { feederUsage = feed(fds[1], eventsPerSec, stop); });
+        std::thread timer([&] {
+            std::this_thread::sleep_for(std::chrono::seconds(seconds));
+            stop = true;
+        });
+        if (mode == 0) runThreaded(fds[0], targets, intervalMs, stop);
+        else runReactor(fds[0], targets, intervalMs, stop, reactor);
+        timer.join();
+        feeder.join();
+        ProcessUsage end = ProcessUsage::sample();
+
+        report(mode == 0 ? "threaded" : "reactor", start, end, feederUsage, applied, polled);
+        if (mode == 1)
+            std::printf("          loop: %llu wakeups, %llu fd events, %llu timers\n",
+                        static_cast<unsigned long long>(reactor.wakeups()),
+                        static_cast<unsigned long long>(reactor.fdEvents()),
+                        static_cast<unsigned long long>(reactor.timersFired()));
+        close(fds[0]);
+        close(fds[1]);
+    }
+    return sink == 42 ? 1 : 0;
+}
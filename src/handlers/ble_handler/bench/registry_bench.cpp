@@ -0,0 +1,175 @@
+// Registry lookup benchmark: string-keyed std::unordered_map (the old layout)
+// against packed keys in FlatMap with interned paths.
+//
+// Simulates the per-signal work of the handler at 10k devices: map an object
+// path to its device and resolve a characteristic UUID to a path.
+//
+//   ./registry_bench [devices] [signals]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include <malloc.h>
+#include <vector>
+
+#include "../ble_keys.h"
+#include "../flat_map.h"
+#include "../path_table.h"
+
+// --- allocation accounting (live heap bytes, including malloc rounding) ---
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static std::atomic<size_t> liveBytes{0};
+static std::atomic<size_t> allocatedBytes{0};
+
+void* operator new(size_t size)
+{
+    if (void* p = std::malloc(size)) {
+        liveBytes += malloc_usable_size(p);
+        allocatedBytes += size;
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept
+{
+    if (p) liveBytes -= malloc_usable_size(p);
+    std::free(p);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+namespace {
+
+constexpr int CHARS_PER_DEVICE = 8;
+
+struct OldDevice {
+    std::string address;
+    std::unordered_map<std::string, std::string> characteristics;
+};
+
+struct NewDevice {
+    MacAddr mac = 0;
+    FlatMap<Uuid128, PathId> characteristics;
+};
+
+std::string devicePath(MacAddr mac)
+{
+    std::string s = macToString(mac);
+    std::replace(s.begin(), s.end(), ':', '_');
+    return "/org/bluez/hci0/dev_" + s;
+}
+
+std::string charPath(MacAddr mac, int c)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "/service%04x/char%04x", 0x10, 0x11 + c * 3);
+    return devicePath(mac) + buf;
+}
+
+Uuid128 charUuid(int c)
+{
+    return Uuid128{0x21b5b57bda8d4ea4ULL + static_cast<uint64_t>(c), 0xbaf87654a2214650ULL};
+}
+
+double nsPer(std::chrono::steady_clock::duration d, size_t n)
+{
+    return std::chrono::duration<double, std::nano>(d).count() / static_cast<double>(n);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t deviceCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    size_t signalCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<MacAddr> macs(deviceCount);
+    for (auto& mac : macs) mac = rng() & 0xFFFFFFFFFFFFULL;
+
+    // Signal stream: characteristic object paths of random devices
+    std::vector<std::string> signalPaths;
+    std::vector<int> signalChars;
+    signalPaths.reserve(signalCount);
+    for (size_t i = 0; i < signalCount; ++i) {
+        int c = static_cast<int>(rng() % CHARS_PER_DEVICE);
+        signalPaths.push_back(charPath(macs[rng() % deviceCount], c));
+        signalChars.push_back(c);
+    }
+
+    // --- old layout ---
+    size_t before = liveBytes;
+    auto oldDevices = std::make_unique<std::unordered_map<std::string, std::shared_ptr<OldDevice>>>();
+    for (MacAddr mac : macs) {
+        auto dev = std::make_shared<OldDevice>();
+        dev->address = macToString(mac);
+        for (int c = 0; c < CHARS_PER_DEVICE; ++c)
+            dev->characteristics[uuidToString(charUuid(c))] = charPath(mac, c);
+        (*oldDevices)[dev->address] = dev;
+    }
+    size_t oldBytes = liveBytes - before;
+
+    // --- new layout ---
+    before = liveBytes;
+    auto paths = std::make_unique<PathTable>();
+    auto newDevices = std::make_unique<FlatMap<MacAddr, std::shared_ptr<NewDevice>>>();
+    for (MacAddr mac : macs) {
+        auto dev = std::make_shared<NewDevice>();
+        dev->mac = mac;
+        for (int c = 0; c < CHARS_PER_DEVICE; ++c)
+            dev->characteristics.emplace(charUuid(c), paths->intern(pathBelowDevice(charPath(mac, c))));
+        newDevices->emplace(mac, dev);
+    }
+    size_t newBytes = liveBytes - before;
+
+    std::vector<std::string> uuidStrings;
+    for (int c = 0; c < CHARS_PER_DEVICE; ++c) uuidStrings.push_back(uuidToString(charUuid(c)));
+
+    // --- per-signal cost: path -> device -> characteristic ---
+    size_t hits = 0;
+    size_t allocBefore = allocatedBytes;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < signalCount; ++i) {
+        const std::string& path = signalPaths[i];
+        auto pos = path.find("dev_");
+        std::string mac = path.substr(pos + 4, 17);
+        std::replace(mac.begin(), mac.end(), '_', ':');
+        auto it = oldDevices->find(mac);
+        if (it == oldDevices->end()) continue;
+        auto cit = it->second->characteristics.find(uuidStrings[signalChars[i]]);
+        hits += cit != it->second->characteristics.end();
+    }
+    auto oldTime = std::chrono::steady_clock::now() - t0;
+    size_t oldSignalAlloc = allocatedBytes - allocBefore;
+
+    allocBefore = allocatedBytes;
+    t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < signalCount; ++i) {
+        MacAddr mac;
+        if (!macFromPath(signalPaths[i], mac)) continue;
+        auto dev = newDevices->find(mac);
+        if (!dev) continue;
+        hits += (*dev)->characteristics.find(charUuid(signalChars[i])) != nullptr;
+    }
+    auto newTime = std::chrono::steady_clock::now() - t0;
+    size_t newSignalAlloc = allocatedBytes - allocBefore;
+
+    std::printf("devices=%zu characteristics/device=%d signals=%zu (hits=%zu)\n",
+                deviceCount, CHARS_PER_DEVICE, signalCount, hits);
+    std::printf("%-28s %12s %12s\n", "", "string keys", "packed keys");
+    std::printf("%-28s %12.1f %12.1f\n", "ns per signal", nsPer(oldTime, signalCount), nsPer(newTime, signalCount));
+    std::printf("%-28s %12.1f %12.1f\n", "heap bytes per signal",
+                double(oldSignalAlloc) / signalCount, double(newSignalAlloc) / signalCount);
+    std::printf("%-28s %12zu %12zu\n", "registry bytes per device", oldBytes / deviceCount, newBytes / deviceCount);
+    return 0;
+}
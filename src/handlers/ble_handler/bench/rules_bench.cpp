@@ -0,0 +1,105 @@
+// Rules engine benchmark: compile R rules over D BTHome devices, then time
+// evaluate() for readings that have rules and for readings that have none.
+//
+//   ./rules_bench [devices] [rules]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../rules_engine.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string macOf(int d)
+{
+    char buf[18];
+    std::snprintf(buf, sizeof(buf), "A4:C1:38:00:%02X:%02X", (d >> 8) & 0xFF, d & 0xFF);
+    return buf;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int deviceCount = argc > 1 ? std::atoi(argv[1]) : 100;
+    int ruleCount   = argc > 2 ? std::atoi(argv[2]) : 1000;
+    const std::string devicesFile = "/tmp/rules_bench_devices.json";
+    const std::string rulesFile = "/tmp/rules_bench_rules.json";
+    const std::string bthomeUuid = "d52246df-98ac-4d21-be1b-70d5f66a5ddb";
+
+    json devices = json::object();
+    for (int d = 0; d < deviceCount; ++d) {
+        devices["sensor_" + std::to_string(d)] = {
+            {"protocol", "BLE"}, {"ble_address", macOf(d)},
+            {"characteristics", {{"data", {{"uuid", bthomeUuid}, {"Properties", {"Read"}}, {"accepted values", {
+                {"motion", {{"id", "0x21"}, {"data type", "uint8"}}},
+                {"illuminance", {{"id", "0x05"}, {"data type", "uint24"}, {"scale factor", 0.01}}},
+            }}}}}},
+        };
+    }
+    devices["light"] = {{"protocol", "MQTT"}, {"address", "home/light"}, {"commands", {{"turn_on", "turn_on"}}}};
+    std::ofstream(devicesFile) << json{{"devices", devices}}.dump();
+
+    json rules = json::object();
+    for (int r = 0; r < ruleCount; ++r) {
+        bool motion = r % 2 == 0;
+        rules["rule_" + std::to_string(r)] = {
+            {"when", {{"device", "sensor_" + std::to_string(r % deviceCount)},
+                      {"field", motion ? "motion" : "illuminance"}, {"op", ">="},
+                      {"value", motion ? 1 : 100 + r}}},
+            {"then", {{{"device", "light"}, {"command", "turn_on"}}}},
+        };
+    }
+    std::ofstream(rulesFile) << json{{"rules", rules}}.dump();
+
+    std::string error;
+    auto schema = loadSchemaIndex(devicesFile, error);
+    if (!schema) {
+        std::fprintf(stderr, "schema: %s\n", error.c_str());
+        return 1;
+    }
+    RuleEngine engine(rulesFile, devicesFile);
+    auto noEncode = [](const json&, const CharacteristicSchema*, std::vector<uint8_t>&) { return std::string(); };
+    if (!engine.reload(schema, noEncode)) return 1;
+
+    Uuid128 uuid;
+    parseUuid(bthomeUuid, uuid);
+    std::vector<MacAddr> macs(deviceCount);
+    for (int d = 0; d < deviceCount; ++d) parseMac(macOf(d), macs[d]);
+    std::vector<FiredRule> fired;
+    const int iterations = 2000000;
+
+    // Motion readings toggle, so rules keep crossing. With the default
+    // arguments even devices carry 10 motion rules and odd ones none.
+    auto t0 = Clock::now();
+    size_t fires = 0;
+    for (int i = 0; i < iterations; ++i) {
+        fired.clear();
+        engine.evaluate(SeriesKey{macs[i % deviceCount], uuid, 0x21}, (i / deviceCount) % 2, i, fired);
+        fires += fired.size();
+    }
+    double withRules = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / iterations;
+
+    // Readings nothing listens to (battery)
+    t0 = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        engine.evaluate(SeriesKey{macs[i % deviceCount], uuid, 0x01}, 50, i, fired);
+    }
+    double withoutRules = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / iterations;
+
+    std::printf("devices=%d rules=%zu\n", deviceCount, engine.ruleCount());
+    std::printf("reading with rules:    %.0f ns/evaluation (engine mean %llu ns), %zu fired\n",
+                withRules, static_cast<unsigned long long>(engine.meanEvalNs()), fires);
+    std::printf("reading without rules: %.0f ns/evaluation\n", withoutRules);
+    return 0;
+}
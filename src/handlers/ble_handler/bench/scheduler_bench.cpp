@@ -0,0 +1,102 @@
+// Command scheduler benchmark: keep N schedules active, let F one-shots of
+// them come due over a few seconds, and report how late they ran and how
+// much CPU the scheduler thread used meanwhile.
+//
+//   ./scheduler_bench [schedules] [fire] [seconds]
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../command_scheduler.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t wallMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+double cpuSeconds()
+{
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int total   = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int fire    = argc > 2 ? std::atoi(argv[2]) : 2000;
+    int seconds = argc > 3 ? std::atoi(argv[3]) : 10;
+    const std::string file = "/tmp/scheduler_bench.json";
+    std::remove(file.c_str());
+
+    CommandScheduler scheduler(file);
+    std::mutex mtx;
+    std::vector<int64_t> lateMs;
+    scheduler.start([&](const std::string&, const json& command) {
+        int64_t late = wallMs() - command.value("due", int64_t(0));
+        std::lock_guard<std::mutex> lock(mtx);
+        lateMs.push_back(late);
+    });
+
+    // Background load: cron schedules that stay armed for the whole run
+    std::mt19937 rng(7);
+    auto t0 = Clock::now();
+    json out;
+    for (int i = 0; i < total - fire; ++i) {
+        json request = {{"id", "cron_" + std::to_string(i)},
+                        {"cron", std::to_string(rng() % 60) + " " + std::to_string(rng() % 24) + " 1 1 *"},
+                        {"action", {{"command", "read_characteristic"}, {"mac", "A4:C1:38:00:00:01"}}}};
+        if (auto err = scheduler.add(request, out); !err.empty()) {
+            std::fprintf(stderr, "add: %s\n", err.c_str());
+            return 1;
+        }
+    }
+    // One-shots spread over the run
+    int64_t start = wallMs();
+    for (int i = 0; i < fire; ++i) {
+        int64_t due = start + 500 + static_cast<int64_t>(rng() % ((seconds - 1) * 1000));
+        json request = {{"at", due},
+                        {"action", {{"command", "write_characteristic"}, {"mac", "A4:C1:38:00:00:01"}, {"due", due}}}};
+        scheduler.add(request, out);
+    }
+    double addUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / total;
+
+    double cpu0 = cpuSeconds();
+    auto w0 = Clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    double wall = std::chrono::duration<double>(Clock::now() - w0).count();
+    double cpu = cpuSeconds() - cpu0;
+    scheduler.stop();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    std::sort(lateMs.begin(), lateMs.end());
+    auto pct = [&](double p) { return lateMs.empty() ? 0 : lateMs[static_cast<size_t>(p * (lateMs.size() - 1))]; };
+    std::printf("schedules=%d fired=%zu/%d add=%.1f us/schedule\n", total, lateMs.size(), fire, addUs);
+    std::printf("lateness ms: min %lld p50 %lld p99 %lld max %lld (tick %u ms)\n",
+                static_cast<long long>(pct(0)), static_cast<long long>(pct(0.5)),
+                static_cast<long long>(pct(0.99)), static_cast<long long>(pct(1)), CommandScheduler::TICK_MS);
+    std::printf("cpu: %.3f s over %.1f s wall (%.2f%%), including saves of %zu schedules\n",
+                cpu, wall, 100.0 * cpu / wall, scheduler.size());
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Discovery storm benchmark: signal handlers doing the work inline on the
+// loop thread against handlers that only enqueue into EventQueue, with a
+// worker that coalesces per device.
+//
+// N advertisers each send PropertiesChanged (RSSI/ServiceData) at a fixed
+// rate. Publishing one update costs "publish us" of busy time, standing in
+// for JSON building plus a contended MQTT publish.
+//
+//   ./signal_queue_bench [advertisers] [hz per advertiser] [seconds] [publish us]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ble_keys.h"
+#include "../event_queue.h"
+#include "../flat_map.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    MacAddr mac = 0;
+    int16_t rssi = 0;
+    std::vector<uint8_t> serviceData;
+};
+
+void busyFor(std::chrono::microseconds d)
+{
+    auto until = Clock::now() + d;
+    while (Clock::now() < until) {}
+}
+
+struct Result {
+    std::vector<double> handlerUs;   // time spent inside each signal handler
+    double maxLagMs = 0;             // how far dispatch fell behind the arrival schedule
+    size_t published = 0;
+    uint64_t dropped = 0;
+};
+
+double percentile(std::vector<double>& v, double p)
+{
+    if (v.empty()) return 0;
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+// The "loop thread": dispatches signals on schedule, handler is the callback
+template <typename Handler>
+void runStorm(size_t advertisers, int hz, int seconds, Result& result, Handler&& handler)
+{
+    size_t total = advertisers * hz * seconds;
+    auto interval = std::chrono::nanoseconds(1000000000LL / (static_cast<long long>(advertisers) * hz));
+    result.handlerUs.reserve(total);
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < total; ++i) {
+        auto due = start + interval * i;
+        auto now = Clock::now();
+        if (now < due) std::this_thread::sleep_until(due);
+        else result.maxLagMs = std::max(result.maxLagMs, std::chrono::duration<double, std::milli>(now - due).count());
+
+        Event ev;
+        ev.mac = 0xC0FFEE000000ULL + i % advertisers;
+        ev.rssi = static_cast<int16_t>(-40 - static_cast<int>(i % 50));
+        ev.serviceData.assign(12, static_cast<uint8_t>(i));
+
+        auto t0 = Clock::now();
+        handler(std::move(ev));
+        result.handlerUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+}
+
+void print(const char* label, Result& r)
+{
+    std::printf("%-8s handler p50 %7.2f us  p99 %8.2f us  max %9.2f us  lag %8.1f ms  published %zu  dropped %llu\n",
+                label, percentile(r.handlerUs, 0.50), percentile(r.handlerUs, 0.99),
+                *std::max_element(r.handlerUs.begin(), r.handlerUs.end()),
+                r.maxLagMs, r.published, static_cast<unsigned long long>(r.dropped));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t advertisers = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    int hz             = argc > 2 ? std::atoi(argv[2]) : 10;
+    int seconds        = argc > 3 ? std::atoi(argv[3]) : 3;
+    auto publishCost   = std::chrono::microseconds(argc > 4 ? std::atoi(argv[4]) : 150);
+
+    std::printf("advertisers=%zu rate=%d Hz each, %d s, publish cost %lld us\n",
+                advertisers, hz, seconds, static_cast<long long>(publishCost.count()));
+
+    // --- inline: publish from the handler ---
+    Result inlineResult;
+    runStorm(advertisers, hz, seconds, inlineResult, [&](Event&&) {
+        busyFor(publishCost);
+        ++inlineResult.published;
+    });
+    print("inline", inlineResult);
+
+    // --- queued: handler enqueues, worker coalesces per device ---
+    Result queuedResult;
+    EventQueue<Event> queue(8192);
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> published{0};
+
+    std::thread worker([&]() {
+        FlatMap<MacAddr, Event> pending;
+        pending.reserve(4096);
+        for (;;) {
+            Event ev;
+            size_t count = 0;
+            while (count < 4096 && queue.tryPop(ev)) {
+                ++count;
+                *pending.emplace(ev.mac).first = std::move(ev);
+            }
+            for (const auto& [mac, update] : pending) {
+                (void)update;
+                busyFor(publishCost);
+                ++published;
+            }
+            pending.clear();
+            if (count == 0) {
+                if (stop) break;
+                queue.wait(100);
+            }
+        }
+    });
+
+    runStorm(advertisers, hz, seconds, queuedResult, [&](Event&& ev) {
+        queue.tryPush(std::move(ev));
+    });
+    stop = true;
+    queue.wake();
+    worker.join();
+    queuedResult.published = published;
+    queuedResult.dropped = queue.droppedCount();
+    print("queued", queuedResult);
+    return 0;
+}
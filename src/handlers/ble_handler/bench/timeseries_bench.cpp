@@ -0,0 +1,111 @@
+// Time-series store benchmark: ingest N devices x 1 Hz for D days, then
+// time typical history queries against the mmap'd rings.
+//
+//   ./timeseries_bench [devices] [days] [dir]
+//
+// The directory is removed first and left in place afterwards so the
+// on-disk size can be inspected (du -sh).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "../latency_histogram.h"
+#include "../timeseries_store.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t diskBytes(const std::string& dir)
+{
+    uint64_t total = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        struct stat st{};
+        if (stat(entry.path().c_str(), &st) == 0) total += static_cast<uint64_t>(st.st_blocks) * 512;
+    }
+    return total;
+}
+
+template <typename F>
+void timeQueries(const char* label, int runs, F&& query)
+{
+    LatencyHistogram latency;
+    size_t results = 0;
+    for (int i = 0; i < runs; ++i) {
+        auto t0 = Clock::now();
+        results += query(i);
+        latency.record(Clock::now() - t0);
+    }
+    std::printf("%-32s %s  (%.0f results/query)\n", label, latency.summary().c_str(),
+                static_cast<double>(results) / runs);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int devices     = argc > 1 ? std::atoi(argv[1]) : 100;
+    int days        = argc > 2 ? std::atoi(argv[2]) : 30;
+    std::string dir = argc > 3 ? argv[3] : "/tmp/ble_timeseries_bench";
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+
+    TimeSeriesStore store(dir);
+    Uuid128 uuid;
+    parseUuid("d52246df-98ac-4d21-be1b-70d5f66a5ddb", uuid);
+    auto keyOf = [&](int d) { return SeriesKey{0xA4C138000000ULL + static_cast<uint64_t>(d), uuid, 0x05}; };
+
+    // Illuminance-like random walk per device, 1 Hz with a little jitter
+    const int64_t start = 1700000000000LL;
+    const int64_t seconds = int64_t(days) * 86400;
+    std::mt19937 rng(7);
+    std::vector<int64_t> value(devices, 50000);
+
+    auto t0 = Clock::now();
+    for (int64_t s = 0; s < seconds; ++s) {
+        for (int d = 0; d < devices; ++d) {
+            value[d] = std::max<int64_t>(0, value[d] + static_cast<int64_t>(rng() % 201) - 100);
+            store.append(keyOf(d), 0.01, start + s * 1000 + static_cast<int64_t>(rng() % 20), value[d]);
+        }
+    }
+    double ingestSec = std::chrono::duration<double>(Clock::now() - t0).count();
+    uint64_t samples = store.samplesAppended();
+
+    uint64_t bytes = diskBytes(dir);
+    std::printf("devices=%d days=%d samples=%llu\n", devices, days, static_cast<unsigned long long>(samples));
+    std::printf("ingest: %.2f s, %.2f M samples/s, %.0f ns/sample\n",
+                ingestSec, samples / ingestSec / 1e6, ingestSec * 1e9 / samples);
+    std::printf("disk: %.1f MiB total, %.2f bytes/sample\n", bytes / 1048576.0, double(bytes) / samples);
+
+    const int64_t end = start + seconds * 1000;
+    std::vector<HistoryPoint> points;
+    std::vector<HistoryBucket> buckets;
+
+    timeQueries("last hour, raw points", 200, [&](int i) {
+        store.query(keyOf(i % devices), end - 3600000, end, 10000, points);
+        return points.size();
+    });
+    timeQueries("last 24 h, 1 min buckets", 200, [&](int i) {
+        store.aggregate(keyOf(i % devices), end - 86400000, end, 60000, buckets);
+        return buckets.size();
+    });
+    timeQueries("whole range, 1 h buckets", 50, [&](int i) {
+        store.aggregate(keyOf(i % devices), start, end, 3600000, buckets);
+        return buckets.size();
+    });
+
+    // Oldest retained sample shows whether the ring held the whole range
+    store.query(keyOf(0), start, end, 0, points);
+    if (!points.empty())
+        std::printf("retained: %.1f days of %d\n", (end - points.front().tsMs) / 86400000.0, days);
+    return 0;
+}
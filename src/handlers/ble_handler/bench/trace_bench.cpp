@@ -0,0 +1,93 @@
+// Cost of a TraceSpan with tracing off and on, from one and from several
+// threads, and of flushing the rings to Chrome trace JSON. The file is
+// parsed back to check it is valid JSON with every event in it.
+//
+//   ./trace_bench [threads] [spans per thread]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../trace.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+thread_local volatile uint64_t sink = 0;
+
+// A span around a few ns of work, like a registry lookup
+double spanNs(int spans)
+{
+    auto t0 = Clock::now();
+    for (int i = 0; i < spans; ++i) {
+        TraceSpan span("registry_lookup", "A4:C1:38:00:00:01");
+        sink = sink + static_cast<uint64_t>(i);
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / spans;
+}
+
+double baselineNs(int spans)
+{
+    auto t0 = Clock::now();
+    for (int i = 0; i < spans; ++i) sink = sink + static_cast<uint64_t>(i);
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / spans;
+}
+
+// Wall time over all spans of all threads (on fewer cores than threads,
+// per-thread timings would count the time slices of the others)
+double threadedNs(int threads, int spans)
+{
+    std::vector<std::thread> pool;
+    auto t0 = Clock::now();
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back([t, spans] {
+            tracer.nameThread("worker " + std::to_string(t));
+            spanNs(spans);
+        });
+    for (auto& th : pool) th.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / (double(threads) * spans);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    int spans = argc > 2 ? std::atoi(argv[2]) : 2000000;
+    std::printf("%d threads, %d spans each, rings of %zu events\n", threads, spans, Tracer::BUFFER_EVENTS);
+
+    double base = baselineNs(spans);
+    tracer.enable(false);
+    double off = spanNs(spans);
+    tracer.enable(true);
+    double one = spanNs(spans);
+    double many = threadedNs(threads, spans);
+    std::printf("loop body %.2f ns | span off %.2f ns | on, 1 thread %.1f ns | on, %d threads %.1f ns (%u cores)\n",
+                base, off, one, threads, many, std::thread::hardware_concurrency());
+
+    // Flush what the rings hold: the last BUFFER_EVENTS of every thread
+    const std::string file = "/tmp/trace_bench.json";
+    size_t events = 0;
+    size_t threadsSeen = tracer.threads();
+    auto t0 = Clock::now();
+    bool ok = tracer.flush(file, events);
+    double flushMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    auto bytes = static_cast<long long>(in.tellg());
+    in.seekg(0);
+    auto doc = nlohmann::json::parse(in);
+    size_t spansInFile = 0;
+    for (const auto& e : doc["traceEvents"]) spansInFile += e["ph"] == "X";
+    std::printf("flush %s: %zu events from %zu threads in %.1f ms, %lld kB; parsed back %zu spans; "
+                "%llu recorded, %llu overwritten before the flush\n",
+                ok ? "ok" : "FAILED", events, threadsSeen, flushMs, bytes / 1000, spansInFile,
+                static_cast<unsigned long long>(tracer.recorded()), static_cast<unsigned long long>(tracer.lost()));
+    return ok && spansInFile == events ? 0 : 1;
+}
@@ -1,12 +1,48 @@
 #include <sdbus-c++/sdbus-c++.h>
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <algorithm>
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
+#include <future>
+#include <cmath>
+#include <optional>
+#include <set>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
 #include <nlohmann/json.hpp>
 #include <mqtt/async_client.h>
+#include "adv_monitor.h"
+#include "att_reactor.h"
+#include "ble_keys.h"
+#include "device_ownership.h"
+#include "device_query.h"
+#include "device_schema.h"
+#include "bthome.h"
+#include "bulk_transfer.h"
+#include "bus_pool.h"
+#include "device_snapshot.h"
+#include "device_state.h"
+#include "discovery_sessions.h"
+#include "event_queue.h"
+#include "event_reactor.h"
+#include "flat_map.h"
+#include "gatt_discovery.h"
+#include "link_quality.h"
+#include "op_coalescer.h"
+#include "op_queue.h"
+#include "path_table.h"
+#include "poll_scheduler.h"
+#include "reconnect_supervisor.h"
+#include "command_scheduler.h"
+#include "coro_executor.h"
+#include "rules_engine.h"
+#include "timeseries_store.h"
+#include "trace.h"
 
 using json = nlohmann::json;
 using sdbus::ObjectPath;
@@ -22,34 +58,101 @@ const std::string Service_IFACE = "org.bluez.GattService1";
 const std::string Characteristic_IFACE = "org.bluez.GattCharacteristic1";
 const std::string Descriptor_IFACE = "org.bluez.GattDescriptor1";
 const std::string PROPERTIES_IFACE = "org.freedesktop.DBus.Properties";
+const std::string INTROSPECTABLE_IFACE = "org.freedesktop.DBus.Introspectable";
+const std::string MONITOR_MANAGER_IFACE = "org.bluez.AdvertisementMonitorManager1";
+const std::string MONITOR_IFACE = "org.bluez.AdvertisementMonitor1";
+const std::string MONITOR_ROOT_PATH = "/ble_handler/monitor";     // ObjectManager bluetoothd reads
+const std::string MONITOR_PATH = "/ble_handler/monitor/devices";
 
 //MQTT info
 const std::string SERVER_ADDRESS = "tcp://localhost:1883";
 const std::string CLIENT_ID = "ble_handler";
 const std::string OUTPUT_TOPIC{"home-automation/hub"};
 const std::string INPUT_TOPIC{"home-automation/ble_handler"};  // Topic to subscribe to
+const std::string DEVICE_TOPIC_PREFIX{"home-automation/ble/"};  // <mac>/state (retained) and <mac>/event
+
+//Scale-out: several instances on one broker (--instance <id>), see device_ownership.h
+const std::string SHARED_INPUT_TOPIC{"$share/ble_handler/" + INPUT_TOPIC}; // each command reaches one instance
+const std::string BROADCAST_TOPIC{INPUT_TOPIC + "/all"};          // registry changes, for every instance
+const std::string INSTANCE_TOPIC_PREFIX{INPUT_TOPIC + "/instance/"}; // commands for one instance
+const std::string OWNERSHIP_TOPIC{INPUT_TOPIC + "/ownership"};    // bids and claims of every instance
+constexpr int64_t OWNERSHIP_GOSSIP_MS = 2000;
+
+//query_devices: a snapshot serves every query until it is this old or the registry changes
+constexpr int64_t QUERY_SNAPSHOT_MAX_AGE_MS = 1000;
+
+//Persistence
+const std::string SNAPSHOT_PATH = "./data/ble_registry.snap";
+const std::string DEVICES_CONFIG_PATH = "./config/devices_config.json";
+const std::string HISTORY_DIR = "./data/history";
+constexpr size_t HISTORY_MAX_POINTS = 10000;  // per query_history answer, raw points or buckets
+const std::string RULES_CONFIG_PATH = "./config/rules_config.json";
+const std::string SCHEDULES_PATH = "./data/schedules.json";
+const std::string TRACE_PATH_PREFIX = "./data/trace-";   // + wall clock ms + .json
+
+//D-Bus connections for outbound calls (the main connection only carries signals)
+constexpr size_t BUS_IO_CONNECTIONS = 2;
+
+//Radio operations requested over MQTT
+constexpr size_t RADIO_OP_WORKERS = 3;
+
+//Coroutine workflows (commands, Link_Devices) resume on these; they hold no thread while waiting
+constexpr size_t CORO_THREADS = 2;
+constexpr uint64_t LINK_SCAN_KEY = 1ULL << 63;  // wake key of Link_Devices scans (above any MAC)
+
+//Bulk transfers (bulk_write)
+constexpr size_t BULK_WINDOW_CHUNKS = 16;       // writes without response between acknowledged checkpoints
+constexpr size_t BULK_MAX_BYTES = 1 << 20;      // largest payload one command may carry
+constexpr size_t ATT_DEFAULT_PAYLOAD = 20;      // ATT MTU 23 - 3, when no write socket reports the MTU
+constexpr int64_t BULK_PROGRESS_MS = 500;       // at most one progress event per interval
+constexpr int64_t BULK_BACKOFF_MS = 2;          // write socket full (no controller credits) or draining
+constexpr int64_t BULK_STALL_MS = 2000;         // socket stuck this long = link stalled
+constexpr int BULK_RETRIES = 2;                 // rewinds to the last checkpoint before giving up
+
+//Signal processing
+constexpr size_t SIGNAL_QUEUE_CAPACITY = 8192;  // events buffered between the sdbus loop and the signal worker
+constexpr size_t SIGNAL_BATCH_MAX = 4096;       // events coalesced per batch (> devices in a storm)
+
+//Discovery cycle: scan window, then a short pause before the next one
+constexpr int64_t DISCOVERY_WINDOW_MS = 30000;
+constexpr int64_t DISCOVERY_PAUSE_MS = 1000;
+constexpr int64_t DISCOVERY_TICK_MS = 100;      // session results while sessions run
+const MonitorRssi MONITOR_RSSI{};               // passive scanning filter, see adv_monitor.h
+
+//Characteristic paths relative to their device node, interned
+//(e.g. "/service0010/char0011", shared by every device with that layout)
+PathTable object_paths;
+
+using CharacteristicMap = FlatMap<Uuid128, PathId>; //key=UUID value=interned relative Path
 
 //strusts & enum
 struct BLEDevice {
-    std::string address;       // MAC address
+    MacAddr mac = 0;           // MAC address, packed
     std::string path;          // D-Bus object path
     std::string name;
     bool discovered = false;
     bool connected = false;
     bool paired = false;
     bool trusted = false;
-    std::unordered_map<std::string, std::string> characteristics; //key=UUID value=Path
+    int16_t rssi = 0;          // last RSSI in dBm, 0 = unknown
+    int64_t lastSeenMs = 0;    // unix time in ms
+    CharacteristicMap characteristics;
+    std::string gattHash;      // Database Hash (hex) characteristics was read under, empty = unknown
     std::shared_ptr<sdbus::IProxy> proxy;
     std::mutex mtx;
 
-    void setAddress(const std::string& value) {
+    void setMac(const MacAddr& value) {
         std::lock_guard<std::mutex> lock(mtx);
-        address = value;
+        mac = value;
     }
 
-    std::string getAddress() {
+    MacAddr getMac() {
         std::lock_guard<std::mutex> lock(mtx);
-        return address;
+        return mac;
+    }
+
+    std::string getAddress() {
+        return macToString(getMac());
     }
 
     void setPath(const std::string& value) {
@@ -112,27 +215,80 @@ struct BLEDevice {
         return trusted;
     }
 
-    void setCharacteristics(const std::unordered_map<std::string, std::string>& value) {
+    void setRssi(const int16_t& value) {
+        std::lock_guard<std::mutex> lock(mtx);
+        rssi = value;
+    }
+
+    int16_t getRssi() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return rssi;
+    }
+
+    void setLastSeen(const int64_t& value) {
+        std::lock_guard<std::mutex> lock(mtx);
+        lastSeenMs = value;
+    }
+
+    int64_t getLastSeen() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return lastSeenMs;
+    }
+
+    void setCharacteristics(const CharacteristicMap& value) {
         std::lock_guard<std::mutex> lock(mtx);
         characteristics = value;
     }
 
-    std::unordered_map<std::string, std::string> getCharacteristics() {
+    CharacteristicMap getCharacteristics() {
         std::lock_guard<std::mutex> lock(mtx);
         return characteristics;
     }
 
-    void addCharacteristics(std::string uuid, std::string path) {
+    void setGattHash(const std::string& value) {
         std::lock_guard<std::mutex> lock(mtx);
-        if (auto it = characteristics.find(uuid); it != characteristics.end()) return;
-        characteristics[uuid] = path;
+        gattHash = value;
     }
 
-    void removeCharacteristics(std::string uuid) {
+    std::string getGattHash() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return gattHash;
+    }
+
+    // INVALID_PATH if the characteristic is unknown
+    PathId findCharacteristic(const Uuid128& uuid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        const PathId* id = characteristics.find(uuid);
+        return id ? *id : INVALID_PATH;
+    }
+
+    // Full object path of a characteristic, empty if unknown
+    std::string getCharacteristicPath(const Uuid128& uuid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        const PathId* id = characteristics.find(uuid);
+        return id ? path + object_paths.str(*id) : std::string();
+    }
+
+    void addCharacteristics(const Uuid128& uuid, PathId path) {
+        std::lock_guard<std::mutex> lock(mtx);
+        characteristics.emplace(uuid, path);
+    }
+
+    void removeCharacteristics(const Uuid128& uuid) {
         std::lock_guard<std::mutex> lock(mtx);
         characteristics.erase(uuid);
     }
 
+    void removeCharacteristicPath(PathId path) {
+        std::lock_guard<std::mutex> lock(mtx);
+        Uuid128 found;
+        bool match = false;
+        for (const auto& [uuid, id] : characteristics) {
+            if (id == path) { found = uuid; match = true; break; }
+        }
+        if (match) characteristics.erase(found);
+    }
+
     void setProxy(const std::shared_ptr<sdbus::IProxy>& value) {
         std::lock_guard<std::mutex> lock(mtx);
         proxy = value;
@@ -144,84 +300,281 @@ struct BLEDevice {
     }
 };
 
-struct ScanHandle {
-    std::shared_ptr<sdbus::IProxy> proxy;
-    std::thread worker;
-    std::shared_ptr<std::atomic<bool>> stopRequested;
-
-    ScanHandle() : stopRequested(std::make_shared<std::atomic<bool>>(false)) {}
-
-    ~ScanHandle() {
-        stop(); // ensure the scan stops and thread joins
-    }
-
-    // Not copyable
-    ScanHandle(const ScanHandle&) = delete;
-    ScanHandle& operator=(const ScanHandle&) = delete;
-
-    // Movable
-    ScanHandle(ScanHandle&& other) noexcept
-        : proxy(std::move(other.proxy)),
-          worker(std::move(other.worker)),
-          stopRequested(std::move(other.stopRequested)) {}
+//Signal events. The sdbus loop thread only decodes a signal into a BusEvent
+//and queues it; the signal worker applies it to the registry and publishes.
+enum class BusEventType : uint8_t {
+    None,
+    DeviceAdded,            // InterfacesAdded with Device1
+    DeviceRemoved,          // InterfacesRemoved with Device1
+    DeviceProperties,       // PropertiesChanged on a registered device
+    CharacteristicAdded,
+    CharacteristicRemoved,
+    ScanDeviceAdded,        // seen by a scanDevices() session
+    ScanDeviceRemoved,
+    MonitorDeviceFound,     // AdvertisementMonitor1.DeviceFound / DeviceLost
+    MonitorDeviceLost,
+};
 
-    ScanHandle& operator=(ScanHandle&& other) noexcept {
-        if (this != &other) {
-            stop();
-            proxy = std::move(other.proxy);
-            worker = std::move(other.worker);
-            stopRequested = std::move(other.stopRequested);
-        }
-        return *this;
+// For traces
+const char* bus_event_name(BusEventType type)
+{
+    switch (type) {
+    case BusEventType::DeviceAdded: return "DeviceAdded";
+    case BusEventType::DeviceRemoved: return "DeviceRemoved";
+    case BusEventType::DeviceProperties: return "DeviceProperties";
+    case BusEventType::CharacteristicAdded: return "CharacteristicAdded";
+    case BusEventType::CharacteristicRemoved: return "CharacteristicRemoved";
+    case BusEventType::ScanDeviceAdded: return "ScanDeviceAdded";
+    case BusEventType::ScanDeviceRemoved: return "ScanDeviceRemoved";
+    case BusEventType::MonitorDeviceFound: return "MonitorDeviceFound";
+    case BusEventType::MonitorDeviceLost: return "MonitorDeviceLost";
+    default: return "None";
     }
+}
 
-    // Explicit stop method
-    void stop() {
-        if (stopRequested) stopRequested->store(true); // checks if stopRequested pointer is not null then -> request stop
-        if (worker.joinable()) {
-            try {
-                worker.join(); // wait for the worker thread to finish
-            } catch (const std::system_error& e) {
-                std::cerr << "Error joining scan thread: " << e.what() << std::endl;
-            }
-        }
-    }
+//BusEvent::present bits
+constexpr uint8_t EV_CONNECTED = 1 << 0;
+constexpr uint8_t EV_PAIRED    = 1 << 1;
+constexpr uint8_t EV_TRUSTED   = 1 << 2;
+constexpr uint8_t EV_RSSI      = 1 << 3;
+constexpr uint8_t EV_NAME      = 1 << 4;
+constexpr uint8_t EV_TXPOWER   = 1 << 5;
+constexpr uint8_t EV_SERVICES_RESOLVED = 1 << 6;
+
+struct BusEvent {
+    BusEventType type = BusEventType::None;
+    MacAddr mac = 0;
+    uint8_t present = 0;       // which of the fields below the signal carried
+    bool connected = false;
+    bool paired = false;
+    bool trusted = false;
+    int16_t rssi = 0;
+    int16_t txPower = 0;
+    bool servicesResolved = false;
+    std::string name;
+    Uuid128 uuid;              // CharacteristicAdded
+    std::string path;          // object path of added/removed objects
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> serviceData; // uuid, bytes
+    std::vector<Uuid128> uuids;  // advertised services (UUIDs property)
+    std::chrono::steady_clock::time_point received; // when the loop thread queued it
 };
 
+using ManagedObjects = std::map<sdbus::ObjectPath, std::map<std::string, std::map<std::string, sdbus::Variant>>>;
+
 //prototypes 
+Task<std::optional<ManagedObjects>> get_managed_objects_async();
+bool get_managed_objects(ManagedObjects& managedObjects);
+Task<void> adapter_call_async(std::string method);
+void adapter_call(const std::string& method);
 bool set_bool_property(const std::string& devicePath, const std::string& propertyName, bool value);
 bool get_bool_property(const std::string& devicePath, std::string propertyName);
 std::string get_string_property(const std::string& devicePath, std::string propertyName);
 
-ScanHandle scanDevices(std::shared_ptr<std::unordered_map<std::string, std::shared_ptr<BLEDevice>>>& discovered, std::mutex& discoveredMutex,
-                       int scanDurationMs = 0); // 0 = run until manually stopped
+using DeviceMap = FlatMap<MacAddr, std::shared_ptr<BLEDevice>>;
+
+Task<std::shared_ptr<sdbus::IProxy>> scanDevices(std::shared_ptr<DeviceMap> discovered,
+                                                 std::shared_ptr<std::mutex> discoveredMutex);
+Task<bool> pair_device_async(std::shared_ptr<BLEDevice> device, int maxRetries = 3, int timeoutMs = 10000);
+Task<bool> connect_device_async(std::shared_ptr<BLEDevice> device, int maxRetries = 3, int timeoutMs = 10000);
+Task<bool> disconnect_device_async(std::shared_ptr<BLEDevice> device);
 bool pairDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries = 3, int timeoutMs = 10000);
 bool connectDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries = 3, int timeoutMs = 10000);
-bool DisconnectDevice(BLEDevice& device);
-void Link_Devices(int scanTimeMs = 20000);
-std::unordered_map<std::string, std::string> getCharacteristics(
+Task<void> Link_Devices(int scanTimeMs = 20000);
+CharacteristicMap getCharacteristics(
     const sdbus::ObjectPath& devPath,
     const std::map<sdbus::ObjectPath, std::map<std::string, std::map<std::string, sdbus::Variant>>>& managedObjects);
-void handleDevicePropertiesChanged(
-    std::weak_ptr<BLEDevice> weakDev,
-    std::weak_ptr<sdbus::IConnection> weakCon,
-    const std::string& interface,
-    const std::map<std::string, sdbus::Variant>& changed,
-    const std::vector<std::string>& invalidated);
-
-void add_device(const std::string mac);
-void remove_device(const std::string mac);
-std::shared_ptr<BLEDevice> get_device(const std::string mac);
+void decode_device_properties(const std::map<std::string, sdbus::Variant>& props, BusEvent& ev);
+void enqueue_signal(BusEvent&& ev);
+void apply_bus_event(BusEvent& ev);
+void apply_device_properties(const std::shared_ptr<BLEDevice>& device, const BusEvent& ev);
+void signal_worker();
+void ingest_reading(MacAddr mac, const Uuid128& uuid, const std::vector<uint8_t>& value, int64_t tsMs,
+                    std::chrono::steady_clock::time_point received);
+void publish_link_quality(const LinkQuality& q);
+void publish_device_state(const std::shared_ptr<BLEDevice>& dev, const std::string& type);
+void offer_sighting(const BusEvent& ev, const std::string& name);
+void publish_discovery(const std::vector<DiscoveryResult>& results, const std::vector<DiscoverySummary>& ended);
+bool read_characteristic_value(BLEDevice& device, const Uuid128& uuid, std::vector<uint8_t>& value);
+void poll_worker();
+void reconnect_worker();
+void kick_reconnect_worker();
+void publish_reconnect_change(MacAddr mac, ReconnectSupervisor::Change change, int64_t downtimeMs);
+bool run_radio_op(OpPriority priority, const std::string& command, std::function<bool()> fn);
+void schedule_gatt_refresh(const std::shared_ptr<BLEDevice>& device);
+void release_att_channels(MacAddr mac);
+bool run_blocking(const std::string& command, std::function<void()> fn);
+std::string flush_trace(size_t& events);
+void kick_discovery_tick();
+bool owns_device(MacAddr mac);
+Task<void> register_adv_monitor();
+void refresh_adv_monitor();
+
+void add_device(MacAddr mac);
+void remove_device(MacAddr mac);
+std::shared_ptr<BLEDevice> get_device(MacAddr mac);
+void register_device_signals(const std::shared_ptr<BLEDevice>& dev);
+bool save_registry_snapshot();
+std::vector<std::shared_ptr<BLEDevice>> warm_start_registry();
 
 //Global variables
-std::shared_ptr<sdbus::IConnection> connection = sdbus::createSystemBusConnection();
+std::shared_ptr<sdbus::IConnection> connection = sdbus::createSystemBusConnection(); //signals only
+BusPool bus_pool; //method calls
+CoroExecutor coro_executor; //resumes awaited calls, timeouts and device waits
 
-std::unordered_map<std::string, std::shared_ptr<BLEDevice>> devices; //key = mac address
+DeviceMap devices; //key = packed mac address
 std::mutex devicesMutex;
 
-mqtt::async_client client(SERVER_ADDRESS, CLIENT_ID);
+std::unique_ptr<mqtt::async_client> client; // created in main(), the client id depends on --instance
 std::mutex mqtt_mutex;
 std::atomic<bool> mqtt_connected = false;
+DeviceStateTable device_states; // what the retained state topics hold
+TopicAliases topic_aliases;     // guarded by mqtt_mutex, reset per connection
+std::atomic<uint16_t> topic_alias_max = 0; // from the broker's CONNACK
+
+SchemaStore schema_store(DEVICES_CONFIG_PATH);
+
+std::atomic<bool> registry_dirty = false;  // set when the snapshot on disk is stale
+std::atomic<uint64_t> registry_generation = 0; // bumped when a device is added or removed
+std::mutex query_snapshot_mutex;
+std::shared_ptr<const DeviceQuerySnapshot> query_snapshot;
+uint64_t query_snapshot_generation = 0;
+int64_t query_snapshot_steady_ms = 0;
+std::atomic<uint64_t> queries_served = 0;
+std::atomic<uint64_t> query_snapshots_built = 0;
+const auto process_start = std::chrono::steady_clock::now();
+std::atomic<bool> first_read_done = false;
+bool warm_started = false;
+bool verbose_stats = false;   // --stats: every subsystem's counters, not just the summary line
+
+EventQueue<BusEvent> signal_queue(SIGNAL_QUEUE_CAPACITY);
+std::atomic<bool> signal_worker_stop = false;
+std::atomic<uint64_t> signals_applied = 0;    // events handled by the worker
+std::atomic<uint64_t> signals_coalesced = 0;  // PropertiesChanged folded into an earlier one
+std::atomic<size_t> signals_max_batch = 0;
+// Events that must not be lost, queued here while the ring is full; in
+// arrival order, applied before anything newer from the ring
+std::deque<BusEvent> signal_overflow;
+std::mutex signal_overflow_mutex;
+std::atomic<bool> signal_overflowing = false;
+std::atomic<uint64_t> signals_spilled = 0;    // went through signal_overflow
+std::atomic<uint64_t> signals_dropped = 0;    // RSSI / advertisement data discarded while full
+
+TimeSeriesStore history_store(HISTORY_DIR);
+RuleEngine rules_engine(RULES_CONFIG_PATH, DEVICES_CONFIG_PATH);
+LinkQualityTable link_quality; // smoothed RSSI / presence per device
+DiscoverySessions discovery_sessions; // scan_devices_on clients sharing one discovery
+
+PollScheduler poll_scheduler;               // owned by the poll worker
+std::atomic<bool> poll_worker_stop = false;
+std::atomic<bool> poll_targets_dirty = true; // registry changed, resync the poll targets
+std::mutex poll_mutex;
+std::condition_variable poll_cv;
+LatencyHistogram history_query_latency;
+CommandScheduler command_scheduler(SCHEDULES_PATH);
+OpQueue radio_ops; // reads, writes, connect/pair/disconnect from commands
+GattRefreshStats gatt_refresh_stats;
+BulkTransferStats bulk_stats;
+AdvMonitorStats monitor_stats;
+std::string instance_id; // --instance, empty when this is the only instance
+std::unique_ptr<DeviceOwnership> ownership; // which instance holds which device, scale-out only
+std::atomic<uint64_t> commands_forwarded = 0;
+std::atomic<bool> ownership_worker_stop = false;
+std::mutex ownership_mutex;
+std::condition_variable ownership_cv;
+std::atomic<bool> trace_signal_stop = false;
+std::atomic<bool> monitor_active = false; // bluetoothd scans passively for us, no discovery cycling
+std::unique_ptr<sdbus::IObject> monitor_root;
+std::unique_ptr<sdbus::IObject> monitor_object;
+std::vector<MonitorPattern> monitor_patterns; // what monitor_object reports
+std::shared_ptr<const SchemaIndex> monitor_schema; // the patterns were built from this
+std::mutex monitor_mutex;
+AttReactor att_reactor; // AcquireNotify/AcquireWrite sockets
+std::set<std::pair<MacAddr, Uuid128>> acquire_write_unsupported; // fall back to WriteValue until reconnect
+std::mutex acquire_mutex;
+FlatSet<MacAddr> gatt_refresh_pending; // devices with a refresh queued
+std::mutex gatt_refresh_mutex;
+bool reactor_mode = false; // --reactor: one event loop instead of the worker threads
+EventReactor event_reactor;
+ProcessUsage usage_mark = ProcessUsage::sample(); // last stats line
+uint64_t reactor_wakeups_mark = 0;
+uint64_t reactor_busy_mark = 0;
+
+int64_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Monotonic ms for timers; unaffected by wall clock changes
+int64_t steady_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ReconnectSupervisor reconnect_supervisor(steady_ms()); // heals dropped connections
+std::atomic<bool> reconnect_worker_stop = false;
+std::atomic<bool> reconnect_kick = false;              // supervisor state changed, re-check now
+std::mutex reconnect_mutex;
+std::condition_variable reconnect_cv;
+
+// A radio op slot held by a coroutine: counts against the op queue limits
+// until it goes out of scope. Empty when the op expired or was rejected.
+class RadioSlot {
+public:
+    RadioSlot() = default;
+    RadioSlot(std::function<void()> release, bool expired) : release(std::move(release)), wasExpired(expired) {}
+    RadioSlot(RadioSlot&& other) noexcept
+        : release(std::exchange(other.release, nullptr)), wasExpired(other.wasExpired) {}
+    RadioSlot& operator=(const RadioSlot&) = delete;
+    ~RadioSlot() {
+        if (release) release();
+    }
+
+    explicit operator bool() const { return static_cast<bool>(release); }
+    bool expired() const { return wasExpired; }
+
+private:
+    std::function<void()> release;
+    bool wasExpired = false;
+};
+
+// co_await admit_radio(...) queues an op on radio_ops and resumes the
+// coroutine on the executor once a worker picks it up, so commands and
+// Link_Devices stay under the same priority classes and budgets as the
+// blocking callers of run_radio_op().
+struct RadioAdmission {
+    struct Outcome {
+        std::function<void()> release;
+        bool expired = false;
+    };
+    RadioOp op;
+    std::shared_ptr<Outcome> outcome = std::make_shared<Outcome>();
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+        op.start = [outcome = outcome, h](std::function<void()> done) {
+            outcome->release = std::move(done);
+            coro_executor.post(h);
+        };
+        op.expired = [outcome = outcome, h]() {
+            outcome->expired = true;
+            coro_executor.post(h);
+        };
+        // Once submitted the op may resume h at any time: no member access after this
+        return radio_ops.submit(std::move(op));
+    }
+    RadioSlot await_resume() { return RadioSlot(std::move(outcome->release), outcome->expired); }
+};
+
+RadioAdmission admit_radio(const std::string& command, OpPriority priority, int64_t deadlineMs = 0)
+{
+    RadioAdmission admission;
+    admission.op.command = command;
+    admission.op.priority = priority;
+    admission.op.deadlineMs = deadlineMs;
+    return admission;
+}
 
 void mqtt_publish(mqtt::message_ptr pubmsg)
 {
@@ -229,42 +582,103 @@ void mqtt_publish(mqtt::message_ptr pubmsg)
         std::cerr << "MQTT not connected\n";
         return;
     } else {
+        TraceSpan span("mqtt_publish", pubmsg->get_topic());
         std::lock_guard<std::mutex> lock(mqtt_mutex);
-        client.publish(pubmsg);  // async publish
+        client->publish(pubmsg);  // async publish
+    }
+}
+
+// Publishes on a device topic, with a topic alias when the broker allows.
+// QoS 1 always carries the topic: it may be retransmitted on the resumed
+// session after a reconnect, where the alias means nothing.
+void mqtt_publish_device_topic(const std::string& topic, const std::string& payload, int qos, bool retained)
+{
+    if (!mqtt_connected) {
+        std::cerr << "MQTT not connected\n";
+        return;
+    }
+    TraceSpan span("mqtt_publish", topic);
+    std::lock_guard<std::mutex> lock(mqtt_mutex);
+    bool sendTopic = true;
+    uint16_t alias = qos == 0 ? topic_aliases.resolve(topic, sendTopic) : 0;
+    if (!alias) {
+        client->publish(mqtt::make_message(topic, payload, qos, retained));
+        return;
     }
+    mqtt::properties props{mqtt::property(mqtt::property::TOPIC_ALIAS, alias)};
+    client->publish(mqtt::make_message(sendTopic ? topic : std::string(), payload, qos, retained, props));
 }
 
-void add_device(const std::string mac)
+/**********************************************************************
+|   publish_device_event() merges fields into the device's state and   |
+|   publishes what changed: the full document retained on              |
+|   <mac>/state, the changed fields (plus extra, which is not state)   |
+|   on <mac>/event. An update that changes nothing publishes nothing.  |
+|   With several instances only the holder of a device publishes it.   |
+***********************************************************************/
+void publish_device_event(MacAddr mac, const std::string& type, const json& fields, const json& extra = json())
+{
+    if (!owns_device(mac)) return;
+    json state, delta;
+    if (!device_states.merge(mac, fields, state, delta)) return;
+
+    int64_t ts = now_ms();
+    std::string address = macToString(mac);
+    std::string base = DEVICE_TOPIC_PREFIX + address;
+    state["device_mac"] = address;
+    state["updated"] = ts;
+    mqtt_publish_device_topic(base + "/state", state.dump(), 1, true);
+
+    json event = {{"origin", "ble_handler"}, {"type", type}, {"device_mac", address}, {"ts", ts}};
+    event.update(delta);
+    if (extra.is_object()) event.update(extra);
+    mqtt_publish_device_topic(base + "/event", event.dump(), 0, false);
+}
+
+// The full state of every device we hold, after a reconnect: changes
+// merged while the broker was away were recorded but not published, and
+// later identical values publish nothing
+void republish_device_states()
+{
+    int64_t ts = now_ms();
+    for (auto& [mac, state] : device_states.all()) {
+        if (!owns_device(mac)) continue;
+        std::string address = macToString(mac);
+        state["device_mac"] = address;
+        state["updated"] = ts;
+        mqtt_publish_device_topic(DEVICE_TOPIC_PREFIX + address + "/state", state.dump(), 1, true);
+    }
+}
+
+// Empty retained message: the broker drops the device's state
+void clear_device_state(MacAddr mac)
+{
+    device_states.erase(mac);
+    mqtt_publish_device_topic(DEVICE_TOPIC_PREFIX + macToString(mac) + "/state", std::string(), 1, true);
+}
+
+void add_device(MacAddr mac)
 {
     {
         std::lock_guard<std::mutex> lock(devicesMutex);
-        if (devices.find(mac) != devices.end()) return;
+        if (devices.contains(mac)) return;
     }
 
     auto dev = std::make_shared<BLEDevice>();
-    dev->address = mac;
+    dev->mac = mac;
 
     //see if device is discovered
-    auto proxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, "/");
-    std::map<sdbus::ObjectPath, std::map<std::string, std::map<std::string, sdbus::Variant>>> managedObjects;
-    try {
-        proxy->callMethod("GetManagedObjects")
-            .onInterface(DBUS_OM_IFACE)
-            .storeResultsTo(managedObjects);
-    } 
-    catch (const sdbus::Error& e) {
-        std::cerr << "Faild to GetManagedObjects: " << e.getName() << " - " << e.getMessage() << "\n";
-    }
+    ManagedObjects managedObjects;
+    get_managed_objects(managedObjects);
 
     for (const auto& [path, interfaces] : managedObjects) 
     {
         if (auto it = interfaces.find(DEVICE_IFACE); it != interfaces.end()) 
         {
             const auto& props = it->second;
-            if (props.count("Address")) 
+            MacAddr address;
+            if (macFromPath(path, address)) 
             {
-                auto address = props.at("Address").get<std::string>();
-
                 if (address == mac) 
                 {
                     dev->path       = path;
@@ -273,24 +687,12 @@ void add_device(const std::string mac)
                     dev->connected  = props.count("Connected") ? props.at("Connected").get<bool>() : false;
                     dev->paired     = props.count("Paired") ? props.at("Paired").get<bool>() : false;
                     dev->trusted    = props.count("Trusted") ? props.at("Trusted").get<bool>() : false;
+                    dev->rssi       = props.count("RSSI") ? props.at("RSSI").get<int16_t>() : 0;
+                    dev->lastSeenMs = now_ms();
                     dev->characteristics = getCharacteristics(path, managedObjects);
 
                     //---create signal handler---
-                    std::shared_ptr<sdbus::IProxy> proxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, path);
-                    dev->setProxy(proxy);
-
-                    // Capture weak_ptr to device so handler won’t access dangling memory
-                    std::weak_ptr<BLEDevice> weakDev = dev;
-                    std::weak_ptr<sdbus::IConnection> weakCon = connection;
-
-                    dev->proxy->uponSignal("PropertiesChanged")
-                        .onInterface(PROPERTIES_IFACE)
-                        .call([weakDev, weakCon](const std::string& interface,
-                                const std::map<std::string, sdbus::Variant>& changed,
-                                const std::vector<std::string>& invalidated) {
-                            handleDevicePropertiesChanged(weakDev, weakCon, interface, changed, invalidated);
-                    });
-                    dev->proxy->finishRegistration();
+                    register_device_signals(dev);
 
                     continue;
                 }
@@ -299,29 +701,17 @@ void add_device(const std::string mac)
     }
     {
         std::lock_guard<std::mutex> lock(devicesMutex);
-        if (devices.find(mac) != devices.end()) return;
-        devices[mac] = dev;
-    }
-
-    std::cout << "Device added: " << mac << std::endl;
-    json j;
-    j["origin"] = "ble_handler";
-    j["type"] = "device_added";
-    {
-        std::lock_guard<std::mutex> lock(dev->mtx);
-        j["device_mac"] = dev->address;
-        j["name"] = dev->name;
-        j["discovered"] = dev->discovered;
-        j["connected"] = dev->connected;
-        j["paired"] = dev->paired;
-        j["trusted"] = dev->trusted;
+        if (!devices.emplace(mac, dev).second) return;
     }
+    registry_dirty = true;
+    ++registry_generation;
+    poll_targets_dirty = true;
 
-    mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
-    mqtt_publish(pubmsg);
+    std::cout << "Device added: " << macToString(mac) << std::endl;
+    publish_device_state(dev, "device_added");
 }
 
-void remove_device(const std::string mac)
+void remove_device(MacAddr mac)
 {
     std::shared_ptr<BLEDevice> dev;
     json j;
@@ -332,289 +722,848 @@ void remove_device(const std::string mac)
     {
         std::lock_guard<std::mutex> lock(devicesMutex);
         auto it = devices.find(mac);
-        if (it == devices.end())
+        if (!it)
         {
-            std::cout << "[Error] Device removed: Device not found-> " << mac << std::endl;
+            std::cout << "[Error] Device removed: Device not found-> " << macToString(mac) << std::endl;
             j["Error"] = "Device not found";
             mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
             mqtt_publish(pubmsg);
             return;  // Device not found
         }
 
-        dev = it->second;      // Keep a shared_ptr copy
-        devices.erase(it);     // Erase from map immediately
+        dev = *it;             // Keep a shared_ptr copy
+        devices.erase(mac);    // Erase from map immediately
     }
-
-    // Step 2: Disconnect safely outside the devicesMutex
-    // This avoids deadlocks if DisconnectDevice triggers signal callbacks
+    registry_dirty = true;
+    ++registry_generation;
+    poll_targets_dirty = true;
+    link_quality.forget(mac);
+    reconnect_supervisor.forget(mac);
+    if (ownership) ownership->forget(mac);
+
+    // Step 2: Disconnect safely outside the devicesMutex, on the executor
+    // so the MQTT callback (or the reactor loop) does not wait for BlueZ
     if (dev) {
-        DisconnectDevice(*dev);       // Disconnect BLE device
-        dev->proxy.reset();           // Reset proxy to stop further calls
+        coro_executor.spawn([](std::shared_ptr<BLEDevice> dev) -> Task<void> {
+            co_await disconnect_device_async(dev);   // Disconnect BLE device
+            dev->setProxy(nullptr);                  // Reset proxy to stop further calls
+        }(dev));
     }
 
-    // Step 3: After this, dev will go out of scope, freeing memory safely
+    // Step 3: The coroutine holds the last reference and frees the device
 
-    std::cout << "Device removed: " << mac << std::endl;
-    j["device_mac"] = mac;
-    mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
-    mqtt_publish(pubmsg);
+    std::cout << "Device removed: " << macToString(mac) << std::endl;
+    j["device_mac"] = macToString(mac);
+    j["ts"] = now_ms();
+    clear_device_state(mac);
+    mqtt_publish_device_topic(DEVICE_TOPIC_PREFIX + macToString(mac) + "/event", j.dump(), 1, false);
 }
 
 
-std::shared_ptr<BLEDevice> get_device(const std::string mac)
+std::shared_ptr<BLEDevice> get_device(MacAddr mac)
 {
+    TraceSpan span("registry_lookup");
     std::lock_guard<std::mutex> lock(devicesMutex);
-    if (devices.find(mac) == devices.end()) return nullptr;
-    std::shared_ptr<BLEDevice> dev = devices[mac];
-    return dev;
+    auto it = devices.find(mac);
+    return it ? *it : nullptr;
 }
 
-void handleDevicePropertiesChanged(
-    std::weak_ptr<BLEDevice> weakDev,
-    std::weak_ptr<sdbus::IConnection> weakCon,
-    const std::string& interface,
-    const std::map<std::string, sdbus::Variant>& changed,
-    const std::vector<std::string>& invalidated)
+void register_device_signals(const std::shared_ptr<BLEDevice>& dev)
 {
-    if (interface != DEVICE_IFACE)
-        return;
+    std::shared_ptr<sdbus::IProxy> proxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, dev->getPath());
+    dev->setProxy(proxy);
+
+    // Capture the key, not the device: the worker looks it up again and
+    // skips the event if the device was removed in the meantime
+    MacAddr mac = dev->getMac();
+
+    proxy->uponSignal("PropertiesChanged")
+        .onInterface(PROPERTIES_IFACE)
+        .call([mac](const std::string& interface,
+                const std::map<std::string, sdbus::Variant>& changed,
+                const std::vector<std::string>& /*invalidated*/) {
+            if (interface != DEVICE_IFACE) return;
+            BusEvent ev;
+            ev.type = BusEventType::DeviceProperties;
+            ev.mac  = mac;
+            decode_device_properties(changed, ev);
+            if (ev.present || !ev.serviceData.empty()) enqueue_signal(std::move(ev));
+    });
+    proxy->finishRegistration();
+}
 
-    if (auto device = weakDev.lock()) { // ✅ safe
-        bool updated = false;
-        json j;
-        std::string address = device->getAddress();
-        j["origin"] = "ble_handler";
-        j["type"] = "device_update";
-        j["device_mac"] = address;
-
-        // Connected
-        auto it = changed.find("Connected");
-        if (it != changed.end()) {
-            bool connected = it->second.get<bool>();
-            device->setConnected(connected);
-            std::cout << "Device " << address
-                      << " updated Connected: " << connected << std::endl;
-            updated = true;
-            j["connected"] = connected;
-
-            if (connected) 
-                if(!device->getTrusted()) set_bool_property(device->getPath(), "Trusted", true);
-            //else 
-                //device->setCharacteristics({});
-        }
-
-        // ServicesResolved (if true get characteristics)
-        /*it = changed.find("ServicesResolved");
-        if (it != changed.end()) {
-            bool resolved = it->second.get<bool>();
-            if (resolved) {
-                if (auto connection = weakCon.lock()) { // ✅ safe
-                    auto slashProxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, "/");
-                    std::map<sdbus::ObjectPath, std::map<std::string,
-                        std::map<std::string, sdbus::Variant>>> managedObjects;
-
-                    try {
-                        slashProxy->callMethod("GetManagedObjects")
-                                .onInterface(DBUS_OM_IFACE)
-                                .storeResultsTo(managedObjects);
-                    }
-                    catch (const sdbus::Error& e) {
-                        std::cerr << "Failed to GetManagedObjects: "
-                                << e.getName() << " - " << e.getMessage() << "\n";
-                    }
-                    device->setCharacteristics(getCharacteristics(device->getPath(), managedObjects));
-                }
-            } else {
-                device->setCharacteristics({});
-            }
-        }*/
-
-        // Paired
-        it = changed.find("Paired");
-        if (it != changed.end()) {
-            bool paired = it->second.get<bool>();
-            device->setPaired(paired);
-            std::cout << "Device " << address
-                      << " updated Paired: " << paired << std::endl;
-            updated = true;
-            j["paired"] = paired;
-        }
-
-        // Trusted
-        it = changed.find("Trusted");
-        if (it != changed.end()) {
-            bool trusted = it->second.get<bool>();
-            device->setTrusted(trusted);
-            std::cout << "Device " << address
-                      << " updated Trusted: " << trusted << std::endl;
-            updated = true;
-            j["trusted"] = trusted;
-        }
-
-        it = changed.find("ServiceData");
-        if (it != changed.end()) {
-            try {
-                // Extract the dictionary {UUID -> Variant(ByteArray)}
-                const auto& serviceDataMap = it->second.get<std::map<std::string, sdbus::Variant>>();
+bool save_registry_snapshot()
+{
+    std::vector<std::shared_ptr<BLEDevice>> current;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        current.reserve(devices.size());
+        for (const auto& [mac, dev] : devices) current.push_back(dev);
+    }
+    registry_dirty = false;
+
+    std::vector<DeviceSnapshotEntry> entries;
+    entries.reserve(current.size());
+    for (const auto& dev : current) {
+        DeviceSnapshotEntry entry;
+        {
+            std::lock_guard<std::mutex> lock(dev->mtx);
+            entry.address    = macToString(dev->mac);
+            entry.path       = dev->path;
+            entry.name       = dev->name;
+            entry.paired     = dev->paired;
+            entry.trusted    = dev->trusted;
+            entry.lastRssi   = dev->rssi;
+            entry.lastSeenMs = dev->lastSeenMs;
+            entry.gattHash   = dev->gattHash;
+            entry.characteristics.reserve(dev->characteristics.size());
+            for (const auto& [uuid, path] : dev->characteristics)
+                entry.characteristics.emplace_back(uuidToString(uuid), dev->path + object_paths.str(path));
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    if (!saveDeviceSnapshot(SNAPSHOT_PATH, entries)) {
+        registry_dirty = true; // try again on the next cycle
+        return false;
+    }
+    return true;
+}
 
-                for (const auto& [uuid, variant] : serviceDataMap) {
-                    // Get the byte array
-                    const auto& data = variant.get<std::vector<uint8_t>>();
+/**********************************************************************
+|   device_query_snapshot() returns the registry as query_devices      |
+|   sees it. The registry lock is held only to copy the device         |
+|   pointers; each device is then copied under its own lock, once,     |
+|   instead of field by field. Rebuilt when a device was added or      |
+|   removed, or after QUERY_SNAPSHOT_MAX_AGE_MS, so a dashboard        |
+|   polling at 10k devices does not copy the registry per request.     |
+***********************************************************************/
+std::shared_ptr<const DeviceQuerySnapshot> device_query_snapshot()
+{
+    std::lock_guard<std::mutex> lock(query_snapshot_mutex);
+    uint64_t generation = registry_generation;
+    if (query_snapshot && query_snapshot_generation == generation &&
+        steady_ms() - query_snapshot_steady_ms < QUERY_SNAPSHOT_MAX_AGE_MS)
+        return query_snapshot;
 
-                    // Convert data to hex string
-                    std::ostringstream oss;
-                    oss << std::hex << std::setfill('0');
-                    for (uint8_t byte : data)
-                        oss << std::setw(2) << static_cast<int>(byte) << " ";
+    std::vector<std::shared_ptr<BLEDevice>> current;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        current.reserve(devices.size());
+        for (const auto& [mac, dev] : devices) current.push_back(dev);
+    }
 
-                    std::string dataStr = oss.str();
+    auto snapshot = std::make_shared<DeviceQuerySnapshot>();
+    snapshot->takenMs = now_ms();
+    snapshot->records.reserve(current.size());
+    for (const auto& dev : current) {
+        DeviceRecord r;
+        {
+            std::lock_guard<std::mutex> lock(dev->mtx);
+            r.mac        = dev->mac;
+            r.name       = dev->name;
+            r.path       = dev->path;
+            r.discovered = dev->discovered;
+            r.connected  = dev->connected;
+            r.paired     = dev->paired;
+            r.trusted    = dev->trusted;
+            r.rssi       = dev->rssi;
+            r.lastSeenMs = dev->lastSeenMs;
+            r.uuids.reserve(dev->characteristics.size());
+            for (const auto& [uuid, path] : dev->characteristics) r.uuids.push_back(uuid);
+        }
+        std::sort(r.uuids.begin(), r.uuids.end());
+        r.hasLink = link_quality.get(r.mac, r.link);
+        if (ownership) r.owner = ownership->owner(r.mac);
+        snapshot->records.push_back(std::move(r));
+    }
+    std::sort(snapshot->records.begin(), snapshot->records.end(),
+              [](const DeviceRecord& a, const DeviceRecord& b) { return a.mac < b.mac; });
+
+    query_snapshot = std::move(snapshot);
+    query_snapshot_generation = generation;
+    query_snapshot_steady_ms = steady_ms();
+    ++query_snapshots_built;
+    return query_snapshot;
+}
 
-                    // Trim trailing space (optional)
-                    if (!dataStr.empty() && dataStr.back() == ' ')
-                        dataStr.pop_back();
+/**********************************************************************
+|   warm_start_registry() loads the last registry snapshot and          |
+|   revalidates each device against BlueZ with a scoped GetAll on its   |
+|   own object path instead of a full GetManagedObjects. Cached         |
+|   characteristic paths are trusted until a read proves them stale.    |
+|   Returns the devices that are present in BlueZ right now.            |
+***********************************************************************/
+std::vector<std::shared_ptr<BLEDevice>> warm_start_registry()
+{
+    std::vector<std::shared_ptr<BLEDevice>> present;
+    std::vector<DeviceSnapshotEntry> entries;
+    if (!loadDeviceSnapshot(SNAPSHOT_PATH, entries)) return present;
 
-                    // Print broadcast bytes
-                    std::cout << "ServiceData from " << address 
-                              << ", UUID " << uuid 
-                              << ": " << dataStr << std::endl;
+    std::cout << "[Snapshot] Loaded " << entries.size() << " devices from " << SNAPSHOT_PATH << std::endl;
 
-                    j["type"] = "device_broadcast";
-                    j["service_data"]["uuid"] = uuid;
-                    j["service_data"]["data"] = dataStr;
+    for (auto& entry : entries)
+    {
+        MacAddr mac;
+        if (!parseMac(entry.address, mac)) continue;
+
+        auto dev = std::make_shared<BLEDevice>();
+        dev->mac        = mac;
+        dev->path       = entry.path;
+        dev->name       = entry.name;
+        dev->paired     = entry.paired;
+        dev->trusted    = entry.trusted;
+        dev->rssi       = entry.lastRssi;
+        dev->lastSeenMs = entry.lastSeenMs;
+        dev->gattHash   = entry.gattHash;
+        for (const auto& [uuidStr, charPath] : entry.characteristics) {
+            Uuid128 uuid;
+            if (parseUuid(uuidStr, uuid)) dev->characteristics.emplace(uuid, object_paths.intern(pathBelowDevice(charPath)));
+        }
 
-                    updated = true;
-                }
+        // Revalidate against the live object only
+        if (!entry.path.empty()) {
+            std::map<std::string, sdbus::Variant> props;
+            try {
+                auto proxy = bus_pool.proxy(BusLane::Control, mac, BLUEZ_SERVICE_NAME, entry.path);
+                AsyncReply<std::map<std::string, sdbus::Variant>> reply;
+                proxy->callMethodAsync("GetAll")
+                    .onInterface(PROPERTIES_IFACE)
+                    .withArguments(DEVICE_IFACE)
+                    .uponReplyInvoke(reply.handler());
+                std::tie(props) = reply.get(bus_pool.latency(BusLane::Control));
+            }
+            catch (const sdbus::Error& e) {
+                // Object is gone (e.g. BlueZ cache cleared). Discovery will find it again.
+                std::cout << "[Snapshot] " << entry.address << " not present in BlueZ: " << e.getName() << std::endl;
             }
-            catch (const std::exception& e) {
-                std::cerr << "Error decoding ServiceData: " << e.what() << std::endl;
+
+            MacAddr liveMac;
+            if (props.count("Address") && parseMac(props.at("Address").get<std::string>(), liveMac) && liveMac == mac) {
+                dev->discovered = true;
+                dev->connected  = props.count("Connected") ? props.at("Connected").get<bool>() : false;
+                dev->paired     = props.count("Paired") ? props.at("Paired").get<bool>() : dev->paired;
+                dev->trusted    = props.count("Trusted") ? props.at("Trusted").get<bool>() : dev->trusted;
+                if (props.count("Name")) dev->name = props.at("Name").get<std::string>();
+                if (props.count("RSSI")) dev->rssi = props.at("RSSI").get<int16_t>();
+            } else {
+                dev->path.clear();
+                dev->characteristics.clear();
+                dev->gattHash.clear();
             }
         }
 
-        if (updated) {
-            // Publish changes to MQTT or other system here
-            mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
-            mqtt_publish(pubmsg);
+        {
+            std::lock_guard<std::mutex> lock(devicesMutex);
+            if (!devices.emplace(mac, dev).second) continue;
+        }
+
+        if (dev->discovered) {
+            register_device_signals(dev);
+            present.push_back(dev);
         }
     }
+    return present;
 }
 
-std::unordered_map<std::string, std::string> getCharacteristics(
-    const sdbus::ObjectPath& devPath,
-    const std::map<sdbus::ObjectPath, std::map<std::string, std::map<std::string, sdbus::Variant>>>& managedObjects)
+// Copies the Device1 properties the handler uses out of a signal payload.
+// Runs on the sdbus loop thread, so it only copies; no locks, no D-Bus calls.
+void decode_device_properties(const std::map<std::string, sdbus::Variant>& props, BusEvent& ev)
 {
-    std::unordered_map<std::string, std::string> result;
-
-    for (const auto& [path, interfaces] : managedObjects)
-    {
-        auto it = interfaces.find(Characteristic_IFACE);
-        if (it != interfaces.end())
-        {
-            // Characteristic belongs to this device if path starts with the device path
-            if (path.find(devPath) == 0)
-            {
-                const auto& props = it->second;
-                if (props.count("UUID"))
-                {
-                    auto uuid = props.at("UUID").get<std::string>();
-                    result[uuid] = path;
-                }
+    try {
+        if (auto it = props.find("Connected"); it != props.end()) {
+            ev.connected = it->second.get<bool>();
+            ev.present |= EV_CONNECTED;
+        }
+        if (auto it = props.find("Paired"); it != props.end()) {
+            ev.paired = it->second.get<bool>();
+            ev.present |= EV_PAIRED;
+        }
+        if (auto it = props.find("Trusted"); it != props.end()) {
+            ev.trusted = it->second.get<bool>();
+            ev.present |= EV_TRUSTED;
+        }
+        if (auto it = props.find("RSSI"); it != props.end()) {
+            ev.rssi = it->second.get<int16_t>();
+            ev.present |= EV_RSSI;
+        }
+        if (auto it = props.find("Name"); it != props.end()) {
+            ev.name = it->second.get<std::string>();
+            ev.present |= EV_NAME;
+        }
+        if (auto it = props.find("TxPower"); it != props.end()) {
+            ev.txPower = it->second.get<int16_t>();
+            ev.present |= EV_TXPOWER;
+        }
+        if (auto it = props.find("ServicesResolved"); it != props.end()) {
+            ev.servicesResolved = it->second.get<bool>();
+            ev.present |= EV_SERVICES_RESOLVED;
+        }
+        if (auto it = props.find("UUIDs"); it != props.end()) {
+            for (const auto& text : it->second.get<std::vector<std::string>>()) {
+                Uuid128 uuid;
+                if (parseUuid(text, uuid)) ev.uuids.push_back(uuid);
             }
         }
+        if (auto it = props.find("ServiceData"); it != props.end()) {
+            // Dictionary {UUID -> Variant(ByteArray)}
+            const auto& serviceDataMap = it->second.get<std::map<std::string, sdbus::Variant>>();
+            for (const auto& [uuid, variant] : serviceDataMap)
+                ev.serviceData.emplace_back(uuid, variant.get<std::vector<uint8_t>>());
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error decoding device properties: " << e.what() << std::endl;
     }
-    return result;
 }
 
-ScanHandle scanDevices(std::shared_ptr<std::unordered_map<std::string, std::shared_ptr<BLEDevice>>>& discovered,
-                       std::mutex& discoveredMutex,
-                       int scanDurationMs)  // 0 = run until manually stopped
+// True if from sets Connected or ServicesResolved to the opposite of a
+// pending value: merged, a disconnect and reconnect would be lost
+bool flips_link_state(const BusEvent& pending, const BusEvent& from)
 {
-    ScanHandle handle;
-    handle.proxy   = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, "/");
+    uint8_t both = pending.present & from.present;
+    return ((both & EV_CONNECTED) && pending.connected != from.connected) ||
+           ((both & EV_SERVICES_RESOLVED) && pending.servicesResolved != from.servicesResolved);
+}
 
-    // 1. Populate with already-known devices
-    std::map<sdbus::ObjectPath, std::map<std::string, std::map<std::string, sdbus::Variant>>> managedObjects;
-    try {
-        handle.proxy->callMethod("GetManagedObjects")
-            .onInterface(DBUS_OM_IFACE)
-            .storeResultsTo(managedObjects);
-    } 
-    catch (const sdbus::Error& e) {
-        std::cerr << "Faild to GetManagedObjects: " << e.getName() << " - " << e.getMessage() << "\n";
+// Folds a later PropertiesChanged into a pending one; the newest value wins
+void merge_device_properties(BusEvent& into, BusEvent&& from)
+{
+    if (from.present & EV_CONNECTED) into.connected = from.connected;
+    if (from.present & EV_PAIRED)    into.paired    = from.paired;
+    if (from.present & EV_TRUSTED)   into.trusted   = from.trusted;
+    if (from.present & EV_RSSI)      into.rssi      = from.rssi;
+    if (from.present & EV_NAME)      into.name      = std::move(from.name);
+    if (from.present & EV_TXPOWER)   into.txPower   = from.txPower;
+    if (from.present & EV_SERVICES_RESOLVED) into.servicesResolved = from.servicesResolved;
+    into.present |= from.present;
+    if (!from.uuids.empty()) into.uuids = std::move(from.uuids);
+
+    for (auto& [uuid, data] : from.serviceData) {
+        auto it = std::find_if(into.serviceData.begin(), into.serviceData.end(),
+                               [&](const auto& entry) { return entry.first == uuid; });
+        if (it != into.serviceData.end()) it->second = std::move(data);
+        else into.serviceData.emplace_back(uuid, std::move(data));
     }
+}
 
-    for (const auto& [path, interfaces] : managedObjects) 
+// Only RSSI, TxPower and advertisement data may be dropped: the next
+// advertisement brings them again. Connection and pairing state, names
+// and added/removed objects would leave the registry out of sync.
+bool droppable_signal(const BusEvent& ev)
+{
+    return ev.type == BusEventType::DeviceProperties && (ev.present & ~(EV_RSSI | EV_TXPOWER)) == 0;
+}
+
+void enqueue_signal(BusEvent&& ev)
+{
+    // Never block the loop thread; the worker reports drops
+    ev.received = std::chrono::steady_clock::now();
+    if (tracer.on()) tracer.instant("signal", bus_event_name(ev.type));
+    if (!signal_overflowing && signal_queue.tryPush(std::move(ev))) return;
+
+    // Ring full, or older events still wait in the overflow: keep order
+    if (droppable_signal(ev)) {
+        ++signals_dropped;
+        return;
+    }
     {
-        if (auto it = interfaces.find(DEVICE_IFACE); it != interfaces.end()) 
-        {
-            const auto& props = it->second;
-            if (props.count("Address")) 
-            {
-                auto mac = props.at("Address").get<std::string>();
+        std::lock_guard<std::mutex> lock(signal_overflow_mutex);
+        signal_overflow.push_back(std::move(ev));
+        signal_overflowing = true;
+    }
+    ++signals_spilled;
+    signal_queue.wake();
+}
 
-                std::lock_guard<std::mutex> lock(discoveredMutex);
-                if (discovered->find(mac) == discovered->end()) 
-                {
-                    auto dev        = std::make_shared<BLEDevice>();
-                    dev->address    = mac;
-                    dev->path       = path;
-                    dev->name       = props.count("Name") ? props.at("Name").get<std::string>() : "";
-                    dev->discovered = true;
-                    dev->connected  = props.count("Connected") ? props.at("Connected").get<bool>() : false;
-                    dev->paired     = props.count("Paired") ? props.at("Paired").get<bool>() : false;
-                    dev->trusted    = props.count("Trusted") ? props.at("Trusted").get<bool>() : false;
-                    dev->characteristics = getCharacteristics(path, managedObjects);
+std::string bytes_to_hex(const std::vector<uint8_t>& data)
+{
+    std::ostringstream oss;
+    oss << std::hex << std::setfill('0');
+    for (uint8_t byte : data)
+        oss << std::setw(2) << static_cast<int>(byte) << " ";
 
-                    discovered->emplace(mac, dev);
-                    // publish "already known device found"
-                    std::cout << "publish already known device discovered: " << path << std::endl;
-                    json j;
-                    j["origin"] = "ble_handler";
-                    j["type"] = "scan_existing_devices";
-                    j["device_mac"] = dev->address;
-                    j["name"] = dev->name;
-                    j["discovered"] = dev->discovered;
-                    j["connected"] = dev->connected;
-                    j["paired"] = dev->paired;
-                    j["trusted"] = dev->trusted;
+    std::string dataStr = oss.str();
 
-                    mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
-                    mqtt_publish(pubmsg);
-                }
+    // Trim trailing space (optional)
+    if (!dataStr.empty() && dataStr.back() == ' ')
+        dataStr.pop_back();
+    return dataStr;
+}
+
+void apply_device_properties(const std::shared_ptr<BLEDevice>& device, const BusEvent& ev)
+{
+    bool owned = owns_device(ev.mac);
+    bool updated = false;
+    json j;
+    std::string address = macToString(ev.mac);
+    j["origin"] = "ble_handler";
+    j["type"] = "device_update";
+    j["device_mac"] = address;
+
+    // Connected
+    if (ev.present & EV_CONNECTED) {
+        device->setConnected(ev.connected);
+        std::cout << "Device " << address
+                  << " updated Connected: " << ev.connected << std::endl;
+        updated = true;
+        j["connected"] = ev.connected;
+
+        if (ev.connected)
+            if(!device->getTrusted())
+                run_blocking("trust", [path = device->getPath()]() { set_bool_property(path, "Trusted", true); });
+
+        // Unexpected drops are healed by the reconnect supervisor
+        int64_t downtimeMs = 0;
+        if (ev.connected) {
+            publish_reconnect_change(ev.mac, reconnect_supervisor.connected(ev.mac, steady_ms(), downtimeMs), downtimeMs);
+        } else {
+            if (owned) {   // another instance's device is its to heal
+                reconnect_supervisor.disconnected(ev.mac, steady_ms());
+                kick_reconnect_worker();
             }
+            release_att_channels(ev.mac);
         }
+        //else
+            //device->setCharacteristics({});
     }
 
-    // 2. Register signal handlers for ongoing discovery
-    handle.proxy->uponSignal("InterfacesAdded")
-    .onInterface(DBUS_OM_IFACE)
-    .call([discovered, &discoveredMutex](const sdbus::ObjectPath& path,
-              const std::map<std::string, std::map<std::string, sdbus::Variant>>& ifaces) {
-        if (auto it = ifaces.find(DEVICE_IFACE); it != ifaces.end())
-        {
-            // Device discovered
-            const auto& props = it->second;
-            if (props.count("Address"))
-            {
-                auto mac = props.at("Address").get<std::string>();
-                std::lock_guard<std::mutex> lock(discoveredMutex);
-                if (discovered->find(mac) == discovered->end())
-                {
-                    auto dev        = std::make_shared<BLEDevice>();
-                    dev->address    = mac;
-                    dev->path       = path;
-                    dev->name       = props.count("Name") ? props.at("Name").get<std::string>() : "";
+    // Paired
+    if (ev.present & EV_PAIRED) {
+        device->setPaired(ev.paired);
+        std::cout << "Device " << address
+                  << " updated Paired: " << ev.paired << std::endl;
+        updated = true;
+        registry_dirty = true;
+        j["paired"] = ev.paired;
+    }
+
+    // Connect/pair workflows waiting on this device re-check their condition
+    if (ev.present & (EV_CONNECTED | EV_PAIRED)) coro_executor.wake(ev.mac);
+
+    // Trusted
+    if (ev.present & EV_TRUSTED) {
+        device->setTrusted(ev.trusted);
+        std::cout << "Device " << address
+                  << " updated Trusted: " << ev.trusted << std::endl;
+        updated = true;
+        registry_dirty = true;
+        j["trusted"] = ev.trusted;
+    }
+
+    // ServicesResolved
+    if (ev.present & EV_SERVICES_RESOLVED) {
+        std::cout << "Device " << address
+                  << " updated ServicesResolved: " << ev.servicesResolved << std::endl;
+        updated = true;
+        j["services_resolved"] = ev.servicesResolved;
+
+        // Learn the GATT layout; a reconnect with unchanged firmware costs one read
+        if (ev.servicesResolved) schedule_gatt_refresh(device);
+    }
+
+    // RSSI, TxPower and Name are kept for the registry; RSSI and sightings
+    // feed the link-quality estimate, which publishes on its own when it moves
+    int64_t now = now_ms();
+    LinkQuality q;
+    if (ev.present & EV_TXPOWER) link_quality.observeTxPower(ev.mac, ev.txPower);
+    if (ev.present & EV_RSSI) {
+        device->setRssi(ev.rssi);
+        device->setLastSeen(now);
+        if (link_quality.observeRssi(ev.mac, ev.rssi, now, q)) publish_link_quality(q);
+    }
+    else if (!ev.serviceData.empty()) {
+        device->setLastSeen(now);
+        if (link_quality.observeSeen(ev.mac, now, q)) publish_link_quality(q);
+    }
+    if (ev.present & EV_NAME) device->setName(ev.name);
+
+    // Readings and updates reach the hub once, from the instance holding the device
+    for (const auto& [uuid, data] : ev.serviceData) {
+        if (!owned) break;
+        std::string dataStr = bytes_to_hex(data);
+
+        Uuid128 serviceUuid;
+        if (parseUuid(uuid, serviceUuid)) ingest_reading(ev.mac, serviceUuid, data, now, ev.received);
+
+        // Print broadcast bytes
+        std::cout << "ServiceData from " << address
+                  << ", UUID " << uuid
+                  << ": " << dataStr << std::endl;
+
+        j["type"] = "device_broadcast";
+        j["service_data"][uuid] = dataStr;
+
+        updated = true;
+    }
+
+    if (updated && owned) {
+        std::string type = j["type"];
+        for (const char* key : {"origin", "type", "device_mac"}) j.erase(key);
+        publish_device_event(ev.mac, type, j);
+    }
+}
+
+void publish_device_state(const std::shared_ptr<BLEDevice>& dev, const std::string& type)
+{
+    json j;
+    MacAddr mac;
+    {
+        std::lock_guard<std::mutex> lock(dev->mtx);
+        mac = dev->mac;
+        j["name"] = dev->name;
+        j["discovered"] = dev->discovered;
+        j["connected"] = dev->connected;
+        j["paired"] = dev->paired;
+        j["trusted"] = dev->trusted;
+    }
+    publish_device_event(mac, type, j);
+}
+
+void publish_link_quality(const LinkQuality& q)
+{
+    json j;
+    j["present"] = q.present;
+    j["last_seen"] = q.lastSeenMs;
+    if (q.rssiSamples > 0) {
+        j["rssi"] = std::lround(q.rssiDbm);
+        j["rssi_spread"] = std::lround(q.rssiSpreadDb);
+        if (q.txPower != LQ_TXPOWER_UNKNOWN) j["path_loss"] = std::lround(q.txPower - q.rssiDbm);
+    }
+    if (q.advIntervalMs > 0) j["adv_interval_ms"] = std::lround(q.advIntervalMs);
+    if (q.connectAttempts > 0) j["connect_success"] = std::round(q.connectSuccess * 100) / 100;
+    publish_device_event(q.mac, "link_quality", json{{"link", j}});
+}
+
+// Offers a device sighting to the running discovery sessions
+void offer_sighting(const BusEvent& ev, const std::string& name)
+{
+    if (!discovery_sessions.active()) return;
+
+    Sighting sighting;
+    sighting.mac = ev.mac;
+    sighting.hasRssi = ev.present & EV_RSSI;
+    sighting.rssi = ev.rssi;
+    sighting.name = name;
+    sighting.uuids = ev.uuids;
+
+    std::vector<DiscoveryResult> results;
+    discovery_sessions.offer(sighting, now_ms(), results);
+    publish_discovery(results, {});
+}
+
+void publish_discovery(const std::vector<DiscoveryResult>& results, const std::vector<DiscoverySummary>& ended)
+{
+    for (const auto& r : results) {
+        json j;
+        j["origin"] = "ble_handler";
+        j["type"] = "scan_result";
+        j["session"] = r.session;
+        j["device_mac"] = macToString(r.sighting.mac);
+        j["name"] = r.sighting.name;
+        if (r.sighting.hasRssi) j["rssi"] = r.sighting.rssi;
+        j["uuids"] = json::array();
+        for (const auto& uuid : r.sighting.uuids) j["uuids"].push_back(uuidToString(uuid));
+        mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j.dump()));
+    }
+
+    for (const auto& e : ended) {
+        std::cout << "[Scan] Session " << e.session << " " << e.reason << " after " << e.elapsedMs << " ms, "
+                  << e.results << " results, " << e.duplicates << " duplicates, " << e.dropped << " dropped" << std::endl;
+        json j;
+        j["origin"] = "ble_handler";
+        j["type"] = "scan_session";
+        j["session"] = e.session;
+        j["state"] = "ended";
+        j["reason"] = e.reason;
+        j["elapsed_ms"] = e.elapsedMs;
+        j["results"] = e.results;
+        j["duplicates"] = e.duplicates;
+        j["dropped"] = e.dropped;
+        mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j.dump()));
+    }
+}
+
+void apply_bus_event(BusEvent& ev)
+{
+    if (tracer.on()) tracer.async("signal_queue", ev.received, std::chrono::steady_clock::now(), bus_event_name(ev.type));
+    TraceSpan span("apply_signal", bus_event_name(ev.type));
+    switch (ev.type) {
+    case BusEventType::DeviceAdded: {
+        offer_sighting(ev, ev.name);
+        std::shared_ptr<BLEDevice> dev = get_device(ev.mac);
+        if (!dev) return;
+
+        dev->setPath        (ev.path);
+        dev->setName        (ev.name);
+        dev->setDiscovered  (true);
+        dev->setConnected   (ev.connected);
+        dev->setPaired      (ev.paired);
+        dev->setTrusted     (ev.trusted);
+        if (ev.present & EV_RSSI) dev->setRssi(ev.rssi);
+        dev->setLastSeen    (now_ms());
+        registry_dirty = true;
+        coro_executor.wake(ev.mac);
+
+        LinkQuality q;
+        if (ev.present & EV_TXPOWER) link_quality.observeTxPower(ev.mac, ev.txPower);
+        bool moved = (ev.present & EV_RSSI) ? link_quality.observeRssi(ev.mac, ev.rssi, now_ms(), q)
+                                            : link_quality.observeSeen(ev.mac, now_ms(), q);
+        if (moved) publish_link_quality(q);
+
+        //---create signal handler---
+        register_device_signals(dev);
+
+        // publish "device added"
+        std::cout << "device discovered: " << ev.path << std::endl;
+        publish_device_state(dev, "device_update");
+        break;
+    }
+    case BusEventType::DeviceRemoved: {
+        std::shared_ptr<BLEDevice> dev = get_device(ev.mac);
+        if (!dev) return;
+        dev->setConnected(false);
+        dev->setPaired(false);
+        dev->setDiscovered(false);
+        dev->getProxy().reset();
+
+        std::cout << "device undiscovered: " << ev.path << std::endl;
+        publish_device_state(dev, "device_update");
+        break;
+    }
+    case BusEventType::DeviceProperties: {
+        if (auto dev = get_device(ev.mac)) {
+            if (ev.present & EV_RSSI) offer_sighting(ev, (ev.present & EV_NAME) ? ev.name : dev->getName());
+            apply_device_properties(dev, ev);
+        }
+        break;
+    }
+    case BusEventType::CharacteristicAdded: {
+        std::shared_ptr<BLEDevice> dev = get_device(ev.mac);
+        if (!dev) return;
+        dev->addCharacteristics(ev.uuid, object_paths.intern(pathBelowDevice(ev.path)));
+        registry_dirty = true;
+        break;
+    }
+    case BusEventType::CharacteristicRemoved: {
+        std::shared_ptr<BLEDevice> dev = get_device(ev.mac);
+        if (!dev) return;
+
+        PathId pathId = object_paths.find(pathBelowDevice(ev.path));
+        if (pathId != INVALID_PATH) dev->removeCharacteristicPath(pathId);
+        registry_dirty = true;
+        break;
+    }
+    case BusEventType::ScanDeviceAdded: {
+        // publish "device added"
+        std::cout << "device discovered: " << ev.path << std::endl;
+        json j;
+        j["origin"] = "ble_handler";
+        j["type"] = "scan_added_device";
+        j["device_mac"] = macToString(ev.mac);
+        j["name"] = ev.name;
+        j["discovered"] = true;
+        j["connected"] = ev.connected;
+        j["paired"] = ev.paired;
+        j["trusted"] = ev.trusted;
+
+        mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
+        mqtt_publish(pubmsg);
+        break;
+    }
+    case BusEventType::ScanDeviceRemoved: {
+        // publish "device removed"
+        std::cout << "device removed from discovered: " << ev.path << std::endl;
+        json j;
+        j["origin"] = "ble_handler";
+        j["type"] = "scan_removed_device";
+        j["device_mac"] = macToString(ev.mac);
+
+        mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
+        mqtt_publish(pubmsg);
+        break;
+    }
+    case BusEventType::MonitorDeviceFound:
+    case BusEventType::MonitorDeviceLost: {
+        bool found = ev.type == BusEventType::MonitorDeviceFound;
+        std::shared_ptr<BLEDevice> dev = get_device(ev.mac);
+        if (found) monitor_stats.found(dev != nullptr);
+        if (!dev) return;   // matched a name or BTHome pattern, but not one of ours
+        if (!found) monitor_stats.lost();
+
+        if (found) {
+            dev->setDiscovered(true);
+            dev->setLastSeen(now_ms());
+            coro_executor.wake(ev.mac);
+            LinkQuality q;
+            if (link_quality.observeSeen(ev.mac, now_ms(), q)) publish_link_quality(q);
+        }
+        std::cout << "[Monitor] " << macToString(ev.mac) << (found ? " in range" : " out of range") << std::endl;
+        publish_device_event(ev.mac, found ? "monitor_device_found" : "monitor_device_lost",
+                             json{{"in_range", found}});
+        break;
+    }
+    case BusEventType::None:
+        break;
+    }
+}
+
+/**********************************************************************
+|   drain_signal_batch() takes up to SIGNAL_BATCH_MAX events off the    |
+|   signal queue. Repeated PropertiesChanged for one device inside a    |
+|   batch are merged into a single update (and a single MQTT message),  |
+|   except a Connected or ServicesResolved change that reverses the     |
+|   pending one: that update is applied first, so the supervisor and    |
+|   the GATT refresh see every disconnect and reconnect.                |
+|   Any other event for that device first flushes its pending update    |
+|   so ordering is kept. Events that spilled over while the ring was    |
+|   full follow once it is empty. Returns the number of events taken.   |
+***********************************************************************/
+size_t drain_signal_batch(FlatMap<MacAddr, BusEvent>& pending, uint64_t& reportedDrops)
+{
+    BusEvent ev;
+    size_t count = 0;
+    std::deque<BusEvent> spilled;
+    auto next = [&]() {
+        if (signal_queue.tryPop(ev)) return true;
+        // The ring is empty: what spilled over is next, all of it at once
+        if (spilled.empty() && signal_overflowing) {
+            std::lock_guard<std::mutex> lock(signal_overflow_mutex);
+            spilled.swap(signal_overflow);
+            signal_overflowing = false;
+        }
+        if (spilled.empty()) return false;
+        ev = std::move(spilled.front());
+        spilled.pop_front();
+        return true;
+    };
+    while ((count < SIGNAL_BATCH_MAX || !spilled.empty()) && next()) {
+        ++count;
+        if (ev.type == BusEventType::DeviceProperties) {
+            auto [slot, inserted] = pending.emplace(ev.mac);
+            if (inserted) *slot = std::move(ev);
+            else if (flips_link_state(*slot, ev)) {
+                apply_bus_event(*slot);
+                *slot = std::move(ev);
+            } else {
+                merge_device_properties(*slot, std::move(ev));
+                ++signals_coalesced;
+            }
+            continue;
+        }
+
+        if (BusEvent* earlier = pending.find(ev.mac)) {
+            apply_bus_event(*earlier);
+            pending.erase(ev.mac);
+        }
+        apply_bus_event(ev);
+    }
+
+    for (const auto& [mac, update] : pending) apply_bus_event(update);
+    pending.clear();
+
+    signals_applied += count;
+    if (count > signals_max_batch) signals_max_batch = count;
+
+    uint64_t drops = signals_dropped;
+    if (drops != reportedDrops) {
+        std::cerr << "[Signals] Queue full, dropped " << drops - reportedDrops << " RSSI/advertisement updates"
+                  << std::endl;
+        reportedDrops = drops;
+    }
+    return count;
+}
+
+// Discovery sessions: release rate limited results, end expired sessions
+void tick_discovery_sessions()
+{
+    if (!discovery_sessions.active()) return;
+    std::vector<DiscoveryResult> results;
+    std::vector<DiscoverySummary> ended;
+    discovery_sessions.tick(now_ms(), results, ended);
+    publish_discovery(results, ended);
+}
+
+void signal_worker()
+{
+    FlatMap<MacAddr, BusEvent> pending;
+    pending.reserve(SIGNAL_BATCH_MAX);
+    uint64_t reportedDrops = 0;
+
+    while (!signal_worker_stop) {
+        size_t count = drain_signal_batch(pending, reportedDrops);
+        tick_discovery_sessions();
+        if (count == 0) signal_queue.wait(discovery_sessions.active() ? DISCOVERY_TICK_MS : 1000);
+    }
+}
+
+CharacteristicMap getCharacteristics(
+    const sdbus::ObjectPath& devPath,
+    const std::map<sdbus::ObjectPath, std::map<std::string, std::map<std::string, sdbus::Variant>>>& managedObjects)
+{
+    CharacteristicMap result;
+
+    for (const auto& [path, interfaces] : managedObjects)
+    {
+        auto it = interfaces.find(Characteristic_IFACE);
+        if (it != interfaces.end())
+        {
+            // Characteristic belongs to this device if path starts with the device path
+            if (path.find(devPath) == 0)
+            {
+                const auto& props = it->second;
+                Uuid128 uuid;
+                if (props.count("UUID") && parseUuid(props.at("UUID").get<std::string>(), uuid))
+                {
+                    result[uuid] = object_paths.intern(pathBelowDevice(path));
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// Seeds discovered with the devices BlueZ already knows, then adds every
+// device InterfacesAdded reports and restarts discovery. Waiters on
+// LINK_SCAN_KEY are woken on each change. The returned proxy carries the
+// signal handlers: the scan lasts until the caller drops it.
+Task<std::shared_ptr<sdbus::IProxy>> scanDevices(std::shared_ptr<DeviceMap> discovered,
+                                                 std::shared_ptr<std::mutex> discoveredMutex)
+{
+    auto proxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, "/");
+
+    // 1. Populate with already-known devices
+    ManagedObjects managedObjects;
+    if (auto objects = co_await get_managed_objects_async()) managedObjects = std::move(*objects);
+
+    for (const auto& [path, interfaces] : managedObjects) 
+    {
+        if (auto it = interfaces.find(DEVICE_IFACE); it != interfaces.end()) 
+        {
+            const auto& props = it->second;
+            MacAddr mac;
+            if (macFromPath(path, mac)) 
+            {
+                std::lock_guard<std::mutex> lock(*discoveredMutex);
+                if (!discovered->contains(mac)) 
+                {
+                    auto dev        = std::make_shared<BLEDevice>();
+                    dev->mac        = mac;
+                    dev->path       = path;
+                    dev->name       = props.count("Name") ? props.at("Name").get<std::string>() : "";
                     dev->discovered = true;
                     dev->connected  = props.count("Connected") ? props.at("Connected").get<bool>() : false;
                     dev->paired     = props.count("Paired") ? props.at("Paired").get<bool>() : false;
                     dev->trusted    = props.count("Trusted") ? props.at("Trusted").get<bool>() : false;
+                    dev->characteristics = getCharacteristics(path, managedObjects);
 
                     discovered->emplace(mac, dev);
-                    // publish "device added"
-                    std::cout << "device discovered: " << path << std::endl;
+                    // publish "already known device found"
+                    std::cout << "publish already known device discovered: " << path << std::endl;
                     json j;
                     j["origin"] = "ble_handler";
-                    j["type"] = "scan_added_device";
-                    j["device_mac"] = dev->address;
+                    j["type"] = "scan_existing_devices";
+                    j["device_mac"] = macToString(dev->mac);
                     j["name"] = dev->name;
                     j["discovered"] = dev->discovered;
                     j["connected"] = dev->connected;
@@ -626,45 +1575,72 @@ ScanHandle scanDevices(std::shared_ptr<std::unordered_map<std::string, std::shar
                 }
             }
         }
+    }
+    coro_executor.wake(LINK_SCAN_KEY);
+
+    // 2. Register signal handlers for ongoing discovery
+    //    (bookkeeping inline so Link_Devices sees it, publishing on the signal worker)
+    proxy->uponSignal("InterfacesAdded")
+    .onInterface(DBUS_OM_IFACE)
+    .call([discovered, discoveredMutex](const sdbus::ObjectPath& path,
+              const std::map<std::string, std::map<std::string, sdbus::Variant>>& ifaces) {
+        if (auto it = ifaces.find(DEVICE_IFACE); it != ifaces.end())
+        {
+            // Device discovered
+            BusEvent ev;
+            if (!macFromPath(path, ev.mac))
+                return;
+            ev.type = BusEventType::ScanDeviceAdded;
+            ev.path = path;
+            decode_device_properties(it->second, ev);
+
+            {
+                std::lock_guard<std::mutex> lock(*discoveredMutex);
+                if (discovered->contains(ev.mac))
+                    return;
+
+                auto dev        = std::make_shared<BLEDevice>();
+                dev->mac        = ev.mac;
+                dev->path       = path;
+                dev->name       = ev.name;
+                dev->discovered = true;
+                dev->connected  = ev.connected;
+                dev->paired     = ev.paired;
+                dev->trusted    = ev.trusted;
+                discovered->emplace(ev.mac, dev);
+            }
+            coro_executor.wake(LINK_SCAN_KEY);   // outside the lock, the waiter's check takes it
+            enqueue_signal(std::move(ev));
+        }
     });
-    handle.proxy->uponSignal("InterfacesRemoved")
+    proxy->uponSignal("InterfacesRemoved")
         .onInterface(DBUS_OM_IFACE)
-        .call([discovered, &discoveredMutex](const sdbus::ObjectPath& path,
-                  const std::map<std::string, std::map<std::string, sdbus::Variant>>& ifaces) {
-            auto it = ifaces.find(DEVICE_IFACE);
-            if (it != ifaces.end()) 
+        .call([discovered, discoveredMutex](const sdbus::ObjectPath& path,
+                  const std::vector<std::string>& interfaces) {
+            MacAddr mac;
+            bool isDevice = std::find(interfaces.begin(), interfaces.end(), DEVICE_IFACE) != interfaces.end();
+            if (isDevice && macFromPath(path, mac)) 
             {
-                std::lock_guard<std::mutex> lock(discoveredMutex);
-                for (auto it2 = discovered->begin(); it2 != discovered->end();) 
                 {
-                    if (it2->second->path == path) 
-                    {
-                        // publish "device removed"
-                        std::cout << "device removed from discovered: " << path << std::endl;
-                        json j;
-                        j["origin"] = "ble_handler";
-                        j["type"] = "scan_removed_device";
-                        j["device_mac"] = it2->second->address;
-
-                        mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
-                        mqtt_publish(pubmsg);
-                        it2 = discovered->erase(it2);
-                    } else {
-                        ++it2;
-                    }
+                    std::lock_guard<std::mutex> lock(*discoveredMutex);
+                    if (!discovered->erase(mac))
+                        return;
                 }
+                BusEvent ev;
+                ev.type = BusEventType::ScanDeviceRemoved;
+                ev.mac  = mac;
+                ev.path = path;
+                enqueue_signal(std::move(ev));
             }
     });
-    handle.proxy->finishRegistration();
+    proxy->finishRegistration();
 
     std::cout << "Scanning started..." << std::endl;
     try {
-        auto adapter = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, "/org/bluez/hci0");
+        co_await adapter_call_async("StopDiscovery");
+        co_await coro_executor.sleep(2000); // let BlueZ reset
 
-        adapter->callMethod("StopDiscovery").onInterface(ADAPTER_IFACE);
-        std::this_thread::sleep_for(std::chrono::seconds(2)); // let BlueZ reset
-
-        adapter->callMethod("StartDiscovery").onInterface(ADAPTER_IFACE);
+        co_await adapter_call_async("StartDiscovery");
         std::cout << "Discovery restarted to refresh visible devices." << std::endl;
     } 
     catch (const sdbus::Error& e) {
@@ -672,78 +1648,79 @@ ScanHandle scanDevices(std::shared_ptr<std::unordered_map<std::string, std::shar
                   << e.getName() << " - " << e.getMessage() << std::endl;
     }
 
-    // (4) Launch worker thread
-    handle.worker = std::thread([scanDurationMs, 
-                             stop = handle.stopRequested]() mutable {
-        auto start = std::chrono::steady_clock::now();
-
-        while (!stop->load()) {
-            if (scanDurationMs > 0) {
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                std::chrono::steady_clock::now() - start);
-                if (elapsed.count() >= scanDurationMs)
-                    break;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-        stop->store(true);  // tell the outside world we’re done
-    });
+    co_return proxy;
+}
 
-    return handle;
+// Connects, then pairs, one device found by Link_Devices. Background
+// class, so a reconnect storm cannot hold up interactive commands.
+Task<void> link_device(std::shared_ptr<BLEDevice> device)
+{
+    if (!owns_device(device->mac)) co_return;   // held by another instance
+    if (!device->getConnected()) {
+        RadioSlot slot = co_await admit_radio("link_connect", OpPriority::Background);
+        if (slot) co_await connect_device_async(device);
+    }
+    if (!device->getPaired()) {
+        RadioSlot slot = co_await admit_radio("link_pair", OpPriority::Background);
+        if (slot) co_await pair_device_async(device);
+    }
 }
 
 /**********************************************************************
-|   Link_Devices() function scans for all saved devices and            |
-|   connects/pairs to the saved devices it found then updates the      |
-|   status                                                             |
-|                    MAY BE OUTDATED                                   |
+|   Link_Devices() scans for all saved devices and connects/pairs to   |
+|   the saved devices it found then updates the status. The scan ends  |
+|   once every saved device was seen (plus a short grace period for    |
+|   signals in flight) or after scanTimeMs; each device then gets its  |
+|   own link_device() workflow, so one slow device holds up no other.  |
 ***********************************************************************/
-void Link_Devices(int scanTimeMs)
+Task<void> Link_Devices(int scanTimeMs)
 {
-    auto discovered = std::make_shared<
-        std::unordered_map<std::string, std::shared_ptr<BLEDevice>>>();
-    std::mutex discoveredMutex;
+    auto discovered = std::make_shared<DeviceMap>();
+    auto discoveredMutex = std::make_shared<std::mutex>();
 
     // Build device_list with expected MACs from devices
-    std::vector<std::string> Devices_list;
+    std::vector<MacAddr> Devices_list;
     {
         std::lock_guard<std::mutex> lock(devicesMutex);
         for(const auto& [mac, device]: devices) Devices_list.push_back(mac);
     }
 
-    auto handle = scanDevices(discovered, discoveredMutex, scanTimeMs);
+    auto scan = co_await scanDevices(discovered, discoveredMutex);
 
-    while (!handle.stopRequested->load()) 
-    {
-        bool foundAll = true;
-        {
-            std::lock_guard<std::mutex> lock(discoveredMutex);
-            for(const auto& mac : Devices_list) {
-                if(discovered->find(mac) == discovered->end()) {
-                    foundAll = false;
-                    break;
-                }
-            }
+    bool foundAll = co_await coro_executor.waitFor(LINK_SCAN_KEY, [discovered, discoveredMutex, Devices_list] {
+        std::lock_guard<std::mutex> lock(*discoveredMutex);
+        for(const auto& mac : Devices_list) {
+            if(!discovered->contains(mac)) return false;
         }
+        return true;
+    }, scanTimeMs);
 
-        if (foundAll) {
-            // Grace period to catch in-flight signals
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // Grace period to catch in-flight signals
+    if (foundAll) co_await coro_executor.sleep(500);
+    scan.reset(); // stop listening
 
-            handle.stop(); // join worker + stop discovery
-            break;
+    // Strongest links first, so a device at the edge of range retrying
+    // its connects does not hold up the rest
+    std::vector<std::pair<float, MacAddr>> order;
+    {
+        std::lock_guard<std::mutex> lock(*discoveredMutex);
+        for(const auto& [mac, dev] : *discovered)
+        {
+            LinkQuality q;
+            order.emplace_back(link_quality.get(mac, q) && q.rssiSamples > 0 ? q.rssiDbm : -127.0f, mac);
         }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
     }
+    std::sort(order.begin(), order.end(), std::greater<>());
 
-    for(const auto& [mac, dev] : *discovered)
+    for(const auto& [rssi, mac] : order)
     {
+        std::shared_ptr<BLEDevice> dev = *discovered->find(mac);
         std::shared_ptr<BLEDevice> original;
         {
             std::lock_guard<std::mutex> lock(devicesMutex);
-            if (devices.find(mac) == devices.end()) continue;
-            original = devices[mac];
+            auto it = devices.find(mac);
+            if (!it) continue;
+            original = *it;
         }
 
         // Copy over fields from the newly discovered BLEDevice
@@ -757,40 +1734,68 @@ void Link_Devices(int scanTimeMs)
         auto path = original->getPath();
 
         //---create signal handler---
-        std::shared_ptr<sdbus::IProxy> proxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, path);
-        original->setProxy(proxy);
+        register_device_signals(original);
 
-        // Capture weak_ptr to device so handler won’t access dangling memory
-        std::weak_ptr<BLEDevice> weakDev = original;
-        std::weak_ptr<sdbus::IConnection> weakCon = connection;
-
-        original->proxy->uponSignal("PropertiesChanged")
-            .onInterface(PROPERTIES_IFACE)
-            .call([weakDev, weakCon](const std::string& interface,
-                    const std::map<std::string, sdbus::Variant>& changed,
-                    const std::vector<std::string>& invalidated) {
-                handleDevicePropertiesChanged(weakDev, weakCon, interface, changed, invalidated);
-        });
-        original->proxy->finishRegistration();
+        std::cout << "Added BLE device path: " << path << " to " << macToString(mac) << std::endl;
 
-        std::cout << "Added BLE device path: " << path << " to " << mac << std::endl;
+        coro_executor.spawn(link_device(original));
+    }
+}
 
-        if (!original->getConnected()) connectDevice(original);
-        if (!original->getPaired()) pairDevice(original);
+Task<std::optional<ManagedObjects>> get_managed_objects_async()
+{
+    try {
+        auto proxy = bus_pool.proxy(BusLane::Control, 0, BLUEZ_SERVICE_NAME, "/");
+        AwaitableReply<ManagedObjects> reply(coro_executor);
+        proxy->callMethodAsync("GetManagedObjects")
+            .onInterface(DBUS_OM_IFACE)
+            .uponReplyInvoke(reply.handler());
+        auto [managedObjects] = co_await reply.result(bus_pool.latency(BusLane::Control));
+        co_return std::move(managedObjects);
+    }
+    catch (const sdbus::Error& e) {
+        std::cerr << "Faild to GetManagedObjects: " << e.getName() << " - " << e.getMessage() << "\n";
     }
+    co_return std::nullopt;
+}
+
+bool get_managed_objects(ManagedObjects& managedObjects)
+{
+    auto objects = coro_executor.runSync(get_managed_objects_async());
+    if (!objects) return false;
+    managedObjects = std::move(*objects);
+    return true;
+}
+
+// StartDiscovery/StopDiscovery on the adapter, throws sdbus::Error
+Task<void> adapter_call_async(std::string method)
+{
+    auto adapter = bus_pool.proxy(BusLane::Control, 0, BLUEZ_SERVICE_NAME, ADAPTER_PATH);
+    AwaitableReply<> reply(coro_executor);
+    adapter->callMethodAsync(method)
+        .onInterface(ADAPTER_IFACE)
+        .uponReplyInvoke(reply.handler());
+    co_await reply.result(bus_pool.latency(BusLane::Control));
+}
+
+void adapter_call(const std::string& method)
+{
+    coro_executor.runSync(adapter_call_async(method));
 }
 
 bool get_bool_property(const std::string& devicePath, std::string propertyName)
 {
     bool value;
-    auto deviceProxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, devicePath);
+    auto deviceProxy = bus_pool.proxy(BusLane::Control, 0, BLUEZ_SERVICE_NAME, devicePath);
 
     try {
         sdbus::Variant var;
-        deviceProxy->callMethod("Get")
+        AsyncReply<sdbus::Variant> reply;
+        deviceProxy->callMethodAsync("Get")
             .onInterface(PROPERTIES_IFACE)
             .withArguments(DEVICE_IFACE, propertyName)
-            .storeResultsTo(var);
+            .uponReplyInvoke(reply.handler());
+        std::tie(var) = reply.get(bus_pool.latency(BusLane::Control));
 
         value = var.get<bool>();
         return value;
@@ -803,14 +1808,17 @@ bool get_bool_property(const std::string& devicePath, std::string propertyName)
 bool set_bool_property(const std::string& devicePath, const std::string& propertyName, bool value)
 {
     try {
-        auto deviceProxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, devicePath);
+        auto deviceProxy = bus_pool.proxy(BusLane::Control, 0, BLUEZ_SERVICE_NAME, devicePath);
 
         // BlueZ expects Variant for Set method
         sdbus::Variant variantValue = value;
 
-        deviceProxy->callMethod("Set")
+        AsyncReply<> reply;
+        deviceProxy->callMethodAsync("Set")
             .onInterface("org.freedesktop.DBus.Properties")
-            .withArguments("org.bluez.Device1", propertyName, variantValue);
+            .withArguments("org.bluez.Device1", propertyName, variantValue)
+            .uponReplyInvoke(reply.handler());
+        reply.wait(bus_pool.latency(BusLane::Control));
 
         std::cout << "Set " << propertyName << " = "
                   << (value ? "true" : "false")
@@ -830,14 +1838,16 @@ bool set_bool_property(const std::string& devicePath, const std::string& propert
 std::string get_string_property(const std::string& devicePath, std::string propertyName)
 {
     std::string value;
-    auto deviceProxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, devicePath);
+    auto deviceProxy = bus_pool.proxy(BusLane::Control, 0, BLUEZ_SERVICE_NAME, devicePath);
 
     try {
         sdbus::Variant var;
-        deviceProxy->callMethod("Get")
+        AsyncReply<sdbus::Variant> reply;
+        deviceProxy->callMethodAsync("Get")
             .onInterface(PROPERTIES_IFACE)
             .withArguments(DEVICE_IFACE, propertyName)
-            .storeResultsTo(var);
+            .uponReplyInvoke(reply.handler());
+        std::tie(var) = reply.get(bus_pool.latency(BusLane::Control));
 
         value = var.get<std::string>();
         return value;
@@ -847,22 +1857,30 @@ std::string get_string_property(const std::string& devicePath, std::string prope
     }
 }
 
-bool pairDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int timeoutMs)
+/**********************************************************************
+|   pair_device_async() / connect_device_async() start the BlueZ call,  |
+|   then wait for the PropertiesChanged signal to confirm it, retrying |
+|   with a pause in between. Nothing blocks: replies, retry delays and |
+|   the signal wait are all awaited on the coroutine executor.         |
+***********************************************************************/
+Task<bool> pair_device_async(std::shared_ptr<BLEDevice> device, int maxRetries, int timeoutMs)
 {
-    auto proxy = device->getProxy();
-    if (!proxy) return false; // must have a proxy
+    if (!device->getProxy()) co_return false; // must have a proxy (signals update the state)
 
     // Already paired? Nothing to do
-    if (device->getPaired()) return true;
+    if (device->getPaired()) co_return true;
 
     std::string path = device->getPath();
     if (!device->getDiscovered() || path.empty()) 
     {
         std::cerr << "[WARN] Device " << device->getAddress() 
                   << " not discovered yet, skipping.\n";
-        return false;
+        co_return false;
     }
 
+    // Control connection: a long timeout here must not hold up reads/writes
+    auto proxy = bus_pool.proxy(BusLane::Control, device->getMac(), BLUEZ_SERVICE_NAME, path);
+
     for (int attempt = 1; attempt <= maxRetries; ++attempt) 
     {
         std::cout << "[INFO] Pair attempt " << attempt 
@@ -870,9 +1888,12 @@ bool pairDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int ti
 
         try {
             // Initiate Pair call
-            proxy->callMethod("Pair")
+            AwaitableReply<> reply(coro_executor);
+            proxy->callMethodAsync("Pair")
                  .onInterface(DEVICE_IFACE)
-                 .withTimeout(std::chrono::milliseconds(timeoutMs));
+                 .withTimeout(std::chrono::milliseconds(timeoutMs))
+                 .uponReplyInvoke(reply.handler());
+            co_await reply.result(bus_pool.latency(BusLane::Control));
         } 
         catch (const sdbus::Error& e) 
         {
@@ -881,50 +1902,40 @@ bool pairDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int ti
         }
 
         // Wait for signal to update device->paired
-        auto start = std::chrono::steady_clock::now();
-        while (!device->getPaired() &&
-               std::chrono::duration_cast<std::chrono::milliseconds>(
-                   std::chrono::steady_clock::now() - start
-               ).count() < timeoutMs) 
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
-
-        if (device->getPaired()) 
+        if (co_await coro_executor.waitFor(device->getMac(), [device] { return device->getPaired(); }, timeoutMs))
         {
             std::cout << "[OK] Device paired successfully on attempt " 
                       << attempt << std::endl;
 
-            return true;
+            co_return true;
         }
 
         // Retry delay
-        if (attempt < maxRetries) 
-        {
-            std::this_thread::sleep_for(std::chrono::seconds(2));
-        }
+        if (attempt < maxRetries) co_await coro_executor.sleep(2000);
     }
 
     std::cerr << "[FAIL] Device failed to pair after " << maxRetries << " attempts" << std::endl;
-    return false;
+    co_return false;
 }
 
-bool connectDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int timeoutMs)
+Task<bool> connect_device_async(std::shared_ptr<BLEDevice> device, int maxRetries, int timeoutMs)
 {
-    auto proxy = device->getProxy();
-    if (!proxy) return false; // must have a proxy
+    if (!device->getProxy()) co_return false; // must have a proxy (signals update the state)
 
     // Already connected? Nothing to do
-    if (device->getConnected()) return true;
+    if (device->getConnected()) co_return true;
 
     std::string path = device->getPath();
     if (!device->getDiscovered() || path.empty()) 
     {
         std::cerr << "[WARN] Device " << device->getAddress() 
                   << " not discovered yet, skipping.\n";
-        return false;
+        co_return false;
     }
 
+    // Control connection: a long timeout here must not hold up reads/writes
+    auto proxy = bus_pool.proxy(BusLane::Control, device->getMac(), BLUEZ_SERVICE_NAME, path);
+
     for (int attempt = 1; attempt <= maxRetries; ++attempt) 
     {
         std::cout << "[INFO] Connect attempt " << attempt 
@@ -932,9 +1943,12 @@ bool connectDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int
 
         try {
             // Initiate Connect call
-            proxy->callMethod("Connect")
+            AwaitableReply<> reply(coro_executor);
+            proxy->callMethodAsync("Connect")
                          .onInterface(DEVICE_IFACE)
-                         .withTimeout(std::chrono::milliseconds(timeoutMs));
+                         .withTimeout(std::chrono::milliseconds(timeoutMs))
+                         .uponReplyInvoke(reply.handler());
+            co_await reply.result(bus_pool.latency(BusLane::Control));
         } 
         catch (const sdbus::Error& e) 
         {
@@ -943,166 +1957,2294 @@ bool connectDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int
         }
 
         // Wait for signal to update device->connected
-        auto start = std::chrono::steady_clock::now();
-        while (!device->getConnected() &&
-               std::chrono::duration_cast<std::chrono::milliseconds>(
-                   std::chrono::steady_clock::now() - start
-               ).count() < timeoutMs) 
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
+        bool connected = co_await coro_executor.waitFor(device->getMac(), [device] { return device->getConnected(); },
+                                                        timeoutMs);
+
+        LinkQuality q;
+        if (link_quality.recordConnect(device->getMac(), connected, now_ms(), q))
+            publish_link_quality(q);
 
-        if (device->getConnected()) 
+        if (connected) 
         {
             std::cout << "[OK] Device connected successfully on attempt " 
                       << attempt << std::endl;
 
-            /*auto slashProxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, "/");
-            std::map<sdbus::ObjectPath, std::map<std::string,
-                std::map<std::string, sdbus::Variant>>> managedObjects;
-
-            try {
-                slashProxy->callMethod("GetManagedObjects")
-                        .onInterface(DBUS_OM_IFACE)
-                        .storeResultsTo(managedObjects);
-            }
-            catch (const sdbus::Error& e) {
-                std::cerr << "Failed to GetManagedObjects: "
-                        << e.getName() << " - " << e.getMessage() << "\n";
-            }
-            device->setCharacteristics(getCharacteristics(device->getPath(), managedObjects));*/
-            
-            return true;
+            // Characteristics follow once BlueZ reports ServicesResolved
+            co_return true;
         }
 
         // Disconnect before next retry
         if (attempt < maxRetries) 
         {
-            std::this_thread::sleep_for(std::chrono::seconds(2));
-            try { proxy->callMethod("Disconnect").onInterface(DEVICE_IFACE); }
+            co_await coro_executor.sleep(2000);
+            try {
+                AwaitableReply<> reply(coro_executor);
+                proxy->callMethodAsync("Disconnect").onInterface(DEVICE_IFACE).uponReplyInvoke(reply.handler());
+                co_await reply.result(bus_pool.latency(BusLane::Control));
+            }
             catch (const sdbus::Error& e) { std::cerr << "Error: " << e.getName() << " - " << e.getMessage() << "\n"; }
         }
     }
 
     std::cerr << "[FAIL] Device failed to connect after " << maxRetries << " attempts" << std::endl;
-    return false;
+    co_return false;
 }
 
-bool DisconnectDevice(BLEDevice& device) {
-    auto proxy = device.getProxy();
-    if (!proxy) {
-        std::cerr << "No proxy for device " << device.getAddress() << std::endl;
-        return false;
+Task<bool> disconnect_device_async(std::shared_ptr<BLEDevice> device)
+{
+    if (!device->getProxy()) {
+        std::cerr << "No proxy for device " << device->getAddress() << std::endl;
+        co_return false;
     }
 
     try {
-        proxy->callMethod("Disconnect").onInterface(DEVICE_IFACE);
-        std::cout << "Disconnect requested for " << device.getAddress() << std::endl;
-        return true;
+        auto proxy = bus_pool.proxy(BusLane::Control, device->getMac(), BLUEZ_SERVICE_NAME, device->getPath());
+        AwaitableReply<> reply(coro_executor);
+        proxy->callMethodAsync("Disconnect").onInterface(DEVICE_IFACE).uponReplyInvoke(reply.handler());
+        co_await reply.result(bus_pool.latency(BusLane::Control));
+        std::cout << "Disconnect requested for " << device->getAddress() << std::endl;
+        co_return true;
     } catch (const sdbus::Error& e) {
         std::cerr << "Failed to Disconnect: " << e.getName() << " - " << e.getMessage() << std::endl;
-        return false;
+        co_return false;
     }
 }
 
-std::string ReadCharacteristic(BLEDevice& device, const std::string& uuid)
+// Blocking forms for threads outside the executor (op workers, poll and
+// reconnect threads); never call them from a coroutine
+bool pairDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int timeoutMs)
+{
+    return coro_executor.runSync(pair_device_async(device, maxRetries, timeoutMs));
+}
+
+bool connectDevice(const std::shared_ptr<BLEDevice>& device, int maxRetries, int timeoutMs)
 {
-    bool connected = device.getConnected();
-    if(!connected) {
-        return "Error: Device not connected";
-    }
+    return coro_executor.runSync(connect_device_async(device, maxRetries, timeoutMs));
+}
 
-    // Find the characteristic path from the device
-    auto characteristics = device.getCharacteristics();
-    auto it = characteristics.find(uuid);
-    if (it == characteristics.end()) {
-        return ("Characteristic " + uuid + " not found for device");
-    }
-    std::string path = it->second;
+// ReadValue on the device's I/O connection; nullopt if the read failed.
+// device must outlive the call (the awaiting caller holds it).
+Task<std::optional<std::vector<uint8_t>>> read_characteristic_async(BLEDevice& device, Uuid128 uuid)
+{
+    std::string path = device.getCharacteristicPath(uuid);
+    if (path.empty()) co_return std::nullopt;
 
-    // Create D-Bus proxy to the characteristic
-    auto characteristicProxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, path);
+    // Create D-Bus proxy to the characteristic (I/O connection of this device)
+    auto characteristicProxy = bus_pool.proxy(BusLane::Io, device.getMac(), BLUEZ_SERVICE_NAME, path);
 
     std::map<std::string, sdbus::Variant> options{};
-    std::vector<uint8_t> response;
 
     try {
-        characteristicProxy->callMethod("ReadValue")
+        AwaitableReply<std::vector<uint8_t>> reply(coro_executor);
+        characteristicProxy->callMethodAsync("ReadValue")
                     .onInterface(Characteristic_IFACE)
                     .withArguments(options)
-                    .storeResultsTo(response);
+                    .uponReplyInvoke(reply.handler());
+        auto [value] = co_await reply.result(bus_pool.latency(BusLane::Io));
+        ingest_reading(device.getMac(), uuid, value, now_ms(), std::chrono::steady_clock::now());
+
+        if (!first_read_done.exchange(true)) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::steady_clock::now() - process_start).count();
+            std::cout << "[METRIC] Time to first GATT read: " << elapsed << " ms ("
+                      << (warm_started ? "warm" : "cold") << " start)" << std::endl;
+
+            json m;
+            m["origin"] = "ble_handler";
+            m["type"] = "startup_metric";
+            m["first_gatt_read_ms"] = elapsed;
+            m["warm_start"] = warm_started;
+            mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, m.dump()));
+        }
+        co_return std::move(value);
     } 
     catch (const sdbus::Error& e) {
         std::cerr << "Faild to ReadValue: " << e.getName() << " - " << e.getMessage() << "\n";
-    }
-
-    // Build JSON result
-    json j;
-    j["origin"] = "ble_handler";
-    j["type"] = "read_characteristic";
-    j["device_mac"] = device.getAddress();
-    j["uuid"]  = uuid;
-
-    // Convert data to hex string
-    std::ostringstream oss;
-    oss << std::hex << std::setfill('0');
-    for (uint8_t byte : response)
-        oss << std::setw(2) << static_cast<int>(byte) << " ";
-
-    std::string dataStr = oss.str();
-
-    // Trim trailing space (optional)
-    if (!dataStr.empty() && dataStr.back() == ' ')
-        dataStr.pop_back();
 
-    j["data"] = dataStr;
-
-    return j.dump(); // return JSON string (ready to publish)
+        // Path came from a stale snapshot, forget it until InterfacesAdded reports it again
+        if (e.getName() == "org.freedesktop.DBus.Error.UnknownObject") {
+            device.removeCharacteristics(uuid);
+            registry_dirty = true;
+        }
+    }
+    co_return std::nullopt;
 }
 
-bool WriteCharacteristic(BLEDevice& device, const std::string& uuid, const std::vector<uint8_t>& value, bool withResponse = true)
+bool read_characteristic_value(BLEDevice& device, const Uuid128& uuid, std::vector<uint8_t>& value)
 {
-    // Find the characteristic path from the device
-    auto characteristics = device.getCharacteristics();
-    auto it = characteristics.find(uuid);
-    if (it == characteristics.end() || !device.getConnected()) {
-        return false;
-    }
-    std::string path = it->second;
+    auto result = coro_executor.runSync(read_characteristic_async(device, uuid));
+    if (!result) return false;
+    value = std::move(*result);
+    return true;
+}
 
-    // Create D-Bus proxy to the characteristic
-    auto characteristicProxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, path);
+/**********************************************************************
+|   acquire_notify_channels() asks BlueZ for a notify socket for every |
+|   characteristic devices_config.json marks "notify". Values then     |
+|   arrive on the ATT reactor instead of being polled over D-Bus; a    |
+|   characteristic BlueZ will not hand out stays on ReadValue polling. |
+***********************************************************************/
+void acquire_notify_channels(BLEDevice& device)
+{
+    auto schema = schema_store.get();
+    MacAddr mac = device.getMac();
+    const DeviceSchema* devSchema = schema ? schema->findDevice(mac) : nullptr;
+    if (!devSchema || !device.getConnected()) return;
+
+    for (const auto& chr : devSchema->characteristics) {
+        if (!chr.notify || att_reactor.hasNotify(mac, chr.uuid)) continue;
+        std::string path = device.getCharacteristicPath(chr.uuid);
+        if (path.empty()) continue;
+
+        try {
+            auto proxy = bus_pool.proxy(BusLane::Io, mac, BLUEZ_SERVICE_NAME, path);
+            AsyncReply<sdbus::UnixFd, uint16_t> reply;
+            proxy->callMethodAsync("AcquireNotify")
+                .onInterface(Characteristic_IFACE)
+                .withArguments(std::map<std::string, sdbus::Variant>{})
+                .uponReplyInvoke(reply.handler());
+            auto [fd, mtu] = reply.get(bus_pool.latency(BusLane::Io));
+            if (att_reactor.addNotify(mac, chr.uuid, fd.release(), mtu))
+                std::cout << "[ATT] " << macToString(mac) << " " << chr.name << " notifying on socket (MTU "
+                          << mtu << ")" << std::endl;
+        }
+        catch (const sdbus::Error& e) {
+            std::cout << "[ATT] " << macToString(mac) << " " << chr.name << " stays polled: "
+                      << e.getName() << std::endl;
+        }
+    }
+}
+
+// Write socket for a write-without-response characteristic, acquired on
+// first use; false if BlueZ does not offer one (remembered until reconnect)
+Task<bool> acquire_write_channel(BLEDevice& device, Uuid128 uuid)
+{
+    MacAddr mac = device.getMac();
+    if (att_reactor.hasWrite(mac, uuid)) co_return true;
+    {
+        std::lock_guard<std::mutex> lock(acquire_mutex);
+        if (acquire_write_unsupported.count({mac, uuid})) co_return false;
+    }
+
+    std::string path = device.getCharacteristicPath(uuid);
+    if (path.empty()) co_return false;
+    try {
+        auto proxy = bus_pool.proxy(BusLane::Io, mac, BLUEZ_SERVICE_NAME, path);
+        AwaitableReply<sdbus::UnixFd, uint16_t> reply(coro_executor);
+        proxy->callMethodAsync("AcquireWrite")
+            .onInterface(Characteristic_IFACE)
+            .withArguments(std::map<std::string, sdbus::Variant>{})
+            .uponReplyInvoke(reply.handler());
+        auto [fd, mtu] = co_await reply.result(bus_pool.latency(BusLane::Io));
+        // A concurrent writer may have won the race; either way a channel exists
+        att_reactor.addWrite(mac, uuid, fd.release(), mtu);
+        co_return att_reactor.hasWrite(mac, uuid);
+    }
+    catch (const sdbus::Error& e) {
+        std::cout << "[ATT] " << macToString(mac) << " " << uuidToString(uuid) << " writes stay on WriteValue: "
+                  << e.getName() << std::endl;
+        std::lock_guard<std::mutex> lock(acquire_mutex);
+        acquire_write_unsupported.insert({mac, uuid});
+    }
+    co_return false;
+}
+
+void release_att_channels(MacAddr mac)
+{
+    att_reactor.closeDevice(mac);
+    std::lock_guard<std::mutex> lock(acquire_mutex);
+    acquire_write_unsupported.erase(acquire_write_unsupported.lower_bound({mac, Uuid128{}}),
+                                    acquire_write_unsupported.upper_bound({mac, Uuid128{UINT64_MAX, UINT64_MAX}}));
+}
+
+// Key of a value in the device's state: the schema name, else the UUID
+std::string value_key(MacAddr mac, const Uuid128& uuid)
+{
+    auto schema = schema_store.get();
+    if (const DeviceSchema* devSchema = schema ? schema->findDevice(mac) : nullptr)
+        if (const CharacteristicSchema* chr = devSchema->findByUuid(uuid)) return chr->name;
+    return uuidToString(uuid);
+}
+
+// Values from notify sockets; runs on the reactor thread
+void on_att_notification(MacAddr mac, const Uuid128& uuid, const uint8_t* data, size_t len, bool changed,
+                         std::chrono::steady_clock::time_point received)
+{
+    thread_local std::vector<uint8_t> value;
+    value.assign(data, data + len);
+    ingest_reading(mac, uuid, value, now_ms(), received);
+    if (!changed) return;
+
+    publish_device_event(mac, "notify_update", json{{"values", {{value_key(mac, uuid), bytes_to_hex(value)}}}},
+                         json{{"uuid", uuidToString(uuid)}});
+}
+
+// ReadValue of the Database Hash as hex; not a reading, so nothing is ingested
+bool read_gatt_hash(BLEDevice& device, std::string& hashHex)
+{
+    std::string path = device.getCharacteristicPath(GATT_DB_HASH_UUID);
+    if (path.empty()) return false;
+
+    try {
+        auto proxy = bus_pool.proxy(BusLane::Io, device.getMac(), BLUEZ_SERVICE_NAME, path);
+        AsyncReply<std::vector<uint8_t>> reply;
+        proxy->callMethodAsync("ReadValue")
+            .onInterface(Characteristic_IFACE)
+            .withArguments(std::map<std::string, sdbus::Variant>{})
+            .uponReplyInvoke(reply.handler());
+        auto [value] = reply.get(bus_pool.latency(BusLane::Io));
+        hashHex = gattHashHex(value);
+        return !hashHex.empty();
+    }
+    catch (const sdbus::Error& e) {
+        std::cerr << "[GATT] Database hash read failed for " << device.getAddress() << ": "
+                  << e.getName() << " - " << e.getMessage() << std::endl;
+        return false;
+    }
+}
+
+// Introspects every parent at once and appends the full paths of their
+// children whose node name starts with prefix. Throws sdbus::Error.
+void introspect_children(MacAddr mac, const std::vector<std::string>& parents, std::string_view prefix,
+                         std::vector<std::string>& children, uint32_t& calls)
+{
+    std::vector<std::unique_ptr<sdbus::IProxy>> proxies;
+    std::vector<AsyncReply<std::string>> replies(parents.size());
+    proxies.reserve(parents.size());
+    for (size_t i = 0; i < parents.size(); ++i) {
+        proxies.push_back(bus_pool.proxy(BusLane::Control, mac, BLUEZ_SERVICE_NAME, parents[i]));
+        proxies.back()->callMethodAsync("Introspect")
+            .onInterface(INTROSPECTABLE_IFACE)
+            .uponReplyInvoke(replies[i].handler());
+    }
+    calls += static_cast<uint32_t>(parents.size());
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < parents.size(); ++i) {
+        auto [xml] = replies[i].get(bus_pool.latency(BusLane::Control));
+        names.clear();
+        introspectChildren(xml, prefix, names);
+        for (const auto& name : names) children.push_back(parents[i] + "/" + name);
+    }
+}
+
+/**********************************************************************
+|   refresh_gatt() learns a device's characteristics once its services |
+|   are resolved. A cached map read under the GATT Database Hash the   |
+|   device reports now is kept as is; otherwise only the subtree under |
+|   the device node is walked: services, then characteristics, then    |
+|   their UUIDs, each level in one round of parallel calls.            |
+***********************************************************************/
+bool refresh_gatt(const std::shared_ptr<BLEDevice>& device, std::chrono::steady_clock::time_point resolvedAt)
+{
+    std::string devPath = device->getPath();
+    std::string address = device->getAddress();
+    if (devPath.empty()) return false;
+
+    // Unchanged database: every cached path is still right
+    std::string cachedHash = device->getGattHash();
+    std::string hash;
+    if (!cachedHash.empty() && read_gatt_hash(*device, hash) && hash == cachedHash) {
+        gatt_refresh_stats.hit(std::chrono::steady_clock::now() - resolvedAt);
+        std::cout << "[GATT] " << address << " database unchanged (" << hash << "), discovery skipped" << std::endl;
+        acquire_notify_channels(*device);
+        return true;
+    }
+
+    MacAddr mac = device->getMac();
+    uint32_t calls = 0;
+    CharacteristicMap found;
+    try {
+        std::vector<std::string> services, chars;
+        introspect_children(mac, {devPath}, "service", services, calls);
+        introspect_children(mac, services, "char", chars, calls);
+
+        std::vector<std::unique_ptr<sdbus::IProxy>> proxies;
+        std::vector<AsyncReply<sdbus::Variant>> replies(chars.size());
+        proxies.reserve(chars.size());
+        for (size_t i = 0; i < chars.size(); ++i) {
+            proxies.push_back(bus_pool.proxy(BusLane::Control, mac, BLUEZ_SERVICE_NAME, chars[i]));
+            proxies.back()->callMethodAsync("Get")
+                .onInterface(PROPERTIES_IFACE)
+                .withArguments(Characteristic_IFACE, std::string("UUID"))
+                .uponReplyInvoke(replies[i].handler());
+        }
+        calls += static_cast<uint32_t>(chars.size());
+
+        for (size_t i = 0; i < chars.size(); ++i) {
+            auto [uuidVariant] = replies[i].get(bus_pool.latency(BusLane::Control));
+            Uuid128 uuid;
+            if (parseUuid(uuidVariant.get<std::string>(), uuid))
+                found[uuid] = object_paths.intern(pathBelowDevice(chars[i]));
+        }
+    }
+    catch (const sdbus::Error& e) {
+        gatt_refresh_stats.failed();
+        std::cerr << "[GATT] Discovery failed for " << address << ": " << e.getName() << " - " << e.getMessage() << std::endl;
+        return false;
+    }
+
+    if (found.empty()) {
+        gatt_refresh_stats.failed();  // keep what InterfacesAdded reported
+        return false;
+    }
+
+    device->setCharacteristics(found);
+    hash.clear();
+    if (found.contains(GATT_DB_HASH_UUID)) read_gatt_hash(*device, hash);
+    device->setGattHash(hash);
+    registry_dirty = true;
+
+    gatt_refresh_stats.walked(std::chrono::steady_clock::now() - resolvedAt, calls);
+    std::cout << "[GATT] " << address << " discovered " << found.size() << " characteristics in "
+              << calls << " calls" << (hash.empty() ? " (no database hash)" : "") << std::endl;
+    acquire_notify_channels(*device);
+    return true;
+}
+
+// Queues refresh_gatt() as a radio op, at most one per device at a time
+void schedule_gatt_refresh(const std::shared_ptr<BLEDevice>& device)
+{
+    MacAddr mac = device->getMac();
+    {
+        std::lock_guard<std::mutex> lock(gatt_refresh_mutex);
+        if (!gatt_refresh_pending.insert(mac)) return;
+    }
+    auto done = [mac]() {
+        std::lock_guard<std::mutex> lock(gatt_refresh_mutex);
+        gatt_refresh_pending.erase(mac);
+    };
+
+    RadioOp op;
+    op.command = "gatt_refresh";
+    op.priority = OpPriority::Normal;
+    op.run = [device, done, resolvedAt = std::chrono::steady_clock::now()]() {
+        done();  // a later ServicesResolved may queue another
+        refresh_gatt(device, resolvedAt);
+    };
+    if (!radio_ops.submit(std::move(op))) {
+        done();
+        gatt_refresh_stats.failed();
+    }
+}
+
+// device must outlive the call (the awaiting caller holds it)
+Task<bool> write_characteristic_async(BLEDevice& device, Uuid128 uuid, std::vector<uint8_t> value,
+                                      bool withResponse = true)
+{
+    // Find the characteristic path from the device
+    std::string path = device.getCharacteristicPath(uuid);
+    if (path.empty() || !device.getConnected()) {
+        co_return false;
+    }
+
+    // Without response: straight onto the write socket when BlueZ gives one
+    if (!withResponse && co_await acquire_write_channel(device, uuid)) {
+        for (int attempt = 0; attempt < 50; ++attempt) {
+            auto result = att_reactor.write(device.getMac(), uuid, value.data(), value.size());
+            if (result == AttReactor::WriteResult::Ok) co_return true;
+            if (result != AttReactor::WriteResult::Busy) break;   // too long or closed: WriteValue
+            co_await coro_executor.sleep(2);
+        }
+    }
+
+    // Create D-Bus proxy to the characteristic (I/O connection of this device)
+    auto characteristicProxy = bus_pool.proxy(BusLane::Io, device.getMac(), BLUEZ_SERVICE_NAME, path);
+
+    // Options map can include "type" = "request" (write with response) or "command" (write without response)
+    std::map<std::string, sdbus::Variant> options;
+    options["type"] = sdbus::Variant(withResponse ? std::string("request") 
+                                                  : std::string("command"));
+
+    try {
+        // Perform the WriteValue call
+        AwaitableReply<> reply(coro_executor);
+        characteristicProxy->callMethodAsync("WriteValue")
+            .onInterface(Characteristic_IFACE)
+            .withArguments(value, options)
+            .uponReplyInvoke(reply.handler());
+        co_await reply.result(bus_pool.latency(BusLane::Io));
+    } 
+    catch (const sdbus::Error& e) {
+        std::cerr << "Faild to ReadValue: " << e.getName() << " - " << e.getMessage() << "\n";
+        co_return false;
+    }
+    co_return true;
+}
+
+std::vector<uint8_t> hexStringToBytesLE(const std::string& hex)
+{
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        std::string byteStr = hex.substr(i, 2);
+        uint8_t byte = static_cast<uint8_t>(std::stoul(byteStr, nullptr, 16));
+        bytes.push_back(byte);
+    }
+
+    // Reverse for little endian {low byte first}
+    //std::reverse(bytes.begin(), bytes.end());
+    return bytes;
+}
+
+// Strict hex for payloads from the hub; false on odd length or a non-hex digit
+bool parse_hex_bytes(const std::string& hex, std::vector<uint8_t>& bytes)
+{
+    if (hex.size() % 2) return false;
+    auto nibble = [](char ch) {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+        if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+        return -1;
+    };
+    bytes.clear();
+    bytes.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int hi = nibble(hex[i]), lo = nibble(hex[i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        bytes.push_back(static_cast<uint8_t>(hi << 4 | lo));
+    }
+    return true;
+}
+
+bool parse_mac_field(const json& value, MacAddr& mac)
+{
+    if (value.is_string() && parseMac(value.get<std::string>(), mac)) return true;
+    std::cerr << "Invalid mac: " << value.dump() << std::endl;
+    return false;
+}
+
+/**********************************************************************
+|   resolve_characteristic() fills mac/uuid for a command. Devices can  |
+|   be addressed by "mac" or by their devices_config.json id in         |
+|   "device", characteristics by "uuid" or by friendly name in          |
+|   "characteristic". Returns an error message, empty on success.       |
+***********************************************************************/
+std::string resolve_characteristic(const json& j, MacAddr& mac, Uuid128& uuid,
+                                   std::shared_ptr<const SchemaIndex>& schema,
+                                   const CharacteristicSchema*& chr)
+{
+    schema = schema_store.get();
+    chr = nullptr;
+    const DeviceSchema* devSchema = nullptr;
+
+    if (j.contains("mac")) {
+        std::string text = j["mac"];
+        if (!parseMac(text, mac)) return "Invalid mac " + text;
+        if (schema) devSchema = schema->findDevice(mac);
+    }
+    else if (j.contains("device")) {
+        std::string id = j["device"];
+        if (schema) devSchema = schema->findDevice(id);
+        if (!devSchema || !devSchema->macAddr) return "Unknown device " + id;
+        mac = devSchema->macAddr;
+    }
+    else return "Missing mac";
+
+    if (j.contains("uuid")) {
+        std::string text = j["uuid"];
+        if (!parseUuid(text, uuid)) return "Invalid uuid " + text;
+        if (devSchema) chr = devSchema->findByUuid(uuid);
+    }
+    else if (j.contains("characteristic")) {
+        std::string name = j["characteristic"];
+        if (devSchema) chr = devSchema->findByName(name);
+        if (!chr) return "Unknown characteristic " + name;
+        uuid = chr->uuid;
+    }
+    else return "Missing uuid";
+
+    return "";
+}
+
+// Encodes the "value" field of a write. Integers are validated against the
+// schema and packed little-endian, strings are raw hex bytes.
+std::string encode_write_value(const json& value, const CharacteristicSchema* chr, std::vector<uint8_t>& bytes)
+{
+    if (chr && !chr->writable && !chr->writeWithoutResponse)
+        return chr->name + " is not writable";
+
+    if (value.is_number_integer() || value.is_boolean()) {
+        if (!chr) return "Numeric values need a characteristic from devices_config.json";
+        int64_t v = value.is_boolean() ? value.get<bool>() : value.get<int64_t>();
+        if (auto err = chr->validate(v); !err.empty()) return err;
+
+        int length = chr->length > 0 ? chr->length : 1;
+        for (int i = 0; i < length; ++i) bytes.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        return "";
+    }
+
+    if (!value.is_string()) return "Value must be a hex string or an integer";
+    bytes = hexStringToBytesLE(value.get<std::string>());
+
+    if (chr && chr->length > 0) {
+        if (static_cast<int>(bytes.size()) != chr->length)
+            return chr->name + " expects " + std::to_string(chr->length) + " bytes";
+        if (chr->length <= 8) {
+            int64_t v = 0;
+            for (size_t i = 0; i < bytes.size(); ++i) v |= static_cast<int64_t>(bytes[i]) << (8 * i);
+            if (auto err = chr->validate(v); !err.empty()) return err;
+        }
+    }
+    return "";
+}
+
+// Characteristic whose history a reading belongs to. BTHome advertisements
+// (service data 0xFCD2) are filed under the device's BTHome characteristic.
+const CharacteristicSchema* history_characteristic(const DeviceSchema& devSchema, const Uuid128& uuid)
+{
+    if (const CharacteristicSchema* chr = devSchema.findByUuid(uuid)) return chr;
+
+    Uuid128 bthome;
+    parseUuid("fcd2", bthome);
+    if (uuid != bthome) return nullptr;
+    for (const auto& chr : devSchema.characteristics) {
+        if (!chr.bthomeObjects.empty()) return &chr;
+    }
+    return nullptr;
+}
+
+// A rule's write, admitted as an interactive radio op
+Task<void> rule_write(std::string name, RuleAction action, std::chrono::steady_clock::time_point received)
+{
+    RadioSlot slot = co_await admit_radio("rule_write", OpPriority::Interactive);
+    if (!slot) {
+        std::cerr << "[Rules] " << name << ": op queue full, write dropped" << std::endl;
+        co_return;
+    }
+    auto dev = get_device(action.mac);
+    if (!dev || !co_await write_characteristic_async(*dev, action.uuid, action.bytes, action.withResponse)) {
+        std::cerr << "[Rules] " << name << ": write to " << macToString(action.mac) << " failed" << std::endl;
+        co_return;
+    }
+    rules_engine.reactionLatency().record(std::chrono::steady_clock::now() - received);
+}
+
+// Runs the actions of fired rules. Publishes go out inline; writes are
+// spawned as interactive radio ops so signal processing never waits on a
+// slow device.
+void run_rule_actions(const std::vector<FiredRule>& fired, std::chrono::steady_clock::time_point received)
+{
+    for (const auto& rule : fired) {
+        std::cout << "[Rules] " << rule.rule << " fired at " << rule.value << std::endl;
+        for (const auto& action : rule.actions) {
+            if (action.kind == RuleAction::Kind::Publish) {
+                std::string payload = action.payload;
+                if (auto pos = payload.find("{value}"); pos != std::string::npos) {
+                    std::ostringstream value;
+                    value << rule.value;
+                    payload.replace(pos, 7, value.str());
+                }
+                mqtt_publish(mqtt::make_message(action.topic, payload));
+                rules_engine.reactionLatency().record(std::chrono::steady_clock::now() - received);
+                continue;
+            }
+
+            coro_executor.spawn(rule_write(rule.rule, action, received));
+        }
+    }
+}
+
+/**********************************************************************
+|   ingest_reading() handles every value coming off the radio (read     |
+|   reply, notification or advertisement): it is filed in the           |
+|   time-series store and checked against the local rules. BTHome       |
+|   payloads become one reading per object, plain values up to 8 bytes  |
+|   one little-endian integer. Only devices in devices_config.json are  |
+|   handled. received is when the value reached the handler, for the    |
+|   rule reaction latency.                                              |
+***********************************************************************/
+void ingest_reading(MacAddr mac, const Uuid128& uuid, const std::vector<uint8_t>& value, int64_t tsMs,
+                    std::chrono::steady_clock::time_point received)
+{
+    auto schema = schema_store.get();
+    const DeviceSchema* devSchema = schema ? schema->findDevice(mac) : nullptr;
+    if (!devSchema || value.empty()) return;
+
+    const CharacteristicSchema* chr = history_characteristic(*devSchema, uuid);
+    if (!chr) return;
+
+    std::vector<FiredRule> fired;
+    auto reading = [&](const SeriesKey& key, double scale, int64_t raw) {
+        history_store.append(key, scale, tsMs, raw);
+        rules_engine.evaluate(key, static_cast<double>(raw) * scale, tsMs, fired);
+    };
+
+    if (!chr->bthomeObjects.empty()) {
+        decodeBTHome(value, chr->bthomeObjects, [&](const BTHomeObjectSchema& object, int64_t raw) {
+            if (object.id == BTHOME_PACKET_ID) return;
+            reading(SeriesKey{mac, chr->uuid, object.id}, object.scale, raw);
+        });
+    } else if (value.size() <= 8) {
+        int64_t raw = 0;
+        for (size_t i = 0; i < value.size(); ++i) raw |= static_cast<int64_t>(value[i]) << (8 * i);
+        reading(SeriesKey{mac, chr->uuid, SERIES_FIELD_VALUE}, 1.0, raw);
+    }
+
+    if (!fired.empty()) run_rule_actions(fired, received);
+}
+
+/**********************************************************************
+|   query_history() answers a query_history command from the store,     |
+|   without touching the radio:                                         |
+|   {"command": "query_history", "device": "motion_sensor_1",           |
+|    "characteristic": "BTHome sensor data objects",                    |
+|    "field": "illuminance", "from": ms, "to": ms,                      |
+|    "bucket_ms": 60000, "limit": 1000}                                 |
+|   Without bucket_ms the raw points are returned, with it one          |
+|   [start, min, max, avg, count] entry per non-empty bucket.           |
+***********************************************************************/
+json query_history(const json& j)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    json resp;
+    resp["origin"] = "ble_handler";
+    resp["type"] = "history";
+    resp["device_mac"] = j.value("mac", j.value("device", ""));
+    resp["uuid"] = j.value("uuid", j.value("characteristic", ""));
+
+    MacAddr mac = 0;
+    Uuid128 uuid;
+    std::shared_ptr<const SchemaIndex> schema;
+    const CharacteristicSchema* chr;
+    std::string error = resolve_characteristic(j, mac, uuid, schema, chr);
+
+    const DeviceSchema* devSchema = error.empty() && schema ? schema->findDevice(mac) : nullptr;
+    if (error.empty() && devSchema) chr = history_characteristic(*devSchema, uuid);
+    if (error.empty() && !chr) error = "No history for this characteristic";
+
+    SeriesKey key{mac, chr ? chr->uuid : uuid, SERIES_FIELD_VALUE};
+    if (error.empty() && !chr->bthomeObjects.empty()) {
+        std::string field = j.value("field", "");
+        auto it = std::find_if(chr->bthomeObjects.begin(), chr->bthomeObjects.end(),
+                               [&](const BTHomeObjectSchema& o) { return o.name == field; });
+        if (it == chr->bthomeObjects.end()) error = "Unknown field " + field;
+        else {
+            key.field = it->id;
+            resp["field"] = field;
+        }
+    }
+
+    if (!error.empty()) {
+        resp["error"] = error;
+        return resp;
+    }
+
+    int64_t to       = j.value("to", now_ms());
+    int64_t from     = j.value("from", to - 3600 * 1000);
+    int64_t bucketMs = j.value("bucket_ms", int64_t(0));
+    size_t limit     = std::min<size_t>(j.value("limit", size_t(1000)), HISTORY_MAX_POINTS);
+    if (bucketMs > 0 && to > from && (to - from) / bucketMs >= static_cast<int64_t>(HISTORY_MAX_POINTS)) {
+        resp["error"] = "Too many buckets: at most " + std::to_string(HISTORY_MAX_POINTS) + ", raise bucket_ms";
+        return resp;
+    }
+    resp["device_mac"] = macToString(mac);
+    resp["uuid"] = uuidToString(key.uuid);
+    resp["from"] = from;
+    resp["to"] = to;
+
+    if (bucketMs > 0) {
+        std::vector<HistoryBucket> buckets;
+        history_store.aggregate(key, from, to, bucketMs, buckets);
+        resp["bucket_ms"] = bucketMs;
+        resp["buckets"] = json::array();
+        for (const auto& b : buckets) resp["buckets"].push_back({b.startMs, b.min, b.max, b.avg, b.count});
+    } else {
+        std::vector<HistoryPoint> points;
+        history_store.query(key, from, to, limit, points);
+        resp["points"] = json::array();
+        for (const auto& p : points) resp["points"].push_back({p.tsMs, p.value});
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    history_query_latency.record(elapsed);
+    resp["query_us"] = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    return resp;
+}
+
+// Registered devices x characteristics with a "poll" block in the config
+void sync_poll_targets(const SchemaIndex& schema)
+{
+    int64_t now = steady_ms();
+    poll_scheduler.beginSync();
+    for (const auto& devSchema : schema.devices) {
+        if (!devSchema.macAddr) continue;
+        {
+            std::lock_guard<std::mutex> lock(devicesMutex);
+            if (!devices.contains(devSchema.macAddr)) continue;
+        }
+        for (const auto& chr : devSchema.characteristics) {
+            if (!chr.pollIntervalMs) continue;
+            poll_scheduler.set(devSchema.macAddr, chr.uuid,
+                               PollConfig{chr.pollIntervalMs, chr.pollMinMs, chr.pollMaxMs}, now);
+        }
+    }
+    poll_scheduler.endSync();
+}
+
+// Resync after a config reload or a registry change
+void resync_poll_targets(std::shared_ptr<const SchemaIndex>& synced)
+{
+    auto schema = schema_store.get();
+    if (schema && (schema != synced || poll_targets_dirty.exchange(false))) {
+        sync_poll_targets(*schema);
+        synced = schema;
+    }
+}
+
+void publish_poll_update(MacAddr mac, const Uuid128& uuid, const std::vector<uint8_t>& value)
+{
+    publish_device_event(mac, "poll_update", json{{"values", {{value_key(mac, uuid), bytes_to_hex(value)}}}},
+                         json{{"uuid", uuidToString(uuid)}, {"interval_ms", poll_scheduler.intervalMs(mac, uuid)}});
+}
+
+/**********************************************************************
+|   poll_worker() reads the characteristics that have a "poll" block   |
+|   in devices_config.json and cannot notify. Intervals adapt to how   |
+|   often the value changes; only changed values are published.        |
+***********************************************************************/
+void poll_worker()
+{
+    std::shared_ptr<const SchemaIndex> synced;
+    std::vector<Uuid128> batch;
+    std::vector<uint8_t> value;
+
+    while (!poll_worker_stop) {
+        resync_poll_targets(synced);
+
+        MacAddr mac = 0;
+        if (!poll_scheduler.takeDue(steady_ms(), mac, batch)) {
+            // Sleep until the next read is due, waking at least once a second for resyncs
+            int64_t wait = std::clamp<int64_t>(poll_scheduler.nextDueMs() - steady_ms(), 1, 1000);
+            std::unique_lock<std::mutex> lock(poll_mutex);
+            poll_cv.wait_for(lock, std::chrono::milliseconds(wait), [] { return poll_worker_stop.load(); });
+            continue;
+        }
+
+        // One batch per device, back to back while its link is up
+        auto dev = get_device(mac);
+        for (const auto& uuid : batch) {
+            // Streaming over a notify socket; the read would only repeat it
+            if (att_reactor.hasNotify(mac, uuid)) {
+                poll_scheduler.complete(mac, uuid, steady_ms(), nullptr);
+                continue;
+            }
+            bool ok = dev && dev->getConnected() && run_radio_op(OpPriority::Background, "poll_read", [&] {
+                return read_characteristic_value(*dev, uuid, value);
+            });
+            if (poll_scheduler.complete(mac, uuid, steady_ms(), ok ? &value : nullptr))
+                publish_poll_update(mac, uuid, value);
+        }
+    }
+}
+
+void reactor_reconnect_tick();
+
+void kick_reconnect_worker()
+{
+    if (reactor_mode) {
+        event_reactor.post(reactor_reconnect_tick);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(reconnect_mutex);
+        reconnect_kick = true;
+    }
+    reconnect_cv.notify_one();
+}
+
+void publish_reconnect_change(MacAddr mac, ReconnectSupervisor::Change change, int64_t downtimeMs)
+{
+    using Change = ReconnectSupervisor::Change;
+    if (change == Change::None) return;
+
+    json j;
+    j["origin"] = "ble_handler";
+    j["type"] = "reconnect";
+    j["device_mac"] = macToString(mac);
+    j["state"] = change == Change::BreakerOpened ? "breaker_open" : "recovered";
+    if (change != Change::BreakerOpened) j["downtime_ms"] = downtimeMs;
+    std::cout << "[Reconnect] " << macToString(mac) << " " << j["state"].get<std::string>();
+    if (change != Change::BreakerOpened) std::cout << " after " << downtimeMs << " ms";
+    std::cout << std::endl;
+    mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j.dump()));
+}
+
+// One connect try on the op queue; the result goes back to the supervisor
+void submit_reconnect(MacAddr mac)
+{
+    auto finish = [mac](bool ok) {
+        int64_t downtimeMs = 0;
+        auto change = reconnect_supervisor.attemptFinished(mac, ok, steady_ms(), downtimeMs);
+        publish_reconnect_change(mac, change, downtimeMs);
+        kick_reconnect_worker();
+    };
+    RadioOp op;
+    op.command = "reconnect";
+    op.priority = OpPriority::Normal;
+    op.run = [mac, finish]() {
+        auto dev = get_device(mac);
+        finish(dev && connectDevice(dev, 1));
+    };
+    if (!radio_ops.submit(std::move(op))) finish(false);
+}
+
+/**********************************************************************
+|   reconnect_worker() hands the attempts the supervisor releases to    |
+|   the op queue, one connect try each. Results go back to the          |
+|   supervisor, which decides on the next backoff or the breaker.       |
+***********************************************************************/
+void reconnect_worker()
+{
+    std::vector<MacAddr> due;
+
+    while (!reconnect_worker_stop) {
+        due.clear();
+        reconnect_supervisor.takeDue(steady_ms(), due);
+        for (MacAddr mac : due) submit_reconnect(mac);
+
+        int64_t wait = std::clamp<int64_t>(reconnect_supervisor.nextWakeMs() - steady_ms(), 1, 1000);
+        std::unique_lock<std::mutex> lock(reconnect_mutex);
+        reconnect_cv.wait_for(lock, std::chrono::milliseconds(wait),
+                              [] { return reconnect_worker_stop.load() || reconnect_kick.load(); });
+        reconnect_kick = false;
+    }
+}
+
+// Correlation for one command: request_id is echoed in its command_result,
+// deadline_ms is a budget from receipt after which queued work is dropped
+struct CommandContext {
+    std::string command;
+    std::string requestId;
+    int64_t receivedMs = 0;   // steady_ms()
+    int64_t deadlineMs = 0;   // steady_ms(), 0 = none
+    OpPriority priority = OpPriority::Normal;
+};
+
+void publish_command_result(const CommandContext& ctx, const std::string& status, const std::string& error,
+                            const json& result = json::object())
+{
+    json j;
+    j["origin"] = "ble_handler";
+    j["type"] = "command_result";
+    j["command"] = ctx.command;
+    if (!ctx.requestId.empty()) j["request_id"] = ctx.requestId;
+    j["status"] = status;  // ok, error, expired or rejected
+    if (!error.empty()) j["error"] = error;
+    j["elapsed_ms"] = steady_ms() - ctx.receivedMs;
+    for (const auto& [key, value] : result.items()) j[key] = value;
+    mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j.dump()));
+    // Whole life of the command, receipt to result
+    if (tracer.on())
+        tracer.async("command", std::chrono::steady_clock::time_point(std::chrono::milliseconds(ctx.receivedMs)),
+                     std::chrono::steady_clock::now(), ctx.command + " " + ctx.requestId);
+}
+
+// For commands that answer with a message of their own: a failure is always
+// reported, success only when the caller correlates with a request_id
+void confirm_command(const CommandContext& ctx, const std::string& error)
+{
+    if (!error.empty()) publish_command_result(ctx, "error", error);
+    else if (!ctx.requestId.empty()) publish_command_result(ctx, "ok", "");
+}
+
+// Waits for a radio slot for a command; work that expires or does not fit
+// is reported as a result instead of run, and gets an empty slot
+Task<RadioSlot> admit_command(CommandContext ctx)
+{
+    std::optional<TraceAsyncSpan> wait(std::in_place, "radio_wait", ctx.command);
+    RadioSlot slot = co_await admit_radio(ctx.command, ctx.priority, ctx.deadlineMs);
+    wait.reset();
+    if (slot.expired()) {
+        std::cout << "[Ops] " << ctx.command << " " << ctx.requestId << " expired in the queue" << std::endl;
+        publish_command_result(ctx, "expired", "Deadline passed before the radio was free");
+    } else if (!slot) {
+        publish_command_result(ctx, "rejected", "Operation queue full");
+    }
+    co_return std::move(slot);
+}
+
+OpCoalescer<CommandContext> pending_ops;   // reads and writes waiting per characteristic
+
+// Radio slot for a coalesced batch: the most urgent priority among its
+// callers and the latest deadline (none if one of them has none). Every
+// caller hears if the batch expired or did not fit.
+Task<RadioSlot> admit_batch(std::vector<CommandContext> callers)
+{
+    CommandContext lead = callers.back();
+    for (const auto& c : callers) {
+        lead.priority = std::min(lead.priority, c.priority);
+        lead.deadlineMs = lead.deadlineMs && c.deadlineMs ? std::max(lead.deadlineMs, c.deadlineMs) : 0;
+    }
+    std::optional<TraceAsyncSpan> wait(std::in_place, "radio_wait", lead.command);
+    RadioSlot slot = co_await admit_radio(lead.command, lead.priority, lead.deadlineMs);
+    wait.reset();
+    if (slot.expired()) {
+        std::cout << "[Ops] " << lead.command << " batch of " << callers.size() << " expired in the queue"
+                  << std::endl;
+        for (const auto& c : callers) publish_command_result(c, "expired", "Deadline passed before the radio was free");
+    } else if (!slot) {
+        for (const auto& c : callers) publish_command_result(c, "rejected", "Operation queue full");
+    }
+    co_return std::move(slot);
+}
+
+// One ReadValue for every pending read of the characteristic
+Task<void> read_batch(MacAddr macKey, Uuid128 uuidKey, std::vector<CommandContext> readers)
+{
+    RadioSlot slot = co_await admit_batch(readers);
+    if (!slot) co_return;
+
+    std::string mac = macToString(macKey);
+    std::string uuid = uuidToString(uuidKey);
+    json j_resp;
+    j_resp["origin"] = "ble_handler";
+    j_resp["type"] = "read_characteristic";
+    j_resp["device_mac"] = mac;
+    j_resp["uuid"] = uuid;
+
+    auto dev = get_device(macKey);
+    if (!dev) {
+        j_resp["error"] = "Device not found";
+    } else if (!dev->getConnected()) {
+        // Check if device is connected before attempting read
+        j_resp["error"] = "Device not connected";
+    } else if (dev->findCharacteristic(uuidKey) == INVALID_PATH) {
+        j_resp["error"] = "Characteristic " + uuid + " not found for device";
+    } else if (auto value = co_await read_characteristic_async(*dev, uuidKey); !value) {
+        j_resp["error"] = "Read failed";
+    } else {
+        j_resp["data"] = bytes_to_hex(*value);
+    }
+
+    for (const auto& ctx : readers) {
+        if (!ctx.requestId.empty()) j_resp["request_id"] = ctx.requestId;
+        else j_resp.erase("request_id");
+        mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+        if (j_resp.contains("error")) publish_command_result(ctx, "error", j_resp["error"]);
+        else publish_command_result(ctx, "ok", "", json{{"data", j_resp["data"]}});
+    }
+}
+
+// The newest pending write; callers it replaced get its outcome
+Task<void> write_batch(MacAddr mac, Uuid128 uuid, OpCoalescer<CommandContext>::Batch batch)
+{
+    std::vector<CommandContext> callers = batch.superseded;
+    callers.push_back(batch.writer);
+    RadioSlot slot = co_await admit_batch(callers);
+    if (!slot) co_return;
+
+    auto dev = get_device(mac);
+    bool ok = dev && co_await write_characteristic_async(*dev, uuid, std::move(batch.value), batch.withResponse);
+    std::string error = ok ? "" : dev ? "Write failed" : "Device not found";
+    json result;
+    if (!batch.superseded.empty()) result["collapsed"] = batch.superseded.size();
+    publish_command_result(batch.writer, ok ? "ok" : "error", error, result);
+
+    // Last writer wins: the older values were never written
+    result = {{"superseded", true}};
+    if (!batch.writer.requestId.empty()) result["superseded_by"] = batch.writer.requestId;
+    for (const auto& ctx : batch.superseded) publish_command_result(ctx, ok ? "ok" : "error", error, result);
+}
+
+/**********************************************************************
+|   characteristic_runner() works through the pending reads and writes |
+|   of one characteristic (see op_coalescer.h), one batch at a time:   |
+|   the newest write first, then one read for every pending reader.    |
+|   Whatever arrives meanwhile collapses into the next batch. Exits    |
+|   when nothing is pending; the next submit starts a new runner.      |
+|   If a batch throws, its callers and everything still pending        |
+|   get an error and the runner exits.                                 |
+***********************************************************************/
+Task<void> characteristic_runner(MacAddr mac, Uuid128 uuid)
+{
+    OpCoalescer<CommandContext>::Batch batch;
+    std::string failure;
+    std::vector<CommandContext> unanswered;   // of the batch that failed
+    while (pending_ops.next(mac, uuid, batch)) {
+        std::vector<CommandContext> readers = std::move(batch.readers);
+        std::vector<CommandContext> writers;
+        if (batch.hasWrite) {
+            writers = batch.superseded;
+            writers.push_back(batch.writer);
+        }
+        try {
+            if (batch.hasWrite) co_await write_batch(mac, uuid, std::move(batch));
+            writers.clear();
+            if (!readers.empty()) co_await read_batch(mac, uuid, readers);
+        } catch (const std::exception& e) {
+            failure = e.what();
+            unanswered = std::move(writers);
+            unanswered.insert(unanswered.end(), readers.begin(), readers.end());
+            break;
+        }
+        batch = {};
+    }
+    if (failure.empty()) co_return;
+
+    // Answer everyone still waiting and release the characteristic, or
+    // its next callers would queue behind a runner that is gone
+    std::cerr << "[Ops] " << macToString(mac) << " " << uuidToString(uuid) << " runner failed: " << failure
+              << std::endl;
+    auto fail = [&failure](const std::vector<CommandContext>& callers) {
+        for (const auto& c : callers) {
+            try {
+                publish_command_result(c, "error", failure);
+            } catch (const std::exception&) {
+            }
+        }
+    };
+    fail(unanswered);
+    for (batch = {}; pending_ops.next(mac, uuid, batch); batch = {}) {
+        if (batch.hasWrite) {
+            fail(batch.superseded);
+            fail({batch.writer});
+        }
+        fail(batch.readers);
+    }
+}
+
+// connect_device, pair_device or disconnect_device once the radio is free
+Task<void> link_command(CommandContext ctx, std::shared_ptr<BLEDevice> dev)
+{
+    RadioSlot slot = co_await admit_command(ctx);
+    if (!slot) co_return;
+    bool ok = ctx.command == "connect_device" ? co_await connect_device_async(dev, 1)
+            : ctx.command == "pair_device"    ? co_await pair_device_async(dev, 1)
+                                              : co_await disconnect_device_async(dev);
+    publish_command_result(ctx, ok ? "ok" : "error", ok ? "" : ctx.command + " failed");
+}
+
+// One chunk of a bulk transfer. Unacknowledged chunks go on the write
+// socket if there is one, backing off while it is full (the controller
+// is out of buffer credits), otherwise as WriteValue commands.
+// Acknowledged chunks first let the socket drain so they cannot overtake
+// it, then go as WriteValue requests.
+Task<bool> send_bulk_chunk(std::shared_ptr<BLEDevice> dev, Uuid128 uuid, std::vector<uint8_t> bytes,
+                           bool acknowledged, bool socket)
+{
+    MacAddr mac = dev->getMac();
+    int64_t waitedMs = 0;
+    if (socket && !acknowledged) {
+        while (true) {
+            auto result = att_reactor.write(mac, uuid, bytes.data(), bytes.size());
+            if (result == AttReactor::WriteResult::Ok) co_return true;
+            if (result != AttReactor::WriteResult::Busy || waitedMs >= BULK_STALL_MS) co_return false;
+            bulk_stats.busy();
+            co_await coro_executor.sleep(BULK_BACKOFF_MS);
+            waitedMs += BULK_BACKOFF_MS;
+        }
+    }
+    while (socket && att_reactor.queuedBytes(mac, uuid) > 0) {
+        if (waitedMs >= BULK_STALL_MS) co_return false;
+        co_await coro_executor.sleep(BULK_BACKOFF_MS);
+        waitedMs += BULK_BACKOFF_MS;
+    }
+
+    auto sent = std::chrono::steady_clock::now();
+    bool ok = co_await write_characteristic_async(*dev, uuid, std::move(bytes), acknowledged);
+    if (ok && acknowledged) bulk_stats.checkpoint(std::chrono::steady_clock::now() - sent);
+    co_return ok;
+}
+
+void publish_bulk_progress(const CommandContext& ctx, const std::string& transferId, MacAddr mac, const Uuid128& uuid,
+                           const BulkTransfer& transfer, std::chrono::steady_clock::time_point started)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    json j;
+    j["origin"] = "ble_handler";
+    j["type"] = "bulk_write_progress";
+    j["transfer"] = transferId;
+    if (!ctx.requestId.empty()) j["request_id"] = ctx.requestId;
+    j["device_mac"] = macToString(mac);
+    j["uuid"] = uuidToString(uuid);
+    j["acked"] = transfer.acked();
+    j["total"] = transfer.total();
+    j["bytes_per_s"] = seconds > 0 ? std::lround((transfer.acked() - transfer.start()) / seconds) : 0;
+    mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j.dump()));
+}
+
+/**********************************************************************
+|   bulk_write_command() streams a large payload to one characteristic |
+|   once the radio is free: chunks of the link's largest write, sent   |
+|   without response in windows closed by an acknowledged write (see   |
+|   bulk_transfer.h). A failed chunk rewinds to the last checkpoint.   |
+|   Progress goes out after checkpoints; the result carries bytes/s,   |
+|   and on failure the resume_offset for the next attempt.             |
+***********************************************************************/
+Task<void> bulk_write_command(CommandContext ctx, std::shared_ptr<BLEDevice> dev, Uuid128 uuid,
+                              std::vector<uint8_t> data, size_t offset, size_t window, size_t chunkHint,
+                              std::string transferId)
+{
+    RadioSlot slot = co_await admit_command(ctx);
+    if (!slot) co_return;
+
+    MacAddr mac = dev->getMac();
+    bool socket = co_await acquire_write_channel(*dev, uuid);
+    size_t chunk = socket ? att_reactor.maxWritePayload(mac, uuid) : chunkHint;
+    BulkTransfer transfer(data.size(), offset, chunk, window);
+    bulk_stats.started();
+    std::cout << "[Bulk] " << transferId << ": " << data.size() - transfer.start() << " bytes to " << macToString(mac)
+              << " in " << chunk << " byte chunks, window " << window << (socket ? ", socket" : ", D-Bus") << std::endl;
+
+    auto started = std::chrono::steady_clock::now();
+    int64_t progressMs = steady_ms();
+    int retries = 0;
+    std::string error;
+    BulkTransfer::Chunk c;
+    while (transfer.next(c)) {
+        std::vector<uint8_t> bytes(data.begin() + c.offset, data.begin() + c.offset + c.len);
+        if (co_await send_bulk_chunk(dev, uuid, std::move(bytes), c.acknowledged, socket)) {
+            transfer.sent(c);
+            if (c.acknowledged && !transfer.done() && steady_ms() - progressMs >= BULK_PROGRESS_MS) {
+                publish_bulk_progress(ctx, transferId, mac, uuid, transfer, started);
+                progressMs = steady_ms();
+            }
+            continue;
+        }
+        if (!dev->getConnected()) {
+            error = "Device disconnected";
+            break;
+        }
+        if (++retries > BULK_RETRIES) {
+            error = "Write failed";
+            break;
+        }
+        bulk_stats.retried();
+        std::cerr << "[Bulk] " << transferId << ": write at " << c.offset << " failed, resuming from "
+                  << transfer.acked() << std::endl;
+        transfer.rewind();
+        socket = att_reactor.hasWrite(mac, uuid);   // the socket may have closed under us
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    uint64_t delivered = transfer.acked() - transfer.start();
+    bulk_stats.finished(error.empty(), delivered, elapsed);
+
+    json result;
+    result["transfer"] = transferId;
+    result["total"] = transfer.total();
+    result["acked"] = transfer.acked();
+    result["bytes"] = delivered;
+    result["chunk"] = chunk;
+    result["window"] = window;
+    result["checkpoints"] = transfer.checkpoints();
+    result["bytes_per_s"] = seconds > 0 ? std::lround(delivered / seconds) : 0;
+    if (!error.empty()) result["resume_offset"] = transfer.acked();
+    std::cout << "[Bulk] " << transferId << ": " << delivered << " bytes in " << std::lround(seconds * 1000)
+              << " ms (" << result["bytes_per_s"] << " B/s)" << (error.empty() ? "" : ", " + error) << std::endl;
+    publish_command_result(ctx, error.empty() ? "ok" : "error", error, result);
+}
+
+// Runs fn on an op worker at the given priority and waits for the result.
+// For threads that do their own radio work (polling, reconnects), so it
+// is admitted against the same budgets as hub commands.
+bool run_radio_op(OpPriority priority, const std::string& command, std::function<bool()> fn)
+{
+    auto done = std::make_shared<std::promise<bool>>();
+    auto result = done->get_future();
+    RadioOp op;
+    op.command = command;
+    op.priority = priority;
+    op.run = [fn = std::move(fn), done]() {
+        bool ok = false;
+        try {
+            ok = fn();
+        } catch (const std::exception& e) {
+            std::cerr << "[Ops] " << e.what() << std::endl;
+        }
+        done->set_value(ok);
+    };
+    if (!radio_ops.submit(std::move(op))) return false;
+    try {
+        return result.get();
+    } catch (const std::future_error&) {
+        return false;  // discarded at shutdown
+    }
+}
+
+// Work that may wait on D-Bus or the disk. The threaded workers can afford
+// to run it inline; in reactor mode it goes to an op worker so the loop
+// never stalls. False if the op queue was full and fn will not run.
+bool run_blocking(const std::string& command, std::function<void()> fn)
+{
+    if (!reactor_mode) {
+        fn();
+        return true;
+    }
+    RadioOp op;
+    op.command = command;
+    op.priority = OpPriority::Normal;
+    op.run = std::move(fn);
+    if (radio_ops.submit(std::move(op))) return true;
+    std::cerr << "[Reactor] " << command << " dropped, op queue full" << std::endl;
+    return false;
+}
+
+/**********************************************************************
+|   start_discovery_session() handles scan_devices_on:                 |
+|   {"command": "scan_devices_on", "session": "pair_ui",               |
+|    "duration_ms": 30000, "min_rssi": -80, "names": ["thermo"],       |
+|    "uuids": ["0000fcd2-0000-1000-8000-00805f9b34fb"], "max_rate": 10}|
+|   Matching devices stream out as scan_result messages. The first     |
+|   session turns discovery on; the periodic discovery cycle is held   |
+|   open until the last one ends. Returns the error if rejected.       |
+***********************************************************************/
+std::string start_discovery_session(const json& j)
+{
+    static std::atomic<uint64_t> serial = 0;
+
+    json j_resp;
+    j_resp["origin"] = "ble_handler";
+    j_resp["type"] = "scan_session";
+    std::string id = j.value("session", "");
+    if (id.empty()) id = "scan_" + std::to_string(++serial);
+    j_resp["session"] = id;
+
+    DiscoveryFilter filter;
+    bool first = false;
+    std::string error = DiscoverySessions::parseFilter(j, filter);
+    if (error.empty()) error = discovery_sessions.start(id, filter, now_ms(), first);
+    if (!error.empty()) {
+        j_resp["state"] = "rejected";
+        j_resp["error"] = error;
+        mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+        return error;
+    }
+    j_resp["state"] = "started";
+    j_resp["duration_ms"] = filter.durationMs;
+    mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+    std::cout << "[Scan] Session " << id << " started, " << discovery_sessions.sessions() << " running" << std::endl;
+
+    if (first) {
+        try {
+            adapter_call("StartDiscovery");
+        } catch (const sdbus::Error& e) {
+            if (e.getName() != "org.bluez.Error.InProgress")
+                std::cerr << "[Scan] StartDiscovery failed: " << e.getName() << " - " << e.getMessage() << std::endl;
+        }
+    }
+
+    // Devices BlueZ already tracks do not announce themselves again; those
+    // with a current RSSI are in range, report them from the object tree
+    ManagedObjects objects;
+    if (!get_managed_objects(objects)) return "";
+    for (const auto& [path, ifaces] : objects) {
+        auto it = ifaces.find(DEVICE_IFACE);
+        if (it == ifaces.end() || !it->second.count("RSSI")) continue;
+        BusEvent ev;
+        if (!macFromPath(path, ev.mac)) continue;
+        decode_device_properties(it->second, ev);
+        offer_sighting(ev, ev.name);
+    }
+    return "";
+}
+
+// scan_devices_off: ends one session, or all of them without "session".
+// Returns the error for an unknown session.
+std::string stop_discovery_session(const json& j)
+{
+    std::vector<DiscoverySummary> ended;
+    if (j.contains("session")) {
+        DiscoverySummary summary;
+        if (discovery_sessions.stop(j.value("session", ""), now_ms(), summary)) {
+            ended.push_back(summary);
+        } else {
+            json j_resp;
+            j_resp["origin"] = "ble_handler";
+            j_resp["type"] = "scan_session";
+            j_resp["session"] = j.value("session", json());
+            j_resp["error"] = "no such session";
+            mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+            return "no such session";
+        }
+    } else {
+        discovery_sessions.stopAll(now_ms(), ended);
+    }
+    publish_discovery({}, ended);
+    return "";
+}
+
+/**********************************************************************
+|   dispatch_command() runs one handler command. It serves both the     |
+|   MQTT input topic and the command scheduler, so scheduled actions    |
+|   behave exactly like commands sent by the hub.                       |
+***********************************************************************/
+void dispatch_command(const json& j)
+{
+    CommandContext ctx;
+    ctx.command = j.value("command", "");
+    ctx.requestId = j.contains("request_id") ? (j.at("request_id").is_string() ? j.at("request_id").get<std::string>()
+                                                                               : j.at("request_id").dump())
+                                             : std::string();
+    ctx.receivedMs = steady_ms();
+    if (int64_t budget = j.value("deadline_ms", int64_t(0)); budget > 0) ctx.deadlineMs = ctx.receivedMs + budget;
+    const std::string& command = ctx.command;
+    TraceSpan span("dispatch", command);
+
+    // Writes are what a person waits on (a lock, a light); the hub can override
+    ctx.priority = command == "write_characteristic" ? OpPriority::Interactive : OpPriority::Normal;
+    if (j.contains("priority") && !parsePriority(j.value("priority", ""), ctx.priority)) {
+        publish_command_result(ctx, "error", "priority must be interactive, normal or background");
+        return;
+    }
+
+    if (command == "add_devices") {
+        for (const auto& mac : j.value("mac", json::array())) {
+            MacAddr key;
+            if (!parse_mac_field(mac, key)) continue;
+            std::cout << "Adding device " << mac << std::endl;
+            add_device(key);
+        }
+        confirm_command(ctx, "");
+        return;
+    }
+    else if (command == "remove_devices") {
+        for (const auto& mac : j.value("mac", json::array())) {
+            MacAddr key;
+            if (!parse_mac_field(mac, key)) continue;
+            std::cout << "Removing device " << mac << std::endl;
+            remove_device(key);
+        }
+        confirm_command(ctx, "");
+        return;
+    }
+    else if (command == "query_devices") {
+        DeviceQuery query;
+        std::string error;
+        if (!DeviceQuery::parse(j, query, error)) {
+            publish_command_result(ctx, "error", error);
+            return;
+        }
+        // Serialized from the shared snapshot, without the registry lock
+        json result;
+        runDeviceQuery(*device_query_snapshot(), query, result);
+        ++queries_served;
+        publish_command_result(ctx, "ok", "", result);
+        return;
+    }
+    else if (command == "print") {
+        // Console dump for debugging; the hub uses query_devices
+        auto snapshot = device_query_snapshot();
+        std::cout << "Device List---\n";
+        for (const auto& r : snapshot->records) {
+            std::cout << "device: " << macToString(r.mac) << std::endl;
+            std::cout << "path: " << r.path << std::endl;
+            std::cout << "discovered: " << r.discovered << std::endl;
+            std::cout << "connected: " << r.connected << std::endl;
+            std::cout << "trusted: " << r.trusted << std::endl;
+            std::cout << "paired: " << r.paired << std::endl;
+            const LinkQuality& q = r.link;
+            if (r.hasLink && q.rssiSamples > 0)
+                std::cout << "rssi: " << std::lround(q.rssiDbm) << " dBm (+/-" << std::lround(q.rssiSpreadDb)
+                          << "), adv interval: " << std::lround(q.advIntervalMs) << " ms, present: "
+                          << q.present << std::endl;
+            std::cout << "characteristics: " << std::endl;
+            for (const auto& uuid : r.uuids) std::cout << "characteristic: " << uuidToString(uuid) << std::endl;
+            std::cout << std::endl;
+        }
+        confirm_command(ctx, "");
+        return;
+    }
+    else if (command == "read_characteristic") {
+        MacAddr macKey = 0;
+        Uuid128 uuidKey;
+        std::shared_ptr<const SchemaIndex> schema;
+        const CharacteristicSchema* chr;
+        std::string error = resolve_characteristic(j, macKey, uuidKey, schema, chr);
+        if (error.empty() && chr && !chr->readable) error = chr->name + " is not readable";
+        if (!error.empty()) {
+            json j_resp;
+            j_resp["origin"] = "ble_handler";
+            j_resp["type"] = "read_characteristic";
+            j_resp["device_mac"] = j.value("mac", j.value("device", ""));
+            j_resp["uuid"] = j.value("uuid", j.value("characteristic", ""));
+            j_resp["error"] = error;
+            if (!ctx.requestId.empty()) j_resp["request_id"] = ctx.requestId;
+            mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+            publish_command_result(ctx, "error", error);
+            return;
+        }
+        std::string mac = macToString(macKey);
+        std::string uuid = uuidToString(uuidKey);
+        std::cout << "Reading characteristic " << uuid 
+                << " from device " << mac << std::endl;
+
+        // The read waits on the executor, not on the MQTT callback; identical
+        // pending reads share it
+        if (pending_ops.submitRead(macKey, uuidKey, ctx)) coro_executor.spawn(characteristic_runner(macKey, uuidKey));
+        return;
+    }
+    else if (command == "write_characteristic") {
+        MacAddr mac = 0;
+        Uuid128 uuid;
+        std::shared_ptr<const SchemaIndex> schema;
+        const CharacteristicSchema* chr;
+        std::vector<uint8_t> bytes;
+        std::string error = resolve_characteristic(j, mac, uuid, schema, chr);
+        if (error.empty() && !j.contains("value")) error = "Missing value";
+        if (error.empty()) error = encode_write_value(j.at("value"), chr, bytes);
+
+        auto dev = error.empty() ? get_device(mac) : nullptr;
+        if (error.empty() && !dev) error = "Device not found";
+        if (!error.empty()) {
+            std::cerr << "Write rejected: " << error << std::endl;
+            json j_resp;
+            j_resp["origin"] = "ble_handler";
+            j_resp["type"] = "write_characteristic";
+            j_resp["device_mac"] = j.value("mac", j.value("device", ""));
+            j_resp["uuid"] = j.value("uuid", j.value("characteristic", ""));
+            j_resp["error"] = error;
+            if (!ctx.requestId.empty()) j_resp["request_id"] = ctx.requestId;
+            mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+            publish_command_result(ctx, "error", error);
+            return;
+        }
+
+        std::cout << "Writing " << j.at("value").dump() << " to characteristic " << uuidToString(uuid) 
+                  << " on device " << macToString(mac) << std::endl;
+        bool withResponse = !j.value("without_response", false) && (!chr || chr->writable);
+        // A newer write to the same characteristic replaces this one if the
+        // radio is still busy when it arrives
+        if (pending_ops.submitWrite(mac, uuid, ctx, std::move(bytes), withResponse))
+            coro_executor.spawn(characteristic_runner(mac, uuid));
+        return;
+    }
+    else if (command == "bulk_write") {
+        MacAddr mac = 0;
+        Uuid128 uuid;
+        std::shared_ptr<const SchemaIndex> schema;
+        const CharacteristicSchema* chr;
+        std::vector<uint8_t> data;
+        std::string error = resolve_characteristic(j, mac, uuid, schema, chr);
+        size_t offset = j.value("offset", size_t(0));
+        size_t window = j.value("window", BULK_WINDOW_CHUNKS);
+        size_t chunk = std::clamp<size_t>(j.value("chunk", ATT_DEFAULT_PAYLOAD), 1, 512);
+        if (error.empty() && (!j.value("data", json()).is_string() || !parse_hex_bytes(j["data"], data) || data.empty()))
+            error = "data must be a non-empty hex string";
+        if (error.empty() && data.size() > BULK_MAX_BYTES)
+            error = "data is larger than " + std::to_string(BULK_MAX_BYTES) + " bytes";
+        if (error.empty() && offset >= data.size()) error = "offset is past the end of data";
+        // Checkpoints need write with response; without write-without-response every chunk is one
+        if (error.empty() && chr && !chr->writable) error = chr->name + " has no write with response for checkpoints";
+        if (chr && !chr->writeWithoutResponse) window = 0;
+
+        auto dev = error.empty() ? get_device(mac) : nullptr;
+        if (error.empty() && !dev) error = "Device not found";
+        if (error.empty() && !dev->getConnected()) error = "Device not connected";
+        if (!error.empty()) {
+            std::cerr << "Bulk write rejected: " << error << std::endl;
+            publish_command_result(ctx, "error", error);
+            return;
+        }
+
+        static std::atomic<uint64_t> serial = 0;
+        std::string transferId = j.value("transfer", ctx.requestId.empty() ? "bulk-" + std::to_string(++serial)
+                                                                            : ctx.requestId);
+        coro_executor.spawn(bulk_write_command(ctx, dev, uuid, std::move(data), offset, window, chunk, transferId));
+        return;
+    }
+    else if (command == "trace") {
+        // start, stop (and write the file) or flush (write, keep tracing)
+        std::string action = j.value("action", "");
+        if (action != "start" && action != "stop" && action != "flush") {
+            publish_command_result(ctx, "error", "action must be start, stop or flush");
+            return;
+        }
+        if (action == "start") {
+            tracer.enable(true);
+            publish_command_result(ctx, "ok", "", {{"tracing", true}});
+            return;
+        }
+        if (action == "stop") tracer.enable(false);
+        bool queued = run_blocking(command, [ctx]() {
+            size_t events = 0;
+            std::string file = flush_trace(events);
+            if (file.empty()) publish_command_result(ctx, "error", "Could not write the trace file");
+            else publish_command_result(ctx, "ok", "", {{"tracing", tracer.on()}, {"file", file}, {"events", events}});
+        });
+        if (!queued) publish_command_result(ctx, "rejected", "Operation queue full");
+        return;
+    }
+    else if (command == "reload_rules") {
+        // Like the next two, may run later on an op worker and confirms when done
+        bool queued = run_blocking(command, [ctx]() {
+            bool ok = rules_engine.reload(schema_store.get(), encode_write_value);
+            json j_resp;
+            j_resp["origin"] = "ble_handler";
+            j_resp["type"] = "reload_rules";
+            j_resp["ok"] = ok;
+            j_resp["rules"] = rules_engine.ruleCount();
+            mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+            confirm_command(ctx, ok ? "" : "Rules reload failed, previous rules kept");
+        });
+        if (!queued) publish_command_result(ctx, "rejected", "Operation queue full");
+        return;
+    }
+    else if (command == "query_history") {
+        bool queued = run_blocking(command, [ctx, j]() {
+            json resp = query_history(j);
+            mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, resp.dump()));
+            confirm_command(ctx, resp.value("error", ""));
+        });
+        if (!queued) publish_command_result(ctx, "rejected", "Operation queue full");
+        return;
+    }
+    else if (command == "scan_devices_on") {
+        bool queued = run_blocking(command, [ctx, j]() {
+            std::string error = start_discovery_session(j);
+            kick_discovery_tick();
+            confirm_command(ctx, error);
+        });
+        if (!queued) publish_command_result(ctx, "rejected", "Operation queue full");
+        return;
+    }
+    else if (command == "scan_devices_off") {
+        confirm_command(ctx, stop_discovery_session(j));
+        return;
+    }
+    else if (command == "connect_device" || command == "pair_device" || command == "disconnect_device") {
+        MacAddr mac;
+        std::shared_ptr<BLEDevice> dev;
+        if (!parse_mac_field(j.value("mac", json()), mac)) {
+            publish_command_result(ctx, "error", "Invalid mac");
+            return;
+        }
+        if (!(dev = get_device(mac))) {
+            publish_command_result(ctx, "error", "Device not found");
+            return;
+        }
+        std::cout << command << " " << macToString(mac) << std::endl;
+        if (command == "disconnect_device") reconnect_supervisor.hold(mac);
+        coro_executor.spawn(link_command(ctx, dev));
+        return;
+    }
+    else if (command == "schedule_add") {
+        json j_resp;
+        std::string error = command_scheduler.add(j.value("schedule", json()), j_resp);
+        if (!error.empty()) {
+            std::cerr << "[Sched] Rejected: " << error << std::endl;
+            j_resp = json{{"id", j.value("schedule", json::object()).value("id", "")}, {"error", error}};
+        }
+        j_resp["origin"] = "ble_handler";
+        j_resp["type"] = "schedule_add";
+        mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+        confirm_command(ctx, error);
+        return;
+    }
+    else if (command == "schedule_remove") {
+        std::string id = j.value("id", "");
+        json j_resp;
+        j_resp["origin"] = "ble_handler";
+        j_resp["type"] = "schedule_remove";
+        j_resp["id"] = id;
+        bool removed = command_scheduler.remove(id);
+        j_resp["ok"] = removed;
+        mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+        confirm_command(ctx, removed ? "" : "No schedule " + id);
+        return;
+    }
+    else if (command == "schedule_list") {
+        json j_resp;
+        j_resp["origin"] = "ble_handler";
+        j_resp["type"] = "schedule_list";
+        j_resp["schedules"] = command_scheduler.list();
+        mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j_resp.dump()));
+        confirm_command(ctx, "");
+        return;
+    }
+    else {
+        std::cerr << "Unknown command: " << command << std::endl;
+        publish_command_result(ctx, "error", "Unknown command");
+        return;
+    }
+}
+
+/**********************************************************************
+|   Passive scanning. The handler exports one AdvertisementMonitor1     |
+|   (or_patterns, see adv_monitor.h) under an ObjectManager root on     |
+|   the signal connection, which is the sender bluetoothd reads the     |
+|   monitors back from, and registers the root with the adapter.        |
+|   Activate() turns the discovery cycle off; Release() or a failed     |
+|   registration turns it back on.                                      |
+***********************************************************************/
+void export_adv_monitor()
+{
+    auto object = sdbus::createObject(*connection, MONITOR_PATH);
+    object->registerMethod("Release").onInterface(MONITOR_IFACE).implementedAs([]() {
+        monitor_active = false;
+        monitor_stats.released();
+        std::cout << "[Monitor] released by bluetoothd, back to discovery cycling" << std::endl;
+    });
+    object->registerMethod("Activate").onInterface(MONITOR_IFACE).implementedAs([]() {
+        monitor_active = true;
+        monitor_stats.activated();
+        std::cout << "[Monitor] active, discovery cycling off" << std::endl;
+    });
+    auto deviceEvent = [](BusEventType type) {
+        return [type](const sdbus::ObjectPath& path) {
+            BusEvent ev;
+            ev.type = type;
+            ev.path = path;
+            if (macFromPath(path, ev.mac)) enqueue_signal(std::move(ev));
+        };
+    };
+    object->registerMethod("DeviceFound").onInterface(MONITOR_IFACE)
+        .implementedAs(deviceEvent(BusEventType::MonitorDeviceFound));
+    object->registerMethod("DeviceLost").onInterface(MONITOR_IFACE)
+        .implementedAs(deviceEvent(BusEventType::MonitorDeviceLost));
+
+    object->registerProperty("Type").onInterface(MONITOR_IFACE).withGetter([]() { return std::string("or_patterns"); });
+    object->registerProperty("RSSILowThreshold").onInterface(MONITOR_IFACE).withGetter([]() { return MONITOR_RSSI.low; });
+    object->registerProperty("RSSIHighThreshold").onInterface(MONITOR_IFACE).withGetter([]() { return MONITOR_RSSI.high; });
+    object->registerProperty("RSSILowTimeout").onInterface(MONITOR_IFACE)
+        .withGetter([]() { return MONITOR_RSSI.lowTimeoutS; });
+    object->registerProperty("RSSIHighTimeout").onInterface(MONITOR_IFACE)
+        .withGetter([]() { return MONITOR_RSSI.highTimeoutS; });
+    object->registerProperty("RSSISamplingPeriod").onInterface(MONITOR_IFACE)
+        .withGetter([]() { return MONITOR_RSSI.samplingPeriod; });
+    object->registerProperty("Patterns").onInterface(MONITOR_IFACE).withGetter([]() {
+        std::vector<sdbus::Struct<uint8_t, uint8_t, std::vector<uint8_t>>> out;
+        std::lock_guard<std::mutex> lock(monitor_mutex);
+        for (const auto& p : monitor_patterns) out.emplace_back(p.start, p.adType, p.content);
+        return out;
+    });
+    object->finishRegistration();
+    monitor_object = std::move(object);
+}
+
+Task<void> register_adv_monitor()
+{
+    auto manager = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, ADAPTER_PATH);
+    try {
+        AwaitableReply<sdbus::Variant> supported(coro_executor);
+        manager->callMethodAsync("Get")
+            .onInterface(PROPERTIES_IFACE)
+            .withArguments(MONITOR_MANAGER_IFACE, std::string("SupportedMonitorTypes"))
+            .uponReplyInvoke(supported.handler());
+        auto [types] = co_await supported.result(bus_pool.latency(BusLane::Control));
+        auto list = types.get<std::vector<std::string>>();
+        if (std::find(list.begin(), list.end(), "or_patterns") == list.end()) {
+            std::cout << "[Monitor] or_patterns not supported, keeping discovery cycling" << std::endl;
+            co_return;
+        }
+
+        size_t patternCount;
+        {
+            std::lock_guard<std::mutex> lock(monitor_mutex);
+            monitor_schema = schema_store.get();
+            monitor_patterns = buildMonitorPatterns(monitor_schema.get());
+            patternCount = monitor_patterns.size();
+        }
+        monitor_root = sdbus::createObject(*connection, MONITOR_ROOT_PATH);
+        monitor_root->addObjectManager();
+        monitor_root->finishRegistration();
+        export_adv_monitor();
+
+        AwaitableReply<> reply(coro_executor);
+        manager->callMethodAsync("RegisterMonitor")
+            .onInterface(MONITOR_MANAGER_IFACE)
+            .withArguments(sdbus::ObjectPath(MONITOR_ROOT_PATH))
+            .uponReplyInvoke(reply.handler());
+        co_await reply.result(bus_pool.latency(BusLane::Control));
+        std::cout << "[Monitor] registered with " << patternCount << " patterns" << std::endl;
+    } catch (const sdbus::Error& e) {
+        // Older bluetoothd (no experimental features) has no monitor manager
+        std::cerr << "[Monitor] not available: " << e.getName() << " - " << e.getMessage() << std::endl;
+        monitor_object.reset();
+        monitor_root.reset();
+    }
+}
+
+// bluetoothd reads the patterns once; a schema with other names replaces the monitor
+void refresh_adv_monitor()
+{
+    auto schema = schema_store.get();
+    std::vector<MonitorPattern> patterns = buildMonitorPatterns(schema.get());
+    {
+        std::lock_guard<std::mutex> lock(monitor_mutex);
+        if (!monitor_object || monitor_schema == schema) return;
+        monitor_schema = schema;
+        if (patterns == monitor_patterns) return;
+        monitor_patterns = std::move(patterns);
+    }
+    monitor_object->emitInterfacesRemovedSignal();
+    monitor_object.reset();
+    monitor_active = false;   // until bluetoothd activates the new one
+    export_adv_monitor();
+    monitor_object->emitInterfacesAddedSignal();
+    std::cout << "[Monitor] patterns changed, monitor replaced" << std::endl;
+}
+
+// Monitor patterns cannot match addresses, and passive scans get no scan
+// responses: a registered device that has not shown up still needs discovery
+bool registered_devices_missing()
+{
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    for (const auto& [mac, dev] : devices)
+        if (!dev->getDiscovered()) return true;
+    return false;
+}
+
+// Starts the periodic discovery window (sessions may already have it on)
+void start_discovery_cycle()
+{
+    if (monitor_active && !registered_devices_missing()) return;
+    try {
+        adapter_call("StartDiscovery");
+    }
+    catch (const sdbus::Error& e) {
+        if (e.getName() != "org.bluez.Error.InProgress")
+            std::cerr << "Faild to start discovery: " << e.getName() << " - " << e.getMessage() << "\n";
+    }
+}
+
+void end_discovery_cycle()
+{
+    // Discovery sessions hold the radio until the last one ends
+    if (discovery_sessions.active()) {
+        std::cout << "[Scan] " << discovery_sessions.sessions() << " sessions running, "
+                  << discovery_sessions.results() << " results from "
+                  << discovery_sessions.sightings() << " sightings" << std::endl;
+    } else {
+        try {
+            adapter_call("StopDiscovery");
+            std::cout << "Scanning reset in 1 second." << std::endl;
+        } catch (const std::exception& ex) {
+            std::cerr << "StopDiscovery failed: " << ex.what() << std::endl;
+        }
+    }
+}
+
+// Between two discovery windows: persist, recompile rules, expire presence
+void run_housekeeping()
+{
+    if (registry_dirty) save_registry_snapshot();
+
+    // Rules name devices and fields from the schema, recompile after a reload
+    // (a rules file that failed to compile is retried once it is written again)
+    if (rules_engine.needsReload(schema_store.get()))
+        rules_engine.reload(schema_store.get(), encode_write_value);
+    refresh_adv_monitor();
+
+    // Collected first: sweep() must not take devicesMutex under its own lock
+    FlatSet<MacAddr> connected;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        for (const auto& [mac, dev] : devices)
+            if (dev->getConnected()) connected.insert(mac);
+    }
+    std::vector<LinkQuality> gone;
+    link_quality.sweep(now_ms(), connected, gone);
+    for (const auto& q : gone) publish_link_quality(q);
+}
+
+/**********************************************************************
+|   print_stats() logs one summary line per cycle. The counters of     |
+|   every subsystem follow only with --stats (or BLE_HANDLER_STATS=1). |
+***********************************************************************/
+void print_stats()
+{
+    // CPU and wakeups since the last report, to compare the two modes
+    ProcessUsage usage = ProcessUsage::sample();
+    double seconds = std::max<int64_t>(usage.wallUs - usage_mark.wallUs, 1) / 1e6;
+    uint64_t switches = usage.voluntarySwitches - usage_mark.voluntarySwitches;
+    double cpuPercent = std::round((usage.cpuUs - usage_mark.cpuUs) / seconds / 1e4 * 10) / 10;
+    size_t deviceCount;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        deviceCount = devices.size();
+    }
+    std::cout << "[Stats] " << deviceCount << " devices, " << signals_applied << " signals ("
+              << signals_dropped << " dropped), " << radio_ops.executed() << " radio ops ("
+              << radio_ops.depth() << " queued), " << coro_executor.inFlight() << " commands in flight, cpu "
+              << cpuPercent << "%" << std::endl;
+    if (!verbose_stats) {
+        usage_mark = usage;
+        if (reactor_mode) {
+            reactor_wakeups_mark = event_reactor.wakeups();
+            reactor_busy_mark = event_reactor.busyUs();
+        }
+        return;
+    }
 
-    // Options map can include "type" = "request" (write with response) or "command" (write without response)
-    std::map<std::string, sdbus::Variant> options;
-    options["type"] = sdbus::Variant(withResponse ? std::string("request") 
-                                                  : std::string("command"));
+    std::cout << "[Signals] received " << signal_queue.pushedCount()
+              << ", applied " << signals_applied
+              << ", coalesced " << signals_coalesced
+              << ", spilled " << signals_spilled
+              << ", dropped " << signals_dropped
+              << ", max batch " << signals_max_batch << std::endl;
+    std::cout << "[Bus] control " << bus_pool.latency(BusLane::Control).summary()
+              << " | io " << bus_pool.latency(BusLane::Io).summary() << std::endl;
+    std::cout << "[History] " << history_store.seriesCount() << " series, "
+              << history_store.samplesAppended() << " samples recorded, queries "
+              << history_query_latency.summary() << std::endl;
+    std::cout << "[Poll] " << poll_scheduler.targets() << " characteristics, "
+              << poll_scheduler.reads() << " reads, " << poll_scheduler.changes() << " changed, "
+              << poll_scheduler.failures() << " skipped" << std::endl;
+    std::cout << "[Rules] " << rules_engine.ruleCount() << " rules, "
+              << rules_engine.evaluations() << " evaluations (mean " << rules_engine.meanEvalNs()
+              << " ns), " << rules_engine.firings() << " fired, reaction "
+              << rules_engine.reactionLatency().summary() << std::endl;
+    std::cout << "[Link] " << link_quality.tracked() << " devices, "
+              << link_quality.observations() << " sightings, "
+              << link_quality.published() << " published" << std::endl;
+    std::cout << "[Sched] " << command_scheduler.size() << " schedules, "
+              << command_scheduler.fired() << " fired, lateness "
+              << command_scheduler.lateness().summary() << std::endl;
+    std::cout << "[Ops] " << radio_ops.executed() << " run, " << radio_ops.expired() << " expired, "
+              << radio_ops.rejected() << " rejected, " << radio_ops.promoted() << " promoted, queued "
+              << radio_ops.depth() << std::endl;
+    std::cout << "[Reconnect] " << reconnect_supervisor.down() << " down, "
+              << reconnect_supervisor.breakersOpen() << " breakers open, "
+              << reconnect_supervisor.outages() << " outages, " << reconnect_supervisor.recoveries()
+              << " recovered in " << reconnect_supervisor.attempts() << " attempts, MTTR "
+              << reconnect_supervisor.meanTimeToRecoverMs() << " ms ("
+              << reconnect_supervisor.timeToRecover().summary() << ")" << std::endl;
+    std::cout << "[GATT] " << gatt_refresh_stats.hits() << " unchanged, " << gatt_refresh_stats.walks()
+              << " walked (" << gatt_refresh_stats.busCalls() << " calls), " << gatt_refresh_stats.failures()
+              << " failed | ready after hit " << gatt_refresh_stats.hitLatency().summary()
+              << " | after walk " << gatt_refresh_stats.walkLatency().summary() << std::endl;
+    std::cout << "[Bulk] " << bulk_stats.transfers() << " transfers (" << bulk_stats.completed() << " ok, "
+              << bulk_stats.failed() << " failed), " << bulk_stats.bytes() << " B at "
+              << std::lround(bulk_stats.bytesPerSecond()) << " B/s, " << bulk_stats.busyRetries() << " busy, "
+              << bulk_stats.rewinds() << " rewinds | checkpoint " << bulk_stats.checkpointLatency().summary()
+              << std::endl;
+    std::cout << "[ATT] " << att_reactor.channels() << " sockets, " << att_reactor.notifications()
+              << " notifications (" << att_reactor.bytesIn() << " B), " << att_reactor.writes()
+              << " writes (" << att_reactor.bytesOut() << " B, " << att_reactor.writesBusy()
+              << " busy), " << att_reactor.closedByPeer() << " closed | dispatch "
+              << att_reactor.dispatchLatency().summary() << std::endl;
+    for (auto p : {OpPriority::Interactive, OpPriority::Normal, OpPriority::Background})
+        std::cout << "[Ops] " << priorityName(p) << " wait " << radio_ops.queueWait(p).summary()
+                  << " | total " << radio_ops.latency(p).summary() << std::endl;
+    std::cout << "[Coro] " << coro_executor.threads() << " threads, " << coro_executor.spawned() << " spawned, "
+              << coro_executor.inFlight() << " in flight (peak " << coro_executor.peakInFlight() << "), "
+              << coro_executor.resumes() << " resumes, " << coro_executor.timedOut() << " timed out" << std::endl;
+    if (ownership)
+        std::cout << "[Owner] " << instance_id << ": " << ownership->ownedCount() << " devices held, "
+                  << ownership->peers() << " peers, " << ownership->acquired() << " acquired, "
+                  << ownership->released() << " released (" << ownership->conflicts() << " conflicts), "
+                  << commands_forwarded << " commands forwarded" << std::endl;
+    std::cout << "[Monitor] " << (monitor_active ? "active" : "off (discovery cycling)") << ", "
+              << monitor_stats.devicesFound() << " found, " << monitor_stats.devicesLost() << " lost, "
+              << monitor_stats.foreign() << " foreign, " << monitor_stats.activations() << " activations, "
+              << monitor_stats.releases() << " releases" << std::endl;
+    std::cout << "[Coalesce] " << pending_ops.writes() << " writes (" << pending_ops.writesCollapsed()
+              << " collapsed), " << pending_ops.reads() << " reads (" << pending_ops.readsMerged() << " merged), "
+              << pending_ops.batches() << " radio batches, " << pending_ops.active() << " active" << std::endl;
+    std::cout << "[Query] " << queries_served << " queries, " << query_snapshots_built << " snapshots built"
+              << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(mqtt_mutex);
+        std::cout << "[State] " << device_states.devices() << " devices, " << device_states.changes()
+                  << " changes, " << device_states.unchanged() << " unchanged suppressed | aliases "
+                  << topic_aliases.bound() << "/" << topic_aliases.maximum() << ", " << topic_aliases.aliased()
+                  << " aliased publishes, " << topic_aliases.bytesSaved() << " topic bytes saved" << std::endl;
+    }
 
-    try {
-        // Perform the WriteValue call
-        characteristicProxy->callMethod("WriteValue")
-            .onInterface(Characteristic_IFACE)
-            .withArguments(value, options);
-    } 
-    catch (const sdbus::Error& e) {
-        std::cerr << "Faild to ReadValue: " << e.getName() << " - " << e.getMessage() << "\n";
-        return false;
+    std::cout << "[Trace] " << (tracer.on() ? "on" : "off") << ", " << tracer.threads() << " threads, "
+              << tracer.recorded() << " events recorded, " << tracer.lost() << " overwritten before a flush, "
+              << tracer.flushes() << " flushes" << std::endl;
+
+    std::cout << "[Proc] " << (reactor_mode ? "reactor" : "threaded") << " mode, cpu " << cpuPercent << "%, "
+              << std::lround(switches / seconds) << " wakeups/s ("
+              << usage.involuntarySwitches - usage_mark.involuntarySwitches << " preempted)" << std::endl;
+    if (reactor_mode) {
+        uint64_t wakeups = event_reactor.wakeups();
+        uint64_t busyUs = event_reactor.busyUs();
+        std::cout << "[Reactor] " << std::lround((wakeups - reactor_wakeups_mark) / seconds) << " loop wakeups/s, "
+                  << event_reactor.fdEvents() << " bus events, " << event_reactor.timersFired() << " timers, "
+                  << event_reactor.posted() << " posted, busy "
+                  << std::round((busyUs - reactor_busy_mark) / seconds / 1e4 * 10) / 10 << "%" << std::endl;
+        reactor_wakeups_mark = wakeups;
+        reactor_busy_mark = busyUs;
     }
-    return true;
+    usage_mark = usage;
 }
 
-std::vector<uint8_t> hexStringToBytesLE(const std::string& hex)
+// Commands from MQTT and the scheduler; in reactor mode they run on the loop
+void handle_command(const json& j)
 {
-    std::vector<uint8_t> bytes;
-    for (size_t i = 0; i < hex.size(); i += 2) {
-        std::string byteStr = hex.substr(i, 2);
-        uint8_t byte = static_cast<uint8_t>(std::stoul(byteStr, nullptr, 16));
-        bytes.push_back(byte);
+    if (!reactor_mode) {
+        dispatch_command(j);
+        return;
     }
+    event_reactor.post([j]() {
+        try {
+            dispatch_command(j);
+        } catch (const std::exception& e) {
+            std::cerr << "[Reactor] Command failed: " << e.what() << std::endl;
+        }
+    });
+}
 
-    // Reverse for little endian {low byte first}
-    //std::reverse(bytes.begin(), bytes.end());
-    return bytes;
+/**********************************************************************
+|   Scale-out. With --instance <id> several handlers share the broker,  |
+|   one per Bluetooth host. Commands arrive on a shared subscription, so|
+|   each reaches one instance; every instance also listens on its own   |
+|   topic, on the registry broadcast and on the ownership gossip. Which |
+|   instance holds a device (connects, heals, reports it) is decided by |
+|   DeviceOwnership from the RSSI bids in the gossip.                   |
+***********************************************************************/
+bool owns_device(MacAddr mac)
+{
+    return !ownership || ownership->owns(mac);
+}
+
+// The device a command is for, if it names exactly one
+bool command_target(const json& j, MacAddr& mac)
+{
+    if (j.contains("mac") && j["mac"].is_string()) return parseMac(j["mac"].get<std::string>(), mac);
+    if (j.contains("device") && j["device"].is_string()) {
+        auto schema = schema_store.get();
+        const DeviceSchema* dev = schema ? schema->findDevice(j["device"].get<std::string>()) : nullptr;
+        if (dev && dev->macAddr) {
+            mac = dev->macAddr;
+            return true;
+        }
+    }
+    return false;
+}
+
+void forward_command(const json& j, const std::string& topic)
+{
+    json copy = j;
+    copy["forwarded_by"] = instance_id;
+    mqtt_publish(mqtt::make_message(topic, copy.dump(), 1, false));
+}
+
+// True if this instance runs the command. Registry changes are passed on
+// to every instance; device commands go to the holder of the device.
+// Commands that were already routed (or came in on our own topics) stay.
+bool route_command(const json& j, const std::string& topic)
+{
+    if (!ownership || topic != INPUT_TOPIC || j.contains("forwarded_by")) return true;
+
+    std::string command = j.value("command", "");
+    if (command == "add_devices" || command == "remove_devices") {
+        forward_command(j, BROADCAST_TOPIC);
+        return true;
+    }
+    MacAddr mac = 0;
+    if (!command_target(j, mac)) return true;
+    std::string owner = ownership->owner(mac);
+    if (owner.empty() || owner == instance_id) return true;   // unclaimed: try it here
+
+    forward_command(j, INSTANCE_TOPIC_PREFIX + owner);
+    commands_forwarded++;
+    return false;
+}
+
+// {"instance", "bids": {mac: rssi}, "owned": [mac]} or {"instance", "gone": true}
+void on_ownership_gossip(const json& j)
+{
+    std::string peer = j.value("instance", "");
+    if (peer.empty() || peer == instance_id) return;
+    if (j.value("gone", false)) {
+        ownership->peerGone(peer);
+        std::cout << "[Owner] instance " << peer << " left" << std::endl;
+        return;
+    }
+
+    std::vector<OwnershipBid> bids;
+    std::vector<MacAddr> owned;
+    MacAddr mac;
+    if (auto it = j.find("bids"); it != j.end() && it->is_object())
+        for (const auto& [text, rssi] : it->items())
+            if (rssi.is_number_integer() && parseMac(text, mac)) bids.push_back(OwnershipBid{mac, rssi.get<int16_t>()});
+    if (auto it = j.find("owned"); it != j.end() && it->is_array())
+        for (const auto& text : *it)
+            if (text.is_string() && parseMac(text.get<std::string>(), mac)) owned.push_back(mac);
+    ownership->peerUpdate(peer, bids, owned, steady_ms());
+}
+
+void apply_ownership_change(const DeviceOwnership::Decision& d)
+{
+    bool acquired = d.change == DeviceOwnership::Change::Acquired;
+    std::cout << "[Owner] " << macToString(d.mac) << (acquired ? " acquired" : " released");
+    if (!d.peer.empty()) std::cout << " to " << d.peer;
+    std::cout << std::endl;
+
+    json j;
+    j["origin"] = "ble_handler";
+    j["type"] = "device_owner";
+    j["device_mac"] = macToString(d.mac);
+    j["instance"] = instance_id;
+    j["state"] = acquired ? "acquired" : "released";
+    if (!d.peer.empty()) j["to"] = d.peer;
+    mqtt_publish(mqtt::make_message(OUTPUT_TOPIC, j.dump()));
+
+    // The retained state is ours to keep now, or the new holder's
+    if (!acquired) device_states.erase(d.mac);
+    auto dev = get_device(d.mac);
+    if (!dev) return;
+    if (acquired) {
+        publish_device_state(dev, "device_update");
+        // The supervisor connects it, with its backoff and breaker
+        if (!dev->getConnected()) {
+            reconnect_supervisor.disconnected(d.mac, steady_ms());
+            kick_reconnect_worker();
+        }
+        return;
+    }
+    reconnect_supervisor.forget(d.mac);
+    if (dev->getConnected()) {
+        coro_executor.spawn([](std::shared_ptr<BLEDevice> dev) -> Task<void> {
+            RadioSlot slot = co_await admit_radio("handoff_disconnect", OpPriority::Normal);
+            if (slot) co_await disconnect_device_async(dev);
+        }(dev));
+    }
+}
+
+// Decides with this instance's bids, applies the changes and gossips
+void ownership_tick()
+{
+    // Heard recently, or connected (a connected device stops advertising)
+    std::vector<OwnershipBid> local;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        for (const auto& [mac, dev] : devices) {
+            LinkQuality q;
+            bool heard = link_quality.get(mac, q) && q.present && q.rssiSamples > 0;
+            bool connected = dev->getConnected();
+            if (!heard && !connected) continue;
+            int16_t rssi = q.rssiSamples > 0 ? static_cast<int16_t>(std::lround(q.rssiDbm)) : dev->getRssi();
+            local.push_back(OwnershipBid{mac, rssi, connected});
+        }
+    }
+
+    std::vector<DeviceOwnership::Decision> changes;
+    ownership->evaluate(local, steady_ms(), changes);
+    for (const auto& d : changes) apply_ownership_change(d);
+
+    json j;
+    j["instance"] = instance_id;
+    j["bids"] = json::object();
+    for (const auto& b : local) j["bids"][macToString(b.mac)] = b.rssi;
+    j["owned"] = json::array();
+    for (MacAddr mac : ownership->ownedDevices()) j["owned"].push_back(macToString(mac));
+    mqtt_publish(mqtt::make_message(OWNERSHIP_TOPIC, j.dump()));
+}
+
+// Writes the buffered trace events to a new file under ./data; the file
+// name, empty if it could not be written
+std::string flush_trace(size_t& events)
+{
+    std::string file = TRACE_PATH_PREFIX + std::to_string(now_ms()) + ".json";
+    if (!tracer.flush(file, events)) {
+        std::cerr << "[Trace] Could not write " << file << std::endl;
+        return std::string();
+    }
+    std::cout << "[Trace] " << events << " events written to " << file << std::endl;
+    return file;
+}
+
+// SIGUSR1 flushes the trace (kill -USR1 <pid>). The signal is blocked in
+// every thread and taken here, so the flush runs as normal code.
+void trace_signal_worker()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    timespec timeout{0, 500 * 1000 * 1000};
+    while (!trace_signal_stop) {
+        if (sigtimedwait(&set, nullptr, &timeout) != SIGUSR1) continue;
+        size_t events = 0;
+        flush_trace(events);
+    }
+}
+
+void ownership_worker()
+{
+    std::unique_lock<std::mutex> lock(ownership_mutex);
+    while (!ownership_worker_stop) {
+        lock.unlock();
+        ownership_tick();
+        lock.lock();
+        ownership_cv.wait_for(lock, std::chrono::milliseconds(OWNERSHIP_GOSSIP_MS),
+                              []() { return ownership_worker_stop.load(); });
+    }
+}
+
+// Single instance: the command topic. Scale-out: the shared command topic,
+// this instance's topic, the registry broadcast and the gossip; our own
+// broadcasts and gossip are not sent back (no local)
+void subscribe_topics(bool wait)
+{
+    std::vector<mqtt::token_ptr> tokens;
+    if (!ownership) {
+        tokens.push_back(client->subscribe(INPUT_TOPIC, 1));
+    } else {
+        mqtt::subscribe_options noLocal(true);
+        tokens.push_back(client->subscribe(SHARED_INPUT_TOPIC, 1));
+        tokens.push_back(client->subscribe(INSTANCE_TOPIC_PREFIX + instance_id, 1));
+        tokens.push_back(client->subscribe(BROADCAST_TOPIC, 1, noLocal, mqtt::properties()));
+        tokens.push_back(client->subscribe(OWNERSHIP_TOPIC, 0, noLocal, mqtt::properties()));
+    }
+    if (wait)
+        for (auto& t : tokens) t->wait();
+}
+
+/**********************************************************************
+|   Reactor mode (--reactor). The signal connection, the timers that   |
+|   the worker threads used to sleep on (discovery cycle, polling,     |
+|   reconnect backoff, session ticks) and the commands all run on one  |
+|   event loop on the main thread. Anything that blocks (D-Bus calls,  |
+|   snapshot writes) goes to the op workers and posts back.            |
+***********************************************************************/
+EventReactor::TimerId poll_timer = EventReactor::INVALID_TIMER;
+EventReactor::TimerId reconnect_timer = EventReactor::INVALID_TIMER;
+EventReactor::TimerId discovery_tick_timer = EventReactor::INVALID_TIMER;
+
+void reactor_discovery_cycle()
+{
+    run_blocking("discovery_start", start_discovery_cycle);
+    event_reactor.after(DISCOVERY_WINDOW_MS, []() {
+        run_blocking("discovery_stop", end_discovery_cycle);
+        event_reactor.after(DISCOVERY_PAUSE_MS, []() {
+            run_blocking("housekeeping", run_housekeeping);
+            print_stats();
+            reactor_discovery_cycle();
+        });
+    });
+}
+
+// Session ticks only while a session runs, so an idle loop stays asleep
+void arm_discovery_tick()
+{
+    if (discovery_tick_timer != EventReactor::INVALID_TIMER || !discovery_sessions.active()) return;
+    discovery_tick_timer = event_reactor.after(DISCOVERY_TICK_MS, []() {
+        discovery_tick_timer = EventReactor::INVALID_TIMER;
+        tick_discovery_sessions();
+        arm_discovery_tick();
+    });
+}
+
+void kick_discovery_tick()
+{
+    if (reactor_mode) event_reactor.post(arm_discovery_tick);
+}
+
+void reactor_poll_tick();
+
+void arm_poll_timer()
+{
+    event_reactor.cancel(poll_timer);
+    // Wake at least once a second for resyncs, like the poll worker
+    int64_t wait = std::clamp<int64_t>(poll_scheduler.nextDueMs() - steady_ms(), 1, 1000);
+    poll_timer = event_reactor.after(wait, reactor_poll_tick);
+}
+
+// One op per device batch; the reads run on a worker, the scheduler is
+// only touched on the loop
+void submit_poll_batch(MacAddr mac, const std::vector<Uuid128>& batch)
+{
+    using Read = std::pair<Uuid128, std::optional<std::vector<uint8_t>>>;
+    auto reads = std::make_shared<std::vector<Read>>();
+    for (const auto& uuid : batch) {
+        // Streaming over a notify socket; the read would only repeat it
+        if (att_reactor.hasNotify(mac, uuid)) poll_scheduler.complete(mac, uuid, steady_ms(), nullptr);
+        else reads->emplace_back(uuid, std::nullopt);
+    }
+    if (reads->empty()) return;
+
+    auto finish = [mac, reads]() {
+        for (const auto& [uuid, value] : *reads)
+            if (poll_scheduler.complete(mac, uuid, steady_ms(), value ? &*value : nullptr))
+                publish_poll_update(mac, uuid, *value);
+        arm_poll_timer();
+    };
+    RadioOp op;
+    op.command = "poll_read";
+    op.priority = OpPriority::Background;
+    op.run = [mac, reads, finish]() {
+        auto dev = get_device(mac);
+        std::vector<uint8_t> value;
+        for (auto& [uuid, result] : *reads) {
+            if (!dev || !dev->getConnected()) break;
+            if (read_characteristic_value(*dev, uuid, value)) result = value;
+        }
+        event_reactor.post(finish);
+    };
+    if (!radio_ops.submit(std::move(op))) finish();
+}
+
+void reactor_poll_tick()
+{
+    static std::shared_ptr<const SchemaIndex> synced;
+    static std::vector<Uuid128> batch;
+
+    poll_timer = EventReactor::INVALID_TIMER;
+    resync_poll_targets(synced);
+    MacAddr mac = 0;
+    while (poll_scheduler.takeDue(steady_ms(), mac, batch)) submit_poll_batch(mac, batch);
+    arm_poll_timer();
+}
+
+// Also posted by kick_reconnect_worker() whenever the supervisor changes
+void reactor_reconnect_tick()
+{
+    static std::vector<MacAddr> due;
+
+    due.clear();
+    reconnect_supervisor.takeDue(steady_ms(), due);
+    for (MacAddr mac : due) submit_reconnect(mac);
+
+    event_reactor.cancel(reconnect_timer);
+    reconnect_timer = EventReactor::INVALID_TIMER;
+    int64_t next = reconnect_supervisor.nextWakeMs();
+    if (next != INT64_MAX)
+        reconnect_timer = event_reactor.after(std::max<int64_t>(next - steady_ms(), 1), reactor_reconnect_tick);
+}
+
+void reactor_ownership_tick()
+{
+    ownership_tick();
+    event_reactor.after(OWNERSHIP_GOSSIP_MS, reactor_ownership_tick);
+}
+
+uint32_t epoll_events(short pollEvents)
+{
+    return ((pollEvents & POLLIN) ? static_cast<uint32_t>(EPOLLIN) : 0u) |
+           ((pollEvents & POLLOUT) ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+}
+
+// Dispatches every message sdbus has read or can read without blocking
+void drain_bus()
+{
+    while (connection->processPendingRequest()) {}
+}
+
+void start_reactor()
+{
+    // The signal connection: readiness runs the callbacks, which fill the
+    // signal queue; before every wait the queue is applied in one batch and
+    // sdbus says how long it may sleep and what to watch for
+    auto bus = connection->getEventLoopPollData();
+    static uint32_t watched = epoll_events(bus.events);
+    event_reactor.watch(bus.fd, watched, [](uint32_t) { drain_bus(); });
+    event_reactor.addPrepareHook([fd = bus.fd](int64_t) -> int64_t {
+        static FlatMap<MacAddr, BusEvent> pending;
+        static uint64_t reportedDrops = 0;
+
+        drain_bus();
+        size_t count = drain_signal_batch(pending, reportedDrops);
+        arm_discovery_tick();
+
+        auto poll = connection->getEventLoopPollData();
+        if (uint32_t events = epoll_events(poll.events); events != watched && event_reactor.modify(fd, events))
+            watched = events;
+        if (count == SIGNAL_BATCH_MAX) return 0;   // more queued, come straight back
+        return poll.getPollTimeout();
+    });
+
+    reactor_discovery_cycle();
+    reactor_poll_tick();
+    reactor_reconnect_tick();
+    if (ownership) reactor_ownership_tick();
+    std::cout << "[Reactor] Running, bus fd " << bus.fd << std::endl;
 }
 
 class callback : public virtual mqtt::callback
@@ -1116,14 +4258,24 @@ public:
     // --- Called when connected or reconnected ---
     void connected(const std::string& cause) override {
         std::cout << "[MQTT] Connected: " << cause << std::endl;
+        {
+            // Aliases do not outlive the network connection
+            std::lock_guard<std::mutex> lock(mqtt_mutex);
+            topic_aliases.reset(topic_alias_max);
+        }
         mqtt_connected = true;
         try {
             // Resubscribe (important if broker reset)
-            client.subscribe(INPUT_TOPIC, 1);
-            std::cout << "[MQTT] Subscribed to topic: " << INPUT_TOPIC << std::endl;
+            subscribe_topics(false);
+            std::cout << "[MQTT] Subscribed to topic: " << (ownership ? SHARED_INPUT_TOPIC : INPUT_TOPIC) << std::endl;
         } catch (const mqtt::exception& e) {
             std::cerr << "[MQTT] Subscribe failed: " << e.what() << std::endl;
         }
+        try {
+            republish_device_states();
+        } catch (const std::exception& e) {
+            std::cerr << "[MQTT] Republishing device states failed: " << e.what() << std::endl;
+        }
     }
 
     // --- Called when connection is lost ---
@@ -1136,12 +4288,23 @@ public:
     // Called when a message arrives on a subscribed topic
     void message_arrived(mqtt::const_message_ptr msg) override {
         try {
+            // Gossip comes from every peer every few seconds, keep it out of the log
+            if (ownership && msg->get_topic() == OWNERSHIP_TOPIC) {
+                on_ownership_gossip(json::parse(msg->to_string()));
+                return;
+            }
+
+            TraceSpan span("mqtt_receive", msg->get_topic());
             std::cout << "Message received on topic '" 
                       << msg->get_topic() << "': " 
                       << msg->to_string() << std::endl;
 
             // Parse JSON
-            auto j = json::parse(msg->to_string());
+            json j;
+            {
+                TraceSpan parse("json_parse");
+                j = json::parse(msg->to_string());
+            }
 
             if (!j.contains("command")) {
                 std::cerr << "No command found in message!" << std::endl;
@@ -1153,116 +4316,10 @@ public:
             // Dispatch logic based on command type
             if (command == "exit") {
                 exit = true;
+                if (reactor_mode) event_reactor.stop();
             }
-            else if (command == "add_devices") {
-                for (const auto& mac : j["mac"]) {
-                    std::cout << "Adding device " << mac << std::endl;
-                    add_device(mac);
-                }
-            }
-            else if (command == "remove_devices") {
-                for (const auto& mac : j["mac"]) {
-                    std::cout << "Removing device " << mac << std::endl;
-                    remove_device(mac);
-                }
-            }
-            else if (command == "print") {
-                std::cout << "Device List---\n";
-                {
-                    std::lock_guard<std::mutex> lock(devicesMutex);
-                    for(const auto& device : devices)
-                    {
-                        std::cout << "device: " << device.second->getAddress() << std::endl;
-                        std::cout << "path: " << device.second->getPath() << std::endl;
-                        std::cout << "discovered: " << device.second->getDiscovered() << std::endl;
-                        std::cout << "connected: " << device.second->getConnected() << std::endl;
-                        std::cout << "trusted: " << device.second->getTrusted() << std::endl;
-                        std::cout << "paired: " << device.second->getPaired() << std::endl;
-                        std::cout << "characteristics: " << std::endl;
-                        for(const auto& [uuid, path] : device.second->getCharacteristics())
-                        {
-                            std::cout << "characteristic: " << uuid << "- " << path << std::endl;
-                        }
-                        std::cout  << std::endl;
-                    }
-                }
-            }
-            else if (command == "read_characteristic") {
-                std::string mac = j["mac"];
-                std::string uuid = j["uuid"];
-                std::cout << "Reading characteristic " << uuid 
-                        << " from device " << mac << std::endl;
-
-                // Run BLE read in a separate thread to avoid blocking the MQTT callback
-                std::thread([this, mac, uuid]() {
-                    auto dev = get_device(mac);
-                    if (!dev) {
-                        std::cerr << "Device " << mac << " not found" << std::endl;
-                        return;
-                    }
-
-                    // Check if device is connected before attempting read
-                    if (!dev->getConnected()) {
-                        json j_resp;
-                        j_resp["origin"] = "ble_handler";
-                        j_resp["type"] = "read_characteristic";
-                        j_resp["device_mac"] = mac;
-                        j_resp["uuid"] = uuid;
-                        j_resp["error"] = "Device not connected";
-                        mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j_resp.dump());
-                        mqtt_publish(pubmsg);
-                        return;
-                    }
-
-                    std::string response;
-                    try {
-                        response = ReadCharacteristic(*dev, uuid);  // already returns JSON string
-                    } catch (const std::exception& e) {
-                        json j_resp;
-                        j_resp["origin"] = "ble_handler";
-                        j_resp["type"] = "read_characteristic";
-                        j_resp["device_mac"] = mac;
-                        j_resp["uuid"] = uuid;
-                        j_resp["error"] = e.what();
-                        mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j_resp.dump());
-                        mqtt_publish(pubmsg);
-                        return;
-                    }
-
-                    // Publish asynchronously
-                    mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, response);
-                    mqtt_publish(pubmsg);
-                }).detach();  // detach thread
-            }
-            else if (command == "write_characteristic") {
-                std::string mac = j["mac"];
-                std::string uuid = j["uuid"];
-                std::string value = j["value"];
-                std::cout << "Writing " << value << " to characteristic " << uuid 
-                          << " on device " << mac << std::endl;
-                auto bytes = hexStringToBytesLE(value);
-                WriteCharacteristic(*get_device(mac), uuid, bytes);
-            }
-            else if (command == "scan_devices_on") {
-                std::cout << "Scanning devices..." << std::endl;
-                // Start scanning logic
-            }
-            else if (command == "scan_devices_off") {
-                std::cout << "Scanning devices stop" << std::endl;
-                // Stop scanning logic
-            }
-            else if (command == "connect_device") {
-                std::string mac = j["mac"];
-                std::cout << "Connecting device " << mac << std::endl;
-                connectDevice(get_device(mac), 1);
-            }
-            else if (command == "pair_device") {
-                std::string mac = j["mac"];
-                std::cout << "Pairing device " << mac << std::endl;
-                pairDevice(get_device(mac), 1);
-            }
-            else {
-                std::cerr << "Unknown command: " << command << std::endl;
+            else if (route_command(j, msg->get_topic())) {
+                handle_command(j);
             }
 
         } catch (const json::exception& e) {
@@ -1275,87 +4332,70 @@ public:
 
 int main(int argc, char* argv[])
 {
+    bool coldStart = false; // --cold-start ignores the registry snapshot
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--cold-start") coldStart = true;
+        if (std::string(argv[i]) == "--reactor") reactor_mode = true;
+        if (std::string(argv[i]) == "--instance" && i + 1 < argc) instance_id = argv[++i];
+        if (std::string(argv[i]) == "--trace") tracer.enable(true);
+        if (std::string(argv[i]) == "--stats") verbose_stats = true;
+    }
+    if (instance_id.empty())
+        if (const char* env = std::getenv("BLE_HANDLER_INSTANCE")) instance_id = env;
+    if (const char* env = std::getenv("BLE_HANDLER_TRACE"); env && *env && std::string(env) != "0") tracer.enable(true);
+    if (const char* env = std::getenv("BLE_HANDLER_STATS"); env && *env && std::string(env) != "0") verbose_stats = true;
+
+    // Before any thread starts, so that they all inherit the mask and
+    // SIGUSR1 only reaches trace_signal_worker
+    sigset_t traceSignals;
+    sigemptyset(&traceSignals);
+    sigaddset(&traceSignals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &traceSignals, nullptr);
+    std::thread traceSignalThread(trace_signal_worker);
+
+    // Instances need their own client id. MQTT v5 for topic aliases, and
+    // with instances for the shared subscription and no-local
+    if (!instance_id.empty()) ownership = std::make_unique<DeviceOwnership>(instance_id, steady_ms());
+    client = std::make_unique<mqtt::async_client>(SERVER_ADDRESS, ownership ? CLIENT_ID + "-" + instance_id : CLIENT_ID,
+                                                  mqtt::create_options(MQTTVERSION_5));
+    if (reactor_mode && !event_reactor.open()) reactor_mode = false;
+
+    schema_store.reload();
+    schema_store.startWatching();
+
+    bus_pool.open(BUS_IO_CONNECTIONS);
+    coro_executor.start(CORO_THREADS);
+    rules_engine.reload(schema_store.get(), encode_write_value);
+
     auto Proxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, "/");
     Proxy->uponSignal("InterfacesAdded")
         .onInterface(DBUS_OM_IFACE)
         .call([](const sdbus::ObjectPath& path,
                 const std::map<std::string, std::map<std::string, sdbus::Variant>>& ifaces) {
+            MacAddr mac;
+            if (!macFromPath(path, mac))
+                return;
+
             if (auto it = ifaces.find(DEVICE_IFACE); it != ifaces.end())
             {
-                // Device discovered
-                const auto& props = it->second;
-                if (props.count("Address"))
-                {
-                    std::shared_ptr<BLEDevice> dev;
-                    auto mac = props.at("Address").get<std::string>();
-                    {
-                        std::lock_guard<std::mutex> lock(devicesMutex);
-                        auto devMap = devices.find(mac);
-                        if(devMap == devices.end()) return;
-                        dev = devMap->second;
-                    }
-
-                    dev->setPath        (path);
-                    dev->setName        (props.count("Name") ? props.at("Name").get<std::string>() : "");
-                    dev->setDiscovered  (true);
-                    dev->setConnected   (props.count("Connected") ? props.at("Connected").get<bool>() : false);
-                    dev->setPaired      (props.count("Paired") ? props.at("Paired").get<bool>() : false);
-                    dev->setTrusted     (props.count("Trusted") ? props.at("Trusted").get<bool>() : false);
-
-                    //---create signal handler---
-                    std::shared_ptr<sdbus::IProxy> proxy = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, path);
-                    dev->setProxy(proxy);
-
-                    // Capture weak_ptr to device so handler won’t access dangling memory
-                    std::weak_ptr<BLEDevice> weakDev = dev;
-                    std::weak_ptr<sdbus::IConnection> weakCon = connection;
-
-                    dev->proxy->uponSignal("PropertiesChanged")
-                        .onInterface(PROPERTIES_IFACE)
-                        .call([weakDev, weakCon](const std::string& interface,
-                                const std::map<std::string, sdbus::Variant>& changed,
-                                const std::vector<std::string>& invalidated) {
-                            handleDevicePropertiesChanged(weakDev, weakCon, interface, changed, invalidated);
-                    });
-                    dev->proxy->finishRegistration();
-
-                    // publish "device added"
-                    std::cout << "device discovered: " << path << std::endl;
-                    json j;
-                    j["origin"] = "ble_handler";
-                    j["type"] = "device_update";
-                    j["device_mac"] = dev->address;
-                    j["name"] = dev->name;
-                    j["discovered"] = dev->discovered;
-                    j["connected"] = dev->connected;
-                    j["paired"] = dev->paired;
-                    j["trusted"] = dev->trusted;
-
-                    mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
-                    mqtt_publish(pubmsg);
-                }
+                // Device discovered, the worker ignores it unless it is registered
+                BusEvent ev;
+                ev.type = BusEventType::DeviceAdded;
+                ev.mac  = mac;
+                ev.path = path;
+                decode_device_properties(it->second, ev);
+                enqueue_signal(std::move(ev));
             }
             else if (auto it = ifaces.find(Characteristic_IFACE); it != ifaces.end())
             {
-                auto pos = path.find("dev_");
-                if (pos == std::string::npos)
-                    return;
-
-                std::string mac = path.substr(pos + 4, 17); // skip "dev_"
-                std::replace(mac.begin(), mac.end(), '_', ':');
-
-                std::shared_ptr<BLEDevice> dev;
-                {
-                    std::lock_guard<std::mutex> lock(devicesMutex);
-                    auto devMap = devices.find(mac);
-                    if(devMap == devices.end()) return;
-                    dev = devMap->second;
-                }
-
                 const auto& props = it->second;
-                if (auto itUuid = props.find("UUID"); itUuid != props.end()) {
-                    std::string uuid = itUuid->second.get<std::string>();
-                    dev->addCharacteristics(uuid, path);
+                BusEvent ev;
+                ev.type = BusEventType::CharacteristicAdded;
+                ev.mac  = mac;
+                ev.path = path;
+                if (auto itUuid = props.find("UUID"); itUuid != props.end() &&
+                    parseUuid(itUuid->second.get<std::string>(), ev.uuid)) {
+                    enqueue_signal(std::move(ev));
                 }
             }
     });
@@ -1363,138 +4403,216 @@ int main(int argc, char* argv[])
         .onInterface(DBUS_OM_IFACE)
         .call([](const sdbus::ObjectPath& path,
                  const std::vector<std::string>& interfaces) {
+            MacAddr mac;
+            if (!macFromPath(path, mac))
+                return;
+
             for(const auto& iface : interfaces)
             {
-                if(iface == DEVICE_IFACE)
-                {
-                    auto pos = path.find("dev_");
-                    if (pos == std::string::npos)
-                        return;
-
-                    std::string mac = path.substr(pos + 4); // skip "dev_" and after mac
-                    std::replace(mac.begin(), mac.end(), '_', ':');
-                    
-                    std::shared_ptr<BLEDevice> dev;
-                    {
-                        std::lock_guard<std::mutex> lock(devicesMutex);
-                        auto devMap = devices.find(mac);
-                        if(devMap == devices.end()) return;
-                        dev = devMap->second;
-                    }
-                    dev->setConnected(false);
-                    dev->setPaired(false);
-                    dev->setDiscovered(false);
-                    dev->getProxy().reset();
-
-                    std::cout << "device undiscovered: " << path << std::endl;
-                    json j;
-                    j["origin"] = "ble_handler";
-                    j["type"] = "device_update";
-                    j["device_mac"] = dev->address;
-                    j["name"] = dev->name;
-                    j["discovered"] = dev->discovered;
-                    j["connected"] = dev->connected;
-                    j["paired"] = dev->paired;
-                    j["trusted"] = dev->trusted;
-
-                    mqtt::message_ptr pubmsg = mqtt::make_message(OUTPUT_TOPIC, j.dump());
-                    mqtt_publish(pubmsg);
-                }
-                else if (iface == Characteristic_IFACE)
-                {
-                    auto pos = path.find("dev_");
-                    if (pos == std::string::npos)
-                        return;
-
-                    std::string mac = path.substr(pos + 4, 17); // skip "dev_" and after mac
-                    std::cout << mac << std::endl;
-                    std::replace(mac.begin(), mac.end(), '_', ':');
-                    std::cout << mac << std::endl;
-
-                    std::shared_ptr<BLEDevice> dev;
-                    {
-                        std::lock_guard<std::mutex> lock(devicesMutex);
-                        auto devMap = devices.find(mac);
-                        if(devMap == devices.end()) return;
-                        dev = devMap->second;
-                    }
-
-                    auto characteristics = dev->getCharacteristics();
-                    for (const auto& [uuid, Charpath] : characteristics)
-                    {
-                        if (path == Charpath) dev->removeCharacteristics(uuid);
-                    }
-                }
+                BusEvent ev;
+                if (iface == DEVICE_IFACE) ev.type = BusEventType::DeviceRemoved;
+                else if (iface == Characteristic_IFACE) ev.type = BusEventType::CharacteristicRemoved;
+                else continue;
+
+                ev.mac  = mac;
+                ev.path = path;
+                enqueue_signal(std::move(ev));
             }
     });
     Proxy->finishRegistration();
     
-    // Run the event loop in a background thread
-    std::thread loopThread([&] {
-        connection->enterEventLoop();
+    // Signals are applied off the loop thread so slow MQTT or D-Bus calls
+    // never hold up dispatch. Reactor mode does both on its loop.
+    std::thread signalThread;
+    std::thread loopThread;
+    if (!reactor_mode) {
+        signalThread = std::thread(signal_worker);
+
+        // Run the event loop in a background thread
+        loopThread = std::thread([&] {
+            connection->enterEventLoop();
+        });
+    }
+
+    // Spawned, not run: the replies come in on the signal connection, whose
+    // loop is not running yet in reactor mode
+    coro_executor.spawn(register_adv_monitor());
+
+    att_reactor.start(on_att_notification, [](MacAddr mac, const Uuid128& uuid, bool write) {
+        std::cout << "[ATT] " << macToString(mac) << " " << uuidToString(uuid) << (write ? " write" : " notify")
+                  << " socket closed, back on D-Bus" << std::endl;
     });
+    radio_ops.start(RADIO_OP_WORKERS);
+
+    // Warm start: restore the registry and reconnect right away
+    std::vector<std::shared_ptr<BLEDevice>> warmDevices;
+    if (!coldStart) {
+        warmDevices = warm_start_registry();
+        warm_started = !warmDevices.empty();
+        poll_targets_dirty = true;
+        for (const auto& dev : warmDevices) {
+            // Already up: no ServicesResolved will come, confirm the cached GATT map now
+            if (dev->getConnected()) {
+                schedule_gatt_refresh(dev);
+                continue;
+            }
+            if (ownership) continue;   // connected once this instance holds it
+            coro_executor.spawn([](std::shared_ptr<BLEDevice> dev) -> Task<void> {
+                RadioSlot slot = co_await admit_radio("warm_connect", OpPriority::Normal);
+                if (slot) co_await connect_device_async(dev);
+            }(dev));
+        }
+    }
 
-    auto adapter = sdbus::createProxy(*connection, BLUEZ_SERVICE_NAME, ADAPTER_PATH);
+    // Reads for characteristics that cannot notify
+    std::thread pollThread;
+    std::thread reconnectThread;
+    std::thread ownershipThread;
+    if (!reactor_mode) {
+        pollThread = std::thread(poll_worker);
+        reconnectThread = std::thread(reconnect_worker);
+    }
+
+    // Time-based automations; each due command runs like one sent over MQTT
+    command_scheduler.load();
+    command_scheduler.start([](const std::string& id, const json& command) {
+        std::cout << "[Sched] " << id << ": " << command.value("command", "") << std::endl;
+        try {
+            // radio work goes to the op queue, this does not block
+            if (route_command(command, INPUT_TOPIC)) handle_command(command);
+        } catch (const std::exception& e) {
+            std::cerr << "[Sched] Command failed: " << e.what() << std::endl;
+        }
+    });
 
     try {
         std::atomic<bool> exit = false;
-        callback cb(client, exit);
-        client.set_callback(cb);
+        callback cb(*client, exit);
+        client->set_callback(cb);
 
-        mqtt::connect_options connOpts;
+        mqtt::connect_options connOpts = mqtt::connect_options::v5();
         connOpts.set_automatic_reconnect(true);
-        connOpts.set_clean_session(false); // Keep subscriptions
         connOpts.set_keep_alive_interval(20);
         connOpts.set_connect_timeout(10);
+        // Keep subscriptions for an hour
+        connOpts.set_clean_start(false);
+        connOpts.set_properties({mqtt::property(mqtt::property::SESSION_EXPIRY_INTERVAL, 3600)});
+        if (ownership) {
+            // Peers drop our claims as soon as we are gone
+            json gone = {{"instance", instance_id}, {"gone", true}};
+            connOpts.set_will(mqtt::will_options(OWNERSHIP_TOPIC, gone.dump(), 1, false));
+        }
 
         std::cout << "[MQTT] Connecting to broker..." << std::endl;
-        client.connect(connOpts)->wait();
+        mqtt::token_ptr connTok = client->connect(connOpts);
+        connTok->wait();
         std::cout << "[MQTT] Connected.\n";
+        // No Topic Alias Maximum in the CONNACK means the broker takes none
+        const auto& connAck = connTok->get_connect_response().get_properties();
+        if (connAck.contains(mqtt::property::TOPIC_ALIAS_MAXIMUM))
+            topic_alias_max = mqtt::get<uint16_t>(connAck, mqtt::property::TOPIC_ALIAS_MAXIMUM);
+        {
+            std::lock_guard<std::mutex> lock(mqtt_mutex);
+            topic_aliases.reset(topic_alias_max);
+        }
+        std::cout << "[MQTT] " << topic_alias_max << " topic aliases" << std::endl;
 
         // Subscribe
-        std::cout << "Subscribing to topic: " << INPUT_TOPIC << std::endl;
-        client.subscribe(INPUT_TOPIC, 1)->wait();
-
-        // Keep the program alive to receive messages
-        while (!exit) {
-            try {
-                adapter->callMethod("StartDiscovery").onInterface(ADAPTER_IFACE);
-            } 
-            catch (const sdbus::Error& e) {
-                std::cerr << "Faild to start discovery: " << e.getName() << " - " << e.getMessage() << "\n";
-            }
+        std::cout << "Subscribing to topic: " << (ownership ? SHARED_INPUT_TOPIC : INPUT_TOPIC) << std::endl;
+        subscribe_topics(true);
+        if (ownership) {
+            std::cout << "[Owner] instance " << instance_id << ", commands for it on " << INSTANCE_TOPIC_PREFIX
+                      << instance_id << std::endl;
+            if (!reactor_mode) ownershipThread = std::thread(ownership_worker);
+        }
 
-            std::this_thread::sleep_for(std::chrono::seconds(30));
+        // Let the hub know about devices restored from the snapshot
+        for (const auto& dev : warmDevices) publish_device_state(dev, "device_added");
 
-            try {
-                adapter->callMethod("StopDiscovery").onInterface(ADAPTER_IFACE);
-                std::cout << "Scanning reset in 1 second." << std::endl;
-            } catch (const std::exception& ex) {
-                std::cerr << "StopDiscovery failed: " << ex.what() << std::endl;
+        // Keep the program alive to receive messages
+        if (reactor_mode) {
+            start_reactor();
+            event_reactor.run();
+        }
+        else {
+            while (!exit) {
+                start_discovery_cycle();
+                std::this_thread::sleep_for(std::chrono::milliseconds(DISCOVERY_WINDOW_MS));
+                end_discovery_cycle();
+                std::this_thread::sleep_for(std::chrono::milliseconds(DISCOVERY_PAUSE_MS));
+                run_housekeeping();
+                print_stats();
             }
-
-            std::this_thread::sleep_for(std::chrono::seconds(1));
         }
 
-        client.disconnect()->wait();
+        if (ownership) {
+            // Peers take over our devices now instead of after PEER_TIMEOUT_MS
+            json gone = {{"instance", instance_id}, {"gone", true}};
+            mqtt_publish(mqtt::make_message(OWNERSHIP_TOPIC, gone.dump(), 1, false));
+        }
+        client->disconnect()->wait();
     }
     catch (const mqtt::exception& e) {
         std::cerr << "[MQTT] Fatal error: " << e.what() << std::endl;
         return 1;
     }
 
+    command_scheduler.stop();
+    {
+        std::lock_guard<std::mutex> lock(reconnect_mutex);
+        reconnect_worker_stop = true;
+    }
+    reconnect_cv.notify_all();
+    if (reconnectThread.joinable()) reconnectThread.join();
+    {
+        std::lock_guard<std::mutex> lock(ownership_mutex);
+        ownership_worker_stop = true;
+    }
+    ownership_cv.notify_all();
+    if (ownershipThread.joinable()) ownershipThread.join();
+    radio_ops.stop();
+    att_reactor.stop();
+
     try {
-        adapter->callMethod("StopDiscovery").onInterface(ADAPTER_IFACE);
+        adapter_call("StopDiscovery");
         std::cout << "Scanning stopped." << std::endl;
     } catch (const std::exception& ex) {
         std::cerr << "StopDiscovery failed: " << ex.what() << std::endl;
     }
+    coro_executor.stop();
+
+    save_registry_snapshot();
+    schema_store.stopWatching();
 
     //close threads & exit loop
-    connection->leaveEventLoop();
-    loopThread.join();
+    if (loopThread.joinable()) {
+        connection->leaveEventLoop();
+        loopThread.join();
+    }
+    event_reactor.close();
+    monitor_object.reset();
+    monitor_root.reset();
+
+    signal_worker_stop = true;
+    signal_queue.wake();
+    if (signalThread.joinable()) signalThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex);
+        poll_worker_stop = true;
+    }
+    poll_cv.notify_all();
+    if (pollThread.joinable()) pollThread.join();
+    bus_pool.close();
+
+    trace_signal_stop = true;
+    if (traceSignalThread.joinable()) traceSignalThread.join();
+    if (tracer.on()) {
+        size_t events = 0;
+        flush_trace(events);
+    }
 
-    for (auto& [mac, dev] : devices) {
+    for (const auto& [mac, dev] : devices) {
         dev->proxy.reset();
     }
     Proxy.reset();
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Compact keys for the BLE registry. MACs are packed into the low 48 bits of
+// a uint64_t and UUIDs are kept as two 64-bit halves, so lookups compare and
+// hash 8/16 bytes instead of 17/36-char strings. None of the parsers allocate.
+
+using MacAddr = uint64_t;
+
+struct Uuid128 {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool operator==(const Uuid128& other) const { return hi == other.hi && lo == other.lo; }
+    bool operator!=(const Uuid128& other) const { return !(*this == other); }
+    bool operator<(const Uuid128& other) const { return hi != other.hi ? hi < other.hi : lo < other.lo; }
+    bool empty() const { return hi == 0 && lo == 0; }
+};
+
+namespace ble_keys_detail {
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace ble_keys_detail
+
+// "AA:BB:CC:DD:EE:FF" (or with '_' separators as in BlueZ object paths)
+inline bool parseMac(std::string_view text, MacAddr& out)
+{
+    using ble_keys_detail::hexValue;
+
+    if (text.size() < 17) return false;
+    MacAddr mac = 0;
+    for (size_t i = 0; i < 17; ++i) {
+        if (i % 3 == 2) {
+            if (text[i] != ':' && text[i] != '_') return false;
+            continue;
+        }
+        int v = hexValue(text[i]);
+        if (v < 0) return false;
+        mac = (mac << 4) | static_cast<MacAddr>(v);
+    }
+    out = mac;
+    return text.size() == 17 || text[17] == '/';
+}
+
+// /org/bluez/hci0/dev_AA_BB_CC_DD_EE_FF[/service.../char...]
+inline bool macFromPath(std::string_view path, MacAddr& out)
+{
+    auto pos = path.find("/dev_");
+    if (pos == std::string_view::npos) return false;
+    return parseMac(path.substr(pos + 5), out);
+}
+
+// Part of an object path below its device node, e.g. "/service0010/char0011".
+// Empty for the device itself or for paths that are not under a device.
+inline std::string_view pathBelowDevice(std::string_view path)
+{
+    auto pos = path.find("/dev_");
+    if (pos == std::string_view::npos || path.size() < pos + 5 + 17) return {};
+    return path.substr(pos + 5 + 17);
+}
+
+inline std::string macToString(MacAddr mac)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out(17, ':');
+    for (int i = 0; i < 6; ++i) {
+        auto byte = static_cast<uint8_t>(mac >> (8 * (5 - i)));
+        out[i * 3]     = digits[byte >> 4];
+        out[i * 3 + 1] = digits[byte & 0xF];
+    }
+    return out;
+}
+
+// Bluetooth base UUID 0000xxxx-0000-1000-8000-00805f9b34fb
+constexpr uint64_t BLUETOOTH_BASE_UUID_HI = 0x0000000000001000ULL;
+constexpr uint64_t BLUETOOTH_BASE_UUID_LO = 0x800000805f9b34fbULL;
+
+// Accepts the full 36-char form as well as 16/32-bit short forms ("fcd2")
+inline bool parseUuid(std::string_view text, Uuid128& out)
+{
+    using ble_keys_detail::hexValue;
+
+    if (text.size() == 4 || text.size() == 8) {
+        uint64_t shortValue = 0;
+        for (char c : text) {
+            int v = hexValue(c);
+            if (v < 0) return false;
+            shortValue = (shortValue << 4) | static_cast<uint64_t>(v);
+        }
+        out.hi = (shortValue << 32) | BLUETOOTH_BASE_UUID_HI;
+        out.lo = BLUETOOTH_BASE_UUID_LO;
+        return true;
+    }
+
+    if (text.size() != 36) return false;
+
+    uint64_t halves[2] = {0, 0};
+    int nibbles = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (text[i] != '-') return false;
+            continue;
+        }
+        int v = hexValue(text[i]);
+        if (v < 0) return false;
+        uint64_t& half = halves[nibbles / 16];
+        half = (half << 4) | static_cast<uint64_t>(v);
+        ++nibbles;
+    }
+    out.hi = halves[0];
+    out.lo = halves[1];
+    return true;
+}
+
+inline std::string uuidToString(const Uuid128& uuid)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out(36, '-');
+    size_t pos = 0;
+    for (int i = 0; i < 32; ++i) {
+        if (pos == 8 || pos == 13 || pos == 18 || pos == 23) ++pos;
+        uint64_t half = i < 16 ? uuid.hi : uuid.lo;
+        int shift = (15 - (i % 16)) * 4;
+        out[pos++] = digits[(half >> shift) & 0xF];
+    }
+    return out;
+}
+
+namespace std {
+template <>
+struct hash<Uuid128> {
+    size_t operator()(const Uuid128& uuid) const noexcept {
+        uint64_t h = uuid.hi ^ (uuid.lo * 0x9E3779B97F4A7C15ULL);
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+} // namespace std
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "device_schema.h"
+
+// BTHome v2: one device info byte, then (object id, little-endian value)
+// pairs. Object sizes are not self-describing, so decoding uses the object
+// table from devices_config.json and stops at the first unknown id.
+
+constexpr uint8_t BTHOME_FLAG_ENCRYPTED = 0x01;
+constexpr uint8_t BTHOME_PACKET_ID = 0x00;
+
+// Calls fn(object, raw) for every decoded object. Returns false for
+// encrypted payloads or when decoding stopped early.
+template <typename F>
+bool decodeBTHome(const std::vector<uint8_t>& data, const std::vector<BTHomeObjectSchema>& objects, F&& fn)
+{
+    if (data.empty() || (data[0] & BTHOME_FLAG_ENCRYPTED)) return false;
+
+    size_t pos = 1;
+    while (pos < data.size()) {
+        uint8_t id = data[pos++];
+        const BTHomeObjectSchema* object = nullptr;
+        for (const auto& o : objects) {
+            if (o.id == id) { object = &o; break; }
+        }
+        if (!object || object->size == 0 || pos + object->size > data.size()) return false;
+
+        uint64_t value = 0;
+        for (size_t i = 0; i < object->size; ++i) value |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+        int64_t raw = static_cast<int64_t>(value);
+        if (object->isSigned && object->size < 8) {
+            int shift = 64 - 8 * object->size;
+            raw = static_cast<int64_t>(value << shift) >> shift;
+        }
+        fn(*object, raw);
+        pos += object->size;
+    }
+    return true;
+}
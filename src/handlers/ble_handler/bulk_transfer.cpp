@@ -0,0 +1,55 @@
+#include "bulk_transfer.h"
+
+#include <algorithm>
+
+BulkTransfer::BulkTransfer(size_t total, size_t startOffset, size_t chunkSize, size_t window)
+    : totalBytes(total),
+      startOffset(std::min(startOffset, total)),
+      chunk(std::max<size_t>(chunkSize, 1)),
+      windowChunks(window),
+      nextOffset(this->startOffset),
+      ackedOffset(this->startOffset)
+{
+}
+
+bool BulkTransfer::next(Chunk& out) const
+{
+    if (nextOffset >= totalBytes) return false;
+    out.offset = nextOffset;
+    out.len = std::min(chunk, totalBytes - nextOffset);
+    out.acknowledged = unacked >= windowChunks || out.offset + out.len == totalBytes;
+    return true;
+}
+
+void BulkTransfer::sent(const Chunk& c)
+{
+    nextOffset = c.offset + c.len;
+    ++chunkCount;
+    if (c.acknowledged) {
+        ackedOffset = nextOffset;
+        unacked = 0;
+        ++checkpointCount;
+    } else {
+        ++unacked;
+    }
+}
+
+void BulkTransfer::rewind()
+{
+    nextOffset = ackedOffset;
+    unacked = 0;
+}
+
+void BulkTransferStats::finished(bool ok, uint64_t bytes, Duration elapsed)
+{
+    (ok ? okCount : failCount).fetch_add(1, std::memory_order_relaxed);
+    byteCount.fetch_add(bytes, std::memory_order_relaxed);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    transferUs.fetch_add(us > 0 ? static_cast<uint64_t>(us) : 0, std::memory_order_relaxed);
+}
+
+double BulkTransferStats::bytesPerSecond() const
+{
+    uint64_t us = transferUs.load(std::memory_order_relaxed);
+    return us ? byteCount.load(std::memory_order_relaxed) * 1e6 / static_cast<double>(us) : 0.0;
+}
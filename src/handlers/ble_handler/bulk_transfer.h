@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "latency_histogram.h"
+
+// Plans a bulk write (firmware blob, config table) as a stream of writes
+// without response broken up by acknowledged checkpoints:
+//
+//   chunk chunk ... chunk [ack] chunk chunk ... chunk [ack] ... [ack]
+//   |<---- window ---->|
+//
+// A chunk is the largest value one write carries (ATT MTU - 3). At most
+// window chunks go out unacknowledged; the chunk after them is written
+// with response. BlueZ answers that write only once the device has it,
+// and ATT keeps order on the bearer, so every byte before it has arrived
+// too. The last chunk is always acknowledged. window = 0 acknowledges
+// every chunk, which is how single writes work and the baseline the
+// throughput is measured against.
+//
+// acked() is the resume point. A failed write rewinds to it; a hub whose
+// transfer failed starts a new one at that offset. One transfer belongs
+// to one coroutine, so the class is not thread-safe.
+
+class BulkTransfer {
+public:
+    struct Chunk {
+        size_t offset = 0;
+        size_t len = 0;
+        bool acknowledged = false;
+    };
+
+    // startOffset is clamped to total, chunkSize to at least 1
+    BulkTransfer(size_t total, size_t startOffset, size_t chunkSize, size_t window);
+
+    // False once every byte was sent
+    bool next(Chunk& out) const;
+    // out went out (and was acknowledged, if it asked for it)
+    void sent(const Chunk& chunk);
+    // Back to the last acknowledged offset after a failed write
+    void rewind();
+
+    size_t total() const { return totalBytes; }
+    size_t start() const { return startOffset; }
+    size_t offset() const { return nextOffset; }     // sent so far
+    size_t acked() const { return ackedOffset; }     // confirmed by the device
+    size_t chunkSize() const { return chunk; }
+    size_t window() const { return windowChunks; }
+    bool done() const { return ackedOffset >= totalBytes; }
+    uint64_t chunks() const { return chunkCount; }
+    uint64_t checkpoints() const { return checkpointCount; }
+
+private:
+    size_t totalBytes;
+    size_t startOffset;
+    size_t chunk;
+    size_t windowChunks;
+    size_t nextOffset;
+    size_t ackedOffset;
+    size_t unacked = 0;          // chunks since the last checkpoint
+    uint64_t chunkCount = 0;
+    uint64_t checkpointCount = 0;
+};
+
+// Totals over all transfers, for the stats line. Thread-safe.
+class BulkTransferStats {
+public:
+    using Duration = std::chrono::steady_clock::duration;
+
+    void started() { startCount.fetch_add(1, std::memory_order_relaxed); }
+    // bytes delivered by one transfer (from its start offset) and how long it took
+    void finished(bool ok, uint64_t bytes, Duration elapsed);
+    void checkpoint(Duration elapsed) { checkpointTime.record(elapsed); }
+    void busy() { busyCount.fetch_add(1, std::memory_order_relaxed); }
+    void retried() { retryCount.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t transfers() const { return startCount.load(std::memory_order_relaxed); }
+    uint64_t completed() const { return okCount.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return failCount.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return byteCount.load(std::memory_order_relaxed); }
+    uint64_t busyRetries() const { return busyCount.load(std::memory_order_relaxed); }
+    uint64_t rewinds() const { return retryCount.load(std::memory_order_relaxed); }
+    // Bytes over transfer time, all transfers together
+    double bytesPerSecond() const;
+    // Acknowledged write round trip
+    LatencyHistogram& checkpointLatency() { return checkpointTime; }
+
+private:
+    std::atomic<uint64_t> startCount{0};
+    std::atomic<uint64_t> okCount{0};
+    std::atomic<uint64_t> failCount{0};
+    std::atomic<uint64_t> byteCount{0};
+    std::atomic<uint64_t> transferUs{0};
+    std::atomic<uint64_t> busyCount{0};
+    std::atomic<uint64_t> retryCount{0};
+    LatencyHistogram checkpointTime;
+};
@@ -0,0 +1,47 @@
+#include "bus_pool.h"
+
+#include <iostream>
+
+BusPool::~BusPool()
+{
+    close();
+}
+
+void BusPool::open(size_t ioConnections)
+{
+    if (control) return;
+
+    control = sdbus::createSystemBusConnection();
+    control->enterEventLoopAsync();
+
+    if (ioConnections == 0) ioConnections = 1;
+    for (size_t i = 0; i < ioConnections; ++i) {
+        auto conn = sdbus::createSystemBusConnection();
+        conn->enterEventLoopAsync();
+        io.push_back(std::move(conn));
+    }
+    std::cout << "[Bus] Opened 1 control + " << io.size() << " I/O connections" << std::endl;
+}
+
+void BusPool::close()
+{
+    for (auto& conn : io) conn->leaveEventLoop();
+    io.clear();
+    if (control) control->leaveEventLoop();
+    control.reset();
+}
+
+sdbus::IConnection& BusPool::connectionFor(BusLane lane, uint64_t key)
+{
+    if (lane == BusLane::Io && !io.empty()) {
+        // MAC low bits are effectively random, good enough to spread devices
+        return *io[(key ^ (key >> 24)) % io.size()];
+    }
+    return *control;
+}
+
+std::unique_ptr<sdbus::IProxy> BusPool::proxy(BusLane lane, uint64_t key, const std::string& destination,
+                                              const std::string& path)
+{
+    return sdbus::createProxy(connectionFor(lane, key), destination, path);
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <sdbus-c++/sdbus-c++.h>
+
+#include "coro_executor.h"
+#include "latency_histogram.h"
+#include "trace.h"
+
+// Outbound D-Bus method calls are split over their own bus connections so
+// they never queue behind each other or behind signal dispatch:
+//
+//   signals  - the handler's main connection (signal subscriptions only)
+//   Control  - Pair/Connect/Disconnect, discovery, property Get/Set;
+//              calls here can take the full BlueZ timeout
+//   Io       - ReadValue/WriteValue, spread over N connections by device
+//              so calls for one device stay in order
+//
+// Every pool connection runs its own event loop thread. Calls are sent
+// with callMethodAsync() and the caller waits on the reply, which is
+// dispatched by that loop; a blocked caller never holds a connection.
+
+enum class BusLane : uint8_t { Control, Io };
+
+class BusPool {
+public:
+    BusPool() = default;
+    ~BusPool();
+
+    BusPool(const BusPool&) = delete;
+    BusPool& operator=(const BusPool&) = delete;
+
+    // Opens 1 control + ioConnections I/O connections to the system bus
+    void open(size_t ioConnections);
+    void close();
+
+    // Proxy on the connection serving lane/key. key is the device MAC for Io.
+    std::unique_ptr<sdbus::IProxy> proxy(BusLane lane, uint64_t key, const std::string& destination,
+                                         const std::string& path);
+
+    LatencyHistogram& latency(BusLane lane) { return lane == BusLane::Io ? ioLatency : controlLatency; }
+
+private:
+    sdbus::IConnection& connectionFor(BusLane lane, uint64_t key);
+
+    std::unique_ptr<sdbus::IConnection> control;
+    std::vector<std::unique_ptr<sdbus::IConnection>> io;
+    LatencyHistogram controlLatency;
+    LatencyHistogram ioLatency;
+};
+
+// Collects the reply of one callMethodAsync() and lets the calling thread
+// wait for it:
+//
+//   AsyncReply<std::vector<uint8_t>> reply;
+//   proxy->callMethodAsync("ReadValue").onInterface(...).withArguments(...)
+//         .uponReplyInvoke(reply.handler());
+//   auto [value] = reply.get(bus_pool.latency(BusLane::Io));
+//
+// get() throws the sdbus::Error of a failed call, like callMethod() does.
+template <typename... Results>
+class AsyncReply {
+public:
+    AsyncReply() : state(std::make_shared<std::promise<std::tuple<Results...>>>()), future(state->get_future()) {}
+
+    auto handler() {
+        return [state = state](const sdbus::Error* error, Results... results) {
+            if (error) state->set_exception(std::make_exception_ptr(*error));
+            else state->set_value(std::make_tuple(std::move(results)...));
+        };
+    }
+
+    std::tuple<Results...> get(LatencyHistogram& latency) {
+        future.wait();
+        auto now = std::chrono::steady_clock::now();
+        latency.record(now - sent);
+        if (tracer.on()) tracer.complete("dbus_call", sent, now);
+        return future.get();
+    }
+
+    // For calls without results, rethrows the error if there was one
+    void wait(LatencyHistogram& latency) { get(latency); }
+
+private:
+    std::shared_ptr<std::promise<std::tuple<Results...>>> state;
+    std::future<std::tuple<Results...>> future;
+    std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+};
+
+// The same for coroutines: the awaiting coroutine holds no thread while
+// the call is out, and is resumed on the executor (never on the bus loop
+// thread that delivered the reply):
+//
+//   AwaitableReply<std::vector<uint8_t>> reply(coro_executor);
+//   proxy->callMethodAsync("ReadValue")...uponReplyInvoke(reply.handler());
+//   auto [value] = co_await reply.result(bus_pool.latency(BusLane::Io));
+//
+// The proxy must outlive the call; keep it in the coroutine frame.
+template <typename... Results>
+class AwaitableReply {
+    struct State {
+        std::mutex mtx;
+        bool done = false;
+        std::optional<std::tuple<Results...>> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> waiter;
+        CoroExecutor* executor = nullptr;
+    };
+
+public:
+    explicit AwaitableReply(CoroExecutor& executor) : state(std::make_shared<State>()) {
+        state->executor = &executor;
+    }
+
+    auto handler() {
+        return [state = state](const sdbus::Error* error, Results... results) {
+            std::coroutine_handle<> waiter;
+            {
+                std::lock_guard<std::mutex> lock(state->mtx);
+                if (error) state->error = std::make_exception_ptr(*error);
+                else state->value.emplace(std::move(results)...);
+                state->done = true;
+                waiter = state->waiter;
+            }
+            if (waiter) state->executor->post(waiter);
+        };
+    }
+
+    struct Awaiter {
+        std::shared_ptr<State> state;
+        LatencyHistogram& latency;
+        std::chrono::steady_clock::time_point sent;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            if (state->done) return false;
+            state->waiter = h;
+            return true;
+        }
+        std::tuple<Results...> await_resume() {
+            auto now = std::chrono::steady_clock::now();
+            latency.record(now - sent);
+            if (tracer.on()) tracer.async("dbus_call", sent, now);
+            if (state->error) std::rethrow_exception(state->error);
+            return std::move(*state->value);
+        }
+    };
+
+    // Throws the sdbus::Error of a failed call on resume
+    Awaiter result(LatencyHistogram& latency) { return Awaiter{state, latency, sent}; }
+
+private:
+    std::shared_ptr<State> state;
+    std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+};
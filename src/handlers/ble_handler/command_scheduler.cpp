@@ -0,0 +1,432 @@
+#include "command_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+int64_t wallMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Commands a schedule may run
+bool schedulable(const std::string& command)
+{
+    return command == "write_characteristic" || command == "read_characteristic" ||
+           command == "connect_device" || command == "disconnect_device" || command == "pair_device";
+}
+
+bool parseNumber(const std::string& text, int& out)
+{
+    if (text.empty() || text.size() > 4) return false;
+    out = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        out = out * 10 + (c - '0');
+    }
+    return true;
+}
+
+// One cron field: "*", "a", "a-b", with an optional "/step", comma separated
+bool parseField(const std::string& text, int lo, int hi, uint64_t& bits, bool& star)
+{
+    bits = 0;
+    star = text == "*";
+    std::stringstream parts(text);
+    std::string part;
+    while (std::getline(parts, part, ',')) {
+        int step = 1;
+        if (auto slash = part.find('/'); slash != std::string::npos) {
+            if (!parseNumber(part.substr(slash + 1), step) || step == 0) return false;
+            part.resize(slash);
+        }
+
+        int from, to;
+        if (part == "*") {
+            from = lo;
+            to = hi;
+        } else if (auto dash = part.find('-'); dash != std::string::npos) {
+            if (!parseNumber(part.substr(0, dash), from) || !parseNumber(part.substr(dash + 1), to)) return false;
+        } else {
+            if (!parseNumber(part, from)) return false;
+            to = step > 1 ? hi : from;   // "5/15" = from 5 every 15
+        }
+        if (from < lo || to > hi || from > to) return false;
+        for (int v = from; v <= to; v += step) bits |= uint64_t(1) << v;
+    }
+    return bits != 0;
+}
+
+bool bit(uint64_t bits, int n)
+{
+    return (bits >> n) & 1;
+}
+
+// mktime() normalises overflowing fields (minute 60, day 32, ...) and DST
+void normalise(std::tm& tm)
+{
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    localtime_r(&t, &tm);
+}
+
+} // namespace
+
+bool CronSpec::parse(const std::string& text, CronSpec& out, std::string& error)
+{
+    std::string spec = text;
+    if (spec == "@hourly") spec = "0 * * * *";
+    else if (spec == "@daily" || spec == "@midnight") spec = "0 0 * * *";
+    else if (spec == "@weekly") spec = "0 0 * * 0";
+    else if (spec == "@monthly") spec = "0 0 1 * *";
+    else if (spec == "@yearly" || spec == "@annually") spec = "0 0 1 1 *";
+
+    std::istringstream in(spec);
+    std::string f[5], extra;
+    for (auto& field : f) in >> field;
+    in >> extra;
+    if (f[4].empty() || !extra.empty()) {
+        error = "cron needs 5 fields: minute hour day month weekday";
+        return false;
+    }
+
+    CronSpec c;
+    uint64_t bits;
+    bool star;
+    if (!parseField(f[0], 0, 59, bits, star)) { error = "bad minute field " + f[0]; return false; }
+    c.minutes = bits;
+    if (!parseField(f[1], 0, 23, bits, star)) { error = "bad hour field " + f[1]; return false; }
+    c.hours = static_cast<uint32_t>(bits);
+    if (!parseField(f[2], 1, 31, bits, c.anyDay)) { error = "bad day field " + f[2]; return false; }
+    c.days = static_cast<uint32_t>(bits);
+    if (!parseField(f[3], 1, 12, bits, star)) { error = "bad month field " + f[3]; return false; }
+    c.months = static_cast<uint16_t>(bits);
+    if (!parseField(f[4], 0, 7, bits, c.anyWeekday)) { error = "bad weekday field " + f[4]; return false; }
+    if (bit(bits, 7)) bits |= 1;   // 7 = Sunday
+    c.weekdays = static_cast<uint8_t>(bits & 0x7F);
+
+    out = c;
+    return true;
+}
+
+int64_t CronSpec::next(int64_t afterMs) const
+{
+    std::time_t t = static_cast<std::time_t>(afterMs / 1000);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    tm.tm_sec = 0;
+    tm.tm_min += 1;
+    normalise(tm);
+
+    const int startYear = tm.tm_year;
+    while (tm.tm_year - startYear <= 5) {
+        if (!bit(months, tm.tm_mon + 1)) {
+            tm.tm_mon += 1;
+            tm.tm_mday = 1;
+            tm.tm_hour = tm.tm_min = 0;
+            normalise(tm);
+            continue;
+        }
+
+        // Classic cron: if both day fields are restricted either may match
+        bool dayOk = bit(days, tm.tm_mday);
+        bool weekdayOk = bit(weekdays, tm.tm_wday);
+        bool match = anyDay && anyWeekday ? true
+                   : anyDay               ? weekdayOk
+                   : anyWeekday           ? dayOk
+                                          : dayOk || weekdayOk;
+        if (!match) {
+            tm.tm_mday += 1;
+            tm.tm_hour = tm.tm_min = 0;
+            normalise(tm);
+            continue;
+        }
+        if (!bit(hours, tm.tm_hour)) {
+            tm.tm_hour += 1;
+            tm.tm_min = 0;
+            normalise(tm);
+            continue;
+        }
+        if (!bit(minutes, tm.tm_min)) {
+            tm.tm_min += 1;
+            normalise(tm);
+            continue;
+        }
+        tm.tm_isdst = -1;
+        return static_cast<int64_t>(std::mktime(&tm)) * 1000;
+    }
+    return -1;
+}
+
+CommandScheduler::CommandScheduler(std::string file) : file(std::move(file)), wheel(TICK_MS, wallMs()) {}
+
+CommandScheduler::~CommandScheduler()
+{
+    stop();
+}
+
+std::string CommandScheduler::addLocked(const json& request, int64_t nowMs, bool restoring, json& out)
+{
+    if (!request.is_object()) return "schedule must be an object";
+    if (schedules.size() >= MAX_SCHEDULES) return "too many schedules";
+
+    const json action = request.value("action", json());
+    if (!action.is_object() || !action.contains("command") || !action["command"].is_string())
+        return "missing action command";
+    if (!schedulable(action["command"]))
+        return "command " + action["command"].get<std::string>() + " cannot be scheduled";
+
+    Schedule s;
+    s.action = action;
+    s.lastMs = request.value("last_run", int64_t(0));
+    s.runs = request.value("runs", uint64_t(0));
+
+    int kinds = request.contains("cron") + request.contains("at") + request.contains("in_ms");
+    if (kinds != 1) return "give exactly one of cron, at, in_ms";
+
+    if (request.contains("cron")) {
+        std::string error;
+        s.cron = request.value("cron", "");
+        if (!CronSpec::parse(s.cron, s.spec, error)) return error;
+        s.nextMs = s.spec.next(nowMs);
+        if (s.nextMs < 0) return "cron never fires";
+    } else if (request.contains("at")) {
+        if (!request["at"].is_number_integer()) return "at must be unix time in ms";
+        s.nextMs = request["at"];
+        int64_t lateBy = nowMs - s.nextMs;
+        if (lateBy > (restoring ? MISSED_GRACE_MS : 1000))
+            return restoring ? "missed while the handler was down" : "at is in the past";
+        s.nextMs = std::max(s.nextMs, nowMs);
+    } else {
+        if (!request["in_ms"].is_number_integer() || request["in_ms"].get<int64_t>() < 0)
+            return "in_ms must be a positive integer";
+        s.nextMs = nowMs + request["in_ms"].get<int64_t>();
+    }
+
+    uint64_t serial = nextSerial++;
+    s.id = request.value("id", "");
+    if (s.id.empty()) {
+        // Serials restart at 1: skip generated ids a restored schedule already has
+        while (byId.find("schedule_" + std::to_string(serial)) != byId.end()) serial = nextSerial++;
+        s.id = "schedule_" + std::to_string(serial);
+    }
+
+    // Same id replaces the old schedule
+    if (auto it = byId.find(s.id); it != byId.end()) {
+        wheel.cancel(schedules[it->second].timer);
+        schedules.erase(it->second);
+        byId.erase(it);
+    }
+
+    s.timer = wheel.add(s.nextMs, serial);
+    out = describe(s);
+    byId[s.id] = serial;
+    schedules.emplace(serial, std::move(s));
+    dirty = true;
+    return "";
+}
+
+bool CommandScheduler::load()
+{
+    std::ifstream in(file);
+    if (!in) return false;
+
+    json root;
+    try {
+        root = json::parse(in);
+    } catch (const json::exception& e) {
+        std::cerr << "[Sched] Cannot parse " << file << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    int64_t now = wallMs();
+    size_t restored = 0;
+    for (const auto& entry : root.value("schedules", json::array())) {
+        json out;
+        std::string error = addLocked(entry, now, true, out);
+        if (error.empty()) ++restored;
+        else std::cerr << "[Sched] Dropped " << entry.value("id", "?") << ": " << error << std::endl;
+    }
+    std::cout << "[Sched] Restored " << restored << " schedules from " << file << std::endl;
+    return true;
+}
+
+void CommandScheduler::start(Executor exec)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (thread.joinable()) return;
+    executor = std::move(exec);
+    stopRequested = false;
+    thread = std::thread(&CommandScheduler::run, this);
+}
+
+void CommandScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopRequested = true;
+    }
+    cv.notify_all();
+    if (thread.joinable()) thread.join();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (dirty) save();
+}
+
+std::string CommandScheduler::add(const json& request, json& out)
+{
+    std::string error;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        error = addLocked(request, wallMs(), false, out);
+    }
+    cv.notify_all();
+    return error;
+}
+
+bool CommandScheduler::remove(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = byId.find(id);
+    if (it == byId.end()) return false;
+    wheel.cancel(schedules[it->second].timer);
+    schedules.erase(it->second);
+    byId.erase(it);
+    dirty = true;
+    return true;
+}
+
+json CommandScheduler::describe(const Schedule& s) const
+{
+    json j;
+    j["id"] = s.id;
+    if (!s.cron.empty()) j["cron"] = s.cron;
+    else j["at"] = s.nextMs;
+    j["action"] = s.action;
+    j["next_run"] = s.nextMs;
+    if (s.runs) {
+        j["last_run"] = s.lastMs;
+        j["runs"] = s.runs;
+    }
+    return j;
+}
+
+json CommandScheduler::list() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<const Schedule*> sorted;
+    sorted.reserve(schedules.size());
+    for (const auto& [serial, s] : schedules) sorted.push_back(&s);
+    std::sort(sorted.begin(), sorted.end(), [](const Schedule* a, const Schedule* b) { return a->nextMs < b->nextMs; });
+
+    json out = json::array();
+    for (const Schedule* s : sorted) out.push_back(describe(*s));
+    return out;
+}
+
+size_t CommandScheduler::size() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return schedules.size();
+}
+
+bool CommandScheduler::save()
+{
+    json root;
+    root["schedules"] = json::array();
+    for (const auto& [serial, s] : schedules) root["schedules"].push_back(describe(s));
+
+    std::error_code ec;
+    std::filesystem::path path(file);
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+
+    // Write then rename so a crash never leaves a half-written file
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!(out << root.dump(2))) {
+            std::cerr << "[Sched] Cannot write " << tmp << std::endl;
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp, file, ec);
+    if (ec) {
+        std::cerr << "[Sched] Cannot replace " << file << ": " << ec.message() << std::endl;
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+/**********************************************************************
+|   run() ticks the wheel. Due schedules are collected under the lock   |
+|   and executed after it is released; cron schedules are re-armed for |
+|   their next minute, one-shots are dropped.                          |
+***********************************************************************/
+void CommandScheduler::run()
+{
+    std::vector<std::pair<std::string, json>> due;
+    int64_t lastSave = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while (!stopRequested) {
+        int64_t now = wallMs();
+
+        // Wall clock stepped back: re-file everything against the new time
+        if (now < wheel.nowMs() - 1000) {
+            std::cerr << "[Sched] Clock moved back, re-arming " << schedules.size() << " schedules" << std::endl;
+            wheel.reset(now);
+            for (auto& [serial, s] : schedules) {
+                if (!s.cron.empty()) s.nextMs = s.spec.next(now - 60000);
+                s.timer = wheel.add(s.nextMs, serial);
+            }
+        }
+
+        due.clear();
+        wheel.advance(now, [&](TimerWheel::TimerId, uint64_t serial) {
+            auto it = schedules.find(serial);
+            if (it == schedules.end()) return;
+            Schedule& s = it->second;
+
+            late.recordUs(static_cast<uint64_t>(std::max<int64_t>(0, now - s.nextMs)) * 1000);
+            fireCount.fetch_add(1, std::memory_order_relaxed);
+            s.lastMs = now;
+            ++s.runs;
+            due.emplace_back(s.id, s.action);
+            dirty = true;
+
+            if (!s.cron.empty() && (s.nextMs = s.spec.next(now)) >= 0) {
+                s.timer = wheel.add(s.nextMs, serial);
+            } else {
+                byId.erase(s.id);
+                schedules.erase(it);
+            }
+        });
+
+        if (!due.empty() && executor) {
+            lock.unlock();
+            for (const auto& [id, action] : due) executor(id, action);
+            lock.lock();
+        }
+
+        if (dirty && now - lastSave >= SAVE_INTERVAL_MS) {
+            save();
+            lastSave = now;
+        }
+
+        // Tick while anything is pending, otherwise wait for an add
+        int64_t sleepMs = wheel.size() ? std::max<int64_t>(1, wheel.nextTickMs() - wallMs()) : 1000;
+        cv.wait_for(lock, std::chrono::milliseconds(sleepMs));
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+#include "latency_histogram.h"
+#include "timer_wheel.h"
+
+// Time-based automations: handler commands (writes, reads, connect and
+// disconnect) run once at a given time or repeatedly on a cron spec, e.g.
+//
+//   {"id": "lights_off", "cron": "0 0 * * *",
+//    "action": {"command": "write_characteristic", "device": "...", ...}}
+//
+// Schedules sit in a TimerWheel ticked every TICK_MS by the scheduler
+// thread, so thousands of them cost the same per tick as one. They are
+// saved to a JSON file (at most every SAVE_INTERVAL_MS) and restored on
+// start; a one-shot that came due while the handler was down still runs
+// if it is no more than MISSED_GRACE_MS late.
+
+// Standard 5-field cron: minute hour day-of-month month day-of-week, with
+// *, lists, ranges and steps, in local time. @hourly/@daily/@weekly/
+// @monthly/@yearly are accepted too.
+struct CronSpec {
+    uint64_t minutes = 0;   // bit per minute 0-59
+    uint32_t hours = 0;     // 0-23
+    uint32_t days = 0;      // 1-31
+    uint16_t months = 0;    // 1-12
+    uint8_t weekdays = 0;   // 0-6, Sunday = 0 (7 is accepted as Sunday)
+    bool anyDay = true;     // day-of-month field was *
+    bool anyWeekday = true; // day-of-week field was *
+
+    static bool parse(const std::string& text, CronSpec& out, std::string& error);
+
+    // First matching minute strictly after afterMs (unix ms), -1 if none within 5 years
+    int64_t next(int64_t afterMs) const;
+};
+
+class CommandScheduler {
+public:
+    using Executor = std::function<void(const std::string& id, const nlohmann::json& command)>;
+
+    static constexpr uint32_t TICK_MS = 50;
+    static constexpr int64_t MISSED_GRACE_MS = 15 * 60 * 1000;
+    static constexpr int64_t SAVE_INTERVAL_MS = 5000;
+    static constexpr size_t MAX_SCHEDULES = 100000;
+
+    explicit CommandScheduler(std::string file);
+    ~CommandScheduler();
+
+    CommandScheduler(const CommandScheduler&) = delete;
+    CommandScheduler& operator=(const CommandScheduler&) = delete;
+
+    // Restores the saved schedules; call before start()
+    bool load();
+    void start(Executor executor);
+    void stop();
+
+    // {"id"?, "cron" | "at" (unix ms) | "in_ms", "action": {...}}. Returns an
+    // error message, or "" and fills out with the id and next run.
+    std::string add(const nlohmann::json& request, nlohmann::json& out);
+    bool remove(const std::string& id);
+    nlohmann::json list() const;
+
+    size_t size() const;
+    uint64_t fired() const { return fireCount.load(std::memory_order_relaxed); }
+    // How late schedules ran relative to their due time
+    LatencyHistogram& lateness() { return late; }
+
+private:
+    struct Schedule {
+        std::string id;
+        std::string cron;          // empty for a one-shot
+        CronSpec spec;
+        nlohmann::json action;
+        int64_t nextMs = 0;
+        int64_t lastMs = 0;
+        uint64_t runs = 0;
+        TimerWheel::TimerId timer = TimerWheel::INVALID_TIMER;
+    };
+
+    std::string addLocked(const nlohmann::json& request, int64_t nowMs, bool restoring, nlohmann::json& out);
+    void run();
+    bool save();
+    nlohmann::json describe(const Schedule& s) const;
+
+    std::string file;
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::thread thread;
+    bool stopRequested = false;
+    bool dirty = false;
+    Executor executor;
+
+    TimerWheel wheel;
+    uint64_t nextSerial = 1;
+    std::unordered_map<uint64_t, Schedule> schedules;        // serial (timer data) -> schedule
+    std::unordered_map<std::string, uint64_t> byId;
+    std::atomic<uint64_t> fireCount{0};
+    LatencyHistogram late;
+};
@@ -0,0 +1,167 @@
+#include "coro_executor.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Fire-and-forget frame around a spawned task; frees itself when done
+struct CoroExecutor::Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }   // runDetached catches
+    };
+};
+
+CoroExecutor::~CoroExecutor()
+{
+    stop();
+}
+
+int64_t CoroExecutor::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+}
+
+void CoroExecutor::start(size_t count)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!workers.empty()) return;
+    stopping = false;
+    for (size_t i = 0; i < std::max<size_t>(1, count); ++i) workers.emplace_back(&CoroExecutor::worker, this);
+}
+
+void CoroExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+    workers.clear();
+}
+
+void CoroExecutor::post(std::coroutine_handle<> h)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping) return;
+        ready.push_back(h);
+    }
+    cv.notify_one();
+}
+
+void CoroExecutor::addTimer(int64_t delayMs, std::coroutine_handle<> h, uint64_t waiterId)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        timers.push(Due{nowMs() + delayMs, ++timerSeq, h, waiterId});
+    }
+    // An idle worker may be sleeping until a later deadline
+    cv.notify_one();
+}
+
+bool CoroExecutor::park(Waiter& waiter, std::coroutine_handle<> h, int64_t timeoutMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // Checked again under the lock so a wake() in between is not lost
+        if (stopping || (waiter.result = waiter.ready())) return false;
+
+        uint64_t id = nextWaiterId++;
+        waiter.handle = h;
+        waiters[id] = &waiter;
+        parked[waiter.key].push_back(id);
+        timers.push(Due{nowMs() + std::max<int64_t>(timeoutMs, 0), ++timerSeq, {}, id});
+    }
+    cv.notify_one();
+    return true;
+}
+
+void CoroExecutor::unpark(uint64_t id, Waiter* waiter)
+{
+    waiters.erase(id);
+    if (auto* ids = parked.find(waiter->key)) {
+        ids->erase(std::remove(ids->begin(), ids->end(), id), ids->end());
+        if (ids->empty()) parked.erase(waiter->key);
+    }
+    ready.push_back(waiter->handle);
+}
+
+void CoroExecutor::wake(uint64_t key)
+{
+    bool resumed = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto* ids = parked.find(key);
+        if (!ids) return;
+        std::vector<uint64_t> candidates = *ids;
+        for (uint64_t id : candidates) {
+            Waiter* waiter = *waiters.find(id);
+            if (!waiter->ready()) continue;
+            waiter->result = true;
+            unpark(id, waiter);   // its timeout entry goes stale
+            resumed = true;
+        }
+    }
+    if (resumed) cv.notify_all();
+}
+
+void CoroExecutor::spawn(Task<void> task)
+{
+    spawnCount.fetch_add(1, std::memory_order_relaxed);
+    uint64_t live = liveCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t peak = peakCount.load(std::memory_order_relaxed);
+    while (live > peak && !peakCount.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    runDetached(*this, std::move(task));
+}
+
+CoroExecutor::Detached CoroExecutor::runDetached(CoroExecutor& executor, Task<void> task)
+{
+    co_await executor.schedule();
+    try {
+        co_await std::move(task);
+    } catch (const std::exception& e) {
+        std::cerr << "[Coro] Task failed: " << e.what() << std::endl;
+    }
+    executor.liveCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CoroExecutor::worker()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        int64_t now = nowMs();
+        while (!timers.empty() && timers.top().dueMs <= now) {
+            Due due = timers.top();
+            timers.pop();
+            if (!due.waiterId) {
+                ready.push_back(due.handle);
+                continue;
+            }
+            Waiter** waiter = waiters.find(due.waiterId);
+            if (!waiter) continue;   // woken before its timeout
+            Waiter* w = *waiter;
+            w->result = w->ready();
+            if (!w->result) timeoutCount.fetch_add(1, std::memory_order_relaxed);
+            unpark(due.waiterId, w);
+        }
+
+        if (!ready.empty()) {
+            auto h = ready.front();
+            ready.pop_front();
+            lock.unlock();
+            resumeCount.fetch_add(1, std::memory_order_relaxed);
+            h.resume();
+            lock.lock();
+            continue;
+        }
+
+        if (timers.empty()) cv.wait(lock);
+        else cv.wait_until(lock, Clock::time_point(std::chrono::milliseconds(timers.top().dueMs)));
+    }
+}
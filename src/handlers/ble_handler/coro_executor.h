@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "coro_task.h"
+#include "flat_map.h"
+
+// A few threads that resume suspended BLE workflows. A coroutine waiting
+// for a D-Bus reply, a timeout or a device state change holds no thread,
+// so thousands of connect/read/write sequences can be in flight at once.
+//
+//   co_await executor.schedule();               continue on a worker
+//   co_await executor.sleep(2000);              retry delay
+//   bool ok = co_await executor.waitFor(mac, [dev] { return dev->getConnected(); }, 10000);
+//
+// waitFor() parks the coroutine under a key until wake(key) finds its
+// predicate true or the timeout passes; the predicate runs under the
+// executor lock, so it must be a cheap read that does not call back in.
+//
+// Timers are a min-heap served by whichever worker is idle. Work left when
+// stop() is called is dropped: suspended frames are not resumed again.
+
+class CoroExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CoroExecutor() = default;
+    ~CoroExecutor();
+
+    CoroExecutor(const CoroExecutor&) = delete;
+    CoroExecutor& operator=(const CoroExecutor&) = delete;
+
+    void start(size_t threads);
+    void stop();
+
+    // Thread-safe: resumes h on a worker
+    void post(std::coroutine_handle<> h);
+
+    struct ScheduleAwaiter {
+        CoroExecutor& executor;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { executor.post(h); }
+        void await_resume() const noexcept {}
+    };
+    ScheduleAwaiter schedule() { return ScheduleAwaiter{*this}; }
+
+    struct SleepAwaiter {
+        CoroExecutor& executor;
+        int64_t delayMs;
+        bool await_ready() const noexcept { return delayMs <= 0; }
+        void await_suspend(std::coroutine_handle<> h) { executor.addTimer(delayMs, h, 0); }
+        void await_resume() const noexcept {}
+    };
+    SleepAwaiter sleep(int64_t delayMs) { return SleepAwaiter{*this, delayMs}; }
+
+    struct Waiter {
+        uint64_t key = 0;
+        std::function<bool()> ready;
+        std::coroutine_handle<> handle;
+        bool result = false;
+    };
+    struct WaitAwaiter {
+        CoroExecutor& executor;
+        Waiter waiter;
+        int64_t timeoutMs;
+        bool await_ready() { return waiter.result = waiter.ready(); }
+        bool await_suspend(std::coroutine_handle<> h) { return executor.park(waiter, h, timeoutMs); }
+        bool await_resume() const noexcept { return waiter.result; }
+    };
+    // True once ready() held after a wake(key), false on timeout
+    WaitAwaiter waitFor(uint64_t key, std::function<bool()> ready, int64_t timeoutMs) {
+        return WaitAwaiter{*this, Waiter{key, std::move(ready), {}, false}, timeoutMs};
+    }
+    // Thread-safe: re-checks the waiters parked under key
+    void wake(uint64_t key);
+
+    // Runs task to completion on the workers; exceptions are logged
+    void spawn(Task<void> task);
+
+    // Blocks the calling thread until task finished. Never call it from a
+    // worker: the task may need that worker to make progress.
+    template <typename T>
+    T runSync(Task<T> task) {
+        auto result = std::make_shared<std::promise<T>>();
+        auto future = result->get_future();
+        spawn(deliver(std::move(task), result));
+        return future.get();
+    }
+
+    size_t threads() const { return workers.size(); }
+    uint64_t spawned() const { return spawnCount.load(std::memory_order_relaxed); }
+    uint64_t inFlight() const { return liveCount.load(std::memory_order_relaxed); }
+    uint64_t peakInFlight() const { return peakCount.load(std::memory_order_relaxed); }
+    uint64_t resumes() const { return resumeCount.load(std::memory_order_relaxed); }
+    uint64_t timedOut() const { return timeoutCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Due {
+        int64_t dueMs;
+        uint64_t seq;
+        std::coroutine_handle<> handle;   // sleep
+        uint64_t waiterId;                // waitFor timeout, 0 for sleep
+        bool operator>(const Due& other) const {
+            return dueMs != other.dueMs ? dueMs > other.dueMs : seq > other.seq;
+        }
+    };
+
+    static int64_t nowMs();
+    void addTimer(int64_t delayMs, std::coroutine_handle<> h, uint64_t waiterId);
+    // False if ready() already holds, then the caller does not suspend
+    bool park(Waiter& waiter, std::coroutine_handle<> h, int64_t timeoutMs);
+    // Call with mtx held
+    void unpark(uint64_t id, Waiter* waiter);
+    void worker();
+
+    struct Detached;
+    static Detached runDetached(CoroExecutor& executor, Task<void> task);
+
+    template <typename T>
+    static Task<void> deliver(Task<T> task, std::shared_ptr<std::promise<T>> result) {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await std::move(task);
+                result->set_value();
+            } else {
+                result->set_value(co_await std::move(task));
+            }
+        } catch (...) {
+            result->set_exception(std::current_exception());
+        }
+    }
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> timers;
+    uint64_t timerSeq = 0;
+    FlatMap<uint64_t, Waiter*> waiters;                 // by id
+    FlatMap<uint64_t, std::vector<uint64_t>> parked;    // key -> waiter ids
+    uint64_t nextWaiterId = 1;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    std::atomic<uint64_t> spawnCount{0};
+    std::atomic<uint64_t> liveCount{0};
+    std::atomic<uint64_t> peakCount{0};
+    std::atomic<uint64_t> resumeCount{0};
+    std::atomic<uint64_t> timeoutCount{0};
+};
@@ -0,0 +1,156 @@
+#include "device_ownership.h"
+
+#include <climits>
+
+DeviceOwnership::DeviceOwnership(std::string self, int64_t nowMs) : selfId(std::move(self)), startMs(nowMs)
+{
+    ownedSet.reserve(64);
+    challenges.reserve(16);
+}
+
+bool DeviceOwnership::outranks(int16_t rssiA, const std::string& a, int16_t rssiB, const std::string& b)
+{
+    return rssiA != rssiB ? rssiA > rssiB : a < b;
+}
+
+void DeviceOwnership::peerUpdate(const std::string& peer, const std::vector<OwnershipBid>& bids,
+                                 const std::vector<MacAddr>& owned, int64_t nowMs)
+{
+    if (peer == selfId) return;
+    std::lock_guard<std::mutex> lock(mtx);
+    Peer& p = peersById[peer];
+    p.lastMs = nowMs;
+    p.bids.clear();
+    p.owned.clear();
+    for (const auto& b : bids) p.bids.emplace(b.mac, b.rssi);
+    for (MacAddr mac : owned) p.owned.insert(mac);
+}
+
+void DeviceOwnership::peerGone(const std::string& peer)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    peersById.erase(peer);
+}
+
+void DeviceOwnership::expirePeers(int64_t nowMs)
+{
+    for (auto it = peersById.begin(); it != peersById.end();) {
+        if (nowMs - it->second.lastMs > PEER_TIMEOUT_MS) it = peersById.erase(it);
+        else ++it;
+    }
+}
+
+void DeviceOwnership::evaluate(const std::vector<OwnershipBid>& local, int64_t nowMs, std::vector<Decision>& out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    expirePeers(nowMs);
+
+    FlatMap<MacAddr, OwnershipBid> mine;
+    mine.reserve(local.size());
+    for (const auto& b : local) mine.emplace(b.mac, b);
+
+    // Held devices: crossed claims first, then handoffs
+    std::vector<MacAddr> held;
+    held.reserve(ownedSet.size());
+    ownedSet.forEach([&held](MacAddr mac) { held.push_back(mac); });
+    for (MacAddr mac : held) {
+        const OwnershipBid* myBid = mine.find(mac);
+        int16_t my = myBid ? myBid->rssi : INT16_MIN;
+        std::string best;
+        int16_t bestRssi = INT16_MIN;
+        std::string rival;   // another holder with a better bid
+        for (const auto& [id, p] : peersById) {
+            const int16_t* bid = p.bids.find(mac);
+            int16_t rssi = bid ? *bid : INT16_MIN;
+            if (p.owned.contains(mac) && rival.empty() && outranks(rssi, id, my, selfId)) rival = id;
+            if (bid && (best.empty() || outranks(rssi, id, bestRssi, best))) {
+                best = id;
+                bestRssi = rssi;
+            }
+        }
+
+        bool release = false;
+        if (!rival.empty()) {
+            conflictCount.fetch_add(1, std::memory_order_relaxed);
+            best = rival;
+            release = true;
+        } else if (!best.empty() && !(myBid && myBid->connected) &&
+                   (!myBid || int(bestRssi) >= int(my) + HYSTERESIS_DB)) {
+            auto [c, inserted] = challenges.emplace(mac);
+            if (inserted || c->peer != best) {
+                c->peer = best;
+                c->sinceMs = nowMs;
+            }
+            release = nowMs - c->sinceMs >= HANDOFF_HOLD_MS;
+        } else {
+            challenges.erase(mac);
+        }
+        if (!release) continue;
+
+        ownedSet.erase(mac);
+        challenges.erase(mac);
+        releaseCount.fetch_add(1, std::memory_order_relaxed);
+        out.push_back(Decision{mac, Change::Released, best});
+    }
+
+    // Unclaimed devices this instance hears best
+    if (nowMs - startMs < SETTLE_MS) return;
+    for (const auto& b : local) {
+        if (ownedSet.contains(b.mac)) continue;
+        bool taken = false;
+        for (const auto& [id, p] : peersById) {
+            const int16_t* bid = p.bids.find(b.mac);
+            if (p.owned.contains(b.mac) || (bid && outranks(*bid, id, b.rssi, selfId))) {
+                taken = true;
+                break;
+            }
+        }
+        if (taken) continue;
+        ownedSet.insert(b.mac);
+        acquireCount.fetch_add(1, std::memory_order_relaxed);
+        out.push_back(Decision{b.mac, Change::Acquired, std::string()});
+    }
+}
+
+void DeviceOwnership::forget(MacAddr mac)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    ownedSet.erase(mac);
+    challenges.erase(mac);
+}
+
+bool DeviceOwnership::owns(MacAddr mac) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return ownedSet.contains(mac);
+}
+
+std::string DeviceOwnership::owner(MacAddr mac) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (ownedSet.contains(mac)) return selfId;
+    for (const auto& [id, p] : peersById)
+        if (p.owned.contains(mac)) return id;
+    return std::string();
+}
+
+std::vector<MacAddr> DeviceOwnership::ownedDevices() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<MacAddr> out;
+    out.reserve(ownedSet.size());
+    ownedSet.forEach([&out](MacAddr mac) { out.push_back(mac); });
+    return out;
+}
+
+size_t DeviceOwnership::peers() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return peersById.size();
+}
+
+size_t DeviceOwnership::ownedCount() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return ownedSet.size();
+}
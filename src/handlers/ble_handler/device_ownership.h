@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// Splits the registered devices between several ble_handler instances
+// (one per Bluetooth host) sharing one broker. Every instance gossips its
+// bids (smoothed RSSI of the devices it hears) and the devices it holds.
+// Each instance decides only for itself from what it last heard:
+//
+//  - an unclaimed device goes to the best bidder: highest RSSI, ties to
+//    the smaller instance id. Nothing is claimed during the first
+//    SETTLE_MS, so a new instance learns the existing claims first.
+//  - the holder keeps the device until another instance beats its bid
+//    by HYSTERESIS_DB for HANDOFF_HOLD_MS without a break. Then it
+//    releases; the challenger takes the now unclaimed device on its
+//    next evaluation. A device is never connected from two hosts on
+//    purpose, and a few dB of fading do not move it back and forth.
+//    A connected device is not handed off: it stops advertising, so the
+//    other bids are old, and a working link is not given up for them.
+//  - if two instances claimed the same device (views crossed), the one
+//    with the worse bid gives it up.
+//  - a peer silent for PEER_TIMEOUT_MS (or whose last will arrived) is
+//    gone; its devices are unclaimed.
+//
+// Thread-safe.
+
+struct OwnershipBid {
+    MacAddr mac = 0;
+    int16_t rssi = 0;
+    bool connected = false;     // this instance's link to it is up
+};
+
+class DeviceOwnership {
+public:
+    static constexpr int HYSTERESIS_DB = 8;
+    static constexpr int64_t HANDOFF_HOLD_MS = 10000;
+    static constexpr int64_t PEER_TIMEOUT_MS = 10000;
+    static constexpr int64_t SETTLE_MS = 5000;
+
+    enum class Change { None, Acquired, Released };
+    struct Decision {
+        MacAddr mac = 0;
+        Change change = Change::None;
+        std::string peer;       // Released: the instance taking over, if known
+    };
+
+    DeviceOwnership(std::string self, int64_t nowMs);
+
+    DeviceOwnership(const DeviceOwnership&) = delete;
+    DeviceOwnership& operator=(const DeviceOwnership&) = delete;
+
+    // A peer's gossip; replaces what it said before
+    void peerUpdate(const std::string& peer, const std::vector<OwnershipBid>& bids,
+                    const std::vector<MacAddr>& owned, int64_t nowMs);
+    // Its last will arrived
+    void peerGone(const std::string& peer);
+    // Re-decides with the bids of this instance (registered devices it hears
+    // or is connected to); appends what changed for this instance to out
+    void evaluate(const std::vector<OwnershipBid>& local, int64_t nowMs, std::vector<Decision>& out);
+    // Device removed from the registry
+    void forget(MacAddr mac);
+
+    bool owns(MacAddr mac) const;
+    // Holder of the device, this instance included; empty if unclaimed
+    std::string owner(MacAddr mac) const;
+    std::vector<MacAddr> ownedDevices() const;
+    const std::string& self() const { return selfId; }
+
+    size_t peers() const;
+    size_t ownedCount() const;
+    uint64_t acquired() const { return acquireCount.load(std::memory_order_relaxed); }
+    uint64_t released() const { return releaseCount.load(std::memory_order_relaxed); }
+    uint64_t conflicts() const { return conflictCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Peer {
+        int64_t lastMs = 0;
+        FlatMap<MacAddr, int16_t> bids;
+        FlatSet<MacAddr> owned;
+    };
+    struct Challenge {
+        std::string peer;
+        int64_t sinceMs = 0;
+    };
+
+    // a outranks b: better RSSI, ties to the smaller id
+    static bool outranks(int16_t rssiA, const std::string& a, int16_t rssiB, const std::string& b);
+    void expirePeers(int64_t nowMs);
+
+    const std::string selfId;
+    const int64_t startMs;
+    mutable std::mutex mtx;
+    std::map<std::string, Peer> peersById;
+    FlatSet<MacAddr> ownedSet;
+    FlatMap<MacAddr, Challenge> challenges;
+
+    std::atomic<uint64_t> acquireCount{0};
+    std::atomic<uint64_t> releaseCount{0};
+    std::atomic<uint64_t> conflictCount{0};
+};
@@ -0,0 +1,154 @@
+#include "device_query.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using json = nlohmann::json;
+
+struct FieldName {
+    const char* name;
+    DeviceField field;
+};
+
+constexpr FieldName FIELD_NAMES[] = {
+    {"name", DF_NAME},           {"path", DF_PATH},         {"discovered", DF_DISCOVERED},
+    {"connected", DF_CONNECTED}, {"paired", DF_PAIRED},     {"trusted", DF_TRUSTED},
+    {"rssi", DF_RSSI},           {"last_seen", DF_LAST_SEEN}, {"characteristics", DF_CHARACTERISTICS},
+    {"link", DF_LINK},           {"owner", DF_OWNER},
+};
+
+bool parseBoolFilter(const json& filter, const char* key, std::optional<bool>& out, std::string& error)
+{
+    auto it = filter.find(key);
+    if (it == filter.end() || it->is_null()) return true;
+    if (!it->is_boolean()) {
+        error = std::string("filter ") + key + " must be true or false";
+        return false;
+    }
+    out = it->get<bool>();
+    return true;
+}
+
+json linkJson(const LinkQuality& q)
+{
+    json j;
+    j["present"] = q.present;
+    if (q.rssiSamples > 0) {
+        j["rssi"] = std::lround(q.rssiDbm);
+        j["rssi_spread"] = std::lround(q.rssiSpreadDb);
+    }
+    if (q.advIntervalMs > 0) j["adv_interval_ms"] = std::lround(q.advIntervalMs);
+    if (q.connectAttempts > 0) j["connect_success"] = std::round(q.connectSuccess * 100) / 100;
+    return j;
+}
+
+json recordJson(const DeviceRecord& r, uint32_t fields)
+{
+    json j;
+    j["mac"] = macToString(r.mac);
+    if (fields & DF_NAME) j["name"] = r.name;
+    if (fields & DF_PATH) j["path"] = r.path;
+    if (fields & DF_DISCOVERED) j["discovered"] = r.discovered;
+    if (fields & DF_CONNECTED) j["connected"] = r.connected;
+    if (fields & DF_PAIRED) j["paired"] = r.paired;
+    if (fields & DF_TRUSTED) j["trusted"] = r.trusted;
+    if (fields & DF_RSSI) j["rssi"] = r.rssi;
+    if (fields & DF_LAST_SEEN) j["last_seen"] = r.lastSeenMs;
+    if (fields & DF_CHARACTERISTICS) {
+        json& uuids = j["characteristics"] = json::array();
+        for (const auto& uuid : r.uuids) uuids.push_back(uuidToString(uuid));
+    }
+    if ((fields & DF_LINK) && r.hasLink) j["link"] = linkJson(r.link);
+    if ((fields & DF_OWNER) && !r.owner.empty()) j["owner"] = r.owner;
+    return j;
+}
+
+} // namespace
+
+bool DeviceQuery::parse(const json& j, DeviceQuery& out, std::string& error)
+{
+    out = DeviceQuery{};
+    if (auto it = j.find("filter"); it != j.end() && !it->is_null()) {
+        const json& filter = *it;
+        if (!filter.is_object()) {
+            error = "filter must be an object";
+            return false;
+        }
+        if (!parseBoolFilter(filter, "discovered", out.discovered, error) ||
+            !parseBoolFilter(filter, "connected", out.connected, error) ||
+            !parseBoolFilter(filter, "paired", out.paired, error) ||
+            !parseBoolFilter(filter, "trusted", out.trusted, error))
+            return false;
+        out.namePrefix = filter.value("name_prefix", "");
+        if (auto u = filter.find("has_uuid"); u != filter.end() && !u->is_null()) {
+            Uuid128 uuid;
+            if (!u->is_string() || !parseUuid(u->get<std::string>(), uuid)) {
+                error = "filter has_uuid must be a UUID";
+                return false;
+            }
+            out.hasUuid = uuid;
+        }
+    }
+
+    if (auto it = j.find("fields"); it != j.end() && !it->is_null()) {
+        if (!it->is_array()) {
+            error = "fields must be an array of names";
+            return false;
+        }
+        out.fields = 0;
+        for (const auto& f : *it) {
+            std::string name = f.is_string() ? f.get<std::string>() : f.dump();
+            auto known = std::find_if(std::begin(FIELD_NAMES), std::end(FIELD_NAMES),
+                                      [&](const FieldName& n) { return name == n.name; });
+            if (known == std::end(FIELD_NAMES)) {
+                error = "Unknown field " + name;
+                return false;
+            }
+            out.fields |= known->field;
+        }
+    }
+
+    if (auto it = j.find("cursor"); it != j.end() && !it->is_null()) {
+        if (!it->is_string() || !parseMac(it->get<std::string>(), out.after)) {
+            error = "cursor must be a MAC address";
+            return false;
+        }
+    }
+
+    out.limit = std::clamp<size_t>(j.value("limit", DEFAULT_LIMIT), 1, MAX_LIMIT);
+    return true;
+}
+
+bool DeviceQuery::matches(const DeviceRecord& r) const
+{
+    if (discovered && r.discovered != *discovered) return false;
+    if (connected && r.connected != *connected) return false;
+    if (paired && r.paired != *paired) return false;
+    if (trusted && r.trusted != *trusted) return false;
+    if (!namePrefix.empty() && r.name.compare(0, namePrefix.size(), namePrefix) != 0) return false;
+    if (hasUuid && !std::binary_search(r.uuids.begin(), r.uuids.end(), *hasUuid)) return false;
+    return true;
+}
+
+void runDeviceQuery(const DeviceQuerySnapshot& snapshot, const DeviceQuery& q, json& resp)
+{
+    const auto& records = snapshot.records;
+    auto it = std::upper_bound(records.begin(), records.end(), q.after,
+                               [](MacAddr mac, const DeviceRecord& r) { return mac < r.mac; });
+
+    json& out = resp["devices"] = json::array();
+    size_t matched = 0;
+    MacAddr last = 0;
+    for (; it != records.end(); ++it) {
+        if (!q.matches(*it)) continue;
+        if (++matched <= q.limit) {
+            out.push_back(recordJson(*it, q.fields));
+            last = it->mac;
+        }
+    }
+    resp["matched"] = matched;
+    resp["snapshot_ts"] = snapshot.takenMs;
+    if (matched > q.limit) resp["next_cursor"] = macToString(last);
+}
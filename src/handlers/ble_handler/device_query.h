@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "ble_keys.h"
+#include "link_quality.h"
+
+// query_devices: the registry as paged JSON for the hub, e.g.
+//
+//   {"command": "query_devices", "filter": {"connected": true,
+//    "name_prefix": "ATC_", "has_uuid": "0000fcd2-0000-1000-8000-00805f9b34fb"},
+//    "fields": ["name", "rssi", "link"], "limit": 200, "cursor": "A4:C1:38:00:12:34"}
+//
+// Queries run against a DeviceQuerySnapshot: every device copied once, in
+// MAC order, under its own lock. The snapshot is immutable and shared, so
+// filtering and serializing hold no lock and several queries (or the pages
+// of one) read the same copy. The cursor is the last MAC of the previous
+// page; a device added between pages shows up in its place, one removed
+// is simply not there, and nothing is returned twice.
+
+struct DeviceRecord {
+    MacAddr mac = 0;
+    std::string name;
+    std::string path;
+    bool discovered = false;
+    bool connected = false;
+    bool paired = false;
+    bool trusted = false;
+    int16_t rssi = 0;           // last RSSI from BlueZ, 0 = unknown
+    int64_t lastSeenMs = 0;
+    std::vector<Uuid128> uuids; // resolved characteristics, sorted
+    bool hasLink = false;
+    LinkQuality link;
+    std::string owner;          // instance holding the device, scale-out only
+};
+
+struct DeviceQuerySnapshot {
+    std::vector<DeviceRecord> records;  // sorted by mac
+    int64_t takenMs = 0;                // unix time in ms
+};
+
+// Projection; mac is always returned
+enum DeviceField : uint32_t {
+    DF_NAME            = 1u << 0,
+    DF_PATH            = 1u << 1,
+    DF_DISCOVERED      = 1u << 2,
+    DF_CONNECTED       = 1u << 3,
+    DF_PAIRED          = 1u << 4,
+    DF_TRUSTED         = 1u << 5,
+    DF_RSSI            = 1u << 6,
+    DF_LAST_SEEN       = 1u << 7,
+    DF_CHARACTERISTICS = 1u << 8,
+    DF_LINK            = 1u << 9,
+    DF_OWNER           = 1u << 10,
+};
+constexpr uint32_t DF_DEFAULT = DF_NAME | DF_DISCOVERED | DF_CONNECTED | DF_PAIRED | DF_TRUSTED;
+
+struct DeviceQuery {
+    static constexpr size_t DEFAULT_LIMIT = 100;
+    static constexpr size_t MAX_LIMIT = 1000;
+
+    std::optional<bool> discovered;
+    std::optional<bool> connected;
+    std::optional<bool> paired;
+    std::optional<bool> trusted;
+    std::string namePrefix;
+    std::optional<Uuid128> hasUuid;
+    uint32_t fields = DF_DEFAULT;
+    MacAddr after = 0;          // cursor, 0 = first page
+    size_t limit = DEFAULT_LIMIT;
+
+    // From the command JSON; false with error set on a bad filter, field or cursor
+    static bool parse(const nlohmann::json& j, DeviceQuery& out, std::string& error);
+
+    bool matches(const DeviceRecord& r) const;
+};
+
+// One page: {"devices": [...], "matched": n, "next_cursor": mac} into resp.
+// matched counts every match from the cursor on; next_cursor is absent on
+// the last page.
+void runDeviceQuery(const DeviceQuerySnapshot& snapshot, const DeviceQuery& q, nlohmann::json& resp);
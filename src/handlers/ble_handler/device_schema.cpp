@@ -0,0 +1,362 @@
+#include "device_schema.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <nlohmann/json.hpp>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+std::string CharacteristicSchema::validate(int64_t value) const
+{
+    if (isBool && value != 0 && value != 1)
+        return name + " accepts only 0 or 1";
+
+    if (hasRange && (value < minValue || value > maxValue))
+        return name + " accepts values in [" + std::to_string(minValue) + ", " + std::to_string(maxValue) + "]";
+
+    if (length > 0 && length < 8) {
+        int64_t limit = int64_t(1) << (length * 8);
+        if (value < 0 || value >= limit)
+            return name + " does not fit in " + std::to_string(length) + " bytes";
+    }
+    return "";
+}
+
+const CharacteristicSchema* DeviceSchema::findByName(const std::string& charName) const
+{
+    auto it = byName.find(charName);
+    return it == byName.end() ? nullptr : &characteristics[it->second];
+}
+
+const CharacteristicSchema* DeviceSchema::findByUuid(const Uuid128& uuid) const
+{
+    const uint32_t* idx = byUuid.find(uuid);
+    return idx ? &characteristics[*idx] : nullptr;
+}
+
+const DeviceSchema* SchemaIndex::findDevice(const std::string& idOrMac) const
+{
+    if (auto it = byId.find(idOrMac); it != byId.end()) return &devices[it->second];
+    MacAddr mac;
+    return parseMac(idOrMac, mac) ? findDevice(mac) : nullptr;
+}
+
+const DeviceSchema* SchemaIndex::findDevice(MacAddr mac) const
+{
+    const uint32_t* idx = byMac.find(mac);
+    return idx ? &devices[*idx] : nullptr;
+}
+
+namespace {
+
+bool parseHexByte(const std::string& text, uint8_t& out)
+{
+    try {
+        size_t used = 0;
+        unsigned long v = std::stoul(text, &used, 16);
+        if (used != text.size() || v > 0xFF) return false;
+        out = static_cast<uint8_t>(v);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// "uint8", "sint16", "uint24", ... whole bytes only
+bool parseDataType(const std::string& text, uint8_t& size, bool& isSigned)
+{
+    if (text.size() < 5 || (text.rfind("uint", 0) != 0 && text.rfind("sint", 0) != 0)) return false;
+    int bits = std::atoi(text.c_str() + 4);
+    if (bits <= 0 || bits > 64 || bits % 8 != 0) return false;
+    size = static_cast<uint8_t>(bits / 8);
+    isSigned = text[0] == 's';
+    return true;
+}
+
+void parseAcceptedValues(const std::string& devId, const json& accepted, CharacteristicSchema& chr)
+{
+    if (!accepted.is_object()) return;
+
+    // Plain value constraints: {"type": "int", "range": [lo, hi]} or {"type": "bool"}
+    if (accepted.contains("type") && accepted["type"].is_string()) {
+        std::string type = accepted["type"];
+        chr.isBool = type == "bool";
+
+        if (accepted.contains("range") && accepted["range"].is_array()) {
+            const auto& range = accepted["range"];
+            bool numeric = !range.empty() && range.size() <= 2;
+            for (const auto& v : range) numeric = numeric && v.is_number_integer();
+
+            if (numeric) {
+                chr.hasRange = true;
+                chr.minValue = range.front().get<int64_t>();
+                chr.maxValue = range.back().get<int64_t>();
+            } else {
+                std::cerr << "[Schema] " << devId << "/" << chr.name << ": invalid range, ignored" << std::endl;
+            }
+        }
+        return;
+    }
+
+    // BTHome object table: {"battery": {"id": "0x01", "data type": "uint8", ...}, ...}
+    for (const auto& [objName, obj] : accepted.items()) {
+        if (!obj.is_object() || !obj.contains("id") || !obj["id"].is_string()) continue;
+
+        std::string idText = obj["id"];
+        if (idText.rfind("0x", 0) == 0 || idText.rfind("0X", 0) == 0) idText = idText.substr(2);
+
+        BTHomeObjectSchema object;
+        object.name = objName;
+        if (!parseHexByte(idText, object.id)) {
+            std::cerr << "[Schema] " << devId << "/" << chr.name << ": bad BTHome id for " << objName << std::endl;
+            continue;
+        }
+        object.dataType = obj.value("data type", "");
+        if (!parseDataType(object.dataType, object.size, object.isSigned))
+            std::cerr << "[Schema] " << devId << "/" << chr.name << ": unsupported data type \""
+                      << object.dataType << "\" for " << objName << std::endl;
+        // the config spells this key "scale facctor"
+        if (obj.contains("scale factor") && obj["scale factor"].is_number()) object.scale = obj["scale factor"];
+        else if (obj.contains("scale facctor") && obj["scale facctor"].is_number()) object.scale = obj["scale facctor"];
+        chr.bthomeObjects.push_back(std::move(object));
+    }
+}
+
+void parsePoll(const std::string& devId, const json& p, CharacteristicSchema& chr)
+{
+    // Either a bare interval or {"interval_ms", "min_interval_ms", "max_interval_ms"}
+    int64_t interval = 0, minMs = 0, maxMs = 0;
+    if (p.is_number_integer()) interval = p;
+    else if (p.is_object()) {
+        interval = p.value("interval_ms", int64_t(0));
+        minMs    = p.value("min_interval_ms", int64_t(0));
+        maxMs    = p.value("max_interval_ms", int64_t(0));
+    }
+
+    if (interval < 1000 || interval > 86400000) {
+        std::cerr << "[Schema] " << devId << "/" << chr.name << ": invalid poll interval, not polled" << std::endl;
+        return;
+    }
+    if (!chr.readable) {
+        std::cerr << "[Schema] " << devId << "/" << chr.name << ": poll on a non-readable characteristic, ignored" << std::endl;
+        return;
+    }
+
+    // Adapts between a quarter and eight times the configured interval unless told otherwise
+    if (minMs <= 0 || minMs > interval) minMs = std::max<int64_t>(1000, interval / 4);
+    if (maxMs < interval) maxMs = std::min<int64_t>(86400000, interval * 8);
+
+    chr.pollIntervalMs = static_cast<uint32_t>(interval);
+    chr.pollMinMs      = static_cast<uint32_t>(minMs);
+    chr.pollMaxMs      = static_cast<uint32_t>(maxMs);
+}
+
+bool parseCharacteristic(const std::string& devId, const std::string& charName, const json& c, CharacteristicSchema& chr)
+{
+    if (!c.is_object() || !c.contains("uuid") || !c["uuid"].is_string()) {
+        std::cerr << "[Schema] " << devId << "/" << charName << ": missing uuid, skipped" << std::endl;
+        return false;
+    }
+
+    chr.name = charName;
+    if (!parseUuid(c["uuid"].get<std::string>(), chr.uuid)) {
+        std::cerr << "[Schema] " << devId << "/" << charName << ": invalid uuid "
+                  << c["uuid"].get<std::string>() << ", skipped" << std::endl;
+        return false;
+    }
+    chr.uuidStr = uuidToString(chr.uuid);
+    chr.type    = c.value("type", "");
+    chr.notify  = c.value("notify", false);
+
+    if (c.contains("length") && c["length"].is_number_integer()) {
+        chr.length = c["length"];
+        if (chr.length <= 0) {
+            std::cerr << "[Schema] " << devId << "/" << charName << ": invalid length, treated as variable" << std::endl;
+            chr.length = -1;
+        }
+    }
+
+    if (c.contains("Properties") && c["Properties"].is_array()) {
+        for (const auto& p : c["Properties"]) {
+            if (!p.is_string()) continue;
+            std::string prop = p;
+            std::transform(prop.begin(), prop.end(), prop.begin(), ::tolower);
+            if (prop.rfind("read", 0) == 0) chr.readable = true;
+            else if (prop.rfind("write without response", 0) == 0) chr.writeWithoutResponse = true;
+            else if (prop.rfind("write", 0) == 0) chr.writable = true;
+            else if (prop.rfind("notify", 0) == 0 || prop.rfind("indicate", 0) == 0) chr.notify = true;
+        }
+    }
+
+    if (c.contains("accepted values")) parseAcceptedValues(devId, c["accepted values"], chr);
+    if (c.contains("poll")) parsePoll(devId, c["poll"], chr);
+    return true;
+}
+
+} // namespace
+
+std::shared_ptr<const SchemaIndex> loadSchemaIndex(const std::string& file, std::string& error)
+{
+    std::ifstream in(file);
+    if (!in) {
+        error = "cannot open " + file;
+        return nullptr;
+    }
+
+    json root;
+    try {
+        root = json::parse(in);
+    } catch (const json::exception& e) {
+        error = std::string("parse error: ") + e.what();
+        return nullptr;
+    }
+
+    if (!root.contains("devices") || !root["devices"].is_object()) {
+        error = "missing \"devices\" object";
+        return nullptr;
+    }
+
+    auto index = std::make_shared<SchemaIndex>();
+    for (const auto& [devId, d] : root["devices"].items()) {
+        if (!d.is_object() || d.value("protocol", "") != "BLE") continue;
+
+        DeviceSchema dev;
+        dev.id   = devId;
+        dev.name = d.value("device_name", "");
+        dev.mac  = d.value("ble_address", "");
+        std::transform(dev.mac.begin(), dev.mac.end(), dev.mac.begin(), ::toupper);
+        if (!dev.mac.empty() && !parseMac(dev.mac, dev.macAddr))
+            std::cerr << "[Schema] " << devId << ": invalid ble_address " << dev.mac << std::endl;
+
+        if (d.contains("characteristics") && d["characteristics"].is_object()) {
+            for (const auto& [charName, c] : d["characteristics"].items()) {
+                CharacteristicSchema chr;
+                if (!parseCharacteristic(devId, charName, c, chr)) continue;
+
+                if (dev.byUuid.contains(chr.uuid)) {
+                    std::cerr << "[Schema] " << devId << "/" << charName << ": duplicate uuid, skipped" << std::endl;
+                    continue;
+                }
+                auto idx = static_cast<uint32_t>(dev.characteristics.size());
+                dev.byName[chr.name] = idx;
+                dev.byUuid[chr.uuid] = idx;
+                dev.characteristics.push_back(std::move(chr));
+            }
+        }
+
+        auto idx = static_cast<uint32_t>(index->devices.size());
+        index->byId[dev.id] = idx;
+        if (dev.macAddr) index->byMac[dev.macAddr] = idx;
+        index->devices.push_back(std::move(dev));
+    }
+    return index;
+}
+
+SchemaStore::SchemaStore(std::string file) : file(std::move(file)) {}
+
+SchemaStore::~SchemaStore()
+{
+    stopWatching();
+}
+
+bool SchemaStore::reload()
+{
+    std::string error;
+    auto next = loadSchemaIndex(file, error);
+    if (!next) {
+        // Keep serving the previous index; a half-written file must not wipe it
+        std::cerr << "[Schema] Reload of " << file << " failed: " << error << std::endl;
+        return false;
+    }
+
+    size_t chars = 0;
+    for (const auto& dev : next->devices) chars += dev.characteristics.size();
+    std::cout << "[Schema] Loaded " << next->devices.size() << " BLE devices, "
+              << chars << " characteristics from " << file << std::endl;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    index = std::move(next);
+    return true;
+}
+
+std::shared_ptr<const SchemaIndex> SchemaStore::get() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return index;
+}
+
+bool SchemaStore::startWatching()
+{
+    if (watcher.joinable()) return true;
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd < 0 || wakeFd < 0) {
+        std::cerr << "[Schema] inotify unavailable: " << std::strerror(errno) << std::endl;
+        stopWatching();
+        return false;
+    }
+
+    auto dir = std::filesystem::path(file).parent_path();
+    if (dir.empty()) dir = ".";
+    if (inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        std::cerr << "[Schema] Cannot watch " << dir << ": " << std::strerror(errno) << std::endl;
+        stopWatching();
+        return false;
+    }
+
+    stopRequested = false;
+    watcher = std::thread([this]() { watchLoop(); });
+    return true;
+}
+
+void SchemaStore::stopWatching()
+{
+    stopRequested = true;
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        (void)!write(wakeFd, &one, sizeof(one));
+    }
+    if (watcher.joinable()) watcher.join();
+    if (inotifyFd >= 0) close(inotifyFd);
+    if (wakeFd >= 0) close(wakeFd);
+    inotifyFd = wakeFd = -1;
+}
+
+void SchemaStore::watchLoop()
+{
+    const std::string fileName = std::filesystem::path(file).filename();
+    alignas(inotify_event) char buffer[4096];
+
+    while (!stopRequested) {
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[Schema] poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (fds[1].revents) return;
+
+        bool changed = false;
+        ssize_t len;
+        while ((len = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* ptr = buffer; ptr < buffer + len;) {
+                auto* ev = reinterpret_cast<inotify_event*>(ptr);
+                if (ev->len > 0 && fileName == ev->name) changed = true;
+                ptr += sizeof(inotify_event) + ev->len;
+            }
+        }
+
+        if (changed) reload();
+    }
+}
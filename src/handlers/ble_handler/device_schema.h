@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// In-memory index of the BLE devices described in devices_config.json.
+// Only entries with "protocol": "BLE" are loaded.
+
+struct BTHomeObjectSchema {
+    std::string name;          // e.g. "illuminance"
+    uint8_t id = 0;            // BTHome object id
+    std::string dataType;      // e.g. "uint24"
+    double scale = 1.0;
+    uint8_t size = 0;          // bytes on the wire, 0 if dataType is not understood
+    bool isSigned = false;
+};
+
+struct CharacteristicSchema {
+    std::string name;          // friendly name from the config
+    Uuid128 uuid;
+    std::string uuidStr;       // canonical lowercase form, as BlueZ reports it
+    std::string type;          // "byte", "array", ...
+    int length = -1;           // bytes, -1 = variable
+    bool readable = false;
+    bool writable = false;
+    bool writeWithoutResponse = false;
+    bool notify = false;
+
+    // accepted values
+    bool isBool = false;
+    bool hasRange = false;
+    int64_t minValue = 0;
+    int64_t maxValue = 0;
+    std::vector<BTHomeObjectSchema> bthomeObjects;
+
+    // "poll": {"interval_ms", "min_interval_ms", "max_interval_ms"}, 0 = not polled
+    uint32_t pollIntervalMs = 0;
+    uint32_t pollMinMs = 0;
+    uint32_t pollMaxMs = 0;
+
+    // Returns an empty string when the value is acceptable
+    std::string validate(int64_t value) const;
+};
+
+struct DeviceSchema {
+    std::string id;            // key in devices_config.json, e.g. "motion_sensor_1"
+    std::string name;          // device_name
+    std::string mac;           // ble_address
+    MacAddr macAddr = 0;       // packed ble_address, 0 if absent
+    std::vector<CharacteristicSchema> characteristics;
+    std::unordered_map<std::string, uint32_t> byName;   // friendly name -> index
+    FlatMap<Uuid128, uint32_t> byUuid;                  // uuid -> index
+
+    const CharacteristicSchema* findByName(const std::string& charName) const;
+    const CharacteristicSchema* findByUuid(const Uuid128& uuid) const;
+};
+
+struct SchemaIndex {
+    std::vector<DeviceSchema> devices;
+    std::unordered_map<std::string, uint32_t> byId;     // config id -> index
+    FlatMap<MacAddr, uint32_t> byMac;                   // MAC -> index
+
+    const DeviceSchema* findDevice(const std::string& idOrMac) const;
+    const DeviceSchema* findDevice(MacAddr mac) const;
+};
+
+// Parses the config file, returns nullptr (and fills error) if it cannot be read
+std::shared_ptr<const SchemaIndex> loadSchemaIndex(const std::string& file, std::string& error);
+
+// Holds the current index and swaps in a new one when the file changes.
+// Readers take a shared_ptr copy so a reload never invalidates an index
+// that an in-flight operation is still using.
+class SchemaStore {
+public:
+    explicit SchemaStore(std::string file);
+    ~SchemaStore();
+
+    SchemaStore(const SchemaStore&) = delete;
+    SchemaStore& operator=(const SchemaStore&) = delete;
+
+    bool reload();
+    std::shared_ptr<const SchemaIndex> get() const;
+
+    // inotify watch on the config directory (editors replace the file with a rename)
+    bool startWatching();
+    void stopWatching();
+
+private:
+    void watchLoop();
+
+    std::string file;
+    mutable std::mutex mtx;
+    std::shared_ptr<const SchemaIndex> index;
+    std::thread watcher;
+    std::atomic<bool> stopRequested{false};
+    int inotifyFd = -1;
+    int wakeFd = -1;
+};
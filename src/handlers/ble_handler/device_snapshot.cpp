@@ -0,0 +1,267 @@
+#include "device_snapshot.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'B', 'L', 'E', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+// Version 1 records lack the trailing gattHash; they still load
+constexpr uint32_t SNAPSHOT_MIN_VERSION = 1;
+constexpr size_t DEVICE_RECORD_V1_SIZE = 48;
+
+constexpr uint8_t FLAG_PAIRED  = 1 << 0;
+constexpr uint8_t FLAG_TRUSTED = 1 << 1;
+
+#pragma pack(push, 1)
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t deviceCount;
+    uint32_t charCount;
+    uint32_t stringBytes;
+    int64_t savedAtMs;
+    uint32_t checksum;     // FNV-1a over everything after the header
+    uint32_t reserved;
+};
+
+struct StringRef {
+    uint32_t offset;       // into the string pool
+    uint32_t length;
+};
+
+struct SnapshotDeviceRecord {
+    StringRef address;
+    StringRef path;
+    StringRef name;
+    uint32_t firstChar;    // index into the characteristic records
+    uint32_t charCount;
+    int64_t lastSeenMs;
+    int16_t lastRssi;
+    uint8_t flags;
+    uint8_t reserved[5];
+    StringRef gattHash;    // since version 2
+};
+
+struct SnapshotCharRecord {
+    StringRef uuid;
+    StringRef path;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(SnapshotHeader) == 40, "snapshot header layout changed");
+static_assert(sizeof(SnapshotDeviceRecord) == 56, "snapshot device record layout changed");
+static_assert(sizeof(SnapshotCharRecord) == 16, "snapshot characteristic record layout changed");
+
+uint32_t fnv1a(const uint8_t* data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+StringRef appendString(std::string& pool, const std::string& value)
+{
+    StringRef ref{static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(value.size())};
+    pool.append(value);
+    return ref;
+}
+
+// write() until every byte is out; a short write is not an error
+bool writeAll(int fd, const void* data, size_t len)
+{
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Keeps the mapping alive for the duration of a load
+struct MappedFile {
+    int fd = -1;
+    void* data = MAP_FAILED;
+    size_t size = 0;
+
+    ~MappedFile() {
+        if (data != MAP_FAILED) munmap(data, size);
+        if (fd >= 0) close(fd);
+    }
+};
+
+} // namespace
+
+bool saveDeviceSnapshot(const std::string& file, const std::vector<DeviceSnapshotEntry>& entries)
+{
+    std::vector<SnapshotDeviceRecord> deviceRecords;
+    std::vector<SnapshotCharRecord> charRecords;
+    std::string pool;
+    deviceRecords.reserve(entries.size());
+
+    for (const auto& entry : entries) {
+        SnapshotDeviceRecord rec{};
+        rec.address    = appendString(pool, entry.address);
+        rec.path       = appendString(pool, entry.path);
+        rec.name       = appendString(pool, entry.name);
+        rec.gattHash   = appendString(pool, entry.gattHash);
+        rec.firstChar  = static_cast<uint32_t>(charRecords.size());
+        rec.charCount  = static_cast<uint32_t>(entry.characteristics.size());
+        rec.lastSeenMs = entry.lastSeenMs;
+        rec.lastRssi   = entry.lastRssi;
+        rec.flags      = (entry.paired ? FLAG_PAIRED : 0) | (entry.trusted ? FLAG_TRUSTED : 0);
+
+        for (const auto& [uuid, path] : entry.characteristics) {
+            SnapshotCharRecord chr{};
+            chr.uuid = appendString(pool, uuid);
+            chr.path = appendString(pool, path);
+            charRecords.push_back(chr);
+        }
+        deviceRecords.push_back(rec);
+    }
+
+    std::string body;
+    body.append(reinterpret_cast<const char*>(deviceRecords.data()), deviceRecords.size() * sizeof(SnapshotDeviceRecord));
+    body.append(reinterpret_cast<const char*>(charRecords.data()), charRecords.size() * sizeof(SnapshotCharRecord));
+    body.append(pool);
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version     = SNAPSHOT_VERSION;
+    header.deviceCount = static_cast<uint32_t>(deviceRecords.size());
+    header.charCount   = static_cast<uint32_t>(charRecords.size());
+    header.stringBytes = static_cast<uint32_t>(pool.size());
+    header.savedAtMs   = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+    header.checksum    = fnv1a(reinterpret_cast<const uint8_t*>(body.data()), body.size());
+
+    // Write to a temp file and rename so a crash never leaves a torn snapshot
+    std::error_code ec;
+    auto parent = std::filesystem::path(file).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+    std::string tmpFile = file + ".tmp";
+    int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "[Snapshot] Failed to open " << tmpFile << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    bool ok = writeAll(fd, &header, sizeof(header)) && writeAll(fd, body.data(), body.size()) && fsync(fd) == 0;
+    close(fd);
+
+    if (!ok || rename(tmpFile.c_str(), file.c_str()) != 0) {
+        std::cerr << "[Snapshot] Failed to write " << file << ": " << std::strerror(errno) << std::endl;
+        unlink(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadDeviceSnapshot(const std::string& file, std::vector<DeviceSnapshotEntry>& entries)
+{
+    MappedFile mapped;
+    mapped.fd = open(file.c_str(), O_RDONLY);
+    if (mapped.fd < 0) return false; // no snapshot yet
+
+    struct stat st{};
+    if (fstat(mapped.fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+        std::cerr << "[Snapshot] " << file << " is truncated, ignoring" << std::endl;
+        return false;
+    }
+    mapped.size = static_cast<size_t>(st.st_size);
+    mapped.data = mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, mapped.fd, 0);
+    if (mapped.data == MAP_FAILED) {
+        std::cerr << "[Snapshot] mmap failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    const auto* base = static_cast<const uint8_t*>(mapped.data);
+    SnapshotHeader header;
+    std::memcpy(&header, base, sizeof(header));
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version < SNAPSHOT_MIN_VERSION || header.version > SNAPSHOT_VERSION) {
+        std::cerr << "[Snapshot] " << file << " has an unknown format, ignoring" << std::endl;
+        return false;
+    }
+
+    size_t recordSize   = header.version == 1 ? DEVICE_RECORD_V1_SIZE : sizeof(SnapshotDeviceRecord);
+    size_t devicesBytes = static_cast<size_t>(header.deviceCount) * recordSize;
+    size_t charsBytes   = static_cast<size_t>(header.charCount) * sizeof(SnapshotCharRecord);
+    size_t bodyBytes    = devicesBytes + charsBytes + header.stringBytes;
+    if (sizeof(SnapshotHeader) + bodyBytes != mapped.size) {
+        std::cerr << "[Snapshot] " << file << " size mismatch, ignoring" << std::endl;
+        return false;
+    }
+
+    const uint8_t* body = base + sizeof(SnapshotHeader);
+    if (fnv1a(body, bodyBytes) != header.checksum) {
+        std::cerr << "[Snapshot] " << file << " checksum mismatch, ignoring" << std::endl;
+        return false;
+    }
+
+    const uint8_t* deviceBase = body;
+    const uint8_t* charBase   = body + devicesBytes;
+    const char* pool          = reinterpret_cast<const char*>(charBase + charsBytes);
+
+    auto readString = [&](const StringRef& ref, std::string& out) {
+        if (static_cast<uint64_t>(ref.offset) + ref.length > header.stringBytes) return false;
+        out.assign(pool + ref.offset, ref.length);
+        return true;
+    };
+
+    std::vector<DeviceSnapshotEntry> loaded;
+    loaded.reserve(header.deviceCount);
+
+    for (uint32_t i = 0; i < header.deviceCount; ++i) {
+        SnapshotDeviceRecord rec{};
+        std::memcpy(&rec, deviceBase + i * recordSize, recordSize);
+
+        DeviceSnapshotEntry entry;
+        if (!readString(rec.address, entry.address) ||
+            !readString(rec.path, entry.path) ||
+            !readString(rec.name, entry.name) ||
+            !readString(rec.gattHash, entry.gattHash) ||
+            static_cast<uint64_t>(rec.firstChar) + rec.charCount > header.charCount) {
+            std::cerr << "[Snapshot] " << file << " has a corrupt record, ignoring" << std::endl;
+            return false;
+        }
+        entry.paired     = rec.flags & FLAG_PAIRED;
+        entry.trusted    = rec.flags & FLAG_TRUSTED;
+        entry.lastRssi   = rec.lastRssi;
+        entry.lastSeenMs = rec.lastSeenMs;
+
+        entry.characteristics.reserve(rec.charCount);
+        for (uint32_t c = rec.firstChar; c < rec.firstChar + rec.charCount; ++c) {
+            SnapshotCharRecord chr;
+            std::memcpy(&chr, charBase + c * sizeof(SnapshotCharRecord), sizeof(chr));
+            std::string uuid, path;
+            if (!readString(chr.uuid, uuid) || !readString(chr.path, path)) {
+                std::cerr << "[Snapshot] " << file << " has a corrupt characteristic, ignoring" << std::endl;
+                return false;
+            }
+            entry.characteristics.emplace_back(std::move(uuid), std::move(path));
+        }
+        loaded.push_back(std::move(entry));
+    }
+
+    entries = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// On-disk snapshot of the device registry so the handler can warm start
+// without waiting for the hub to resend add_devices.
+//
+// Layout (little-endian, all offsets relative to the start of the file):
+//   SnapshotHeader
+//   SnapshotDeviceRecord[deviceCount]
+//   SnapshotCharRecord[charCount]
+//   string pool (stringBytes)
+// Every record is fixed size so the loader can walk the file straight out of
+// an mmap'd view without parsing.
+
+struct DeviceSnapshotEntry {
+    std::string address;       // MAC address
+    std::string path;          // D-Bus object path
+    std::string name;
+    bool paired = false;
+    bool trusted = false;
+    int16_t lastRssi = 0;      // dBm, 0 = unknown
+    int64_t lastSeenMs = 0;    // unix time in ms, 0 = never
+    std::string gattHash;      // GATT Database Hash (hex) the characteristics were read under, empty = none
+    std::vector<std::pair<std::string, std::string>> characteristics; // UUID, Path
+};
+
+bool saveDeviceSnapshot(const std::string& file, const std::vector<DeviceSnapshotEntry>& entries);
+bool loadDeviceSnapshot(const std::string& file, std::vector<DeviceSnapshotEntry>& entries);
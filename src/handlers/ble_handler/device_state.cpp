@@ -0,0 +1,103 @@
+#include "device_state.h"
+
+namespace {
+
+using json = nlohmann::json;
+
+// Applies patch to target, records what changed in delta
+bool mergeInto(json& target, const json& patch, json& delta)
+{
+    bool changed = false;
+    for (const auto& [key, value] : patch.items()) {
+        if (value.is_object()) {
+            json& sub = target[key];
+            if (!sub.is_object()) sub = json::object();
+            json subDelta = json::object();
+            if (mergeInto(sub, value, subDelta)) {
+                delta[key] = std::move(subDelta);
+                changed = true;
+            }
+        } else if (value.is_null()) {
+            if (target.erase(key)) {
+                delta[key] = nullptr;
+                changed = true;
+            }
+        } else if (auto it = target.find(key); it == target.end() || *it != value) {
+            target[key] = value;
+            delta[key] = value;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+bool DeviceStateTable::merge(MacAddr mac, const json& fragment, json& state, json& delta)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    auto [doc, inserted] = states.emplace(mac, json::object());
+    delta = json::object();
+    if (!mergeInto(*doc, fragment, delta)) {
+        unchangedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    state = *doc;
+    changeCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void DeviceStateTable::erase(MacAddr mac)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    states.erase(mac);
+}
+
+std::vector<std::pair<MacAddr, DeviceStateTable::json>> DeviceStateTable::all() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<std::pair<MacAddr, json>> out;
+    out.reserve(states.size());
+    for (const auto& [mac, doc] : states)
+        if (!doc.empty()) out.emplace_back(mac, doc);
+    return out;
+}
+
+size_t DeviceStateTable::devices() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return states.size();
+}
+
+void TopicAliases::reset(uint16_t maximum)
+{
+    max = maximum;
+    lru.clear();
+    byTopic.clear();
+}
+
+uint16_t TopicAliases::resolve(const std::string& topic, bool& sendTopic)
+{
+    sendTopic = true;
+    if (max == 0) return 0;
+
+    if (auto it = byTopic.find(topic); it != byTopic.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        sendTopic = false;
+        ++aliasedCount;
+        savedBytes += topic.size();
+        return it->second->alias;
+    }
+
+    uint16_t alias;
+    if (byTopic.size() < max) {
+        alias = static_cast<uint16_t>(byTopic.size() + 1);
+    } else {
+        alias = lru.back().alias;   // rebind the least recently used
+        byTopic.erase(lru.back().topic);
+        lru.pop_back();
+    }
+    lru.push_front(Binding{topic, alias});
+    byTopic[topic] = lru.begin();
+    return alias;
+}
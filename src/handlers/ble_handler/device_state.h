@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// Per-device state for the retained topics
+//
+//   home-automation/ble/<mac>/state   retained, the full state document
+//   home-automation/ble/<mac>/event   the fields one update changed
+//
+// Updates are JSON fragments merged into the document: objects merge key
+// by key, null removes a key, anything else replaces. Only what differs
+// from the document ends up in the delta, so a repeated value publishes
+// nothing. A hub that starts subscribes to home-automation/ble/+/state and
+// has every device from the retained messages. Thread-safe.
+
+class DeviceStateTable {
+public:
+    using json = nlohmann::json;
+
+    // Merges fragment into the state of mac. On a change, state is the new
+    // document and delta holds the changed fields; false if nothing changed.
+    bool merge(MacAddr mac, const json& fragment, json& state, json& delta);
+    // Device removed from the registry
+    void erase(MacAddr mac);
+    // Copy of every non-empty document, to publish them again after a
+    // reconnect (changes merged while offline were never published)
+    std::vector<std::pair<MacAddr, json>> all() const;
+
+    size_t devices() const;
+    uint64_t changes() const { return changeCount.load(std::memory_order_relaxed); }
+    uint64_t unchanged() const { return unchangedCount.load(std::memory_order_relaxed); }
+
+private:
+    mutable std::mutex mtx;
+    FlatMap<MacAddr, json> states;
+    std::atomic<uint64_t> changeCount{0};
+    std::atomic<uint64_t> unchangedCount{0};
+};
+
+// MQTT v5 topic aliases, client to broker. The first publish on a topic
+// carries the topic and binds an alias to it; later ones send an empty
+// topic and just the alias (3 bytes instead of 2 + topic length). The
+// broker sets how many aliases it accepts (Topic Alias Maximum in the
+// CONNACK). Once they are all bound, the least recently used alias is
+// bound to the new topic. Bindings belong to one network connection, so
+// reset() on every (re)connect, and use them for QoS 0 only: a QoS 1
+// message is retransmitted on a resumed session, where its alias is
+// unknown. Not thread-safe: the caller holds the
+// lock that also orders the publishes, since a binding must go out before
+// any publish that relies on it.
+class TopicAliases {
+public:
+    void reset(uint16_t maximum);
+    // Alias to publish with, 0 = none (send the topic only). sendTopic is
+    // set when the topic must go along to (re)bind the alias.
+    uint16_t resolve(const std::string& topic, bool& sendTopic);
+
+    uint16_t maximum() const { return max; }
+    size_t bound() const { return byTopic.size(); }
+    uint64_t aliased() const { return aliasedCount; }
+    uint64_t bytesSaved() const { return savedBytes; }
+
+private:
+    struct Binding {
+        std::string topic;
+        uint16_t alias;
+    };
+
+    uint16_t max = 0;
+    std::list<Binding> lru;     // front = most recently used
+    std::unordered_map<std::string, std::list<Binding>::iterator> byTopic;
+    uint64_t aliasedCount = 0;
+    uint64_t savedBytes = 0;
+};
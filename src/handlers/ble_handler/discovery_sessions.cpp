@@ -0,0 +1,182 @@
+#include "discovery_sessions.h"
+
+#include <algorithm>
+#include <cctype>
+
+using json = nlohmann::json;
+
+namespace {
+
+std::string lower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+bool matches(const DiscoveryFilter& f, const Sighting& s)
+{
+    if (f.minRssi != DISCOVERY_ANY_RSSI && (!s.hasRssi || s.rssi < f.minRssi)) return false;
+
+    if (!f.names.empty()) {
+        if (s.name.empty()) return false;
+        std::string name = lower(s.name);
+        if (std::none_of(f.names.begin(), f.names.end(),
+                         [&](const std::string& n) { return name.find(n) != std::string::npos; }))
+            return false;
+    }
+
+    if (!f.uuids.empty()) {
+        if (std::none_of(f.uuids.begin(), f.uuids.end(), [&](const Uuid128& u) {
+                return std::find(s.uuids.begin(), s.uuids.end(), u) != s.uuids.end();
+            }))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string DiscoverySessions::parseFilter(const json& request, DiscoveryFilter& out)
+{
+    DiscoveryFilter f;
+    try {
+        f.durationMs = request.value("duration_ms", f.durationMs);
+        if (f.durationMs <= 0 || f.durationMs > MAX_DURATION_MS)
+            return "duration_ms must be between 1 and " + std::to_string(MAX_DURATION_MS);
+
+        if (request.contains("min_rssi")) {
+            int rssi = request["min_rssi"];
+            if (rssi < -127 || rssi > 20) return "min_rssi out of range";
+            f.minRssi = static_cast<int16_t>(rssi);
+        }
+
+        f.maxRate = request.value("max_rate", f.maxRate);
+
+        for (const auto& n : request.value("names", json::array())) {
+            std::string name = n;
+            if (!name.empty()) f.names.push_back(lower(name));
+        }
+        for (const auto& u : request.value("uuids", json::array())) {
+            Uuid128 uuid;
+            if (!parseUuid(u.get<std::string>(), uuid)) return "invalid uuid " + u.get<std::string>();
+            f.uuids.push_back(uuid);
+        }
+    } catch (const json::exception& e) {
+        return std::string("invalid filter: ") + e.what();
+    }
+    out = std::move(f);
+    return "";
+}
+
+std::string DiscoverySessions::start(const std::string& id, const DiscoveryFilter& filter, int64_t nowMs, bool& first)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (std::any_of(list.begin(), list.end(), [&](const Session& s) { return s.id == id; }))
+        return "session " + id + " is already running";
+    if (list.size() >= MAX_SESSIONS) return "too many discovery sessions";
+
+    Session s;
+    s.id = id;
+    s.filter = filter;
+    s.startMs = nowMs;
+    s.endMs = nowMs + filter.durationMs;
+    s.tokens = filter.maxRate;
+    s.refillMs = nowMs;
+    s.seen.reserve(64);
+    s.summary.session = id;
+
+    first = list.empty();
+    list.push_back(std::move(s));
+    running.store(list.size(), std::memory_order_relaxed);
+    return "";
+}
+
+void DiscoverySessions::finish(size_t index, int64_t nowMs, const char* reason, DiscoverySummary& out)
+{
+    Session& s = list[index];
+    s.summary.reason = reason;
+    s.summary.elapsedMs = nowMs - s.startMs;
+    s.summary.dropped += s.pending.size();
+    out = s.summary;
+    list.erase(list.begin() + static_cast<std::ptrdiff_t>(index));
+    running.store(list.size(), std::memory_order_relaxed);
+}
+
+bool DiscoverySessions::stop(const std::string& id, int64_t nowMs, DiscoverySummary& out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (list[i].id != id) continue;
+        finish(i, nowMs, "stopped", out);
+        return true;
+    }
+    return false;
+}
+
+void DiscoverySessions::stopAll(int64_t nowMs, std::vector<DiscoverySummary>& out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    while (!list.empty()) {
+        out.emplace_back();
+        finish(list.size() - 1, nowMs, "stopped", out.back());
+    }
+}
+
+bool DiscoverySessions::takeToken(Session& s, int64_t nowMs)
+{
+    if (s.filter.maxRate == 0) return true;
+    double rate = s.filter.maxRate;
+    s.tokens = std::min(rate, s.tokens + (nowMs - s.refillMs) * rate / 1000.0);
+    s.refillMs = nowMs;
+    if (s.tokens < 1.0) return false;
+    s.tokens -= 1.0;
+    return true;
+}
+
+void DiscoverySessions::offer(const Sighting& sighting, int64_t nowMs, std::vector<DiscoveryResult>& out)
+{
+    if (!active()) return;
+    offered.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (Session& s : list) {
+        if (s.seen.contains(sighting.mac)) {
+            ++s.summary.duplicates;
+            continue;
+        }
+        if (!matches(s.filter, sighting)) continue;
+
+        // Queued results keep queue order, a new one never jumps ahead
+        if (s.pending.empty() && takeToken(s, nowMs)) {
+            out.push_back(DiscoveryResult{s.id, sighting});
+            ++s.summary.results;
+            emitted.fetch_add(1, std::memory_order_relaxed);
+        } else if (s.pending.size() < MAX_PENDING) {
+            s.pending.push_back(sighting);
+        } else {
+            ++s.summary.dropped;
+            continue;   // not marked seen, a later sighting may still get through
+        }
+        s.seen.insert(sighting.mac);
+    }
+}
+
+void DiscoverySessions::tick(int64_t nowMs, std::vector<DiscoveryResult>& out, std::vector<DiscoverySummary>& ended)
+{
+    if (!active()) return;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (Session& s : list) {
+        while (!s.pending.empty() && takeToken(s, nowMs)) {
+            out.push_back(DiscoveryResult{s.id, std::move(s.pending.front())});
+            s.pending.pop_front();
+            ++s.summary.results;
+            emitted.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = list.size(); i-- > 0;) {
+        if (nowMs < list[i].endMs) continue;
+        ended.emplace_back();
+        finish(i, nowMs, "timeout", ended.back());
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// On-demand discovery sessions for pairing UIs. A hub client starts a
+// session with scan_devices_on and receives matching devices as they are
+// sighted, each device once per session, until the session runs out or is
+// stopped with scan_devices_off.
+//
+// Sessions share one BlueZ discovery: start() reports the first session
+// and the caller turns the radio on, the periodic discovery cycle is held
+// open while any session is active. Per session a token bucket caps the
+// result rate; results over the cap wait in a bounded queue that tick()
+// drains.
+
+constexpr int16_t DISCOVERY_ANY_RSSI = INT16_MIN;
+
+struct DiscoveryFilter {
+    int16_t minRssi = DISCOVERY_ANY_RSSI;
+    std::vector<std::string> names;   // lower case, any substring matches; empty = any name
+    std::vector<Uuid128> uuids;       // any advertised service UUID matches; empty = any
+    uint32_t maxRate = 20;            // results per second, 0 = unlimited
+    int64_t durationMs = 30000;
+};
+
+struct Sighting {
+    MacAddr mac = 0;
+    bool hasRssi = false;
+    int16_t rssi = 0;
+    std::string name;
+    std::vector<Uuid128> uuids;
+};
+
+struct DiscoveryResult {
+    std::string session;
+    Sighting sighting;
+};
+
+struct DiscoverySummary {
+    std::string session;
+    std::string reason;      // "timeout" or "stopped"
+    int64_t elapsedMs = 0;
+    uint64_t results = 0;
+    uint64_t duplicates = 0; // sightings of devices already reported
+    uint64_t dropped = 0;    // over the rate limit with a full queue
+};
+
+class DiscoverySessions {
+public:
+    static constexpr size_t MAX_SESSIONS = 8;
+    static constexpr size_t MAX_PENDING = 256;
+    static constexpr int64_t MAX_DURATION_MS = 10 * 60 * 1000;
+
+    // {"duration_ms", "min_rssi", "names": [...], "uuids": [...], "max_rate"}.
+    // Returns an error message, empty on success.
+    static std::string parseFilter(const nlohmann::json& request, DiscoveryFilter& out);
+
+    // first is set when no other session was running, i.e. the radio has to start
+    std::string start(const std::string& id, const DiscoveryFilter& filter, int64_t nowMs, bool& first);
+    bool stop(const std::string& id, int64_t nowMs, DiscoverySummary& out);
+    void stopAll(int64_t nowMs, std::vector<DiscoverySummary>& out);
+
+    // Matches a sighting against every session. Cheap when nothing is running.
+    void offer(const Sighting& s, int64_t nowMs, std::vector<DiscoveryResult>& out);
+
+    // Releases rate limited results and ends sessions that ran out
+    void tick(int64_t nowMs, std::vector<DiscoveryResult>& out, std::vector<DiscoverySummary>& ended);
+
+    bool active() const { return running.load(std::memory_order_relaxed) > 0; }
+    size_t sessions() const { return running.load(std::memory_order_relaxed); }
+    uint64_t sightings() const { return offered.load(std::memory_order_relaxed); }
+    uint64_t results() const { return emitted.load(std::memory_order_relaxed); }
+
+private:
+    struct Session {
+        std::string id;
+        DiscoveryFilter filter;
+        int64_t startMs = 0;
+        int64_t endMs = 0;
+        double tokens = 0;
+        int64_t refillMs = 0;
+        FlatSet<MacAddr> seen;          // devices already reported or queued
+        std::deque<Sighting> pending;   // held back by the rate limit
+        DiscoverySummary summary;
+    };
+
+    bool takeToken(Session& s, int64_t nowMs);
+    void finish(size_t index, int64_t nowMs, const char* reason, DiscoverySummary& out);
+
+    std::mutex mtx;
+    std::vector<Session> list;
+    std::atomic<size_t> running{0};
+    std::atomic<uint64_t> offered{0};
+    std::atomic<uint64_t> emitted{0};
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Bounded lock-free multi-producer / single-consumer queue (Vyukov ring with
+// a sequence number per cell). Producers never block and never take a lock:
+// tryPush() fails when the ring is full and the caller decides what to drop.
+//
+// The consumer sleeps on an eventfd; producers only write to it when the
+// consumer announced it is about to sleep, so a busy consumer costs the
+// producers nothing but the ring operations.
+
+template <typename T>
+class EventQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit EventQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        cells.reset(new Cell[n]);
+        mask = n - 1;
+        for (size_t i = 0; i < n; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    ~EventQueue() {
+        if (wakeFd >= 0) close(wakeFd);
+    }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // Approximate, for stats only
+    size_t depth() const {
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        return tail >= head ? tail - head : 0;
+    }
+
+    bool tryPush(T&& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false; // full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        pushed.fetch_add(1, std::memory_order_relaxed);
+
+        // Pairs with the fence in wait(): either the consumer sees the new
+        // element or we see that it is going to sleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) notify();
+        return true;
+    }
+
+    // Consumer side, single thread only
+    bool tryPop(T& out) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = &cells[pos & mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) return false; // empty
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        out = std::move(cell->value);
+        cell->value = T{};
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocks until something was pushed, wake() was called or the timeout ran out
+    void wait(int timeoutMs) {
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (depth() == 0) {
+            pollfd pfd{wakeFd, POLLIN, 0};
+            if (poll(&pfd, 1, timeoutMs) > 0) {
+                uint64_t count;
+                (void)!read(wakeFd, &count, sizeof(count));
+            }
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    // Wakes the consumer regardless of the queue state (shutdown)
+    void wake() { notify(); }
+
+    uint64_t pushedCount() const { return pushed.load(std::memory_order_relaxed); }
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    void notify() {
+        uint64_t one = 1;
+        (void)!write(wakeFd, &one, sizeof(one));
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    int wakeFd = -1;
+
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+    alignas(64) std::atomic<bool> sleeping{false};
+    std::atomic<uint64_t> pushed{0};
+    std::atomic<uint64_t> dropped{0};
+};
@@ -0,0 +1,265 @@
+#include "event_reactor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+
+// epoll data for the reactor's own descriptors; watched fds use their number
+constexpr uint64_t WAKE_TAG  = UINT64_MAX;
+constexpr uint64_t TIMER_TAG = UINT64_MAX - 1;
+
+} // namespace
+
+EventReactor::~EventReactor()
+{
+    close();
+}
+
+int64_t EventReactor::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+}
+
+bool EventReactor::open()
+{
+    if (epollFd >= 0) return true;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    epoll_event wake{};
+    wake.events = EPOLLIN;
+    wake.data.u64 = WAKE_TAG;
+    epoll_event timer{};
+    timer.events = EPOLLIN;
+    timer.data.u64 = TIMER_TAG;
+    if (epollFd < 0 || wakeFd < 0 || timerFd < 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wake) != 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &timer) != 0) {
+        std::cerr << "[Reactor] Setup failed: " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    armedMs = -1;
+    stopRequested = false;   // a stop() before run() still counts
+    return true;
+}
+
+void EventReactor::close()
+{
+    if (epollFd >= 0) ::close(epollFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+    if (timerFd >= 0) ::close(timerFd);
+    epollFd = wakeFd = timerFd = -1;
+    fds.clear();
+    timers.clear();
+    dueHeap = {};
+}
+
+bool EventReactor::watch(int fd, uint32_t events, FdHandler handler)
+{
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = static_cast<uint64_t>(fd);
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        std::cerr << "[Reactor] Cannot watch fd " << fd << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    fds[fd] = std::move(handler);
+    return true;
+}
+
+bool EventReactor::modify(int fd, uint32_t events)
+{
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = static_cast<uint64_t>(fd);
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventReactor::unwatch(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    fds.erase(fd);
+}
+
+void EventReactor::addPrepareHook(PrepareHook hook)
+{
+    prepareHooks.push_back(std::move(hook));
+}
+
+EventReactor::TimerId EventReactor::after(int64_t delayMs, Task fn)
+{
+    return addTimer(delayMs, 0, std::move(fn));
+}
+
+EventReactor::TimerId EventReactor::every(int64_t periodMs, Task fn)
+{
+    return addTimer(periodMs, periodMs > 0 ? periodMs : 1, std::move(fn));
+}
+
+EventReactor::TimerId EventReactor::addTimer(int64_t delayMs, int64_t periodMs, Task fn)
+{
+    TimerId id = nextTimerId++;
+    Timer& timer = timers[id];
+    timer.fn = std::move(fn);
+    timer.periodMs = periodMs;
+    dueHeap.push(Due{nowMs() + std::max<int64_t>(delayMs, 0), id});
+    return id;
+}
+
+void EventReactor::cancel(TimerId id)
+{
+    timers.erase(id);   // its heap entry is skipped when it surfaces
+}
+
+void EventReactor::post(Task fn)
+{
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(postMutex);
+        wasEmpty = postQueue.empty();
+        postQueue.push_back(std::move(fn));
+    }
+    postCount.fetch_add(1, std::memory_order_relaxed);
+    if (wasEmpty && wakeFd >= 0) {
+        uint64_t one = 1;
+        (void)!write(wakeFd, &one, sizeof(one));
+    }
+}
+
+void EventReactor::stop()
+{
+    stopRequested = true;
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        (void)!write(wakeFd, &one, sizeof(one));
+    }
+}
+
+void EventReactor::armTimerFd()
+{
+    while (!dueHeap.empty() && !timers.contains(dueHeap.top().id)) dueHeap.pop();
+    int64_t due = dueHeap.empty() ? -1 : dueHeap.top().dueMs;
+    if (due == armedMs) return;
+    armedMs = due;
+
+    // Absolute CLOCK_MONOTONIC, the same clock as steady_clock; zero disarms
+    itimerspec spec{};
+    if (due >= 0) {
+        spec.it_value.tv_sec = due / 1000;
+        spec.it_value.tv_nsec = (due % 1000) * 1000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void EventReactor::runTimers()
+{
+    int64_t now = nowMs();
+    while (!dueHeap.empty() && dueHeap.top().dueMs <= now) {
+        Due due = dueHeap.top();
+        dueHeap.pop();
+        Timer* timer = timers.find(due.id);
+        if (!timer) continue;   // cancelled
+
+        // The callback may add or cancel timers, which can move this entry
+        Task fn = timer->fn;
+        if (timer->periodMs > 0) {
+            int64_t next = due.dueMs + timer->periodMs;
+            dueHeap.push(Due{next > now ? next : now + timer->periodMs, due.id});
+        } else {
+            timers.erase(due.id);
+        }
+        timerCount.fetch_add(1, std::memory_order_relaxed);
+        fn();
+    }
+    armedMs = -2;   // heap changed, re-arm before the next wait
+}
+
+void EventReactor::runPosted()
+{
+    {
+        std::lock_guard<std::mutex> lock(postMutex);
+        draining.swap(postQueue);
+    }
+    for (auto& fn : draining) fn();
+    draining.clear();
+}
+
+void EventReactor::run()
+{
+    if (epollFd < 0) return;
+    loopThread = std::this_thread::get_id();
+    isRunning = true;
+    epoll_event events[MAX_EVENTS];
+
+    while (!stopRequested) {
+        int64_t now = nowMs();
+        int64_t timeout = -1;
+        for (auto& hook : prepareHooks) {
+            int64_t t = hook(now);
+            if (t >= 0 && (timeout < 0 || t < timeout)) timeout = t;
+        }
+        runPosted();   // prepare hooks may have posted
+        armTimerFd();
+
+        int n = epoll_wait(epollFd, events, static_cast<int>(MAX_EVENTS),
+                           timeout < 0 ? -1 : static_cast<int>(std::min<int64_t>(timeout, INT32_MAX)));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[Reactor] epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        auto woke = Clock::now();
+        wakeCount.fetch_add(1, std::memory_order_relaxed);
+
+        bool timersDue = false;
+        for (int i = 0; i < n; ++i) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == WAKE_TAG || tag == TIMER_TAG) {
+                uint64_t count;
+                (void)!read(tag == WAKE_TAG ? wakeFd : timerFd, &count, sizeof(count));
+                timersDue |= tag == TIMER_TAG;
+                continue;
+            }
+            FdHandler* handler = fds.find(static_cast<int>(tag));
+            if (!handler) continue;
+            FdHandler fn = *handler;   // the handler may unwatch
+            fdEventCount.fetch_add(1, std::memory_order_relaxed);
+            fn(events[i].events);
+        }
+        if (timersDue || (!dueHeap.empty() && dueHeap.top().dueMs <= nowMs())) runTimers();
+        runPosted();
+
+        busyUsTotal.fetch_add(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - woke).count()),
+            std::memory_order_relaxed);
+    }
+    isRunning = false;
+    loopThread = std::thread::id();
+}
+
+ProcessUsage ProcessUsage::sample()
+{
+    ProcessUsage u;
+    u.wallUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        u.cpuUs = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+        u.voluntarySwitches = static_cast<uint64_t>(ru.ru_nvcsw);
+        u.involuntarySwitches = static_cast<uint64_t>(ru.ru_nivcsw);
+    }
+    return u;
+}
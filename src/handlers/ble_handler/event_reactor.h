@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "flat_map.h"
+
+// Single-threaded event loop for reactor mode (--reactor). One epoll set
+// carries everything that drives the handler:
+//
+//   fds      watched descriptors (the sdbus signal connection) with a
+//            handler run on readiness
+//   prepare  hooks run before every wait; they do the work a library
+//            wants done outside its fd (sdbus processes buffered
+//            messages) and return how long the loop may sleep
+//   timers   one-shot and periodic, on a timerfd armed for the earliest
+//            deadline only, so an idle loop sleeps until the next timer
+//   posts    work handed over from other threads (MQTT callbacks, op
+//            workers finishing), woken through an eventfd that is only
+//            written when the queue goes from empty to non-empty
+//
+// The loop only dispatches; anything that blocks belongs on a worker pool
+// and comes back with post(). There are only a handful of timers, so they
+// sit in a binary heap (cancel is lazy) rather than a timer wheel, which
+// would need a wakeup every tick.
+//
+// All calls except post() and stop() must come from the loop thread once
+// run() has started.
+
+class EventReactor {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+    using Task = std::function<void()>;
+    using FdHandler = std::function<void(uint32_t events)>;
+    // Returns how long the loop may sleep in ms, -1 = no limit
+    using PrepareHook = std::function<int64_t(int64_t nowMs)>;
+
+    static constexpr TimerId INVALID_TIMER = 0;
+    static constexpr size_t MAX_EVENTS = 64;
+
+    EventReactor() = default;
+    ~EventReactor();
+
+    EventReactor(const EventReactor&) = delete;
+    EventReactor& operator=(const EventReactor&) = delete;
+
+    bool open();
+    void close();
+
+    // events are EPOLLIN/EPOLLOUT/...
+    bool watch(int fd, uint32_t events, FdHandler handler);
+    bool modify(int fd, uint32_t events);
+    void unwatch(int fd);
+    void addPrepareHook(PrepareHook hook);
+
+    TimerId after(int64_t delayMs, Task fn);
+    TimerId every(int64_t periodMs, Task fn);
+    void cancel(TimerId id);
+
+    // Thread-safe: runs fn on the loop thread
+    void post(Task fn);
+
+    // Dispatches until stop(); returns at once if not open
+    void run();
+    // Thread-safe
+    void stop();
+    bool inLoop() const { return loopThread == std::this_thread::get_id(); }
+    bool running() const { return isRunning.load(std::memory_order_relaxed); }
+
+    static int64_t nowMs();
+
+    uint64_t wakeups() const { return wakeCount.load(std::memory_order_relaxed); }
+    uint64_t fdEvents() const { return fdEventCount.load(std::memory_order_relaxed); }
+    uint64_t timersFired() const { return timerCount.load(std::memory_order_relaxed); }
+    uint64_t posted() const { return postCount.load(std::memory_order_relaxed); }
+    // Time spent dispatching (not waiting), for a busy ratio
+    uint64_t busyUs() const { return busyUsTotal.load(std::memory_order_relaxed); }
+
+private:
+    struct Timer {
+        Task fn;
+        int64_t periodMs = 0;   // 0 = one shot
+    };
+    struct Due {
+        int64_t dueMs;
+        TimerId id;
+        bool operator>(const Due& other) const { return dueMs > other.dueMs; }
+    };
+
+    TimerId addTimer(int64_t delayMs, int64_t periodMs, Task fn);
+    void armTimerFd();
+    void runTimers();
+    void runPosted();
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    int timerFd = -1;
+    int64_t armedMs = -1;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> isRunning{false};
+    std::thread::id loopThread;
+
+    FlatMap<int, FdHandler> fds;
+    std::vector<PrepareHook> prepareHooks;
+    FlatMap<TimerId, Timer> timers;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> dueHeap;
+    TimerId nextTimerId = 1;
+
+    std::mutex postMutex;
+    std::vector<Task> postQueue;
+    std::vector<Task> draining;  // swapped with postQueue, capacity reused
+
+    std::atomic<uint64_t> wakeCount{0};
+    std::atomic<uint64_t> fdEventCount{0};
+    std::atomic<uint64_t> timerCount{0};
+    std::atomic<uint64_t> postCount{0};
+    std::atomic<uint64_t> busyUsTotal{0};
+};
+
+// CPU time and context switches of the whole process, for comparing the
+// threaded and reactor modes from the stats line
+struct ProcessUsage {
+    int64_t wallUs = 0;
+    int64_t cpuUs = 0;          // user + system
+    uint64_t voluntarySwitches = 0;
+    uint64_t involuntarySwitches = 0;
+
+    static ProcessUsage sample();
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash map with linear probing and backward-shift deletion
+// (no tombstones). Keys and values live inline in one array, so a lookup is
+// a hash plus a short scan over contiguous memory. Meant for small trivially
+// hashable keys such as packed MACs and Uuid128.
+//
+// Not thread-safe; callers keep using their own mutexes.
+
+template <typename K>
+struct FlatHash {
+    size_t operator()(const K& key) const noexcept { return std::hash<K>{}(key); }
+};
+
+// splitmix64 finalizer: packed MACs differ only in the low bits
+template <>
+struct FlatHash<uint64_t> {
+    size_t operator()(uint64_t x) const noexcept {
+        x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return static_cast<size_t>(x);
+    }
+};
+
+template <typename K, typename V, typename Hash = FlatHash<K>>
+class FlatMap {
+    struct Slot {
+        K key{};
+        V value{};
+        bool used = false;
+    };
+
+public:
+    template <bool Const>
+    class Iter {
+        using SlotPtr = std::conditional_t<Const, const Slot*, Slot*>;
+    public:
+        using Ref = std::conditional_t<Const, std::pair<const K&, const V&>, std::pair<const K&, V&>>;
+
+        Iter(SlotPtr pos, SlotPtr end) : pos(pos), end(end) { skip(); }
+        Ref operator*() const { return Ref(pos->key, pos->value); }
+        Iter& operator++() { ++pos; skip(); return *this; }
+        bool operator==(const Iter& other) const { return pos == other.pos; }
+        bool operator!=(const Iter& other) const { return pos != other.pos; }
+
+    private:
+        void skip() { while (pos != end && !pos->used) ++pos; }
+        SlotPtr pos;
+        SlotPtr end;
+    };
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    FlatMap() = default;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return slots.size(); }
+
+    // Keeps the slot array so a map that is refilled in a loop does not reallocate
+    void clear() {
+        if (count == 0) return;
+        for (auto& s : slots) s = Slot{};
+        count = 0;
+    }
+
+    void reserve(size_t n) {
+        size_t want = 8;
+        while (want * 7 / 8 < n) want <<= 1;
+        if (want > slots.size()) rehash(want);
+    }
+
+    V* find(const K& key) {
+        if (slots.empty()) return nullptr;
+        for (size_t i = index(key);; i = (i + 1) & mask()) {
+            Slot& s = slots[i];
+            if (!s.used) return nullptr;
+            if (s.key == key) return &s.value;
+        }
+    }
+
+    const V* find(const K& key) const {
+        return const_cast<FlatMap*>(this)->find(key);
+    }
+
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    // Inserts when absent; returns the value slot and whether it was inserted
+    template <typename... Args>
+    std::pair<V*, bool> emplace(const K& key, Args&&... args) {
+        if ((count + 1) * 8 > slots.size() * 7) rehash(slots.empty() ? 8 : slots.size() * 2);
+        for (size_t i = index(key);; i = (i + 1) & mask()) {
+            Slot& s = slots[i];
+            if (!s.used) {
+                s.key = key;
+                s.value = V(std::forward<Args>(args)...);
+                s.used = true;
+                ++count;
+                return {&s.value, true};
+            }
+            if (s.key == key) return {&s.value, false};
+        }
+    }
+
+    V& operator[](const K& key) { return *emplace(key).first; }
+
+    bool erase(const K& key) {
+        if (slots.empty()) return false;
+        size_t i = index(key);
+        for (;; i = (i + 1) & mask()) {
+            if (!slots[i].used) return false;
+            if (slots[i].key == key) break;
+        }
+
+        // Backward-shift the rest of the cluster so probes never need tombstones
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask(); slots[j].used; j = (j + 1) & mask()) {
+            size_t home = index(slots[j].key);
+            bool movable = hole <= j ? (home <= hole || home > j) : (home <= hole && home > j);
+            if (movable) {
+                slots[hole] = std::move(slots[j]);
+                hole = j;
+            }
+        }
+        slots[hole] = Slot{};
+        --count;
+        return true;
+    }
+
+    iterator begin() { return iterator(slots.data(), slots.data() + slots.size()); }
+    iterator end() { return iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+    const_iterator begin() const { return const_iterator(slots.data(), slots.data() + slots.size()); }
+    const_iterator end() const { return const_iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+
+private:
+    size_t mask() const { return slots.size() - 1; }
+    size_t index(const K& key) const { return Hash{}(key) & mask(); }
+
+    void rehash(size_t newCapacity) {
+        std::vector<Slot> old = std::move(slots);
+        slots.clear();
+        slots.resize(newCapacity);
+        count = 0;
+        for (auto& s : old) {
+            if (s.used) emplace(s.key, std::move(s.value));
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
+
+template <typename K, typename Hash = FlatHash<K>>
+class FlatSet {
+public:
+    size_t size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+    void clear() { map.clear(); }
+    void reserve(size_t n) { map.reserve(n); }
+    bool contains(const K& key) const { return map.contains(key); }
+    bool insert(const K& key) { return map.emplace(key).second; }
+    bool erase(const K& key) { return map.erase(key); }
+
+    template <typename F>
+    void forEach(F&& fn) const {
+        for (const auto& [key, unused] : map) fn(key);
+    }
+
+private:
+    struct Empty {};
+    FlatMap<K, Empty, Hash> map;
+};
@@ -0,0 +1,52 @@
+#include "gatt_discovery.h"
+
+void introspectChildren(std::string_view xml, std::string_view prefix, std::vector<std::string>& out)
+{
+    // BlueZ replies with a flat document: the root <node> holding interface
+    // blocks and one <node name="..."/> per child. Only the name attribute
+    // of node tags matters here, so no XML parser is needed.
+    size_t pos = 0;
+    while ((pos = xml.find("<node", pos)) != std::string_view::npos) {
+        pos += 5;
+        size_t tagEnd = xml.find('>', pos);
+        if (tagEnd == std::string_view::npos) break;
+        std::string_view tag = xml.substr(pos, tagEnd - pos);
+        pos = tagEnd;
+
+        size_t attr = tag.find("name=\"");
+        if (attr == std::string_view::npos) continue;   // root node
+        attr += 6;
+        size_t close = tag.find('"', attr);
+        if (close == std::string_view::npos) continue;
+        std::string_view name = tag.substr(attr, close - attr);
+
+        // The root may carry its own absolute path as name
+        if (name.empty() || name.front() == '/') continue;
+        if (name.substr(0, prefix.size()) == prefix) out.emplace_back(name);
+    }
+}
+
+std::string gattHashHex(const std::vector<uint8_t>& value)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(value.size() * 2);
+    for (uint8_t byte : value) {
+        out.push_back(digits[byte >> 4]);
+        out.push_back(digits[byte & 0xF]);
+    }
+    return out;
+}
+
+void GattRefreshStats::hit(Duration elapsed)
+{
+    hitCount.fetch_add(1, std::memory_order_relaxed);
+    hitTime.record(elapsed);
+}
+
+void GattRefreshStats::walked(Duration elapsed, uint32_t busCalls)
+{
+    walkCount.fetch_add(1, std::memory_order_relaxed);
+    callCount.fetch_add(busCalls, std::memory_order_relaxed);
+    walkTime.record(elapsed);
+}
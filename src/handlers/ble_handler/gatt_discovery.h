@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ble_keys.h"
+#include "latency_histogram.h"
+
+// Scoped GATT discovery. When a device reports ServicesResolved the handler
+// learns its characteristics by walking only the subtree under the device
+// node (Introspect on the device and each service, one UUID Get per
+// characteristic, all in flight at once) instead of a GetManagedObjects
+// over every object BlueZ knows.
+//
+// The walk is skipped entirely when the device exposes the GATT Database
+// Hash characteristic (0x2B2A) and its value matches the hash stored with
+// the cached characteristic map: then the firmware, and so every path, is
+// unchanged and one read is all a reconnect costs.
+
+// Database Hash characteristic, Generic Attribute service
+inline const Uuid128 GATT_DB_HASH_UUID = [] {
+    Uuid128 uuid;
+    parseUuid("2b2a", uuid);
+    return uuid;
+}();
+
+// Names of the child nodes in an Introspect reply that start with prefix
+// ("service", "char"), in document order
+void introspectChildren(std::string_view xml, std::string_view prefix, std::vector<std::string>& out);
+
+// Database hash value as stored in the registry snapshot (lowercase hex)
+std::string gattHashHex(const std::vector<uint8_t>& value);
+
+// Outcome counters for the refreshes run on ServicesResolved. Thread-safe.
+class GattRefreshStats {
+public:
+    using Duration = std::chrono::steady_clock::duration;
+
+    // Cached map confirmed by the database hash
+    void hit(Duration elapsed);
+    // Subtree walked; busCalls counts Introspect + Get calls it took
+    void walked(Duration elapsed, uint32_t busCalls);
+    void failed() { failCount.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t walks() const { return walkCount.load(std::memory_order_relaxed); }
+    uint64_t failures() const { return failCount.load(std::memory_order_relaxed); }
+    uint64_t busCalls() const { return callCount.load(std::memory_order_relaxed); }
+    // ServicesResolved until the characteristic map is usable
+    LatencyHistogram& hitLatency() { return hitTime; }
+    LatencyHistogram& walkLatency() { return walkTime; }
+
+private:
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> walkCount{0};
+    std::atomic<uint64_t> failCount{0};
+    std::atomic<uint64_t> callCount{0};
+    LatencyHistogram hitTime;
+    LatencyHistogram walkTime;
+};
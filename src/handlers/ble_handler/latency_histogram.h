@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Lock-free latency histogram in microseconds. Buckets are log-linear: four
+// per power of two, so a percentile is reported with at most ~25% error at
+// a fixed 2 KiB footprint. record() is a couple of relaxed atomic adds and
+// can be called from any thread.
+
+class LatencyHistogram {
+public:
+    void record(std::chrono::steady_clock::duration d) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        recordUs(us < 0 ? 0 : static_cast<uint64_t>(us));
+    }
+
+    void recordUs(uint64_t us) {
+        buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t seen = maxSeen.load(std::memory_order_relaxed);
+        while (us > seen && !maxSeen.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t maxUs() const { return maxSeen.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the p-th sample, p in [0, 1]
+    uint64_t percentileUs(double p) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        auto rank = static_cast<uint64_t>(p * static_cast<double>(n - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                uint64_t upper = upperBound(i);
+                uint64_t max = maxUs();
+                return upper < max ? upper : max;
+            }
+        }
+        return maxUs();
+    }
+
+    void reset() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        maxSeen.store(0, std::memory_order_relaxed);
+    }
+
+    // "n=120 p50=800us p99=4100us max=5230us"
+    std::string summary() const {
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "n=%llu p50=%lluus p99=%lluus max=%lluus",
+                      static_cast<unsigned long long>(count()),
+                      static_cast<unsigned long long>(percentileUs(0.50)),
+                      static_cast<unsigned long long>(percentileUs(0.99)),
+                      static_cast<unsigned long long>(maxUs()));
+        return buf;
+    }
+
+private:
+    static constexpr size_t BUCKETS = 256;
+
+    static size_t bucketOf(uint64_t us) {
+        if (us < 4) return static_cast<size_t>(us);
+        int msb = 63 - __builtin_clzll(us);
+        return static_cast<size_t>(4 * (msb - 1) + ((us >> (msb - 2)) & 3));
+    }
+
+    static uint64_t upperBound(size_t idx) {
+        if (idx < 4) return idx;
+        int msb = static_cast<int>(idx / 4) + 1;
+        uint64_t lower = static_cast<uint64_t>(4 + idx % 4) << (msb - 2);
+        return lower + (uint64_t(1) << (msb - 2)) - 1;
+    }
+
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> maxSeen{0};
+};
@@ -0,0 +1,176 @@
+#include "link_quality.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+LinkQualityTable::LinkQualityTable()
+{
+    for (size_t i = 0; i < MAX_DEVICES; ++i)
+        freeSlots[i] = static_cast<uint16_t>(MAX_DEVICES - 1 - i);
+    index.reserve(MAX_DEVICES);
+}
+
+LinkQualityTable::Slot* LinkQualityTable::slotFor(MacAddr mac)
+{
+    if (const uint16_t* i = index.find(mac)) return &slots[*i];
+    if (freeCount == 0) {
+        if (!fullReported) {
+            std::cerr << "[Link] Table full (" << MAX_DEVICES << " devices), "
+                      << macToString(mac) << " not tracked" << std::endl;
+            fullReported = true;
+        }
+        return nullptr;
+    }
+
+    uint16_t i = freeSlots[--freeCount];
+    index.emplace(mac, i);
+    slots[i] = Slot{};
+    slots[i].q.mac = mac;
+    return &slots[i];
+}
+
+void LinkQualityTable::seen(Slot& slot, int64_t nowMs)
+{
+    LinkQuality& q = slot.q;
+    int64_t gap = nowMs - q.lastSeenMs;
+    if (q.lastSeenMs > 0 && gap > 0 && gap <= MAX_INTERVAL_MS) {
+        if (q.advIntervalMs == 0) q.advIntervalMs = static_cast<float>(gap);
+        else q.advIntervalMs += INTERVAL_ALPHA * (static_cast<float>(gap) - q.advIntervalMs);
+    }
+    q.lastSeenMs = nowMs;
+    q.present = true;
+    ++observeCount;
+}
+
+bool LinkQualityTable::shouldPublish(Slot& slot, int64_t nowMs, LinkQuality& out)
+{
+    const LinkQuality& q = slot.q;
+    bool publish = q.present != slot.pubPresent;
+
+    if (!publish && nowMs - slot.pubMs >= MIN_PUBLISH_GAP_MS) {
+        float rssiDelta = std::max(RSSI_DELTA_DB, 2 * q.rssiSpreadDb);
+        if (q.rssiSamples > 0 && std::fabs(q.rssiDbm - slot.pubRssi) >= rssiDelta) publish = true;
+
+        if (slot.pubInterval > 0) {
+            if (std::fabs(q.advIntervalMs - slot.pubInterval) >= INTERVAL_DELTA_RATIO * slot.pubInterval)
+                publish = true;
+        } else if (q.advIntervalMs > 0) {
+            publish = true;
+        }
+
+        if (std::fabs(q.connectSuccess - slot.pubConnect) >= CONNECT_DELTA) publish = true;
+    }
+    if (!publish) return false;
+
+    slot.pubRssi = q.rssiDbm;
+    slot.pubInterval = q.advIntervalMs;
+    slot.pubConnect = q.connectSuccess;
+    slot.pubPresent = q.present;
+    slot.pubMs = nowMs;
+    ++publishCount;
+    out = q;
+    return true;
+}
+
+bool LinkQualityTable::observeRssi(MacAddr mac, int16_t rssi, int64_t nowMs, LinkQuality& out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Slot* slot = slotFor(mac);
+    if (!slot) return false;
+
+    LinkQuality& q = slot->q;
+    float sample = rssi;
+    if (q.rssiSamples == 0) {
+        q.rssiDbm = sample;
+    } else {
+        float deviation = std::fabs(sample - q.rssiDbm);
+        q.rssiDbm += RSSI_ALPHA * (sample - q.rssiDbm);
+        q.rssiSpreadDb += RSSI_ALPHA * (deviation - q.rssiSpreadDb);
+    }
+    ++q.rssiSamples;
+    seen(*slot, nowMs);
+    return shouldPublish(*slot, nowMs, out);
+}
+
+bool LinkQualityTable::observeSeen(MacAddr mac, int64_t nowMs, LinkQuality& out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Slot* slot = slotFor(mac);
+    if (!slot) return false;
+    seen(*slot, nowMs);
+    return shouldPublish(*slot, nowMs, out);
+}
+
+void LinkQualityTable::observeTxPower(MacAddr mac, int16_t txPower)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (Slot* slot = slotFor(mac)) slot->q.txPower = txPower;
+}
+
+bool LinkQualityTable::recordConnect(MacAddr mac, bool ok, int64_t nowMs, LinkQuality& out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Slot* slot = slotFor(mac);
+    if (!slot) return false;
+
+    LinkQuality& q = slot->q;
+    q.connectSuccess += CONNECT_ALPHA * ((ok ? 1.0f : 0.0f) - q.connectSuccess);
+    ++q.connectAttempts;
+    return shouldPublish(*slot, nowMs, out);
+}
+
+void LinkQualityTable::sweep(int64_t nowMs, const FlatSet<MacAddr>& connected, std::vector<LinkQuality>& gone)
+{
+    gone.clear();
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& [mac, i] : index) {
+        Slot& slot = slots[i];
+        LinkQuality& q = slot.q;
+        if (!q.present || connected.contains(mac)) continue;
+
+        int64_t timeout = std::max(ABSENT_MIN_MS, static_cast<int64_t>(ABSENT_INTERVALS * q.advIntervalMs));
+        if (nowMs - q.lastSeenMs < timeout) continue;
+
+        q.present = false;
+        LinkQuality out;
+        if (shouldPublish(slot, nowMs, out)) gone.push_back(out);
+    }
+}
+
+bool LinkQualityTable::get(MacAddr mac, LinkQuality& out) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    const uint16_t* i = index.find(mac);
+    if (!i) return false;
+    out = slots[*i].q;
+    return true;
+}
+
+void LinkQualityTable::forget(MacAddr mac)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    const uint16_t* i = index.find(mac);
+    if (!i) return;
+    freeSlots[freeCount++] = *i;
+    index.erase(mac);
+    fullReported = false;
+}
+
+size_t LinkQualityTable::tracked() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return index.size();
+}
+
+uint64_t LinkQualityTable::observations() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return observeCount;
+}
+
+uint64_t LinkQualityTable::published() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return publishCount;
+}
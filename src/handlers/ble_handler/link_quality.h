@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// Smoothed per-device link quality, fed by the RSSI/advertisement signals
+// BlueZ sends during discovery and by connect attempts.
+//
+// Estimates live in a fixed slot array sized at startup, so updates are a
+// hash lookup plus a few float ops and never allocate. Each slot remembers
+// what was last published; an observe call returns true only when an
+// estimate has moved far enough from that to be worth a message, so the hub
+// gets presence and signal trends instead of every raw RSSI reading.
+
+constexpr int16_t LQ_TXPOWER_UNKNOWN = INT16_MIN;
+
+struct LinkQuality {
+    MacAddr mac = 0;
+    float rssiDbm = 0;          // EWMA, valid once rssiSamples > 0
+    float rssiSpreadDb = 0;     // EWMA of |sample - estimate|
+    float advIntervalMs = 0;    // EWMA of the gap between sightings, 0 = unknown
+    float connectSuccess = 1;   // EWMA of connect outcomes, 0..1
+    int16_t txPower = LQ_TXPOWER_UNKNOWN;
+    bool present = false;
+    uint32_t rssiSamples = 0;
+    uint32_t connectAttempts = 0;
+    int64_t lastSeenMs = 0;     // unix time in ms
+};
+
+class LinkQualityTable {
+public:
+    static constexpr size_t MAX_DEVICES = 1024;
+
+    // Smoothing factors: RSSI follows the last ~10 readings, the interval
+    // the last ~8 gaps, connect success the last ~4 attempts
+    static constexpr float RSSI_ALPHA = 0.2f;
+    static constexpr float INTERVAL_ALPHA = 0.125f;
+    static constexpr float CONNECT_ALPHA = 0.25f;
+
+    // Gaps longer than this are an absence (or paused discovery), not an interval
+    static constexpr int64_t MAX_INTERVAL_MS = 30000;
+    // Absent once unseen for max(ABSENT_MIN_MS, ABSENT_INTERVALS x interval)
+    static constexpr int64_t ABSENT_MIN_MS = 90000;
+    static constexpr int64_t ABSENT_INTERVALS = 8;
+
+    // Publish thresholds, relative to the last published estimate
+    static constexpr float RSSI_DELTA_DB = 5.0f;         // or twice the spread, if larger
+    static constexpr float INTERVAL_DELTA_RATIO = 0.5f;
+    static constexpr float CONNECT_DELTA = 0.2f;
+    static constexpr int64_t MIN_PUBLISH_GAP_MS = 10000; // presence changes are never held back
+
+    LinkQualityTable();
+
+    LinkQualityTable(const LinkQualityTable&) = delete;
+    LinkQualityTable& operator=(const LinkQualityTable&) = delete;
+
+    // An RSSI reading (which is also a sighting)
+    bool observeRssi(MacAddr mac, int16_t rssi, int64_t nowMs, LinkQuality& out);
+    // A sighting without RSSI, e.g. changed ServiceData
+    bool observeSeen(MacAddr mac, int64_t nowMs, LinkQuality& out);
+    void observeTxPower(MacAddr mac, int16_t txPower);
+    bool recordConnect(MacAddr mac, bool ok, int64_t nowMs, LinkQuality& out);
+
+    // Marks devices unseen for too long absent and returns them for
+    // publishing. Connected devices are skipped: a peripheral stops
+    // advertising once connected, it is not gone.
+    void sweep(int64_t nowMs, const FlatSet<MacAddr>& connected, std::vector<LinkQuality>& gone);
+
+    bool get(MacAddr mac, LinkQuality& out) const;
+    void forget(MacAddr mac);
+
+    size_t tracked() const;
+    uint64_t observations() const;
+    uint64_t published() const;
+
+private:
+    struct Slot {
+        LinkQuality q;
+        // last published estimate
+        float pubRssi = 0;
+        float pubInterval = 0;
+        float pubConnect = 1;
+        bool pubPresent = false;
+        int64_t pubMs = 0;
+    };
+
+    // nullptr when the table is full
+    Slot* slotFor(MacAddr mac);
+    void seen(Slot& slot, int64_t nowMs);
+    bool shouldPublish(Slot& slot, int64_t nowMs, LinkQuality& out);
+
+    mutable std::mutex mtx;
+    std::array<Slot, MAX_DEVICES> slots;
+    std::array<uint16_t, MAX_DEVICES> freeSlots;
+    size_t freeCount = MAX_DEVICES;
+    FlatMap<MacAddr, uint16_t> index;  // mac -> slot, reserved up front
+    uint64_t observeCount = 0;
+    uint64_t publishCount = 0;
+    bool fullReported = false;
+};
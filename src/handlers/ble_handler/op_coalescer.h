@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// Pending reads and writes per characteristic, collapsed while they wait
+// for the radio. A slider in the UI sends dozens of writes a second to the
+// same characteristic; only the newest value matters once the radio is
+// free, and a dashboard refresh asks several times for the same value.
+//
+// At most one runner per (device, characteristic) works through batches,
+// so ops on a characteristic stay in order and never run concurrently.
+// Everything that arrives while a batch waits or runs goes into the next
+// batch:
+//
+//   writes  last writer wins: a newer value replaces the pending one; the
+//           replaced callers are kept as superseded and get the outcome
+//           of the write that replaced them
+//   reads   identical pending reads share one ReadValue and its result
+//
+// A batch holding both writes first, then reads, so a read sees the
+// newest write. A read that arrives while a read runs goes into the next
+// batch: the running one may have sampled before it was asked.
+//
+// Caller is whatever the result is addressed to (request id, reply topic);
+// every submitted caller comes back out of exactly one batch. A runner
+// that fails keeps calling next() until it returns false (answering what
+// it takes with an error), or the characteristic stays claimed for good.
+// Thread-safe.
+
+template <typename Caller>
+class OpCoalescer {
+public:
+    struct Batch {
+        bool hasWrite = false;
+        std::vector<uint8_t> value;     // newest value
+        bool withResponse = true;
+        Caller writer{};                // whose value is written
+        std::vector<Caller> superseded; // writes replaced before they ran, oldest first
+        std::vector<Caller> readers;
+    };
+
+    // Queues a write; true if no runner is active for the characteristic
+    // and the caller must start one
+    bool submitWrite(MacAddr mac, const Uuid128& uuid, Caller caller, std::vector<uint8_t> value, bool withResponse)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Slot& s = slots[Key{mac, uuid}];
+        Batch& b = s.pending;
+        if (b.hasWrite) {
+            b.superseded.push_back(std::move(b.writer));
+            collapsedWrites.fetch_add(1, std::memory_order_relaxed);
+        }
+        b.hasWrite = true;
+        b.value = std::move(value);
+        b.withResponse = withResponse;
+        b.writer = std::move(caller);
+        submittedWrites.fetch_add(1, std::memory_order_relaxed);
+        return claim(s);
+    }
+
+    // Queues a read; true if the caller must start the runner
+    bool submitRead(MacAddr mac, const Uuid128& uuid, Caller caller)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Slot& s = slots[Key{mac, uuid}];
+        if (!s.pending.readers.empty()) mergedReads.fetch_add(1, std::memory_order_relaxed);
+        s.pending.readers.push_back(std::move(caller));
+        submittedReads.fetch_add(1, std::memory_order_relaxed);
+        return claim(s);
+    }
+
+    // For the runner: takes the next batch. False when nothing is pending;
+    // the runner is then gone and the next submit starts a new one.
+    bool next(MacAddr mac, const Uuid128& uuid, Batch& out)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Slot* s = slots.find(Key{mac, uuid});
+        if (!s) return false;
+        Batch& b = s->pending;
+        if (!b.hasWrite && b.readers.empty()) {
+            slots.erase(Key{mac, uuid});
+            return false;
+        }
+        out = std::move(b);
+        b = Batch{};
+        batchCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t active() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return slots.size();
+    }
+    uint64_t writes() const { return submittedWrites.load(std::memory_order_relaxed); }
+    uint64_t writesCollapsed() const { return collapsedWrites.load(std::memory_order_relaxed); }
+    uint64_t reads() const { return submittedReads.load(std::memory_order_relaxed); }
+    uint64_t readsMerged() const { return mergedReads.load(std::memory_order_relaxed); }
+    uint64_t batches() const { return batchCount.load(std::memory_order_relaxed); }
+
+private:
+    using Key = std::pair<MacAddr, Uuid128>;
+    struct KeyHash {
+        size_t operator()(const Key& key) const noexcept {
+            return FlatHash<uint64_t>{}(key.first ^ (key.second.hi * 31) ^ key.second.lo);
+        }
+    };
+    struct Slot {
+        bool running = false;
+        Batch pending;
+    };
+
+    static bool claim(Slot& s)
+    {
+        if (s.running) return false;
+        s.running = true;
+        return true;
+    }
+
+    mutable std::mutex mtx;
+    FlatMap<Key, Slot, KeyHash> slots;   // present while a runner is active
+    std::atomic<uint64_t> submittedWrites{0};
+    std::atomic<uint64_t> collapsedWrites{0};
+    std::atomic<uint64_t> submittedReads{0};
+    std::atomic<uint64_t> mergedReads{0};
+    std::atomic<uint64_t> batchCount{0};
+};
@@ -0,0 +1,210 @@
+#include "op_queue.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <memory>
+
+namespace {
+
+constexpr size_t INTERACTIVE = static_cast<size_t>(OpPriority::Interactive);
+constexpr size_t NORMAL = static_cast<size_t>(OpPriority::Normal);
+constexpr size_t BACKGROUND = static_cast<size_t>(OpPriority::Background);
+
+} // namespace
+
+const char* priorityName(OpPriority p)
+{
+    switch (p) {
+    case OpPriority::Interactive: return "interactive";
+    case OpPriority::Normal:      return "normal";
+    case OpPriority::Background:  return "background";
+    }
+    return "?";
+}
+
+bool parsePriority(const std::string& text, OpPriority& out)
+{
+    if (text == "interactive")     out = OpPriority::Interactive;
+    else if (text == "normal")     out = OpPriority::Normal;
+    else if (text == "background") out = OpPriority::Background;
+    else return false;
+    return true;
+}
+
+OpQueue::~OpQueue()
+{
+    stop();
+}
+
+int64_t OpQueue::steadyMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void OpQueue::start(size_t count)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!workers.empty()) return;
+    stopping = false;
+    workerCount = std::max<size_t>(1, count);
+    for (size_t i = 0; i < workerCount; ++i) workers.emplace_back(&OpQueue::worker, this);
+}
+
+void OpQueue::stop()
+{
+    std::vector<RadioOp> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+        for (auto& c : classes) {
+            std::move(c.queue.begin(), c.queue.end(), std::back_inserter(dropped));
+            c.queue.clear();
+        }
+    }
+    cv.notify_all();
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+    workers.clear();
+
+    // Whoever waits on a dropped op (a suspended coroutine) must hear of it
+    for (auto& op : dropped) {
+        if (op.expired) op.expired();
+    }
+}
+
+void OpQueue::collectExpired(int64_t nowMs, std::vector<RadioOp>& out)
+{
+    auto live = [nowMs](const RadioOp& op) { return !op.deadlineMs || nowMs < op.deadlineMs; };
+    for (auto& c : classes) {
+        auto it = std::stable_partition(c.queue.begin(), c.queue.end(), live);
+        std::move(it, c.queue.end(), std::back_inserter(out));
+        c.queue.erase(it, c.queue.end());
+    }
+}
+
+bool OpQueue::submit(RadioOp op)
+{
+    std::vector<RadioOp> expiredOps;
+    bool accepted = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        collectExpired(steadyMs(), expiredOps);
+        Class& c = classes[static_cast<size_t>(op.priority)];
+        if (!stopping && c.queue.size() < CAPACITY[static_cast<size_t>(op.priority)]) {
+            op.queued = std::chrono::steady_clock::now();
+            c.queue.push_back(std::move(op));
+            accepted = true;
+        }
+    }
+    if (accepted) cv.notify_one();
+    else rejectCount.fetch_add(1, std::memory_order_relaxed);
+
+    for (auto& e : expiredOps) {
+        expireCount.fetch_add(1, std::memory_order_relaxed);
+        if (e.expired) e.expired();
+    }
+    return accepted;
+}
+
+size_t OpQueue::depth() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    size_t n = 0;
+    for (const auto& c : classes) n += c.queue.size();
+    return n;
+}
+
+int OpQueue::pick()
+{
+    size_t busy = 0;
+    for (const auto& c : classes) busy += c.inFlight;
+    if (busy >= workerCount) return -1;
+
+    if (!classes[INTERACTIVE].queue.empty()) return INTERACTIVE;
+
+    // Non-interactive work leaves one worker free, unless there is only one
+    size_t lowLimit = workerCount > 1 ? workerCount - 1 : 1;
+    if (classes[NORMAL].inFlight + classes[BACKGROUND].inFlight >= lowLimit) return -1;
+
+    // Aged background work goes ahead of Normal, but still within its
+    // in-flight cap: in a reconnect or poll storm every op is aged
+    const auto& bg = classes[BACKGROUND].queue;
+    bool bgAdmissible = !bg.empty() && classes[BACKGROUND].inFlight < BACKGROUND_IN_FLIGHT;
+    if (bgAdmissible) {
+        int64_t waitedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - bg.front().queued).count();
+        if (waitedMs >= BACKGROUND_MAX_WAIT_MS) {
+            promoteCount.fetch_add(1, std::memory_order_relaxed);
+            return BACKGROUND;
+        }
+    }
+    if (!classes[NORMAL].queue.empty()) return NORMAL;
+    if (bgAdmissible) return BACKGROUND;
+    return -1;
+}
+
+void OpQueue::worker()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        int cls = -1;
+        // Wake at least every second so aged background work gets promoted
+        cv.wait_for(lock, std::chrono::seconds(1), [&] { return stopping || (cls = pick()) >= 0; });
+        if (stopping) return;
+        if (cls < 0) continue;
+
+        Class& c = classes[cls];
+        RadioOp op = std::move(c.queue.front());
+        c.queue.pop_front();
+        ++c.inFlight;
+        lock.unlock();
+
+        // Last check before the op reaches the radio
+        if (op.deadlineMs && steadyMs() >= op.deadlineMs) {
+            expireCount.fetch_add(1, std::memory_order_relaxed);
+            if (op.expired) op.expired();
+        } else {
+            c.wait.record(std::chrono::steady_clock::now() - op.queued);
+            runCount.fetch_add(1, std::memory_order_relaxed);
+            if (op.start) {
+                auto once = std::make_shared<std::atomic<bool>>(false);
+                auto done = [this, cls, queued = op.queued, once]() {
+                    if (!once->exchange(true)) finish(static_cast<size_t>(cls), queued);
+                };
+                try {
+                    op.start(done);
+                } catch (const std::exception& e) {
+                    std::cerr << "[Ops] " << op.command << " failed: " << e.what() << std::endl;
+                    done();
+                }
+                lock.lock();
+                continue;   // the slot is released by done()
+            }
+            try {
+                if (op.run) op.run();
+            } catch (const std::exception& e) {
+                std::cerr << "[Ops] " << op.command << " failed: " << e.what() << std::endl;
+            }
+            c.total.record(std::chrono::steady_clock::now() - op.queued);
+        }
+
+        lock.lock();
+        --c.inFlight;
+        // A finished op may make another class admissible
+        cv.notify_all();
+    }
+}
+
+void OpQueue::finish(size_t cls, std::chrono::steady_clock::time_point queued)
+{
+    Class& c = classes[cls];
+    c.total.record(std::chrono::steady_clock::now() - queued);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        --c.inFlight;
+    }
+    cv.notify_all();
+}
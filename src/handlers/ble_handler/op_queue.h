@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.h"
+
+// Radio operations (reads, writes, connect, pair, disconnect) run on a
+// small pool of workers instead of the threads that asked for them, so one
+// slow connect no longer holds up every later command.
+//
+// Ops come in three priority classes, each with its own queue. Workers
+// always take the most urgent class that is admissible:
+//
+//   Interactive  commands a person is waiting on (a lock, a light); may
+//                use every worker
+//   Normal       other hub commands; together with Background at most
+//                workers - 1 in flight, so one worker is always free for
+//                interactive work
+//   Background   polling, reconnects; at most BACKGROUND_IN_FLIGHT in
+//                flight. An op waiting longer than BACKGROUND_MAX_WAIT_MS
+//                is served ahead of Normal so it cannot starve, still
+//                within that cap.
+//
+// An op started with start() instead of run() hands its worker back at
+// once but counts against the limits above until it calls done(), so a
+// suspended coroutine holds a radio slot without holding a thread.
+//
+// An op may carry a deadline. One still queued when its deadline passes is
+// never started: its expired() callback runs instead, so a backlog does not
+// spend airtime on answers nobody is waiting for. Deadlines are checked
+// when a worker picks an op up and on every submit.
+
+enum class OpPriority : uint8_t { Interactive, Normal, Background };
+constexpr size_t OP_PRIORITY_COUNT = 3;
+
+const char* priorityName(OpPriority p);
+bool parsePriority(const std::string& text, OpPriority& out);
+
+struct RadioOp {
+    std::string command;             // for logs
+    OpPriority priority = OpPriority::Normal;
+    int64_t deadlineMs = 0;          // steady clock ms, 0 = none
+    std::function<void()> run;
+    // Instead of run, for ops that finish later (coroutines): the worker is
+    // free again once start returns, the op keeps its slot until done()
+    std::function<void(std::function<void()> done)> start;
+    std::function<void()> expired;   // called instead of run once the deadline passed
+    std::chrono::steady_clock::time_point queued;   // set by submit()
+};
+
+class OpQueue {
+public:
+    // Admission budget: queue length per class
+    static constexpr std::array<size_t, OP_PRIORITY_COUNT> CAPACITY = {64, 128, 256};
+    static constexpr size_t BACKGROUND_IN_FLIGHT = 1;
+    static constexpr int64_t BACKGROUND_MAX_WAIT_MS = 5000;
+
+    OpQueue() = default;
+    ~OpQueue();
+
+    OpQueue(const OpQueue&) = delete;
+    OpQueue& operator=(const OpQueue&) = delete;
+
+    void start(size_t workers);
+    // Ops still queued are not run; their expired() callback runs instead
+    void stop();
+
+    // False when the class queue is full or stopped; the op is not run
+    bool submit(RadioOp op);
+
+    size_t depth() const;
+    uint64_t executed() const { return runCount.load(std::memory_order_relaxed); }
+    uint64_t expired() const { return expireCount.load(std::memory_order_relaxed); }
+    uint64_t rejected() const { return rejectCount.load(std::memory_order_relaxed); }
+    uint64_t promoted() const { return promoteCount.load(std::memory_order_relaxed); }
+    // Time from submit until a worker started the op, and until it finished
+    LatencyHistogram& queueWait(OpPriority p) { return classes[static_cast<size_t>(p)].wait; }
+    LatencyHistogram& latency(OpPriority p) { return classes[static_cast<size_t>(p)].total; }
+
+    static int64_t steadyMs();
+
+private:
+    struct Class {
+        std::deque<RadioOp> queue;
+        size_t inFlight = 0;
+        LatencyHistogram wait;
+        LatencyHistogram total;
+    };
+
+    void worker();
+    // An op of class cls left the radio; releases its in-flight slot
+    void finish(size_t cls, std::chrono::steady_clock::time_point queued);
+    // Class a free worker should serve next, -1 if none is admissible; call with mtx held
+    int pick();
+    // Moves ops whose deadline has passed out of the queues; call with mtx held
+    void collectExpired(int64_t nowMs, std::vector<RadioOp>& out);
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::array<Class, OP_PRIORITY_COUNT> classes;
+    std::vector<std::thread> workers;
+    size_t workerCount = 0;
+    bool stopping = false;
+
+    std::atomic<uint64_t> runCount{0};
+    std::atomic<uint64_t> expireCount{0};
+    std::atomic<uint64_t> rejectCount{0};
+    std::atomic<uint64_t> promoteCount{0};
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interns D-Bus object path fragments and hands out 32-bit ids for them.
+// The handler interns characteristic paths relative to their device node
+// ("/service0010/char0011"), so devices with the same GATT layout share one
+// entry. Entries are never released; the set is bounded by the distinct
+// layouts BlueZ exposes.
+
+using PathId = uint32_t;
+constexpr PathId INVALID_PATH = 0;
+
+class PathTable {
+public:
+    PathTable() { paths.emplace_back(); } // id 0 = no path
+
+    PathId intern(std::string_view path) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (auto it = ids.find(path); it != ids.end()) return it->second;
+        paths.emplace_back(path);
+        auto id = static_cast<PathId>(paths.size() - 1);
+        ids.emplace(paths.back(), id);
+        return id;
+    }
+
+    // Lookup only, INVALID_PATH when the path was never interned
+    PathId find(std::string_view path) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = ids.find(path);
+        return it == ids.end() ? INVALID_PATH : it->second;
+    }
+
+    // References stay valid: deque never moves existing elements
+    const std::string& str(PathId id) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return id < paths.size() ? paths[id] : paths[INVALID_PATH];
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return paths.size() - 1;
+    }
+
+private:
+    mutable std::mutex mtx;
+    std::deque<std::string> paths;
+    std::unordered_map<std::string_view, PathId> ids; // views into paths
+};
@@ -0,0 +1,185 @@
+#include "poll_scheduler.h"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+namespace {
+
+uint64_t hashBytes(const std::vector<uint8_t>& data)
+{
+    // FNV-1a; only compared against the previous read of the same target
+    uint64_t h = 0xCBF29CE484222325ULL ^ data.size();
+    for (uint8_t b : data) {
+        h ^= b;
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+} // namespace
+
+PollScheduler::PollScheduler(uint64_t seed) : rng(seed ? seed : 1) {}
+
+int64_t PollScheduler::jittered(int64_t nowMs, uint32_t interval)
+{
+    // xorshift64, uniform in [-JITTER, +JITTER] of the interval
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    double u = static_cast<double>(rng >> 11) / static_cast<double>(1ULL << 53);
+    return nowMs + static_cast<int64_t>(interval * (1.0 + JITTER * (2 * u - 1)));
+}
+
+void PollScheduler::reschedule(MacAddr mac, DeviceTargets& dev)
+{
+    int64_t due = INT64_MAX;
+    for (const auto& t : dev.targets)
+        if (!t.inFlight) due = std::min(due, t.dueMs);
+
+    ++dev.gen;
+    if (due == INT64_MAX) return;   // everything in flight, complete() reschedules
+    heap.push_back({due, mac, dev.gen});
+    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+}
+
+void PollScheduler::beginSync()
+{
+    ++syncMark;
+}
+
+void PollScheduler::set(MacAddr mac, const Uuid128& uuid, const PollConfig& cfg, int64_t nowMs)
+{
+    DeviceTargets& dev = *devices.emplace(mac).first;
+    auto it = std::find_if(dev.targets.begin(), dev.targets.end(),
+                           [&](const Target& t) { return t.uuid == uuid; });
+
+    if (it == dev.targets.end()) {
+        Target t;
+        t.uuid = uuid;
+        t.cfg = cfg;
+        t.interval = cfg.intervalMs;
+        // First reads are spread over the first interval (at most 10 s) so a
+        // restart does not poll everything at once
+        t.dueMs = jittered(nowMs, std::min<uint32_t>(cfg.intervalMs, 10000) / 2);
+        t.syncMark = syncMark;
+        dev.targets.push_back(t);
+        reschedule(mac, dev);
+        return;
+    }
+
+    it->syncMark = syncMark;
+    if (it->cfg.intervalMs == cfg.intervalMs && it->cfg.minMs == cfg.minMs && it->cfg.maxMs == cfg.maxMs)
+        return;
+
+    // Bounds changed in the config: start over from the new interval
+    it->cfg = cfg;
+    it->interval = cfg.intervalMs;
+    if (!it->inFlight) it->dueMs = std::min(it->dueMs, jittered(nowMs, cfg.intervalMs));
+    reschedule(mac, dev);
+}
+
+void PollScheduler::endSync()
+{
+    std::vector<MacAddr> empty;
+    size_t count = 0;
+    for (auto [mac, dev] : devices) {
+        size_t before = dev.targets.size();
+        dev.targets.erase(std::remove_if(dev.targets.begin(), dev.targets.end(),
+                                         [&](const Target& t) { return t.syncMark != syncMark; }),
+                          dev.targets.end());
+        if (dev.targets.empty()) empty.push_back(mac);
+        else if (dev.targets.size() != before) reschedule(mac, dev);
+        count += dev.targets.size();
+    }
+    for (MacAddr mac : empty) devices.erase(mac);
+    targetCount.store(count, std::memory_order_relaxed);
+
+    // Drop stale nodes once they outnumber live ones
+    if (heap.size() > 2 * count + 64) {
+        heap.erase(std::remove_if(heap.begin(), heap.end(), [&](const HeapNode& n) {
+            const DeviceTargets* dev = devices.find(n.mac);
+            return !dev || dev->gen != n.gen;
+        }), heap.end());
+        std::make_heap(heap.begin(), heap.end(), std::greater<>());
+    }
+}
+
+int64_t PollScheduler::nextDueMs()
+{
+    while (!heap.empty()) {
+        const HeapNode& top = heap.front();
+        const DeviceTargets* dev = devices.find(top.mac);
+        if (dev && dev->gen == top.gen) return top.dueMs;
+        std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+        heap.pop_back();
+    }
+    return INT64_MAX;
+}
+
+bool PollScheduler::takeDue(int64_t nowMs, MacAddr& mac, std::vector<Uuid128>& batch)
+{
+    batch.clear();
+    if (nextDueMs() > nowMs) return false;
+
+    mac = heap.front().mac;
+    std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+    heap.pop_back();
+
+    DeviceTargets& dev = *devices.find(mac);
+    for (auto& t : dev.targets) {
+        if (t.inFlight) continue;
+        if (t.dueMs > nowMs + static_cast<int64_t>(t.interval * GROUP_SLACK)) continue;
+        t.inFlight = true;
+        batch.push_back(t.uuid);
+    }
+    reschedule(mac, dev);   // for targets left out of the batch
+    return !batch.empty();
+}
+
+bool PollScheduler::complete(MacAddr mac, const Uuid128& uuid, int64_t nowMs, const std::vector<uint8_t>* value)
+{
+    DeviceTargets* dev = devices.find(mac);
+    if (!dev) return false;
+    auto it = std::find_if(dev->targets.begin(), dev->targets.end(),
+                           [&](const Target& t) { return t.uuid == uuid; });
+    if (it == dev->targets.end()) return false;   // dropped by a sync while in flight
+
+    Target& t = *it;
+    t.inFlight = false;
+    bool changed = false;
+
+    if (!value) {
+        // Not connected or the read failed: try again after the current interval
+        failCount.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        readCount.fetch_add(1, std::memory_order_relaxed);
+        uint64_t h = hashBytes(*value);
+        changed = !t.haveValue || h != t.lastHash;
+        t.lastHash = h;
+        t.haveValue = true;
+
+        double next = t.interval * (changed ? TIGHTEN_FACTOR : WIDEN_FACTOR);
+        t.interval = static_cast<uint32_t>(std::clamp<double>(next, t.cfg.minMs, t.cfg.maxMs));
+        if (changed) changeCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    t.dueMs = jittered(nowMs, t.interval);
+    reschedule(mac, *dev);
+    return changed;
+}
+
+const PollScheduler::Target* PollScheduler::find(MacAddr mac, const Uuid128& uuid) const
+{
+    const DeviceTargets* dev = devices.find(mac);
+    if (!dev) return nullptr;
+    for (const auto& t : dev->targets)
+        if (t.uuid == uuid) return &t;
+    return nullptr;
+}
+
+uint32_t PollScheduler::intervalMs(MacAddr mac, const Uuid128& uuid) const
+{
+    const Target* t = find(mac, uuid);
+    return t ? t->interval : 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// Read scheduling for characteristics that cannot notify.
+//
+// Every polled characteristic has its own interval, adapted between the
+// configured bounds: a read that returns the same bytes as the previous one
+// widens it by 25%, a changed value halves it. Due times are jittered by
+// +/-10% so devices configured alike do not all hit the radio together.
+//
+// A min-heap holds one node per device, keyed by its earliest due
+// characteristic. When a device comes due, every characteristic of it that
+// is due within a quarter of its own interval is read in the same batch, so
+// polls to one device share its connection window instead of trickling in.
+//
+// Single-threaded (the poll worker owns it); the counters can be read from
+// any thread.
+
+struct PollConfig {
+    uint32_t intervalMs = 0;   // starting interval
+    uint32_t minMs = 0;
+    uint32_t maxMs = 0;
+};
+
+class PollScheduler {
+public:
+    static constexpr double WIDEN_FACTOR = 1.25;
+    static constexpr double TIGHTEN_FACTOR = 0.5;
+    static constexpr double JITTER = 0.10;
+    static constexpr double GROUP_SLACK = 0.25;   // fraction of an interval a read may be pulled forward
+
+    explicit PollScheduler(uint64_t seed = 0x9E3779B97F4A7C15ULL);
+
+    // Sync protocol after a schema or registry change: set() every target
+    // that should be polled between beginSync() and endSync(); anything not
+    // set is dropped. Existing targets keep their adapted interval and last
+    // value unless the configured bounds changed.
+    void beginSync();
+    void set(MacAddr mac, const Uuid128& uuid, const PollConfig& cfg, int64_t nowMs);
+    void endSync();
+
+    // Time of the earliest due read, INT64_MAX when nothing is scheduled
+    int64_t nextDueMs();
+
+    // Pops the next device with a due read; false if none is due at nowMs
+    bool takeDue(int64_t nowMs, MacAddr& mac, std::vector<Uuid128>& batch);
+
+    // Result of a read from takeDue(), value == nullptr if it failed.
+    // Returns true when the value differs from the previous read.
+    bool complete(MacAddr mac, const Uuid128& uuid, int64_t nowMs, const std::vector<uint8_t>* value);
+
+    // Current adapted interval, 0 if the target is not scheduled
+    uint32_t intervalMs(MacAddr mac, const Uuid128& uuid) const;
+
+    size_t targets() const { return targetCount.load(std::memory_order_relaxed); }
+    uint64_t reads() const { return readCount.load(std::memory_order_relaxed); }
+    uint64_t changes() const { return changeCount.load(std::memory_order_relaxed); }
+    uint64_t failures() const { return failCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Target {
+        Uuid128 uuid;
+        PollConfig cfg;
+        uint32_t interval = 0;
+        int64_t dueMs = 0;
+        uint64_t lastHash = 0;
+        bool haveValue = false;
+        bool inFlight = false;
+        uint32_t syncMark = 0;
+    };
+
+    struct DeviceTargets {
+        std::vector<Target> targets;
+        uint32_t gen = 0;   // bumped on every reschedule, older heap nodes are stale
+    };
+
+    struct HeapNode {
+        int64_t dueMs;
+        MacAddr mac;
+        uint32_t gen;
+        bool operator>(const HeapNode& other) const { return dueMs > other.dueMs; }
+    };
+
+    void reschedule(MacAddr mac, DeviceTargets& dev);
+    int64_t jittered(int64_t nowMs, uint32_t interval);
+    const Target* find(MacAddr mac, const Uuid128& uuid) const;
+
+    FlatMap<MacAddr, DeviceTargets> devices;
+    std::vector<HeapNode> heap;
+    uint32_t syncMark = 0;
+    uint64_t rng;
+    std::atomic<size_t> targetCount{0};
+    std::atomic<uint64_t> readCount{0};
+    std::atomic<uint64_t> changeCount{0};
+    std::atomic<uint64_t> failCount{0};
+};
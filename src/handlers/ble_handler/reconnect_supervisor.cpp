@@ -0,0 +1,157 @@
+#include "reconnect_supervisor.h"
+
+#include <algorithm>
+#include <climits>
+
+ReconnectSupervisor::ReconnectSupervisor(int64_t nowMs, uint64_t seed) : wheel(TICK_MS, nowMs), rng(seed)
+{
+    outagesByMac.reserve(64);
+}
+
+int64_t ReconnectSupervisor::backoffMs(uint32_t failures)
+{
+    int64_t d = BASE_DELAY_MS << std::min<uint32_t>(failures, 20);
+    d = std::min(d, MAX_DELAY_MS);
+    return d / 2 + static_cast<int64_t>(rng() % static_cast<uint64_t>(d / 2 + 1));
+}
+
+void ReconnectSupervisor::arm(MacAddr mac, Outage& o, int64_t delayMs, int64_t nowMs)
+{
+    wheel.cancel(o.timer);
+    o.timer = wheel.add(nowMs + delayMs, mac);
+}
+
+void ReconnectSupervisor::disconnected(MacAddr mac, int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (held.erase(mac)) return;   // asked for
+
+    auto [o, inserted] = outagesByMac.emplace(mac);
+    if (!inserted) return;         // already healing
+    o->downSinceMs = nowMs;
+    outageCount.fetch_add(1, std::memory_order_relaxed);
+    arm(mac, *o, backoffMs(0), nowMs);
+}
+
+ReconnectSupervisor::Change ReconnectSupervisor::end(MacAddr mac, int64_t nowMs, int64_t& downtimeMs)
+{
+    Outage* o = outagesByMac.find(mac);
+    if (!o) return Change::None;
+
+    wheel.cancel(o->timer);
+    if (o->waiting) ready.erase(std::remove(ready.begin(), ready.end(), mac), ready.end());
+    downtimeMs = nowMs - o->downSinceMs;
+    outagesByMac.erase(mac);
+
+    recoverCount.fetch_add(1, std::memory_order_relaxed);
+    downtimeTotalMs.fetch_add(static_cast<uint64_t>(std::max<int64_t>(0, downtimeMs)), std::memory_order_relaxed);
+    ttr.recordUs(static_cast<uint64_t>(std::max<int64_t>(0, downtimeMs)) * 1000);
+    return Change::Recovered;
+}
+
+ReconnectSupervisor::Change ReconnectSupervisor::connected(MacAddr mac, int64_t nowMs, int64_t& downtimeMs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    held.erase(mac);
+    // An attempt still in flight finishes through attemptFinished()
+    if (Outage* o = outagesByMac.find(mac); o && o->inFlight) return Change::None;
+    return end(mac, nowMs, downtimeMs);
+}
+
+void ReconnectSupervisor::hold(MacAddr mac)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    held.insert(mac);
+}
+
+void ReconnectSupervisor::forget(MacAddr mac)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    held.erase(mac);
+    Outage* o = outagesByMac.find(mac);
+    if (!o) return;
+    wheel.cancel(o->timer);
+    if (o->inFlight) --inFlight;
+    ready.erase(std::remove(ready.begin(), ready.end(), mac), ready.end());
+    outagesByMac.erase(mac);
+}
+
+void ReconnectSupervisor::takeDue(int64_t nowMs, std::vector<MacAddr>& out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    wheel.advance(nowMs, [&](TimerWheel::TimerId, uint64_t data) {
+        MacAddr mac = data;
+        Outage* o = outagesByMac.find(mac);
+        if (!o || o->inFlight || o->waiting) return;
+        o->timer = TimerWheel::INVALID_TIMER;
+        o->waiting = true;
+        ready.push_back(mac);
+    });
+
+    while (inFlight < MAX_CONCURRENT && !ready.empty()) {
+        MacAddr mac = ready.front();
+        ready.pop_front();
+        Outage* o = outagesByMac.find(mac);
+        if (!o) continue;
+        o->waiting = false;
+        o->inFlight = true;
+        ++inFlight;
+        attemptCount.fetch_add(1, std::memory_order_relaxed);
+        out.push_back(mac);
+    }
+}
+
+ReconnectSupervisor::Change ReconnectSupervisor::attemptFinished(MacAddr mac, bool ok, int64_t nowMs, int64_t& downtimeMs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Outage* o = outagesByMac.find(mac);
+    if (!o || !o->inFlight) return Change::None;   // forgotten meanwhile
+    o->inFlight = false;
+    --inFlight;
+
+    if (ok) {
+        bool wasOpen = o->breakerOpen;
+        end(mac, nowMs, downtimeMs);
+        return wasOpen ? Change::BreakerClosed : Change::Recovered;
+    }
+
+    ++o->failures;
+    if (o->breakerOpen || o->failures >= BREAKER_FAILURES) {
+        // Open (or failed probe): stay away, longer each trip
+        bool opened = !o->breakerOpen;
+        o->breakerOpen = true;
+        int64_t openMs = std::min(BREAKER_MAX_OPEN_MS, BREAKER_OPEN_MS << std::min<uint32_t>(o->trips, 10));
+        ++o->trips;
+        arm(mac, *o, openMs, nowMs);
+        return opened ? Change::BreakerOpened : Change::None;
+    }
+    arm(mac, *o, backoffMs(o->failures), nowMs);
+    return Change::None;
+}
+
+int64_t ReconnectSupervisor::nextWakeMs() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!ready.empty() && inFlight < MAX_CONCURRENT) return wheel.nowMs();
+    return wheel.size() ? wheel.nextTickMs() : INT64_MAX;
+}
+
+size_t ReconnectSupervisor::down() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return outagesByMac.size();
+}
+
+size_t ReconnectSupervisor::breakersOpen() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    size_t n = 0;
+    for (const auto& [mac, o] : outagesByMac) n += o.breakerOpen;
+    return n;
+}
+
+uint64_t ReconnectSupervisor::meanTimeToRecoverMs() const
+{
+    uint64_t n = recoverCount.load(std::memory_order_relaxed);
+    return n ? downtimeTotalMs.load(std::memory_order_relaxed) / n : 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+#include "latency_histogram.h"
+#include "timer_wheel.h"
+
+// Brings devices back after they drop. A Connected=false signal starts an
+// outage; the supervisor then hands out reconnect attempts for that device
+// until a Connected=true signal ends it:
+//
+//  - attempts back off exponentially from BASE_DELAY_MS to MAX_DELAY_MS,
+//    each delay drawn from [d/2, d] so devices that dropped together do
+//    not retry together
+//  - at most MAX_CONCURRENT attempts run at once; due devices wait their
+//    turn in arrival order, so a power blip does not turn into a storm
+//  - after BREAKER_FAILURES failures in a row the breaker opens and the
+//    device is left alone for BREAKER_OPEN_MS (doubling per trip up to
+//    BREAKER_MAX_OPEN_MS); then one probe attempt decides whether it
+//    closes or opens again
+//
+// Time to recover (first drop to reconnected) feeds a histogram for the
+// fleet MTTR. Timers live in a TimerWheel on the steady clock. Thread-safe.
+
+class ReconnectSupervisor {
+public:
+    static constexpr uint32_t TICK_MS = 500;
+    static constexpr int64_t BASE_DELAY_MS = 1000;
+    static constexpr int64_t MAX_DELAY_MS = 5 * 60 * 1000;
+    static constexpr size_t MAX_CONCURRENT = 2;
+    static constexpr uint32_t BREAKER_FAILURES = 8;
+    static constexpr int64_t BREAKER_OPEN_MS = 10 * 60 * 1000;
+    static constexpr int64_t BREAKER_MAX_OPEN_MS = 60 * 60 * 1000;
+
+    enum class Change { None, Recovered, BreakerOpened, BreakerClosed };
+
+    ReconnectSupervisor(int64_t nowMs, uint64_t seed = 0x2545F4914F6CDD1DULL);
+
+    ReconnectSupervisor(const ReconnectSupervisor&) = delete;
+    ReconnectSupervisor& operator=(const ReconnectSupervisor&) = delete;
+
+    // Connected=false for a device that should stay connected
+    void disconnected(MacAddr mac, int64_t nowMs);
+    // Connected=true; returns Recovered (with downtimeMs) if an outage ended
+    Change connected(MacAddr mac, int64_t nowMs, int64_t& downtimeMs);
+    // The next drop of this device was asked for (disconnect_device), do not heal it
+    void hold(MacAddr mac);
+    // Device removed from the registry
+    void forget(MacAddr mac);
+
+    // Devices whose next attempt is due and fits under the concurrency cap
+    void takeDue(int64_t nowMs, std::vector<MacAddr>& out);
+    // Outcome of an attempt handed out by takeDue()
+    Change attemptFinished(MacAddr mac, bool ok, int64_t nowMs, int64_t& downtimeMs);
+
+    // Steady time the caller should next call takeDue(), INT64_MAX if idle
+    int64_t nextWakeMs() const;
+
+    size_t down() const;
+    size_t breakersOpen() const;
+    uint64_t outages() const { return outageCount.load(std::memory_order_relaxed); }
+    uint64_t recoveries() const { return recoverCount.load(std::memory_order_relaxed); }
+    uint64_t attempts() const { return attemptCount.load(std::memory_order_relaxed); }
+    uint64_t meanTimeToRecoverMs() const;
+    // Outage duration of recovered devices
+    LatencyHistogram& timeToRecover() { return ttr; }
+
+private:
+    struct Outage {
+        int64_t downSinceMs = 0;
+        uint32_t failures = 0;       // in a row
+        uint32_t trips = 0;          // times the breaker opened during this outage
+        bool breakerOpen = false;
+        bool inFlight = false;
+        bool waiting = false;        // due, queued for a free slot
+        TimerWheel::TimerId timer = TimerWheel::INVALID_TIMER;
+    };
+
+    void arm(MacAddr mac, Outage& o, int64_t delayMs, int64_t nowMs);
+    int64_t backoffMs(uint32_t failures);
+    Change end(MacAddr mac, int64_t nowMs, int64_t& downtimeMs);
+
+    mutable std::mutex mtx;
+    TimerWheel wheel;
+    FlatMap<MacAddr, Outage> outagesByMac;
+    FlatSet<MacAddr> held;
+    std::deque<MacAddr> ready;
+    size_t inFlight = 0;
+    std::mt19937_64 rng;
+
+    std::atomic<uint64_t> outageCount{0};
+    std::atomic<uint64_t> recoverCount{0};
+    std::atomic<uint64_t> attemptCount{0};
+    std::atomic<uint64_t> downtimeTotalMs{0};
+    LatencyHistogram ttr;
+};
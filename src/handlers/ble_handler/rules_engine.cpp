@@ -0,0 +1,337 @@
+#include "rules_engine.h"
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <tuple>
+
+using json = nlohmann::json;
+
+struct RulePredicate {
+    SeriesKey key;
+    RuleOp op;
+    double threshold;
+    double hysteresis;
+    uint32_t rule;
+};
+
+// Crossing detection: a rule fires when its condition becomes true, and
+// re-arms once the value has left the hysteresis band again
+struct PredicateState {
+    bool known = false;    // a first reading only establishes the side
+    bool active = false;
+    int64_t lastFiredMs = INT64_MIN / 2;
+};
+
+struct CompiledRule {
+    std::string name;
+    std::vector<RuleAction> actions;
+    int64_t cooldownMs = 0;
+};
+
+struct RuleTable {
+    std::vector<RulePredicate> predicates;    // sorted by key
+    std::vector<PredicateState> state;        // parallel to predicates
+    FlatMap<SeriesKey, std::pair<uint32_t, uint32_t>> index;  // key -> [begin, end)
+    std::vector<CompiledRule> rules;
+};
+
+namespace {
+
+bool parseOp(const std::string& text, RuleOp& op)
+{
+    if (text == ">")       op = RuleOp::Gt;
+    else if (text == ">=") op = RuleOp::Ge;
+    else if (text == "<")  op = RuleOp::Lt;
+    else if (text == "<=") op = RuleOp::Le;
+    else if (text == "==") op = RuleOp::Eq;
+    else if (text == "!=") op = RuleOp::Ne;
+    else return false;
+    return true;
+}
+
+bool compare(RuleOp op, double value, double threshold)
+{
+    switch (op) {
+    case RuleOp::Gt: return value > threshold;
+    case RuleOp::Ge: return value >= threshold;
+    case RuleOp::Lt: return value < threshold;
+    case RuleOp::Le: return value <= threshold;
+    case RuleOp::Eq: return value == threshold;
+    case RuleOp::Ne: return value != threshold;
+    }
+    return false;
+}
+
+// Threshold the value has to fall back past before an active rule re-arms
+double releaseThreshold(const RulePredicate& p)
+{
+    switch (p.op) {
+    case RuleOp::Gt: case RuleOp::Ge: return p.threshold - p.hysteresis;
+    case RuleOp::Lt: case RuleOp::Le: return p.threshold + p.hysteresis;
+    default: return p.threshold;
+    }
+}
+
+const CharacteristicSchema* findCharacteristic(const DeviceSchema& dev, const std::string& nameOrUuid)
+{
+    if (const CharacteristicSchema* chr = dev.findByName(nameOrUuid)) return chr;
+    Uuid128 uuid;
+    return parseUuid(nameOrUuid, uuid) ? dev.findByUuid(uuid) : nullptr;
+}
+
+std::string parseCondition(const json& w, const SchemaIndex& schema, RulePredicate& p)
+{
+    if (!w.is_object()) return "\"when\" must be an object";
+
+    std::string devId = w.value("device", "");
+    const DeviceSchema* dev = schema.findDevice(devId);
+    if (!dev || !dev->macAddr) return "unknown BLE device " + devId;
+
+    const CharacteristicSchema* chr = nullptr;
+    std::string field = w.value("field", "");
+    if (w.contains("characteristic")) {
+        chr = findCharacteristic(*dev, w.value("characteristic", ""));
+        if (!chr) return "unknown characteristic " + w.value("characteristic", "");
+    } else if (!field.empty()) {
+        for (const auto& c : dev->characteristics)
+            if (!c.bthomeObjects.empty()) { chr = &c; break; }
+        if (!chr) return devId + " has no BTHome characteristic";
+    } else {
+        return "missing characteristic";
+    }
+
+    p.key = SeriesKey{dev->macAddr, chr->uuid, SERIES_FIELD_VALUE};
+    if (!chr->bthomeObjects.empty()) {
+        auto it = std::find_if(chr->bthomeObjects.begin(), chr->bthomeObjects.end(),
+                               [&](const BTHomeObjectSchema& o) { return o.name == field; });
+        if (it == chr->bthomeObjects.end()) return "unknown field \"" + field + "\"";
+        p.key.field = it->id;
+    }
+
+    if (!parseOp(w.value("op", ""), p.op)) return "invalid op \"" + w.value("op", "") + "\"";
+    if (!w.contains("value") || !w["value"].is_number()) return "missing numeric value";
+    p.threshold  = w["value"];
+    p.hysteresis = std::max(0.0, w.value("hysteresis", 0.0));
+    return "";
+}
+
+std::string parseAction(const json& a, const SchemaIndex& schema, const json& devices,
+                        const RuleEngine::WriteEncoder& encode, RuleAction& action)
+{
+    if (!a.is_object()) return "action must be an object";
+
+    if (a.contains("topic")) {
+        action.kind = RuleAction::Kind::Publish;
+        action.topic = a.value("topic", "");
+        action.payload = a.contains("payload") ? (a["payload"].is_string() ? a["payload"].get<std::string>()
+                                                                          : a["payload"].dump())
+                                               : std::string("{value}");
+        return action.topic.empty() ? "empty topic" : "";
+    }
+
+    std::string devId = a.value("device", "");
+    if (a.contains("characteristic")) {
+        const DeviceSchema* dev = schema.findDevice(devId);
+        if (!dev || !dev->macAddr) return "unknown BLE device " + devId;
+        const CharacteristicSchema* chr = findCharacteristic(*dev, a.value("characteristic", ""));
+        if (!chr) return "unknown characteristic " + a.value("characteristic", "");
+        if (!a.contains("value")) return "write without a value";
+        if (auto err = encode(a["value"], chr, action.bytes); !err.empty()) return err;
+
+        action.kind = RuleAction::Kind::Write;
+        action.mac = dev->macAddr;
+        action.uuid = chr->uuid;
+        action.withResponse = !a.value("without_response", false) && chr->writable;
+        return "";
+    }
+
+    // MQTT device from devices_config.json: publish the command to its address
+    if (!devices.contains(devId)) return "unknown device " + devId;
+    const json& d = devices[devId];
+    if (d.value("protocol", "") != "MQTT" || !d.contains("address")) return devId + " is not an MQTT device";
+    std::string command = a.value("command", "");
+    if (!d.contains("commands") || !d["commands"].contains(command) || !d["commands"][command].is_string())
+        return devId + " has no command \"" + command + "\"";
+
+    action.kind = RuleAction::Kind::Publish;
+    action.topic = d["address"];
+    action.payload = d["commands"][command];
+    if (a.contains("value")) {
+        std::string v = a["value"].is_string() ? a["value"].get<std::string>() : a["value"].dump();
+        if (auto pos = action.payload.find("{value}"); pos != std::string::npos)
+            action.payload.replace(pos, 7, v);
+    }
+    return "";
+}
+
+bool readJson(const std::string& file, json& out, std::string& error)
+{
+    std::ifstream in(file);
+    if (!in) {
+        error = "cannot open " + file;
+        return false;
+    }
+    try {
+        out = json::parse(in);
+    } catch (const json::exception& e) {
+        error = std::string("parse error: ") + e.what();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+RuleEngine::RuleEngine(std::string rulesFile, std::string devicesFile)
+    : rulesFile(std::move(rulesFile)), devicesFile(std::move(devicesFile)) {}
+
+RuleEngine::~RuleEngine() = default;
+
+bool RuleEngine::reload(const std::shared_ptr<const SchemaIndex>& schemaIndex, const WriteEncoder& encode)
+{
+    if (!schemaIndex) return false;
+
+    auto next = std::make_unique<RuleTable>();
+    json root, devicesRoot;
+    std::string error;
+    // Stamped before reading: a write during the parse is seen as a change
+    const FileStamp stamp = fileStamp();
+    auto failed = [&](const std::shared_ptr<const SchemaIndex>& attempted) {
+        std::lock_guard<std::mutex> lock(mtx);
+        failedSchema = attempted;
+        failedStamp = stamp;
+    };
+
+    std::ifstream probe(rulesFile);
+    if (!probe) {
+        std::cout << "[Rules] No " << rulesFile << ", no local rules" << std::endl;
+    } else if (!readJson(rulesFile, root, error) || !readJson(devicesFile, devicesRoot, error)) {
+        std::cerr << "[Rules] Reload failed: " << error << std::endl;
+        failed(schemaIndex);
+        return false;
+    } else if (!root.contains("rules") || !root["rules"].is_object()) {
+        std::cerr << "[Rules] Reload failed: missing \"rules\" object" << std::endl;
+        failed(schemaIndex);
+        return false;
+    }
+
+    const json devices = devicesRoot.is_object() ? devicesRoot.value("devices", json::object()) : json::object();
+    if (root.contains("rules")) {
+        for (const auto& [name, r] : root["rules"].items()) {
+            CompiledRule rule;
+            rule.name = name;
+            RulePredicate p{};
+            std::string err = r.is_object() ? parseCondition(r.value("when", json()), *schemaIndex, p)
+                                            : "rule must be an object";
+
+            json then = r.is_object() ? r.value("then", json()) : json();
+            if (then.is_object()) then = json::array({then});
+            if (err.empty() && (!then.is_array() || then.empty())) err = "missing \"then\"";
+            for (size_t i = 0; err.empty() && i < then.size(); ++i) {
+                RuleAction action;
+                err = parseAction(then[i], *schemaIndex, devices, encode, action);
+                rule.actions.push_back(std::move(action));
+            }
+            if (!err.empty()) {
+                std::cerr << "[Rules] " << name << ": " << err << ", skipped" << std::endl;
+                continue;
+            }
+
+            rule.cooldownMs = std::max<int64_t>(0, r.value("cooldown_ms", int64_t(0)));
+            p.rule = static_cast<uint32_t>(next->rules.size());
+            next->rules.push_back(std::move(rule));
+            next->predicates.push_back(p);
+        }
+    }
+
+    auto order = [](const RulePredicate& p) { return std::make_tuple(p.key.mac, p.key.uuid, p.key.field); };
+    std::stable_sort(next->predicates.begin(), next->predicates.end(),
+                     [&](const RulePredicate& a, const RulePredicate& b) { return order(a) < order(b); });
+    next->state.resize(next->predicates.size());
+    for (uint32_t i = 0; i < next->predicates.size();) {
+        uint32_t end = i;
+        while (end < next->predicates.size() && next->predicates[end].key == next->predicates[i].key) ++end;
+        next->index.emplace(next->predicates[i].key, std::make_pair(i, end));
+        i = end;
+    }
+
+    std::cout << "[Rules] Compiled " << next->rules.size() << " rules on "
+              << next->index.size() << " readings from " << rulesFile << std::endl;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    table = std::move(next);
+    schema = schemaIndex;
+    failedSchema.reset();
+    return true;
+}
+
+std::shared_ptr<const SchemaIndex> RuleEngine::compiledSchema() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return schema;
+}
+
+RuleEngine::FileStamp RuleEngine::fileStamp() const
+{
+    std::error_code ec;   // a missing file stamps as the epoch
+    auto rulesTime = std::filesystem::last_write_time(rulesFile, ec);
+    if (ec) rulesTime = {};
+    auto devicesTime = std::filesystem::last_write_time(devicesFile, ec);
+    if (ec) devicesTime = {};
+    return {rulesTime, devicesTime};
+}
+
+bool RuleEngine::needsReload(const std::shared_ptr<const SchemaIndex>& schemaIndex) const
+{
+    const FileStamp stamp = fileStamp();
+    std::lock_guard<std::mutex> lock(mtx);
+    return schemaIndex != schema && (schemaIndex != failedSchema || stamp != failedStamp);
+}
+
+void RuleEngine::evaluate(const SeriesKey& key, double value, int64_t nowMs, std::vector<FiredRule>& fired)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!table) return;
+    const auto* range = table->index.find(key);
+    if (!range) return;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = range->first; i < range->second; ++i) {
+        const RulePredicate& p = table->predicates[i];
+        PredicateState& st = table->state[i];
+
+        bool truth = compare(p.op, value, p.threshold);
+        bool crossed = false;
+        if (!st.active) {
+            crossed = truth && st.known;
+            st.active = truth;
+        } else if (!compare(p.op, value, releaseThreshold(p))) {
+            st.active = false;
+        }
+        st.known = true;
+
+        const CompiledRule& rule = table->rules[p.rule];
+        if (!crossed || nowMs - st.lastFiredMs < rule.cooldownMs) continue;
+        st.lastFiredMs = nowMs;
+        fired.push_back(FiredRule{rule.name, value, rule.actions});
+        fireCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    evalCount.fetch_add(1, std::memory_order_relaxed);
+    evalNs.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+}
+
+size_t RuleEngine::ruleCount() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return table ? table->rules.size() : 0;
+}
+
+uint64_t RuleEngine::meanEvalNs() const
+{
+    uint64_t n = evalCount.load(std::memory_order_relaxed);
+    return n ? evalNs.load(std::memory_order_relaxed) / n : 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "device_schema.h"
+#include "flat_map.h"
+#include "latency_histogram.h"
+#include "timeseries_store.h"
+
+// Local condition -> action rules, so a sensor can drive an actuator without
+// a round trip through the Python hub. Rules come from rules_config.json:
+//
+//   "motion_turns_on_light": {
+//     "when": {"device": "motion_sensor_1", "field": "motion", "op": ">=", "value": 1},
+//     "then": [{"device": "light_1", "command": "turn_on"}],
+//     "cooldown_ms": 5000
+//   }
+//
+// A condition names a reading the way history does (device, characteristic,
+// BTHome field) and a threshold. It fires when the reading crosses the
+// threshold, not on every reading past it; "hysteresis" widens the band the
+// value has to leave before the rule re-arms. Actions are an MQTT publish
+// (an MQTT device and command from devices_config.json, or a raw topic and
+// payload) or a characteristic write.
+//
+// Rules are compiled against the schema into a flat predicate table sorted
+// by reading, with a hash index from reading to its predicate range; a
+// reading without rules costs one hash lookup.
+
+enum class RuleOp : uint8_t { Gt, Ge, Lt, Le, Eq, Ne };
+
+struct RuleAction {
+    enum class Kind : uint8_t { Publish, Write };
+    Kind kind = Kind::Publish;
+    std::string topic;            // Publish
+    std::string payload;          // Publish, "{value}" is replaced by the reading
+    MacAddr mac = 0;              // Write
+    Uuid128 uuid;
+    std::vector<uint8_t> bytes;
+    bool withResponse = true;
+};
+
+struct FiredRule {
+    std::string rule;
+    double value;
+    std::vector<RuleAction> actions;
+};
+
+struct RuleTable;
+
+class RuleEngine {
+public:
+    // Encodes a write "value" for a characteristic, returns an error message or ""
+    using WriteEncoder = std::function<std::string(const nlohmann::json&, const CharacteristicSchema*,
+                                                   std::vector<uint8_t>&)>;
+
+    RuleEngine(std::string rulesFile, std::string devicesFile);
+    ~RuleEngine();
+
+    RuleEngine(const RuleEngine&) = delete;
+    RuleEngine& operator=(const RuleEngine&) = delete;
+
+    // Compiles the rules file against schema. A missing file means no rules;
+    // on any other error the previous table is kept.
+    bool reload(const std::shared_ptr<const SchemaIndex>& schema, const WriteEncoder& encode);
+
+    // Schema the current table was compiled against
+    std::shared_ptr<const SchemaIndex> compiledSchema() const;
+
+    // True when schema differs from the compiled one, unless a reload against
+    // it already failed and neither file has been written since
+    bool needsReload(const std::shared_ptr<const SchemaIndex>& schema) const;
+
+    // Checks every predicate on this reading and appends the rules that fired
+    void evaluate(const SeriesKey& key, double value, int64_t nowMs, std::vector<FiredRule>& fired);
+
+    size_t ruleCount() const;
+    uint64_t evaluations() const { return evalCount.load(std::memory_order_relaxed); }
+    uint64_t firings() const { return fireCount.load(std::memory_order_relaxed); }
+    // Mean cost of evaluate() for readings that have predicates, in ns
+    uint64_t meanEvalNs() const;
+
+    // Reading received -> action sent, recorded by whoever runs the action
+    LatencyHistogram& reactionLatency() { return reaction; }
+
+private:
+    std::string rulesFile;
+    std::string devicesFile;
+    mutable std::mutex mtx;   // guards the table and its per-predicate state
+    std::unique_ptr<RuleTable> table;
+    std::shared_ptr<const SchemaIndex> schema;
+    // Last failed reload: the schema and the write times of both files
+    using FileStamp = std::pair<std::filesystem::file_time_type, std::filesystem::file_time_type>;
+    FileStamp fileStamp() const;
+    std::shared_ptr<const SchemaIndex> failedSchema;
+    FileStamp failedStamp;
+    std::atomic<uint64_t> evalCount{0};
+    std::atomic<uint64_t> evalNs{0};
+    std::atomic<uint64_t> fireCount{0};
+    LatencyHistogram reaction;
+};
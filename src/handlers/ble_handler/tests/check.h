@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the unit tests: a failed CHECK prints where and keeps
+// going, main() returns test_failures() so ctest sees the result.
+
+inline int& test_failures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++test_failures();                                                            \
+        }                                                                                 \
+    } while (0)
+
+#define CHECK_NEAR(a, b, eps) CHECK(((a) - (b)) < (eps) && ((b) - (a)) < (eps))
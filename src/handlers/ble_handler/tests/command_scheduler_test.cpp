@@ -0,0 +1,68 @@
+// CommandScheduler: schedules restored from the file keep their ids, and a
+// schedule added afterwards without an id never takes one of them.
+
+#include <filesystem>
+#include <set>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "../command_scheduler.h"
+#include "check.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+const std::string SCHEDULES_FILE = "/tmp/command_scheduler_test.json";
+
+json request(int64_t inMs)
+{
+    return {{"in_ms", inMs}, {"action", {{"command", "connect_device"}, {"device", "sensor"}}}};
+}
+
+std::set<std::string> ids(const CommandScheduler& scheduler)
+{
+    std::set<std::string> out;
+    for (const auto& s : scheduler.list()) out.insert(s.value("id", ""));
+    return out;
+}
+
+} // namespace
+
+int main()
+{
+    std::filesystem::remove(SCHEDULES_FILE);
+    json out;
+    {
+        CommandScheduler first(SCHEDULES_FILE);
+        CHECK(first.add(request(3600000), out).empty());
+        CHECK(out.value("id", "") == "schedule_1");
+        CHECK(first.add(request(7200000), out).empty());
+        CHECK(first.add(request(7200000), out).empty());
+        CHECK(out.value("id", "") == "schedule_3");
+        CHECK(first.remove("schedule_1"));
+        first.stop();   // saves
+    }
+
+    // Restored with serials 1 and 2, so the next serial is 3 again
+    CommandScheduler restored(SCHEDULES_FILE);
+    CHECK(restored.load());
+    CHECK(restored.size() == 2);
+    CHECK(ids(restored) == (std::set<std::string>{"schedule_2", "schedule_3"}));
+
+    // A generated id skips the restored ones instead of replacing them
+    for (int i = 0; i < 3; ++i) CHECK(restored.add(request(600000), out).empty());
+    CHECK(restored.size() == 5);
+    CHECK(ids(restored).count("schedule_2") && ids(restored).count("schedule_3"));
+
+    // An explicit id still replaces
+    json again = request(60000);
+    again["id"] = "schedule_2";
+    CHECK(restored.add(again, out).empty());
+    CHECK(restored.size() == 5);
+
+    restored.stop();
+    std::filesystem::remove(SCHEDULES_FILE);
+    return test_failures() ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+// LinkQualityTable: the RSSI, spread and interval EWMAs, the publish
+// thresholds and presence (absent after the timeout, present again on
+// the next sighting, never absent while connected).
+
+#include <vector>
+
+#include "../link_quality.h"
+#include "check.h"
+
+namespace {
+
+constexpr int64_t T0 = 1700000000000;   // unix ms
+const FlatSet<MacAddr> NONE_CONNECTED;
+
+bool swept(LinkQualityTable& table, int64_t nowMs, MacAddr mac, const FlatSet<MacAddr>& connected = NONE_CONNECTED)
+{
+    std::vector<LinkQuality> gone;
+    table.sweep(nowMs, connected, gone);
+    for (const auto& q : gone)
+        if (q.mac == mac) return true;
+    return false;
+}
+
+void testEwma()
+{
+    LinkQualityTable table;
+    LinkQuality q;
+    const MacAddr mac = 0xA4C138000001ULL;
+
+    // The first reading is the estimate, and the device becomes present
+    CHECK(table.observeRssi(mac, -60, T0, q));
+    CHECK(q.present);
+    CHECK_NEAR(q.rssiDbm, -60.0f, 1e-4f);
+
+    // Then RSSI_ALPHA of the way to each sample; the spread follows |sample - estimate|
+    CHECK(!table.observeRssi(mac, -70, T0 + 1000, q));   // within MIN_PUBLISH_GAP_MS
+    CHECK(table.get(mac, q));
+    CHECK_NEAR(q.rssiDbm, -62.0f, 1e-4f);
+    CHECK_NEAR(q.rssiSpreadDb, 2.0f, 1e-4f);
+    CHECK_NEAR(q.advIntervalMs, 1000.0f, 1e-3f);          // the first gap is the interval
+
+    table.observeRssi(mac, -70, T0 + 2000, q);
+    CHECK(table.get(mac, q));
+    CHECK_NEAR(q.rssiDbm, -63.6f, 1e-4f);
+    CHECK_NEAR(q.rssiSpreadDb, 3.2f, 1e-4f);
+    CHECK(q.rssiSamples == 3);
+
+    // A gap longer than MAX_INTERVAL_MS is an absence, not an interval
+    LinkQuality out;
+    CHECK(table.observeSeen(mac, T0 + 2000 + LinkQualityTable::MAX_INTERVAL_MS + 1, out));   // first interval
+    CHECK_NEAR(out.advIntervalMs, 1000.0f, 1e-3f);
+
+    // Connect outcomes: CONNECT_ALPHA towards 0 or 1
+    table.recordConnect(mac, false, T0 + 60000, q);
+    CHECK(table.get(mac, q));
+    CHECK_NEAR(q.connectSuccess, 0.75f, 1e-4f);
+    CHECK(q.connectAttempts == 1);
+}
+
+void testPresence()
+{
+    LinkQualityTable table;
+    LinkQuality q;
+    const MacAddr mac = 0xA4C138000002ULL;
+    table.observeRssi(mac, -60, T0, q);
+
+    // Absent once unseen for ABSENT_MIN_MS, published once
+    CHECK(!swept(table, T0 + LinkQualityTable::ABSENT_MIN_MS - 1, mac));
+    CHECK(swept(table, T0 + LinkQualityTable::ABSENT_MIN_MS, mac));
+    CHECK(table.get(mac, q) && !q.present);
+    CHECK(!swept(table, T0 + 2 * LinkQualityTable::ABSENT_MIN_MS, mac));
+
+    // The next sighting makes it present again, published at once
+    CHECK(table.observeRssi(mac, -61, T0 + 2 * LinkQualityTable::ABSENT_MIN_MS + 1, q));
+    CHECK(q.present);
+}
+
+void testSlowAdvertiser()
+{
+    // Every 20 s: absent only after ABSENT_INTERVALS intervals (160 s)
+    LinkQualityTable table;
+    LinkQuality q;
+    const MacAddr mac = 0xA4C138000003ULL;
+    int64_t t = T0;
+    for (int i = 0; i < 5; ++i, t += 20000) table.observeSeen(mac, t, q);
+    int64_t last = t - 20000;
+    CHECK(table.get(mac, q));
+    CHECK_NEAR(q.advIntervalMs, 20000.0f, 1e-2f);
+    CHECK(!swept(table, last + 100000, mac));
+    CHECK(!swept(table, last + 159999, mac));
+    CHECK(swept(table, last + 160000, mac));
+}
+
+void testConnectedStaysPresent()
+{
+    // A connected peripheral stops advertising; it is not absent
+    LinkQualityTable table;
+    LinkQuality q;
+    const MacAddr mac = 0xA4C138000004ULL;
+    table.observeRssi(mac, -55, T0, q);
+
+    FlatSet<MacAddr> connected;
+    connected.insert(mac);
+    CHECK(!swept(table, T0 + 10 * LinkQualityTable::ABSENT_MIN_MS, mac, connected));
+    CHECK(table.get(mac, q) && q.present);
+
+    // Disconnected and still silent: absent on the next sweep
+    CHECK(swept(table, T0 + 11 * LinkQualityTable::ABSENT_MIN_MS, mac));
+}
+
+} // namespace
+
+int main()
+{
+    testEwma();
+    testPresence();
+    testSlowAdvertiser();
+    testConnectedStaysPresent();
+    return test_failures() ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+// RuleEngine::needsReload: a schema change triggers a recompile, but once a
+// reload against that schema has failed it is not retried until one of the
+// files is written again.
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../rules_engine.h"
+#include "check.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+const std::string DEVICES_FILE = "/tmp/rules_engine_test_devices.json";
+const std::string RULES_FILE = "/tmp/rules_engine_test_rules.json";
+
+// Written with an explicit, later mtime: two writes can land in one timestamp tick
+void writeRules(const std::string& text)
+{
+    static auto stamp = std::filesystem::file_time_type::clock::now();
+    std::ofstream(RULES_FILE) << text;
+    stamp += std::chrono::seconds(1);
+    std::filesystem::last_write_time(RULES_FILE, stamp);
+}
+
+std::shared_ptr<const SchemaIndex> loadSchema()
+{
+    std::string error;
+    auto schema = loadSchemaIndex(DEVICES_FILE, error);
+    CHECK(schema != nullptr);
+    return schema;
+}
+
+} // namespace
+
+int main()
+{
+    json devices = {
+        {"sensor", {{"protocol", "BLE"}, {"ble_address", "A4:C1:38:00:00:01"},
+                    {"characteristics", {{"data", {{"uuid", "d52246df-98ac-4d21-be1b-70d5f66a5ddb"},
+                                                   {"Properties", {"Read"}}, {"accepted values", {
+                        {"motion", {{"id", "0x21"}, {"data type", "uint8"}}},
+                    }}}}}}}},
+        {"light", {{"protocol", "MQTT"}, {"address", "home/light"}, {"commands", {{"turn_on", "turn_on"}}}}},
+    };
+    std::ofstream(DEVICES_FILE) << json{{"devices", devices}}.dump();
+    const std::string goodRules = json{{"rules", {{"motion_light", {
+        {"when", {{"device", "sensor"}, {"field", "motion"}, {"op", ">="}, {"value", 1}}},
+        {"then", {{{"device", "light"}, {"command", "turn_on"}}}},
+    }}}}}.dump();
+
+    RuleEngine engine(RULES_FILE, DEVICES_FILE);
+    auto noEncode = [](const json&, const CharacteristicSchema*, std::vector<uint8_t>&) { return std::string(); };
+
+    writeRules(goodRules);
+    auto schema = loadSchema();
+    CHECK(engine.needsReload(schema));
+    CHECK(engine.reload(schema, noEncode));
+    CHECK(engine.ruleCount() == 1);
+    CHECK(!engine.needsReload(schema));
+
+    // A new schema with a broken rules file: one failed attempt, then quiet
+    writeRules("{\"rules\": {");
+    auto reloaded = loadSchema();
+    CHECK(engine.needsReload(reloaded));
+    CHECK(!engine.reload(reloaded, noEncode));
+    CHECK(engine.ruleCount() == 1);                      // previous table kept
+    CHECK(!engine.needsReload(reloaded));
+    CHECK(engine.needsReload(loadSchema()));             // yet another schema is tried
+
+    // Fixing the file makes it due again
+    writeRules(goodRules);
+    CHECK(engine.needsReload(reloaded));
+    CHECK(engine.reload(reloaded, noEncode));
+    CHECK(!engine.needsReload(reloaded));
+
+    std::filesystem::remove(DEVICES_FILE);
+    std::filesystem::remove(RULES_FILE);
+    return test_failures() ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hierarchical timer wheel: four levels of 64 slots, each level 64 times
+// coarser than the one below. Adding or cancelling a timer is O(1); every
+// tick expires one level-0 slot and, every 64 ticks, re-files one slot of
+// the next level down (cascade), so the cost per tick does not depend on
+// how many timers are pending.
+//
+// With tickMs = 50 the levels cover 3.2 s, 3.4 min, 3.6 h and 9.7 days.
+// Timers beyond that are parked in the last level and re-filed when they
+// cascade, so any due time works.
+//
+// Timer nodes live in one vector with a free list and are linked by index;
+// an id carries a generation so cancelling an expired timer is harmless.
+// Not thread-safe.
+
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+    static constexpr TimerId INVALID_TIMER = 0;
+
+    TimerWheel(uint32_t tickMs, int64_t nowMs) : tickMs(tickMs), currentTick(nowMs / tickMs) {
+        for (auto& level : slots) level.fill(NIL);
+    }
+
+    // Timers due at or before the current tick fire on the next advance()
+    TimerId add(int64_t dueMs, uint64_t data) {
+        uint32_t n;
+        if (freeHead != NIL) {
+            n = freeHead;
+            freeHead = nodes[n].next;
+        } else {
+            n = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        Node& node = nodes[n];
+        node.dueTick = dueMs <= 0 ? 0 : (dueMs + tickMs - 1) / tickMs;  // round up, never early
+        node.data = data;
+        node.live = true;
+        link(n, currentTick + 1);
+        ++count;
+        return (static_cast<uint64_t>(node.gen) << 32) | (n + 1);
+    }
+
+    bool cancel(TimerId id) {
+        uint32_t n = static_cast<uint32_t>(id & 0xFFFFFFFF) - 1;
+        if (id == INVALID_TIMER || n >= nodes.size()) return false;
+        Node& node = nodes[n];
+        if (!node.live || node.gen != static_cast<uint32_t>(id >> 32)) return false;
+        unlink(n);
+        release(n);
+        return true;
+    }
+
+    // Runs every tick up to nowMs, calling fn(id, data) for each expired timer.
+    // fn may add or cancel timers.
+    template <typename F>
+    void advance(int64_t nowMs, F&& fn) {
+        int64_t target = nowMs / tickMs;
+        while (currentTick < target) {
+            ++currentTick;
+            cascade();
+
+            // Detach the whole slot before calling out, fn may cancel any timer
+            uint32_t slot = static_cast<uint32_t>(currentTick & MASK);
+            uint32_t n = slots[0][slot];
+            slots[0][slot] = NIL;
+            expired.clear();
+            while (n != NIL) {
+                uint32_t next = nodes[n].next;
+                if (nodes[n].dueTick > currentTick) {
+                    link(n, currentTick + 1);  // parked beyond the horizon, not due yet
+                } else {
+                    expired.emplace_back((static_cast<uint64_t>(nodes[n].gen) << 32) | (n + 1), nodes[n].data);
+                    release(n);
+                }
+                n = next;
+            }
+            for (const auto& [id, data] : expired) fn(id, data);
+        }
+    }
+
+    // Wall time at which the next tick is due
+    int64_t nextTickMs() const { return (currentTick + 1) * tickMs; }
+    int64_t nowMs() const { return currentTick * tickMs; }
+    size_t size() const { return count; }
+
+    // Re-bases an empty wheel, e.g. after the wall clock stepped backwards
+    void reset(int64_t nowMs) {
+        for (auto& level : slots) level.fill(NIL);
+        nodes.clear();
+        freeHead = NIL;
+        count = 0;
+        currentTick = nowMs / tickMs;
+    }
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int BITS = 6;
+    static constexpr uint32_t SLOTS = 1u << BITS;
+    static constexpr int64_t MASK = SLOTS - 1;
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        int64_t dueTick = 0;
+        uint64_t data = 0;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        uint32_t gen = 0;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+        bool live = false;
+    };
+
+    // earliest is the first tick whose level-0 slot has not been run yet
+    void link(uint32_t n, int64_t earliest) {
+        Node& node = nodes[n];
+        int64_t due = std::max(node.dueTick, earliest);
+        int64_t delta = due - currentTick;
+
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (int64_t(1) << (BITS * (level + 1)))) ++level;
+        if (level == LEVELS - 1 && delta >= (int64_t(1) << (BITS * LEVELS)))
+            due = currentTick + (int64_t(1) << (BITS * LEVELS)) - 1;  // park at the horizon
+
+        node.level = static_cast<uint8_t>(level);
+        node.slot = static_cast<uint8_t>((due >> (BITS * level)) & MASK);
+        uint32_t& head = slots[level][node.slot];
+        node.prev = NIL;
+        node.next = head;
+        if (head != NIL) nodes[head].prev = n;
+        head = n;
+    }
+
+    void unlink(uint32_t n) {
+        Node& node = nodes[n];
+        if (node.prev != NIL) nodes[node.prev].next = node.next;
+        else slots[node.level][node.slot] = node.next;
+        if (node.next != NIL) nodes[node.next].prev = node.prev;
+    }
+
+    void release(uint32_t n) {
+        Node& node = nodes[n];
+        node.live = false;
+        ++node.gen;
+        node.next = freeHead;
+        freeHead = n;
+        --count;
+    }
+
+    // When a level wraps, the matching slot of the level above is due to be
+    // spread over the levels below
+    void cascade() {
+        for (int level = 1; level < LEVELS; ++level) {
+            if (currentTick & ((int64_t(1) << (BITS * level)) - 1)) return;
+            uint32_t slot = static_cast<uint32_t>((currentTick >> (BITS * level)) & MASK);
+            uint32_t n = slots[level][slot];
+            slots[level][slot] = NIL;
+            while (n != NIL) {
+                uint32_t next = nodes[n].next;
+                link(n, currentTick);  // this tick's level-0 slot runs right after
+                n = next;
+            }
+        }
+    }
+
+    uint32_t tickMs;
+    int64_t currentTick;
+    std::array<std::array<uint32_t, SLOTS>, LEVELS> slots;
+    std::vector<Node> nodes;
+    uint32_t freeHead = NIL;
+    size_t count = 0;
+    std::vector<std::pair<TimerId, uint64_t>> expired;  // reused by advance()
+};
@@ -0,0 +1,409 @@
+#include "timeseries_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char SERIES_MAGIC[8] = {'B', 'L', 'E', 'T', 'S', 'E', 'R', '\0'};
+constexpr uint32_t SERIES_VERSION = 1;
+
+#pragma pack(push, 1)
+struct SeriesFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t segmentBytes;
+    uint32_t segmentCount;
+    uint16_t field;
+    uint16_t reserved;
+    uint64_t mac;
+    uint64_t uuidHi;
+    uint64_t uuidLo;
+    double scale;
+};
+
+struct SegmentHeader {
+    uint64_t seq;          // 0 = never written, otherwise increasing per new segment
+    int64_t firstTs;
+    int64_t lastTs;
+    int64_t firstValue;
+    int64_t lastValue;
+    int64_t minValue;
+    int64_t maxValue;
+    int64_t sumValue;
+    uint32_t count;        // samples, including the first one
+    uint32_t used;         // payload bytes
+};
+#pragma pack(pop)
+
+static_assert(sizeof(SeriesFileHeader) == 56, "series header layout changed");
+static_assert(sizeof(SegmentHeader) == 72, "segment header layout changed");
+
+constexpr uint32_t PAYLOAD_BYTES = TimeSeriesStore::SEGMENT_BYTES - sizeof(SegmentHeader);
+constexpr uint32_t MAX_PAIR_BYTES = 20; // two 10-byte varints
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+inline uint8_t* putVarint(uint8_t* p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = static_cast<uint8_t>(v) | 0x80;
+        v >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(v);
+    return p;
+}
+
+inline const uint8_t* getVarint(const uint8_t* p, const uint8_t* end, uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return nullptr; // truncated
+}
+
+std::string seriesFileName(const SeriesKey& key)
+{
+    std::string mac = macToString(key.mac);
+    mac.erase(std::remove(mac.begin(), mac.end(), ':'), mac.end());
+    char field[8];
+    std::snprintf(field, sizeof(field), "%04x", key.field);
+    return mac + "_" + uuidToString(key.uuid) + "_" + field + ".ts";
+}
+
+} // namespace
+
+// One mmap'd ring file. All access goes through mtx.
+class TimeSeries {
+public:
+    ~TimeSeries() {
+        if (base != MAP_FAILED) munmap(base, mappedBytes);
+        if (fd >= 0) close(fd);
+    }
+
+    static std::unique_ptr<TimeSeries> open(const std::string& file, const SeriesKey& key, double scale,
+                                            uint32_t segmentCount, bool create);
+
+    bool append(int64_t tsMs, int64_t raw);
+    // The newest limit points in [fromMs, toMs], oldest first; reads
+    // segments newest first and stops once it has enough
+    void newest(int64_t fromMs, int64_t toMs, size_t limit, std::vector<HistoryPoint>& out) const;
+    bool aggregate(int64_t fromMs, int64_t toMs, int64_t bucketMs, std::vector<HistoryBucket>& out) const;
+
+    double scale = 1.0;
+    std::mutex mtx;
+
+private:
+    SegmentHeader* segment(uint32_t i) const {
+        return reinterpret_cast<SegmentHeader*>(static_cast<uint8_t*>(base) + TimeSeriesStore::SEGMENT_BYTES * (i + 1));
+    }
+    uint8_t* payload(uint32_t i) const { return reinterpret_cast<uint8_t*>(segment(i)) + sizeof(SegmentHeader); }
+
+    // Written segments, oldest first
+    void ordered(std::vector<uint32_t>& out) const;
+    // fn for every sample of segment i in [fromMs, toMs]; false once past toMs
+    bool decode(uint32_t i, int64_t fromMs, int64_t toMs, const std::function<void(int64_t, int64_t)>& fn) const;
+    void startSegment(int64_t tsMs, int64_t raw);
+
+    int fd = -1;
+    void* base = MAP_FAILED;
+    size_t mappedBytes = 0;
+    uint32_t segmentCount = 0;
+    uint32_t head = 0;     // segment being appended to
+    uint64_t headSeq = 0;  // 0 while the series is empty
+};
+
+std::unique_ptr<TimeSeries> TimeSeries::open(const std::string& file, const SeriesKey& key, double scale,
+                                             uint32_t segmentCount, bool create)
+{
+    auto ts = std::unique_ptr<TimeSeries>(new TimeSeries());
+    ts->fd = ::open(file.c_str(), O_RDWR | (create ? O_CREAT : 0) | O_CLOEXEC, 0644);
+    if (ts->fd < 0) {
+        if (create) std::cerr << "[History] Cannot open " << file << ": " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    struct stat st{};
+    fstat(ts->fd, &st);
+    bool fresh = st.st_size == 0;
+
+    SeriesFileHeader header{};
+    if (!fresh) {
+        if (pread(ts->fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            std::memcmp(header.magic, SERIES_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != SERIES_VERSION || header.segmentBytes != TimeSeriesStore::SEGMENT_BYTES ||
+            header.mac != key.mac || header.uuidHi != key.uuid.hi || header.uuidLo != key.uuid.lo ||
+            header.field != key.field ||
+            static_cast<uint64_t>(st.st_size) != uint64_t(header.segmentCount + 1) * TimeSeriesStore::SEGMENT_BYTES) {
+            std::cerr << "[History] " << file << " is not a valid series file, ignoring" << std::endl;
+            return nullptr;
+        }
+        segmentCount = header.segmentCount;
+    } else {
+        std::memcpy(header.magic, SERIES_MAGIC, sizeof(header.magic));
+        header.version      = SERIES_VERSION;
+        header.segmentBytes = TimeSeriesStore::SEGMENT_BYTES;
+        header.segmentCount = segmentCount;
+        header.field        = key.field;
+        header.mac          = key.mac;
+        header.uuidHi       = key.uuid.hi;
+        header.uuidLo       = key.uuid.lo;
+        header.scale        = scale;
+        // Sparse: pages are only allocated once segments are written
+        if (ftruncate(ts->fd, off_t(segmentCount + 1) * TimeSeriesStore::SEGMENT_BYTES) != 0 ||
+            pwrite(ts->fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            std::cerr << "[History] Cannot size " << file << ": " << std::strerror(errno) << std::endl;
+            return nullptr;
+        }
+    }
+
+    ts->segmentCount = segmentCount;
+    ts->scale        = fresh ? scale : header.scale;
+    ts->mappedBytes  = size_t(segmentCount + 1) * TimeSeriesStore::SEGMENT_BYTES;
+    ts->base = mmap(nullptr, ts->mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, ts->fd, 0);
+    if (ts->base == MAP_FAILED) {
+        std::cerr << "[History] mmap of " << file << " failed: " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    for (uint32_t i = 0; i < segmentCount; ++i) {
+        const SegmentHeader* seg = ts->segment(i);
+        if (seg->seq > ts->headSeq && seg->used <= PAYLOAD_BYTES) {
+            ts->headSeq = seg->seq;
+            ts->head = i;
+        }
+    }
+    return ts;
+}
+
+void TimeSeries::startSegment(int64_t tsMs, int64_t raw)
+{
+    if (headSeq != 0) head = (head + 1) % segmentCount;
+    SegmentHeader* seg = segment(head);
+    seg->seq = 0; // invalid while being rewritten
+    seg->firstTs = seg->lastTs = tsMs;
+    seg->firstValue = seg->lastValue = raw;
+    seg->minValue = seg->maxValue = seg->sumValue = raw;
+    seg->count = 1;
+    seg->used = 0;
+    seg->seq = ++headSeq;
+}
+
+bool TimeSeries::append(int64_t tsMs, int64_t raw)
+{
+    SegmentHeader* seg = headSeq ? segment(head) : nullptr;
+    if (!seg || seg->used + MAX_PAIR_BYTES > PAYLOAD_BYTES) {
+        startSegment(tsMs, raw);
+        return true;
+    }
+
+    uint8_t* p = payload(head) + seg->used;
+    uint8_t* end = putVarint(p, zigzag(tsMs - seg->lastTs));
+    end = putVarint(end, zigzag(raw - seg->lastValue));
+
+    seg->lastTs    = tsMs;
+    seg->lastValue = raw;
+    seg->minValue  = std::min(seg->minValue, raw);
+    seg->maxValue  = std::max(seg->maxValue, raw);
+    seg->sumValue += raw;
+    seg->count    += 1;
+    seg->used     += static_cast<uint32_t>(end - p);
+    return true;
+}
+
+void TimeSeries::ordered(std::vector<uint32_t>& out) const
+{
+    out.clear();
+    if (!headSeq) return;
+    for (uint32_t i = 1; i <= segmentCount; ++i) {
+        uint32_t idx = (head + i) % segmentCount;
+        if (segment(idx)->seq != 0) out.push_back(idx);
+    }
+}
+
+bool TimeSeries::decode(uint32_t i, int64_t fromMs, int64_t toMs,
+                        const std::function<void(int64_t, int64_t)>& fn) const
+{
+    const SegmentHeader* seg = segment(i);
+    int64_t ts = seg->firstTs, value = seg->firstValue;
+    if (ts >= fromMs && ts <= toMs) fn(ts, value);
+
+    const uint8_t* p = payload(i);
+    const uint8_t* end = p + seg->used;
+    for (uint32_t n = 1; n < seg->count && p < end; ++n) {
+        uint64_t dt, dv;
+        if (!(p = getVarint(p, end, dt)) || !(p = getVarint(p, end, dv))) break;
+        ts += unzigzag(dt);
+        value += unzigzag(dv);
+        if (ts > toMs) return false;
+        if (ts >= fromMs) fn(ts, value);
+    }
+    return true;
+}
+
+void TimeSeries::newest(int64_t fromMs, int64_t toMs, size_t limit, std::vector<HistoryPoint>& out) const
+{
+    std::vector<uint32_t> segs;
+    ordered(segs);
+    auto first = std::partition_point(segs.begin(), segs.end(),
+                                      [&](uint32_t i) { return segment(i)->lastTs < fromMs; });
+    auto last = std::partition_point(first, segs.end(), [&](uint32_t i) { return segment(i)->firstTs <= toMs; });
+
+    // Newest segment first, each decoded forward; whole segments are kept
+    // until there are enough points, then the oldest extra ones trimmed
+    std::vector<std::vector<HistoryPoint>> chunks;
+    size_t total = 0;
+    for (auto it = last; it != first && total < limit;) {
+        --it;
+        std::vector<HistoryPoint> chunk;
+        decode(*it, fromMs, toMs, [&](int64_t tsMs, int64_t raw) { chunk.push_back({tsMs, raw * scale}); });
+        total += chunk.size();
+        chunks.push_back(std::move(chunk));
+    }
+
+    out.reserve(std::min(total, limit));
+    size_t skip = total > limit ? total - limit : 0;
+    for (auto c = chunks.rbegin(); c != chunks.rend(); ++c) {
+        size_t from = std::min(skip, c->size());
+        skip -= from;
+        out.insert(out.end(), c->begin() + static_cast<ptrdiff_t>(from), c->end());
+    }
+}
+
+bool TimeSeries::aggregate(int64_t fromMs, int64_t toMs, int64_t bucketMs, std::vector<HistoryBucket>& out) const
+{
+    struct Acc {
+        int64_t start = 0;
+        int64_t min = 0, max = 0, sum = 0;
+        uint32_t count = 0;
+    } acc;
+
+    auto flush = [&]() {
+        if (!acc.count) return;
+        out.push_back({acc.start, acc.min * scale, acc.max * scale,
+                       static_cast<double>(acc.sum) / acc.count * scale, acc.count});
+        acc.count = 0;
+    };
+    auto add = [&](int64_t bucketStart, int64_t min, int64_t max, int64_t sum, uint32_t count) {
+        if (acc.count && acc.start != bucketStart) flush();
+        if (!acc.count) {
+            acc.start = bucketStart;
+            acc.min = min;
+            acc.max = max;
+            acc.sum = 0;
+        }
+        acc.min = std::min(acc.min, min);
+        acc.max = std::max(acc.max, max);
+        acc.sum += sum;
+        acc.count += count;
+    };
+    auto bucketOf = [&](int64_t ts) { return fromMs + (ts - fromMs) / bucketMs * bucketMs; };
+
+    std::vector<uint32_t> segs;
+    ordered(segs);
+    auto first = std::partition_point(segs.begin(), segs.end(),
+                                      [&](uint32_t i) { return segment(i)->lastTs < fromMs; });
+
+    for (auto it = first; it != segs.end(); ++it) {
+        const SegmentHeader* seg = segment(*it);
+        if (seg->firstTs > toMs) break;
+
+        // Whole segment inside the range and inside one bucket: use its header
+        if (seg->firstTs >= fromMs && seg->lastTs <= toMs && seg->firstTs <= seg->lastTs &&
+            bucketOf(seg->firstTs) == bucketOf(seg->lastTs)) {
+            add(bucketOf(seg->firstTs), seg->minValue, seg->maxValue, seg->sumValue, seg->count);
+            continue;
+        }
+
+        int64_t ts = seg->firstTs, value = seg->firstValue;
+        if (ts >= fromMs && ts <= toMs) add(bucketOf(ts), value, value, value, 1);
+
+        const uint8_t* p = payload(*it);
+        const uint8_t* end = p + seg->used;
+        for (uint32_t n = 1; n < seg->count && p < end; ++n) {
+            uint64_t dt, dv;
+            if (!(p = getVarint(p, end, dt)) || !(p = getVarint(p, end, dv))) break;
+            ts += unzigzag(dt);
+            value += unzigzag(dv);
+            if (ts > toMs) break;
+            if (ts >= fromMs) add(bucketOf(ts), value, value, value, 1);
+        }
+    }
+    flush();
+    return true;
+}
+
+TimeSeriesStore::TimeSeriesStore(std::string dir, uint32_t segmentsPerSeries)
+    : dir(std::move(dir)), segmentsPerSeries(std::max<uint32_t>(segmentsPerSeries, 2)) {}
+
+TimeSeriesStore::~TimeSeriesStore() = default;
+
+TimeSeries* TimeSeriesStore::series(const SeriesKey& key, double scale, bool create)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (auto* found = seriesMap.find(key)) return found->get();
+
+    std::error_code ec;
+    if (create) std::filesystem::create_directories(dir, ec);
+    auto ts = TimeSeries::open(dir + "/" + seriesFileName(key), key, scale, segmentsPerSeries, create);
+    if (!ts) return nullptr;
+
+    TimeSeries* raw = ts.get();
+    seriesMap.emplace(key, std::move(ts));
+    return raw;
+}
+
+bool TimeSeriesStore::append(const SeriesKey& key, double scale, int64_t tsMs, int64_t raw)
+{
+    TimeSeries* ts = series(key, scale, true);
+    if (!ts) return false;
+
+    std::lock_guard<std::mutex> lock(ts->mtx);
+    ts->append(tsMs, raw);
+    appended.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool TimeSeriesStore::query(const SeriesKey& key, int64_t fromMs, int64_t toMs, size_t limit,
+                            std::vector<HistoryPoint>& out)
+{
+    out.clear();
+    TimeSeries* ts = series(key, 1.0, false);
+    if (!ts) return false;
+
+    std::lock_guard<std::mutex> lock(ts->mtx);
+    ts->newest(fromMs, toMs, limit ? limit : SIZE_MAX, out);
+    return true;
+}
+
+bool TimeSeriesStore::aggregate(const SeriesKey& key, int64_t fromMs, int64_t toMs, int64_t bucketMs,
+                                std::vector<HistoryBucket>& out)
+{
+    out.clear();
+    if (bucketMs <= 0) return false;
+    TimeSeries* ts = series(key, 1.0, false);
+    if (!ts) return false;
+
+    std::lock_guard<std::mutex> lock(ts->mtx);
+    return ts->aggregate(fromMs, toMs, bucketMs, out);
+}
+
+size_t TimeSeriesStore::seriesCount()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return seriesMap.size();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ble_keys.h"
+#include "flat_map.h"
+
+// Per-device, per-characteristic history of sensor readings.
+//
+// Every series is one file of fixed-size segments used as a ring and mapped
+// with mmap(MAP_SHARED), so history survives restarts and queries are served
+// straight from the page cache. A segment keeps its first sample and min/max
+// in its header; the rest are (timestamp delta, value delta) pairs as
+// zigzag varints, which is 2-3 bytes for a 1 Hz sensor. When the ring is
+// full the oldest segment is reused.
+//
+// Values are stored as raw integers; the series scale turns them into
+// engineering units on the way out.
+
+constexpr uint16_t SERIES_FIELD_VALUE = 0xFFFF; // the characteristic value itself
+
+struct SeriesKey {
+    MacAddr mac = 0;
+    Uuid128 uuid;
+    uint16_t field = SERIES_FIELD_VALUE;  // BTHome object id, or SERIES_FIELD_VALUE
+
+    bool operator==(const SeriesKey& other) const {
+        return mac == other.mac && uuid == other.uuid && field == other.field;
+    }
+};
+
+template <>
+struct FlatHash<SeriesKey> {
+    size_t operator()(const SeriesKey& key) const noexcept {
+        return FlatHash<uint64_t>{}(key.mac ^ std::hash<Uuid128>{}(key.uuid) ^ (uint64_t(key.field) << 48));
+    }
+};
+
+struct HistoryPoint {
+    int64_t tsMs;
+    double value;
+};
+
+struct HistoryBucket {
+    int64_t startMs;
+    double min;
+    double max;
+    double avg;
+    uint32_t count;
+};
+
+class TimeSeries;
+
+class TimeSeriesStore {
+public:
+    static constexpr uint32_t SEGMENT_BYTES = 4096;
+    static constexpr uint32_t DEFAULT_SEGMENTS = 4096; // 16 MiB per series, ~30 days at 1 Hz
+
+    explicit TimeSeriesStore(std::string dir, uint32_t segmentsPerSeries = DEFAULT_SEGMENTS);
+    ~TimeSeriesStore();
+
+    TimeSeriesStore(const TimeSeriesStore&) = delete;
+    TimeSeriesStore& operator=(const TimeSeriesStore&) = delete;
+
+    bool append(const SeriesKey& key, double scale, int64_t tsMs, int64_t raw);
+
+    // Points in [fromMs, toMs], oldest first, at most limit of them (the newest are kept)
+    bool query(const SeriesKey& key, int64_t fromMs, int64_t toMs, size_t limit,
+               std::vector<HistoryPoint>& out);
+
+    // min/max/avg per bucketMs-wide bucket in [fromMs, toMs], empty buckets omitted
+    bool aggregate(const SeriesKey& key, int64_t fromMs, int64_t toMs, int64_t bucketMs,
+                   std::vector<HistoryBucket>& out);
+
+    uint64_t samplesAppended() const { return appended.load(std::memory_order_relaxed); }
+    size_t seriesCount();
+
+private:
+    // Opens (or with create, creates) the series file on first use
+    TimeSeries* series(const SeriesKey& key, double scale, bool create);
+
+    std::string dir;
+    uint32_t segmentsPerSeries;
+    std::mutex mtx;  // guards the map only, each series has its own lock
+    FlatMap<SeriesKey, std::unique_ptr<TimeSeries>> seriesMap;
+    std::atomic<uint64_t> appended{0};
+};
@@ -0,0 +1,208 @@
+#include "trace.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+Tracer tracer;
+
+namespace {
+
+static_assert((Tracer::BUFFER_EVENTS & (Tracer::BUFFER_EVENTS - 1)) == 0, "BUFFER_EVENTS must be a power of two");
+
+// JSON string body: quotes, backslashes and control characters escaped
+void writeEscaped(std::FILE* f, std::string_view text)
+{
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', f);
+            std::fputc(c, f);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            std::fprintf(f, "\\u%04x", c);
+        } else {
+            std::fputc(c, f);
+        }
+    }
+}
+
+} // namespace
+
+Tracer::Tracer() : epoch(Clock::now()) {}
+
+int64_t Tracer::sinceEpochNs(Clock::time_point t) const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - epoch).count();
+}
+
+Tracer::ThreadBuffer& Tracer::local()
+{
+    thread_local std::shared_ptr<ThreadBuffer> mine;
+    if (mine) return *mine;
+
+    auto buffer = std::make_shared<ThreadBuffer>();
+    buffer->tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+    char name[16] = {};
+    if (pthread_getname_np(pthread_self(), name, sizeof name) == 0 && name[0]) buffer->name = name;
+    else buffer->name = "thread " + std::to_string(buffer->tid);
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers.push_back(buffer);
+    }
+    mine = std::move(buffer);
+    return *mine;
+}
+
+void Tracer::record(Kind kind, const char* name, int64_t startNs, int64_t durNs, uint64_t id, std::string_view detail)
+{
+    ThreadBuffer& b = local();
+    uint64_t index = b.head.load(std::memory_order_relaxed);
+    Event& e = b.ring[index & (BUFFER_EVENTS - 1)];
+
+    // seq 0 tells flush() the slot is being rewritten
+    e.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name = name;
+    e.startNs = startNs;
+    e.durNs = durNs;
+    e.id = id;
+    e.kind = kind;
+    e.detailLen = static_cast<uint8_t>(detail.size() < DETAIL_MAX ? detail.size() : DETAIL_MAX);
+    std::memcpy(e.detail, detail.data(), e.detailLen);
+    e.seq.store(index + 1, std::memory_order_release);
+
+    b.head.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::complete(const char* name, Clock::time_point start, Clock::time_point end, std::string_view detail)
+{
+    if (!on()) return;
+    record(Kind::Complete, name, sinceEpochNs(start), sinceEpochNs(end) - sinceEpochNs(start), 0, detail);
+}
+
+void Tracer::async(const char* name, Clock::time_point start, Clock::time_point end, std::string_view detail)
+{
+    if (!on()) return;
+    record(Kind::Async, name, sinceEpochNs(start), sinceEpochNs(end) - sinceEpochNs(start),
+           nextAsyncId.fetch_add(1, std::memory_order_relaxed), detail);
+}
+
+void Tracer::instant(const char* name, std::string_view detail)
+{
+    if (!on()) return;
+    record(Kind::Instant, name, sinceEpochNs(Clock::now()), 0, 0, detail);
+}
+
+void Tracer::nameThread(const std::string& name)
+{
+    ThreadBuffer& b = local();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    b.name = name;
+}
+
+size_t Tracer::threads() const
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return buffers.size();
+}
+
+uint64_t Tracer::recorded() const
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t n = retiredCount;
+    for (const auto& b : buffers) n += b->head.load(std::memory_order_relaxed);
+    return n;
+}
+
+/**********************************************************************
+|   flush() takes what every ring holds since the last flush and       |
+|   writes it in the Chrome trace event format: "X" for spans, a       |
+|   "b"/"e" pair for async spans, "i" for instants, "M" for thread     |
+|   names; timestamps in microseconds. A slot is copied only if its    |
+|   sequence number is the same before and after the copy.            |
+***********************************************************************/
+bool Tracer::flush(const std::string& file, size_t& events)
+{
+    std::vector<Record> records;
+    std::vector<std::pair<uint32_t, std::string>> names;
+    uint64_t lostNow = 0;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& b : buffers) {
+            names.emplace_back(b->tid, b->name);
+            uint64_t head = b->head.load(std::memory_order_acquire);
+            uint64_t from = b->tail;
+            if (head - from > BUFFER_EVENTS) {
+                lostNow += head - from - BUFFER_EVENTS;
+                from = head - BUFFER_EVENTS;
+            }
+            for (uint64_t i = from; i < head; ++i) {
+                const Event& e = b->ring[i & (BUFFER_EVENTS - 1)];
+                if (e.seq.load(std::memory_order_acquire) != i + 1) {
+                    ++lostNow;
+                    continue;
+                }
+                Record r{b->tid, e.name, e.startNs, e.durNs, e.id, e.kind, std::string(e.detail, e.detailLen)};
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (e.seq.load(std::memory_order_relaxed) != i + 1) {
+                    ++lostNow;   // overwritten while copied
+                    continue;
+                }
+                records.push_back(std::move(r));
+            }
+            b->tail = head;
+        }
+        // Threads that exited and have nothing left
+        std::erase_if(buffers, [this](const std::shared_ptr<ThreadBuffer>& b) {
+            if (b.use_count() > 1) return false;
+            retiredCount += b->head.load(std::memory_order_relaxed);
+            return true;
+        });
+    }
+    lostCount.fetch_add(lostNow, std::memory_order_relaxed);
+    events = records.size();
+
+    std::FILE* f = std::fopen(file.c_str(), "w");
+    if (!f) return false;
+    int pid = static_cast<int>(::getpid());
+    std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(f, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"ble_handler\"}}",
+                 pid, pid);
+    for (const auto& [tid, name] : names) {
+        std::fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"", pid, tid);
+        writeEscaped(f, name);
+        std::fprintf(f, "\"}}");
+    }
+    auto writeEvent = [&](const Record& r, char ph, int64_t tsNs) {
+        std::fprintf(f, ",\n{\"ph\":\"%c\",\"cat\":\"ble\",\"name\":\"%s\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f", ph, r.name,
+                     pid, r.tid, tsNs / 1000.0);
+        if (ph == 'X') std::fprintf(f, ",\"dur\":%.3f", r.durNs / 1000.0);
+        if (ph == 'b' || ph == 'e') std::fprintf(f, ",\"id\":\"0x%llx\"", static_cast<unsigned long long>(r.id));
+        if (ph == 'i') std::fprintf(f, ",\"s\":\"t\"");
+        if (!r.detail.empty() && ph != 'e') {
+            std::fprintf(f, ",\"args\":{\"detail\":\"");
+            writeEscaped(f, r.detail);
+            std::fprintf(f, "\"}");
+        }
+        std::fprintf(f, "}");
+    };
+    for (const auto& r : records) {
+        switch (r.kind) {
+        case Kind::Complete:
+            writeEvent(r, 'X', r.startNs);
+            break;
+        case Kind::Async:
+            writeEvent(r, 'b', r.startNs);
+            writeEvent(r, 'e', r.startNs + r.durNs);
+            break;
+        case Kind::Instant:
+            writeEvent(r, 'i', r.startNs);
+            break;
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    bool ok = std::fclose(f) == 0;
+    flushCount.fetch_add(1, std::memory_order_relaxed);
+    return ok;
+}
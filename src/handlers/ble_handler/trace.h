@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Opt-in tracing of where the time goes: spans (MQTT receive, JSON parse,
+// dispatch, registry lookup, D-Bus calls, signals, radio waits, publish)
+// written as Chrome trace JSON, which Perfetto UI (ui.perfetto.dev) and
+// chrome://tracing load as is.
+//
+// Every thread writes into its own ring of BUFFER_EVENTS events; a write
+// is a few stores and one release store of the head, with no lock and no
+// allocation (names are string literals, the detail is copied into the
+// event). The oldest events are overwritten when nobody flushes. flush()
+// copies the rings out under a per-slot sequence number, so an event
+// overwritten while it was being copied is skipped rather than torn.
+//
+// While tracing is off a span costs one relaxed load.
+//
+//   TraceSpan span("dispatch", command);            this thread, scope
+//   TraceAsyncSpan wait("radio_wait", command);     may end on another thread
+//   tracer.async("dbus_call", sent, Clock::now());  both ends known
+
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t BUFFER_EVENTS = 8192;   // per thread (about 700 KiB), power of two
+    static constexpr size_t DETAIL_MAX = 40;        // bytes kept of a span's detail
+
+    Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    bool on() const { return enabledFlag.load(std::memory_order_relaxed); }
+    void enable(bool on) { enabledFlag.store(on, std::memory_order_relaxed); }
+
+    // Span on the calling thread
+    void complete(const char* name, Clock::time_point start, Clock::time_point end, std::string_view detail = {});
+    // Span whose ends may be on different threads (a coroutine across a
+    // co_await); shown on its own track
+    void async(const char* name, Clock::time_point start, Clock::time_point end, std::string_view detail = {});
+    // A point in time (a signal arriving)
+    void instant(const char* name, std::string_view detail = {});
+    // Name of the calling thread in the trace; the OS thread name otherwise
+    void nameThread(const std::string& name);
+
+    // Writes the buffered events of every thread to file and drops them
+    // from the buffers; events is how many were written
+    bool flush(const std::string& file, size_t& events);
+
+    size_t threads() const;
+    uint64_t recorded() const;
+    uint64_t lost() const { return lostCount.load(std::memory_order_relaxed); }   // overwritten before a flush
+    uint64_t flushes() const { return flushCount.load(std::memory_order_relaxed); }
+
+private:
+    enum class Kind : uint8_t { Complete, Async, Instant };
+
+    struct Event {
+        std::atomic<uint64_t> seq{0};   // index + 1 once written, 0 while writing
+        const char* name = nullptr;
+        int64_t startNs = 0;            // since the tracer was created
+        int64_t durNs = 0;
+        uint64_t id = 0;                // async spans
+        Kind kind = Kind::Complete;
+        uint8_t detailLen = 0;
+        char detail[DETAIL_MAX];
+    };
+
+    struct ThreadBuffer {
+        uint32_t tid = 0;               // OS thread id
+        std::string name;
+        std::unique_ptr<Event[]> ring{new Event[BUFFER_EVENTS]};
+        std::atomic<uint64_t> head{0};  // written by the owning thread only
+        uint64_t tail = 0;              // flushed up to, under registryMutex
+    };
+
+    // Copy of an event taken by flush()
+    struct Record {
+        uint32_t tid;
+        const char* name;
+        int64_t startNs;
+        int64_t durNs;
+        uint64_t id;
+        Kind kind;
+        std::string detail;
+    };
+
+    ThreadBuffer& local();
+    void record(Kind kind, const char* name, int64_t startNs, int64_t durNs, uint64_t id, std::string_view detail);
+    int64_t sinceEpochNs(Clock::time_point t) const;
+
+    const Clock::time_point epoch;
+    std::atomic<bool> enabledFlag{false};
+    std::atomic<uint64_t> nextAsyncId{1};
+    mutable std::mutex registryMutex;   // threads registering, flush
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;   // kept after a thread exits, until flushed
+    uint64_t retiredCount = 0;          // events of buffers dropped since
+
+    std::atomic<uint64_t> lostCount{0};
+    std::atomic<uint64_t> flushCount{0};
+};
+
+extern Tracer tracer;
+
+// Span over a scope on one thread
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, std::string_view detail = {}) : name(tracer.on() ? name : nullptr) {
+        if (!this->name) return;
+        start = Tracer::Clock::now();
+        detailLen = detail.size() < Tracer::DETAIL_MAX ? detail.size() : Tracer::DETAIL_MAX;
+        std::memcpy(detailBuf, detail.data(), detailLen);
+    }
+    ~TraceSpan() {
+        if (name) tracer.complete(name, start, Tracer::Clock::now(), std::string_view(detailBuf, detailLen));
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    Tracer::Clock::time_point start;
+    size_t detailLen = 0;
+    char detailBuf[Tracer::DETAIL_MAX];
+};
+
+// Span over a scope in a coroutine: it may suspend and end on another thread
+class TraceAsyncSpan {
+public:
+    explicit TraceAsyncSpan(const char* name, std::string_view detail = {}) : name(tracer.on() ? name : nullptr) {
+        if (!this->name) return;
+        start = Tracer::Clock::now();
+        detailLen = detail.size() < Tracer::DETAIL_MAX ? detail.size() : Tracer::DETAIL_MAX;
+        std::memcpy(detailBuf, detail.data(), detailLen);
+    }
+    ~TraceAsyncSpan() {
+        if (name) tracer.async(name, start, Tracer::Clock::now(), std::string_view(detailBuf, detailLen));
+    }
+
+    TraceAsyncSpan(const TraceAsyncSpan&) = delete;
+    TraceAsyncSpan& operator=(const TraceAsyncSpan&) = delete;
+
+private:
+    const char* name;
+    Tracer::Clock::time_point start;
+    size_t detailLen = 0;
+    char detailBuf[Tracer::DETAIL_MAX];
+};